@@ -0,0 +1,7 @@
+// Parsing numbers from strings (as used by JSON.parse, parseFloat, Number())
+var s = "[";
+for (var i=0;i<200;i++) s += (i?",":"") + (Math.sin(i)*1000).toFixed(i%8) + "," + Math.cos(i) + "," + (i*1e-5+1e-3);
+s += "]";
+var t = getTime();
+for (var n=0;n<50;n++) JSON.parse(s);
+print("float_parse: "+Math.round((getTime()-t)*1000)+"ms");
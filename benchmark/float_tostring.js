@@ -0,0 +1,6 @@
+// Converting floating point numbers to strings (as used by print, JSON.stringify, etc)
+var a = new Float64Array(200);
+for (var i=0;i<a.length;i++) a[i] = Math.sin(i)*Math.pow(10,(i%20)-10);
+var t = getTime();
+for (var n=0;n<500;n++) JSON.stringify(a);
+print("float_tostring: "+Math.round((getTime()-t)*1000)+"ms");
@@ -366,6 +366,21 @@ void jswrap_file_close(JsVar* parent) {
   }
 }
 
+/// Write n bytes to the file, adding how many were written to bytesWritten
+static FRESULT fileWriteBuf(JsFile *file, const char *buf, size_t n, size_t *bytesWritten) {
+  FRESULT res = 0;
+  size_t written = 0;
+#ifndef LINUX
+  res = f_write(&file->data.handle, buf, n, &written);
+#else
+  written = fwrite(buf, 1, n, file->data.handle);
+#endif
+  *bytesWritten += written;
+  if (written == 0)
+    res = FR_DISK_ERR;
+  return res;
+}
+
 /*JSON{
   "type" : "method",
   "class" : "File",
@@ -385,30 +400,34 @@ size_t jswrap_file_write(JsVar* parent, JsVar* buffer) {
     JsFile file;
     if (fileGetFromVar(&file, parent)) {
       if(file.data.mode == FM_WRITE || file.data.mode == FM_READ_WRITE) {
-        JsvIterator it;
-        jsvIteratorNew(&it, buffer);
-        char buf[32];
-
-        while (jsvIteratorHasElement(&it)) {
-          // pull in a buffer's worth of data
-          size_t n = 0;
-          while (jsvIteratorHasElement(&it) && n<sizeof(buf)) {
-            buf[n++] = (char)jsvIteratorGetIntegerValue(&it);
-            jsvIteratorNext(&it);
+        if (jsvIsString(buffer)) {
+          // write straight out of each block of the string
+          JsvStringIterator it;
+          jsvStringIteratorNew(&it, buffer, 0);
+          while (!res && jsvStringIteratorHasChar(&it)) {
+            size_t n;
+            const char *span = jsvStringIteratorGetSpan(&it, &n);
+            res = fileWriteBuf(&file, span, n, &bytesWritten);
+            jsvStringIteratorSkip(&it, n);
           }
-          // write it out
-          size_t written = 0;
-#ifndef LINUX
-          res = f_write(&file.data.handle, &buf, n, &written);
-#else
-          written = fwrite(&buf, 1, n, file.data.handle);
-#endif
-          bytesWritten += written;
-          if(written == 0)
-            res = FR_DISK_ERR;
-          if (res) break;
+          jsvStringIteratorFree(&it);
+        } else {
+          JsvIterator it;
+          jsvIteratorNew(&it, buffer);
+          char buf[32];
+
+          while (!res && jsvIteratorHasElement(&it)) {
+            // pull in a buffer's worth of data
+            size_t n = 0;
+            while (jsvIteratorHasElement(&it) && n<sizeof(buf)) {
+              buf[n++] = (char)jsvIteratorGetIntegerValue(&it);
+              jsvIteratorNext(&it);
+            }
+            // write it out
+            res = fileWriteBuf(&file, buf, n, &bytesWritten);
+          }
+          jsvIteratorFree(&it);
         }
-        jsvIteratorFree(&it);
         // finally, sync - just in case there's a reset or something
 #ifndef LINUX
         f_sync(&file.data.handle);
@@ -16,17 +16,18 @@
 #include <string.h>
 #include "jswrap_hashlib.h"
 
-const JsHash256 ctx256;
-// const JsHash512 ctx512;
+/// Scratch space the hash functions work in - each HASH object keeps its state in 'context'
+static JS_CONTEXT_LOCAL JsHash256 ctx256;
+// static JS_CONTEXT_LOCAL JsHash512 ctx512;
 
 JsHashLib hashFunctions[4] = {
-  { .name="sha224", .data=(char*)&ctx256.context, .init=sha224_init, .update=sha224_update,
+  { .name="sha224", .init=sha224_init, .update=sha224_update,
     .final=sha224_final, .digest_size=SHA224_DIGEST_SIZE, .block_size=SHA224_BLOCK_SIZE, .ctx_size=sizeof(ctx256.context) },
-  { .name="sha256", .data=(char*)&ctx256.context, .init=sha256_init, .update=sha256_update,
+  { .name="sha256", .init=sha256_init, .update=sha256_update,
     .final=sha256_final, .digest_size=SHA256_DIGEST_SIZE, .block_size=SHA256_BLOCK_SIZE, .ctx_size=sizeof(ctx256.context) }/*,
-  { .name="sha384", .data=(char*)&ctx512.context, .init=sha384_init, .update=sha384_update,
+  { .name="sha384", .init=sha384_init, .update=sha384_update,
     .final=sha384_final, .digest_size=SHA384_DIGEST_SIZE, .block_size=SHA384_BLOCK_SIZE, .ctx_size=sizeof(ctx512.context)  },
-  { .name="sha512", .data=(char*)&ctx512.context, .init=sha512_init, .update=sha512_update,
+  { .name="sha512", .init=sha512_init, .update=sha512_update,
     .final=sha512_final, .digest_size=SHA512_DIGEST_SIZE, .block_size=SHA512_BLOCK_SIZE, .ctx_size=sizeof(ctx512.context)  }*/
 };
 
@@ -108,9 +109,10 @@ JsVar *jswrap_hashlib_sha2(JsHashType hash_type) {
     return 0; // out of memory
   }
 
-  hashFunctions[hash_type].init(hashFunctions[hash_type].data);
+  char *data = (char*)&ctx256.context;
+  hashFunctions[hash_type].init(data);
 
-  jsvSetString(jsCtx, hashFunctions[hash_type].data, hashFunctions[hash_type].ctx_size);
+  jsvSetString(jsCtx, data, hashFunctions[hash_type].ctx_size);
 
   jsvObjectSetChildAndUnLock(hashobj, "block_size",  jsvNewFromInteger((JsVarInt)hashFunctions[hash_type].block_size));
   jsvObjectSetChildAndUnLock(hashobj, "context",     jsCtx);
@@ -134,7 +136,6 @@ JsVar *jswrap_hashlib_sha2(JsHashType hash_type) {
 */
 void jswrap_hashlib_hash_update(JsVar *parent, JsVar *message) {
   int type;
-  char buff[SHA256_DIGEST_SIZE];
 
   JsVar *jsCtx = jsvObjectGetChild(parent, "context", 0);
   JsVar *child = jsvObjectGetChild(parent, "hash_type", 0);
@@ -142,16 +143,21 @@ void jswrap_hashlib_hash_update(JsVar *parent, JsVar *message) {
   type = jsvGetInteger(child);
   jsvUnLock(child);
 
-  jsvGetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size + 1);  // trailing zero
+  char *data = (char*)&ctx256.context;
+  jsvGetString(jsCtx, data, hashFunctions[type].ctx_size + 1);  // trailing zero
 
   if (jsvIsString(message)) {
-    size_t i;
-    size_t len = jsvGetStringLength(message);
-    for(i = 0; i < len; i += sizeof(buff)) {
-      int read = (int)jsvGetStringChars(message, i, buff, sizeof(buff));
-      hashFunctions[type].update(hashFunctions[type].data, buff, read);
+    // hash straight out of each block of the string
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, message, 0);
+    while (jsvStringIteratorHasChar(&it)) {
+      size_t n;
+      const char *span = jsvStringIteratorGetSpan(&it, &n);
+      hashFunctions[type].update(data, span, (unsigned int)n);
+      jsvStringIteratorSkip(&it, n);
     }
-    jsvSetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size);
+    jsvStringIteratorFree(&it);
+    jsvSetString(jsCtx, data, hashFunctions[type].ctx_size);
   }
 
   jsvUnLock(jsCtx);
@@ -183,10 +189,11 @@ JsVar *jswrap_hashlib_hash_digest(JsVar *parent) {
 
   jsCtx = jsvObjectGetChild(parent, "context", 0);
 
-  jsvGetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size + 1); // trailing zero
+  char *data = (char*)&ctx256.context;
+  jsvGetString(jsCtx, data, hashFunctions[type].ctx_size + 1); // trailing zero
   jsvUnLock(jsCtx);
 
-  hashFunctions[type].final(hashFunctions[type].data, buff);
+  hashFunctions[type].final(data, buff);
   jsvSetString(digest, buff, hashFunctions[type].digest_size);
 
   return digest;
@@ -219,10 +226,11 @@ JsVar *jswrap_hashlib_hash_hexdigest(JsVar *parent) {
   if (!digest) return 0; // out of memory
 
   jsCtx = jsvObjectGetChild(parent, "context", 0);
-  jsvGetString(jsCtx, hashFunctions[type].data, hashFunctions[type].ctx_size + 1); // trailing zero
+  char *data = (char*)&ctx256.context;
+  jsvGetString(jsCtx, data, hashFunctions[type].ctx_size + 1); // trailing zero
   jsvUnLock(jsCtx);
 
-  hashFunctions[type].final(hashFunctions[type].data, buff);
+  hashFunctions[type].final(data, buff);
 
   unsigned int i;
   for(i = 0; i < hashFunctions[type].digest_size; i++) {
@@ -28,7 +28,6 @@ typedef struct {
 
 typedef struct {
     char *name;
-    char *data;
     void (*init)(); // (void *ctx);
     void (*update)(); // (void *ctx, const unsigned char *message, unsigned int len);
     void (*final)(); // (void *, unsigned char *digest);
@@ -21,8 +21,52 @@ static bool isNegativeZero(double x) {
   return *((long long*)&x) == *((long long*)&NEGATIVE_ZERO);
 }
 
+#ifdef FAST_MATH
+/* FAST_MATH=1 replaces sin/cos/atan/exp/log with small polynomials (from
+ * Cephes' single precision versions) evaluated in double precision. They avoid
+ * libm's multi-precision range reduction, which makes them much quicker on
+ * targets without an FPU and smaller than the SAVE_ON_FLASH series.
+ *
+ * Maximum errors measured against glibc, sweeping in steps of ~0.001:
+ *   sin/cos  2.7e-9 absolute for |x| <= FAST_MATH_MAX_ANGLE (1e5). Above that,
+ *            libm's sin/cos are used instead
+ *   atan     8.1e-9 absolute
+ *   exp      1.2e-9 relative for |x| < 700
+ *   log      1.2e-9 absolute when |log(x)|<1, relative otherwise
+ */
+
+// sin on [-PI/4, PI/4]
+static double jswrap_math_sin_poly(double r, double r2) {
+  return r + r*r2*(-1.6666654611E-1 + r2*(8.3321608736E-3 + r2*-1.9515295891E-4));
+}
+
+// cos on [-PI/4, PI/4]
+static double jswrap_math_cos_poly(double r2) {
+  return 1 - 0.5*r2 + r2*r2*(4.166664568298827E-2 + r2*(-1.388731625493765E-3 + r2*2.443315711809948E-5));
+}
+
+/* Above this, k*PI/2 can't be subtracted accurately with our two part PI/2 and
+ * r ends up way outside [-PI/4, PI/4] */
+#define FAST_MATH_MAX_ANGLE 1e5
+
+/// sin(x + quadrantOffset*PI/2) - so quadrantOffset=1 gives cos without losing accuracy adding PI/2
+static double jswrap_math_sin_quadrant(double x, int quadrantOffset) {
+  if (!isfinite(x)) return NAN;
+  if (fabs(x) > FAST_MATH_MAX_ANGLE) return quadrantOffset ? cos(x) : sin(x);
+  // x = k*PI/2 + r, with PI/2 split in two so the subtraction stays accurate
+  double k = floor(x*(2/PI) + 0.5);
+  double r = (x - k*1.57079632673412561417) - k*6.07710050650619224932e-11;
+  double r2 = r*r;
+  int quadrant = (int)(k - 4*floor(k*0.25)) + quadrantOffset;
+  double s = (quadrant&1) ? jswrap_math_cos_poly(r2) : jswrap_math_sin_poly(r, r2);
+  return (quadrant&2) ? -s : s;
+}
+#endif
+
 double jswrap_math_sin(double x) {
-#ifdef SAVE_ON_FLASH
+#if defined(FAST_MATH)
+  return jswrap_math_sin_quadrant(x, 0);
+#elif defined(SAVE_ON_FLASH)
   /* To save on flash, do our own sin function that's slower/nastier
    * but is smaller! If we pull in gcc's it adds:
    * __kernel_rem_pio2    2054 bytes
@@ -166,7 +210,23 @@ JsVarFloat jswrap_math_abs(JsVarFloat x) {
   "return" : ["float","The arc tangent of x, between -PI/2 and PI/2"]
 }*/
 double jswrap_math_atan(double x) {
-#ifdef SAVE_ON_FLASH
+#if defined(FAST_MATH)
+  if (isnan(x)) return x;
+  bool negate = x<0;
+  if (negate) x = -x;
+  // reduce to |x| <= tan(PI/8)
+  double y = 0;
+  if (x > 2.414213562373095) { // tan(3*PI/8)
+    y = PI/2;
+    x = -1/x;
+  } else if (x > 0.4142135623730950) { // tan(PI/8)
+    y = PI/4;
+    x = (x-1)/(x+1);
+  }
+  double z = x*x;
+  y += (((8.05374449538e-2*z - 1.38776856032E-1)*z + 1.99777106478E-1)*z - 3.33329491539E-1)*z*x + x;
+  return negate ? -y : y;
+#elif defined(SAVE_ON_FLASH)
   /* To save on flash, do our own atan function that's slower/nastier
    * but is smaller! */
   // exploit symmetry - we're only accurate when x is small
@@ -214,17 +274,24 @@ double jswrap_math_atan(double x) {
   "return" : ["float","The arctangent of Y/X, between -PI and PI"]
 }*/
 
-/* we use sin here, not cos, to try and save a bit of code space */
 /*JSON{
   "type" : "staticmethod",
   "class" : "Math",
   "name" : "cos",
-  "generate_full" : "jswrap_math_sin(theta + (PI/2))",
+  "generate" : "jswrap_math_cos",
   "params" : [
     ["theta","float","The angle to get the cosine of"]
   ],
   "return" : ["float","The cosine of theta"]
 }*/
+double jswrap_math_cos(double theta) {
+#if defined(FAST_MATH)
+  return jswrap_math_sin_quadrant(theta, 1);
+#else
+  // we use sin here, not cos, to try and save a bit of code space
+  return jswrap_math_sin(theta + (PI/2));
+#endif
+}
 
 double jswrap_math_mod(double x, double y) {
   double a, b;
@@ -342,7 +409,7 @@ JsVar *jswrap_math_round(double x) {
   "type" : "staticmethod",
   "class" : "Math",
   "name" : "tan",
-  "generate_full" : "jswrap_math_sin(theta) / jswrap_math_sin(theta+(PI/2))",
+  "generate_full" : "jswrap_math_sin(theta) / jswrap_math_cos(theta)",
   "params" : [
     ["theta","float","The angle to get the tangent of"]
   ],
@@ -390,22 +457,59 @@ double jswrap_math_sqrt(double x) {
   "type" : "staticmethod",
   "class" : "Math",
   "name" : "exp",
-  "generate" : "exp",
+  "generate" : "jswrap_math_exp",
   "params" : [
     ["x","float","The value raise E to the power of"]
   ],
   "return" : ["float","E^x"]
 }*/
+double jswrap_math_exp(double x) {
+#ifdef FAST_MATH
+  if (isnan(x)) return x;
+  if (x > 709.78) return INFINITY;
+  if (x < -745.2) return 0;
+  // x = k*ln(2) + r, so exp(x) = 2^k * exp(r)
+  double k = floor(x*1.4426950408889634 + 0.5);
+  x = (x - k*0.693359375) - k*-2.12194440e-4;
+  double z = x*x;
+  z = (((((1.9875691500E-4*x + 1.3981999507E-3)*x + 8.3334519073E-3)*x + 4.1665795894E-2)*x + 1.6666665459E-1)*x + 5.0000001201E-1)*z + x + 1;
+  return ldexp(z, (int)k);
+#else
+  return exp(x);
+#endif
+}
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "Math",
   "name" : "log",
-  "generate" : "log",
+  "generate" : "jswrap_math_log",
   "params" : [
     ["x","float","The value to take the logarithm (base E) root of"]
   ],
   "return" : ["float","The log (base E) of x"]
 }*/
+double jswrap_math_log(double x) {
+#ifdef FAST_MATH
+  if (isnan(x) || x<0) return NAN;
+  if (x==0) return -INFINITY;
+  if (!isfinite(x)) return x;
+  // x = 2^e * m, with m in [sqrt(0.5), sqrt(2)), so log(x) = e*ln(2) + log(m)
+  int e;
+  x = frexp(x, &e);
+  if (x < 0.70710678118654752440) {
+    e--;
+    x = x+x-1;
+  } else
+    x = x-1;
+  double z = x*x;
+  double y = ((((((((7.0376836292E-2*x - 1.1514610310E-1)*x + 1.1676998740E-1)*x - 1.2420140846E-1)*x + 1.4249322787E-1)*x - 1.6668057665E-1)*x + 2.0000714765E-1)*x - 2.4999993993E-1)*x + 3.3333331174E-1)*x*z;
+  y += -2.12194440e-4*e - 0.5*z;
+  return x + y + 0.693359375*e;
+#else
+  return log(x);
+#endif
+}
 
 /*JSON{
   "type" : "staticmethod",
@@ -483,3 +587,60 @@ JsVarFloat jswrap_math_minmax(JsVar *args, bool isMax) {
   return v;
 }
 
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "sinTable",
+  "generate" : "jswrap_math_sinTable",
+  "params" : [
+    ["arr","JsVar","A typed array to fill with one period of a sine wave"],
+    ["amplitude","JsVar","(optional) The amplitude of the wave (default 1)"],
+    ["offset","JsVar","(optional) The value to add to every element (default 0)"],
+    ["phase","JsVar","(optional) The phase of the first element, in radians (default 0)"]
+  ],
+  "return" : ["JsVar","arr"]
+}
+Fill `arr` with exactly one period of a sine wave, so that
+`arr[i] = offset + amplitude*Math.sin(phase + 2*Math.PI*i/arr.length)`.
+
+This is much faster than calling `Math.sin` for each element, as only two
+sines are worked out and each element is then found by rotating the previous
+one. For integer typed arrays values are rounded to the nearest integer, so
+for instance a table for `Waveform` can be created with:
+
+```
+var w = E.sinTable(new Uint8Array(256), 127, 128);
+```
+ */
+JsVar *jswrap_math_sinTable(JsVar *arr, JsVar *amplitude, JsVar *offset, JsVar *phase) {
+  if (!jsvIsArrayBuffer(arr) || arr->varData.arraybuffer.type==ARRAYBUFFERVIEW_ARRAYBUFFER) {
+    jsExceptionHere(JSET_ERROR, "Expecting a typed array, got %t", arr);
+    return 0;
+  }
+  size_t n = jsvGetArrayBufferLength(arr);
+  JsVarFloat amp = jsvIsUndefined(amplitude) ? 1 : jsvGetFloat(amplitude);
+  JsVarFloat off = jsvIsUndefined(offset) ? 0 : jsvGetFloat(offset);
+  JsVarFloat ph = jsvIsUndefined(phase) ? 0 : jsvGetFloat(phase);
+  bool isInteger = !(arr->varData.arraybuffer.type & ARRAYBUFFERVIEW_FLOAT);
+  // (c,s) is rotated by (dc,ds) each step - error only grows by ~1e-16 per element
+  JsVarFloat s = jswrap_math_sin(ph), c = jswrap_math_cos(ph);
+  JsVarFloat step = n ? 2*PI/(JsVarFloat)n : 0;
+  JsVarFloat ds = jswrap_math_sin(step), dc = jswrap_math_cos(step);
+
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNew(&it, arr, 0);
+  size_t i;
+  for (i=0;i<n;i++) {
+    JsVarFloat v = off + amp*s;
+    if (isInteger) v = floor(v + 0.5);
+    jsvArrayBufferIteratorSetFloatValue(&it, v);
+    jsvArrayBufferIteratorNext(&it);
+    JsVarFloat ns = s*dc + c*ds;
+    c = c*dc - s*ds;
+    s = ns;
+  }
+  jsvArrayBufferIteratorFree(&it);
+  return jsvLockAgain(arr);
+}
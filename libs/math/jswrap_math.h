@@ -26,6 +26,10 @@ double jswrap_math_pow(double x, double y);
 JsVar *jswrap_math_round(double x);
 double jswrap_math_sqrt(double x);
 double jswrap_math_sin(double x);
+double jswrap_math_cos(double theta);
 double jswrap_math_atan(double x);
+double jswrap_math_exp(double x);
+double jswrap_math_log(double x);
 JsVarFloat jswrap_math_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max);
 JsVarFloat jswrap_math_minmax(JsVar *args, bool isMax);
+JsVar *jswrap_math_sinTable(JsVar *arr, JsVar *amplitude, JsVar *offset, JsVar *phase);
@@ -0,0 +1,331 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Small matrix and quaternion operations on typed arrays (E.matMul, etc)
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_matrix.h"
+#include "jswrap_math.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+/* Matrices are square (2x2, 3x3 or 4x4) and stored row by row in a
+ * Float32Array or Float64Array, so the size is worked out from the length.
+ * Quaternions are Float32Array/Float64Array of [w,x,y,z].
+ *
+ * Everything is copied into doubles on the stack, worked out there and
+ * then written back - so it's fine for the output to be one of the inputs. */
+
+#define JSWMAT_MAX_ELEMENTS 16
+
+/** Read up to JSWMAT_MAX_ELEMENTS values from a float typed array into data.
+ * Returns the array's real length (which callers must check), or 0 on error */
+static size_t jswrap_matrix_load(JsVar *arr, JsVarFloat *data, const char *what) {
+  if (!jsvIsArrayBuffer(arr) || !(arr->varData.arraybuffer.type & ARRAYBUFFERVIEW_FLOAT)) {
+    jsExceptionHere(JSET_ERROR, "Expecting %s to be a Float32Array or Float64Array, got %t", what, arr);
+    return 0;
+  }
+  size_t n = jsvGetArrayBufferLength(arr);
+  size_t count = (n > JSWMAT_MAX_ELEMENTS) ? JSWMAT_MAX_ELEMENTS : n;
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNew(&it, arr, 0);
+  size_t i;
+  for (i=0;i<count;i++) {
+    data[i] = jsvArrayBufferIteratorGetFloatValue(&it);
+    jsvArrayBufferIteratorNext(&it);
+  }
+  jsvArrayBufferIteratorFree(&it);
+  return n;
+}
+
+/// Check that out is a float typed array with at least n elements
+static bool jswrap_matrix_checkOutput(JsVar *out, size_t n) {
+  if (!jsvIsArrayBuffer(out) || !(out->varData.arraybuffer.type & ARRAYBUFFERVIEW_FLOAT) ||
+      jsvGetArrayBufferLength(out) < n) {
+    jsExceptionHere(JSET_ERROR, "Expecting output to be a Float32Array or Float64Array of at least %d elements, got %t", (int)n, out);
+    return false;
+  }
+  return true;
+}
+
+/// Write n values into out (which must have been checked with jswrap_matrix_checkOutput), and return it
+static JsVar *jswrap_matrix_store(JsVar *out, const JsVarFloat *data, size_t n) {
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNew(&it, out, 0);
+  size_t i;
+  for (i=0;i<n;i++) {
+    jsvArrayBufferIteratorSetFloatValue(&it, data[i]);
+    jsvArrayBufferIteratorNext(&it);
+  }
+  jsvArrayBufferIteratorFree(&it);
+  return jsvLockAgain(out);
+}
+
+/// Return the number of rows/columns of a square matrix with n elements, or 0 (and raise an exception)
+static int jswrap_matrix_getSize(size_t n) {
+  if (n==4) return 2;
+  if (n==9) return 3;
+  if (n==16) return 4;
+  jsExceptionHere(JSET_ERROR, "Expecting a 2x2, 3x3 or 4x4 matrix (4, 9 or 16 elements), got %d elements", (int)n);
+  return 0;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "matMul",
+  "generate" : "jswrap_matrix_mul",
+  "params" : [
+    ["a","JsVar","A 2x2, 3x3 or 4x4 matrix"],
+    ["b","JsVar","A matrix the same size as `a`, or a vector with as many elements as `a` has rows"],
+    ["out","JsVar","The array to write the result into (may be `a` or `b`)"]
+  ],
+  "return" : ["JsVar","out"]
+}
+Multiply matrix `a` by matrix or column vector `b`, writing the result into
+`out`. Matrices are `Float32Array` or `Float64Array` with 4, 9 or 16 elements,
+stored row by row.
+
+```
+var rot = new Float32Array([0,-1,0, 1,0,0, 0,0,1]); // 90 degrees about z
+var v = new Float32Array([1,0,0]);
+E.matMul(rot, v, v); // v is now [0,1,0]
+```
+ */
+JsVar *jswrap_matrix_mul(JsVar *a, JsVar *b, JsVar *out) {
+  JsVarFloat ma[JSWMAT_MAX_ELEMENTS], mb[JSWMAT_MAX_ELEMENTS], r[JSWMAT_MAX_ELEMENTS];
+  size_t na = jswrap_matrix_load(a, ma, "a");
+  if (!na) return 0;
+  int size = jswrap_matrix_getSize(na);
+  if (!size) return 0;
+  size_t nb = jswrap_matrix_load(b, mb, "b");
+  if (!nb) return 0;
+  int cols;
+  if (nb==na) cols = size;
+  else if (nb==(size_t)size) cols = 1;
+  else {
+    jsExceptionHere(JSET_ERROR, "Expecting b to have %d or %d elements, got %d", size, (int)na, (int)nb);
+    return 0;
+  }
+  if (!jswrap_matrix_checkOutput(out, nb)) return 0;
+  int i, j, k;
+  for (i=0;i<size;i++) {
+    for (j=0;j<cols;j++) {
+      JsVarFloat sum = 0;
+      for (k=0;k<size;k++)
+        sum += ma[i*size+k] * mb[k*cols+j];
+      r[i*cols+j] = sum;
+    }
+  }
+  return jswrap_matrix_store(out, r, nb);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "matTranspose",
+  "generate" : "jswrap_matrix_transpose",
+  "params" : [
+    ["a","JsVar","A 2x2, 3x3 or 4x4 matrix"],
+    ["out","JsVar","(optional) The array to write the result into. If not specified, `a` is transposed in place"]
+  ],
+  "return" : ["JsVar","out (or a)"]
+}
+Transpose the matrix `a`.
+ */
+JsVar *jswrap_matrix_transpose(JsVar *a, JsVar *out) {
+  JsVarFloat m[JSWMAT_MAX_ELEMENTS], r[JSWMAT_MAX_ELEMENTS];
+  size_t n = jswrap_matrix_load(a, m, "a");
+  if (!n) return 0;
+  int size = jswrap_matrix_getSize(n);
+  if (!size) return 0;
+  if (jsvIsUndefined(out)) out = a;
+  if (!jswrap_matrix_checkOutput(out, n)) return 0;
+  int i, j;
+  for (i=0;i<size;i++)
+    for (j=0;j<size;j++)
+      r[j*size+i] = m[i*size+j];
+  return jswrap_matrix_store(out, r, n);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "matInverse",
+  "generate" : "jswrap_matrix_inverse",
+  "params" : [
+    ["a","JsVar","A 2x2, 3x3 or 4x4 matrix"],
+    ["out","JsVar","(optional) The array to write the result into. If not specified, `a` is inverted in place"]
+  ],
+  "return" : ["JsVar","out (or a), or undefined if the matrix couldn't be inverted"]
+}
+Invert the matrix `a`, using Gauss-Jordan elimination with partial pivoting.
+If `a` is singular, `undefined` is returned and `out` isn't modified.
+ */
+JsVar *jswrap_matrix_inverse(JsVar *a, JsVar *out) {
+  JsVarFloat m[JSWMAT_MAX_ELEMENTS], r[JSWMAT_MAX_ELEMENTS];
+  size_t n = jswrap_matrix_load(a, m, "a");
+  if (!n) return 0;
+  int size = jswrap_matrix_getSize(n);
+  if (!size) return 0;
+  if (jsvIsUndefined(out)) out = a;
+  if (!jswrap_matrix_checkOutput(out, n)) return 0;
+  int i, j, k;
+  // r starts as the identity matrix, and every row operation on m is done to it too
+  for (i=0;i<size;i++)
+    for (j=0;j<size;j++)
+      r[i*size+j] = (i==j) ? 1 : 0;
+  for (k=0;k<size;k++) {
+    // swap the row with the largest value in column k up to row k
+    int pivot = k;
+    JsVarFloat best = jswrap_math_abs(m[k*size+k]);
+    for (i=k+1;i<size;i++) {
+      JsVarFloat v = jswrap_math_abs(m[i*size+k]);
+      if (v > best) {
+        best = v;
+        pivot = i;
+      }
+    }
+    if (!(best > 0)) return 0; // singular (or NaN)
+    if (pivot != k) {
+      for (j=0;j<size;j++) {
+        JsVarFloat t;
+        t = m[k*size+j]; m[k*size+j] = m[pivot*size+j]; m[pivot*size+j] = t;
+        t = r[k*size+j]; r[k*size+j] = r[pivot*size+j]; r[pivot*size+j] = t;
+      }
+    }
+    JsVarFloat scale = 1 / m[k*size+k];
+    for (j=0;j<size;j++) {
+      m[k*size+j] *= scale;
+      r[k*size+j] *= scale;
+    }
+    // remove column k from every other row
+    for (i=0;i<size;i++) {
+      if (i==k) continue;
+      JsVarFloat f = m[i*size+k];
+      if (f==0) continue;
+      for (j=0;j<size;j++) {
+        m[i*size+j] -= f*m[k*size+j];
+        r[i*size+j] -= f*r[k*size+j];
+      }
+    }
+  }
+  return jswrap_matrix_store(out, r, n);
+}
+
+/// Load a quaternion into q, returning false (and raising an exception) if it wasn't one
+static bool jswrap_matrix_loadQuat(JsVar *arr, JsVarFloat *q, const char *what) {
+  size_t n = jswrap_matrix_load(arr, q, what);
+  if (!n) return false;
+  if (n!=4) {
+    jsExceptionHere(JSET_ERROR, "Expecting %s to be a quaternion [w,x,y,z], got %d elements", what, (int)n);
+    return false;
+  }
+  return true;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "quatMul",
+  "generate" : "jswrap_matrix_quatMul",
+  "params" : [
+    ["a","JsVar","A quaternion [w,x,y,z]"],
+    ["b","JsVar","A quaternion [w,x,y,z]"],
+    ["out","JsVar","The array to write the result into (may be `a` or `b`)"]
+  ],
+  "return" : ["JsVar","out"]
+}
+Work out the Hamilton product `a*b` of two quaternions - the rotation `b`
+followed by the rotation `a`. Quaternions are `Float32Array` or `Float64Array`
+of `[w,x,y,z]`.
+ */
+JsVar *jswrap_matrix_quatMul(JsVar *a, JsVar *b, JsVar *out) {
+  JsVarFloat qa[JSWMAT_MAX_ELEMENTS], qb[JSWMAT_MAX_ELEMENTS], r[4];
+  if (!jswrap_matrix_loadQuat(a, qa, "a") ||
+      !jswrap_matrix_loadQuat(b, qb, "b") ||
+      !jswrap_matrix_checkOutput(out, 4)) return 0;
+  r[0] = qa[0]*qb[0] - qa[1]*qb[1] - qa[2]*qb[2] - qa[3]*qb[3];
+  r[1] = qa[0]*qb[1] + qa[1]*qb[0] + qa[2]*qb[3] - qa[3]*qb[2];
+  r[2] = qa[0]*qb[2] - qa[1]*qb[3] + qa[2]*qb[0] + qa[3]*qb[1];
+  r[3] = qa[0]*qb[3] + qa[1]*qb[2] - qa[2]*qb[1] + qa[3]*qb[0];
+  return jswrap_matrix_store(out, r, 4);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "quatNormalize",
+  "generate" : "jswrap_matrix_quatNormalize",
+  "params" : [
+    ["q","JsVar","A quaternion [w,x,y,z]"],
+    ["out","JsVar","(optional) The array to write the result into. If not specified, `q` is normalized in place"]
+  ],
+  "return" : ["JsVar","out (or q)"]
+}
+Scale the quaternion `q` so that its length is 1. A quaternion of length 0
+is left as it is.
+ */
+JsVar *jswrap_matrix_quatNormalize(JsVar *q, JsVar *out) {
+  JsVarFloat r[JSWMAT_MAX_ELEMENTS];
+  if (!jswrap_matrix_loadQuat(q, r, "q")) return 0;
+  if (jsvIsUndefined(out)) out = q;
+  if (!jswrap_matrix_checkOutput(out, 4)) return 0;
+  JsVarFloat len = jswrap_math_sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2] + r[3]*r[3]);
+  if (len > 0) {
+    int i;
+    for (i=0;i<4;i++) r[i] /= len;
+  }
+  return jswrap_matrix_store(out, r, 4);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "quatRotate",
+  "generate" : "jswrap_matrix_quatRotate",
+  "params" : [
+    ["q","JsVar","A unit quaternion [w,x,y,z]"],
+    ["v","JsVar","A 3 element vector [x,y,z]"],
+    ["out","JsVar","(optional) The array to write the result into. If not specified, `v` is rotated in place"]
+  ],
+  "return" : ["JsVar","out (or v)"]
+}
+Rotate the vector `v` by the quaternion `q` (which should have been normalized).
+ */
+JsVar *jswrap_matrix_quatRotate(JsVar *q, JsVar *v, JsVar *out) {
+  JsVarFloat qa[JSWMAT_MAX_ELEMENTS], va[JSWMAT_MAX_ELEMENTS], r[3];
+  if (!jswrap_matrix_loadQuat(q, qa, "q")) return 0;
+  size_t n = jswrap_matrix_load(v, va, "v");
+  if (!n) return 0;
+  if (n!=3) {
+    jsExceptionHere(JSET_ERROR, "Expecting v to be a vector [x,y,z], got %d elements", (int)n);
+    return 0;
+  }
+  if (jsvIsUndefined(out)) out = v;
+  if (!jswrap_matrix_checkOutput(out, 3)) return 0;
+  // v' = v + w*t + cross(q.xyz, t), where t = 2*cross(q.xyz, v)
+  JsVarFloat w = qa[0], x = qa[1], y = qa[2], z = qa[3];
+  JsVarFloat tx = 2*(y*va[2] - z*va[1]);
+  JsVarFloat ty = 2*(z*va[0] - x*va[2]);
+  JsVarFloat tz = 2*(x*va[1] - y*va[0]);
+  r[0] = va[0] + w*tx + (y*tz - z*ty);
+  r[1] = va[1] + w*ty + (z*tx - x*tz);
+  r[2] = va[2] + w*tz + (x*ty - y*tx);
+  return jswrap_matrix_store(out, r, 3);
+}
@@ -0,0 +1,21 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Small matrix and quaternion operations on typed arrays
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_matrix_mul(JsVar *a, JsVar *b, JsVar *out);
+JsVar *jswrap_matrix_transpose(JsVar *a, JsVar *out);
+JsVar *jswrap_matrix_inverse(JsVar *a, JsVar *out);
+JsVar *jswrap_matrix_quatMul(JsVar *a, JsVar *b, JsVar *out);
+JsVar *jswrap_matrix_quatNormalize(JsVar *q, JsVar *out);
+JsVar *jswrap_matrix_quatRotate(JsVar *q, JsVar *v, JsVar *out);
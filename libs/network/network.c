@@ -46,7 +46,7 @@ JsNetworkState networkState =
 #endif
     ;
 
-JsNetwork *networkCurrentStruct = 0;
+JS_CONTEXT_LOCAL JsNetwork *networkCurrentStruct = 0;
 
 uint32_t networkParseIPAddress(const char *ip) {
   int n = 0;
@@ -288,7 +288,7 @@ typedef struct {
   mbedtls_ssl_config conf;
 } SSLSocketData;
 
-BITFIELD_DECL(socketIsHTTPS, 32);
+JS_CONTEXT_LOCAL BITFIELD_DECL(socketIsHTTPS, 32); // the SSL data for these sockets is in this context's root
 
 static void ssl_debug( void *ctx, int level,
                       const char *file, int line, const char *str )
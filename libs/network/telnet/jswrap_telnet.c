@@ -32,7 +32,7 @@ extern int os_printf_plus(const char *format, ...)  __attribute__((format(printf
 
 #ifdef LINUX
 #define PORT 2323 // avoid needing root permissions
-bool telnetEnabled = false; // whether telnet should be enabled or not. Set in main.c
+JS_CONTEXT_LOCAL bool telnetEnabled = false; // whether telnet should be enabled or not. Set in main.c
 #else
 #define PORT 23
 #endif
@@ -61,8 +61,8 @@ typedef struct {
   IOEventFlags oldConsole;       // device the console was stolen from
 } TelnetServer;
 
-static TelnetServer tnSrv;        // the telnet server, only one right now
-static uint8_t      tnSrvMode;    // current mode for the telnet server
+static JS_CONTEXT_LOCAL TelnetServer tnSrv; // the telnet server, only one right now
+static JS_CONTEXT_LOCAL uint8_t tnSrvMode;  // current mode for the telnet server
 
 /*JSON{
   "type"  : "library",
@@ -253,7 +253,7 @@ bool telnetSendBuf(JsNetwork *net) {
   return sent != 0;
 }
 
-static bool ovf;
+static JS_CONTEXT_LOCAL bool ovf;
 
 void telnetSendChar(char ch) {
   if (tnSrv.sock == 0 || tnSrv.cliSock == 0) return;
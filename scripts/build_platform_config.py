@@ -266,6 +266,7 @@ codeOut("#define FLASH_TOTAL ("+str(board.chip['flash'])+"*1024)")
 codeOut("");
 if LINUX:
   codeOut('#define RESIZABLE_JSVARS // Allocate variables in blocks using malloc')
+  codeOut('#define LARGE_ARRAYBUFFERS // Allow ArrayBuffers and typed arrays bigger than 64kB')
   #codeOut("#define JSVAR_CACHE_SIZE                "+str(200)+" // Number of JavaScript variables in RAM")
 else:
   codeOut("#define JSVAR_CACHE_SIZE                "+str(variables)+" // Number of JavaScript variables in RAM")
@@ -25,6 +25,8 @@ if silent:
   class Discarder(object):
     def write(self, text):
         pass # do nothing
+    def flush(self):
+        pass # Python 3 flushes stdout on exit
   # now discard everything coming out of stdout
   sys.stdout = Discarder()
 
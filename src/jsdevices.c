@@ -31,22 +31,84 @@ JshEventCallbackCallback jshEventCallbacks[EV_EXTI_MAX+1-EV_EXTI0];
 //                                                         DATA TRANSMIT BUFFER
 
 /**
- * A single character to be transmitted.
+ * The devices that have a transmit buffer. Loopback and Telnet
+ * send their data directly so don't need one.
  */
-typedef struct {
-  IOEventFlags flags; //!< Where this data should be transmitted
-  unsigned char data; //!< data to transmit
-} PACKED_FLAGS TxBufferItem;
+typedef enum {
+  TXBUFFER_LIMBO,
+#ifdef USB
+  TXBUFFER_USBSERIAL,
+#endif
+#ifdef BLUETOOTH
+  TXBUFFER_BLUETOOTH,
+#endif
+  TXBUFFER_SERIAL1,
+  TXBUFFER_SPI1 = TXBUFFER_SERIAL1 + USART_COUNT,
+#ifdef LINUX // on Linux, SPI data goes through the transmit buffer too
+  TXBUFFER_COUNT = TXBUFFER_SPI1 + SPI_COUNT
+#else
+  TXBUFFER_COUNT = TXBUFFER_SPI1
+#endif
+} PACKED_FLAGS TxBufferIndex;
+
+#if !defined(LINUX) && RAM_TOTAL < 20*1024
+/* Parts with little RAM share what the old single transmit buffer used
+ * (2*(TXBUFFERMASK+1) bytes) between all the rings - each ring's size must
+ * be a power of 2, and head/tail/flowControlChar take 3 bytes */
+#define TXRING_BYTES (2*(TXBUFFERMASK+1) / TXBUFFER_COUNT - 3)
+#define TXRINGMASK ((TXRING_BYTES>=32) ? 31 : (TXRING_BYTES>=16) ? 15 : (TXRING_BYTES>=8) ? 7 : 3)
+#else
+#define TXRINGMASK TXBUFFERMASK
+#endif
 
 /**
- * An array of items to transmit.
+ * A ring buffer of characters waiting to be transmitted on one device.
+ * Each device has its own, so a driver can take a contiguous span of
+ * data at once (see jshGetTransmitChunk) without scanning past other
+ * devices' data.
  */
-volatile TxBufferItem txBuffer[TXBUFFERMASK+1];
+typedef struct {
+  volatile unsigned char data[TXRINGMASK+1]; //!< data to transmit
+  volatile unsigned char head; //!< where the next character will be added
+  volatile unsigned char tail; //!< the next character to be transmitted
+  volatile unsigned char flowControlChar; //!< XON/XOFF handed out by jshGetTransmitChunk but not yet sent
+} PACKED_FLAGS TxBuffer;
 
 /**
- * The head and tail of the list.
+ * The transmit buffers for each device
  */
-volatile unsigned char txHead=0, txTail=0;
+TxBuffer txBuffers[TXBUFFER_COUNT];
+
+/// Get the transmit buffer for the given device, or 0 if it doesn't have one
+static TxBuffer *jshGetTxBuffer(IOEventFlags device) {
+  if (device==EV_LIMBO) return &txBuffers[TXBUFFER_LIMBO];
+#ifdef USB
+  if (device==EV_USBSERIAL) return &txBuffers[TXBUFFER_USBSERIAL];
+#endif
+#ifdef BLUETOOTH
+  if (device==EV_BLUETOOTH) return &txBuffers[TXBUFFER_BLUETOOTH];
+#endif
+  if (device>=EV_SERIAL1 && device<EV_SERIAL1+USART_COUNT)
+    return &txBuffers[TXBUFFER_SERIAL1 + device - EV_SERIAL1];
+#ifdef LINUX
+  if (device>=EV_SPI1 && device<EV_SPI1+SPI_COUNT)
+    return &txBuffers[TXBUFFER_SPI1 + device - EV_SPI1];
+#endif
+  return 0;
+}
+
+/// Get the device that the transmit buffer with the given index is for
+static IOEventFlags jshGetTxBufferDevice(unsigned int idx) {
+  if (idx==TXBUFFER_LIMBO) return EV_LIMBO;
+#ifdef USB
+  if (idx==TXBUFFER_USBSERIAL) return EV_USBSERIAL;
+#endif
+#ifdef BLUETOOTH
+  if (idx==TXBUFFER_BLUETOOTH) return EV_BLUETOOTH;
+#endif
+  if (idx<TXBUFFER_SPI1) return (IOEventFlags)(EV_SERIAL1 + idx - TXBUFFER_SERIAL1);
+  return (IOEventFlags)(EV_SPI1 + idx - TXBUFFER_SPI1);
+}
 
 typedef enum {
   SDS_NONE,
@@ -123,87 +185,179 @@ void jshTransmit(
     return;
   }
 #endif
-  // If the device is EV_NONE then there is nowhere to send the data.
-  if (device==EV_NONE) return;
+  // If the device has no buffer (eg. EV_NONE) then there is nowhere to send the data.
+  TxBuffer *buf = jshGetTxBuffer(device);
+  if (!buf) return;
 
-  // The txHead global points to the current item in the txBuffer.  Since we are adding a new
-  // character, we increment the head pointer.   If it has caught up with the tail, then that means
-  // we have filled the array backing the list.  What we do next is to wait for space to free up.
-  unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
-  if (txHeadNext==txTail) {
+  // The head points to where the new character will go. If moving it on would make it
+  // catch up with the tail then the buffer is full, and we wait for space to free up.
+  if (((buf->head+1)&TXRINGMASK)==buf->tail) {
     jsiSetBusy(BUSY_TRANSMIT, true);
     bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
-    while (txHeadNext==txTail) {
+    while (((buf->head+1)&TXRINGMASK)==buf->tail) {
       // wait for send to finish as buffer is about to overflow
 #ifdef USB
       // just in case USB was unplugged while we were waiting!
       if (!jshIsUSBSERIALConnected()) jshTransmitClearDevice(EV_USBSERIAL);
 #endif
-    }
-    if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
-      /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
-      Basically we must have printed a bunch of stuff to LIMBO and blocked
-      with our output buffer full. But then jsiOneSecondAfterStartup
-      switches to the right console device and swaps everything we wrote
-      over to that device too. Only we're now here, still writing to the
-      old device when really we should be writing to the new one. */
-      device = jsiGetConsoleDevice();
+      if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
+        /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
+        Basically we must have printed a bunch of stuff to LIMBO and blocked
+        with our output buffer full. But then jsiOneSecondAfterStartup
+        switches to the right console device and moves everything we wrote
+        over to that device too. Only we're now here, still writing to the
+        old device when really we should be writing to the new one. */
+        wasConsoleLimbo = false;
+        device = jsiGetConsoleDevice();
+        buf = jshGetTxBuffer(device);
+        if (!buf) {
+          jsiSetBusy(BUSY_TRANSMIT, false);
+          jshTransmit(device, data);
+          return;
+        }
+      }
     }
     jsiSetBusy(BUSY_TRANSMIT, false);
   }
-  // Save the device and data for the new character to be transmitted.
-  txBuffer[txHead].flags = device;
-  txBuffer[txHead].data = data;
-  txHead = txHeadNext;
+  // Save the data, and only then move the head on so the driver can see it
+  unsigned char head = buf->head;
+  buf->data[head] = data;
+  buf->head = (unsigned char)((head+1)&TXRINGMASK);
 
   jshUSARTKick(device); // set up interrupts if required
 }
 
-// Return the device at the top of the transmit queue (or EV_NONE)
+/**
+ * Queue several characters for transmission. This copies as much as
+ * possible straight into the device's buffer, only waiting when it is full.
+ */
+void jshTransmitMultiple(
+    IOEventFlags device,       //!< The device to be used for transmission.
+    const unsigned char *data, //!< The characters to transmit.
+    unsigned int len           //!< The number of characters.
+  ) {
+#ifdef LINUX
+  if (device==DEFAULT_CONSOLE_DEVICE) {
+    fwrite(data, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+#else
+#ifdef USB
+  if (device==EV_USBSERIAL && !jshIsUSBSERIALConnected()) {
+    jshTransmitClearDevice(EV_USBSERIAL); // clear out stuff already waiting
+    return;
+  }
+#endif
+#endif
+  TxBuffer *buf = jshGetTxBuffer(device);
+  while (len) {
+    unsigned char head = 0;
+    // contiguous free space after head (leaving one gap so head never catches up with tail)
+    unsigned int space = 0;
+    if (buf) {
+      head = buf->head;
+      unsigned char tail = buf->tail;
+      if (tail>head) space = (unsigned int)(tail-head-1);
+      else space = (unsigned int)(TXRINGMASK+1-head) - (tail==0 ? 1 : 0);
+    }
+    if (!space) {
+      // No buffer, or it's full - jshTransmit deals with it (and waits if needed)
+      jshTransmit(device, *(data++));
+      len--;
+      if (device==EV_LIMBO && jsiGetConsoleDevice()!=EV_LIMBO) {
+        // console was moved while we waited - see jshTransmit
+        jshTransmitMultiple(jsiGetConsoleDevice(), data, len);
+        return;
+      }
+      continue;
+    }
+    if (space>len) space=len;
+    memcpy((unsigned char*)&buf->data[head], data, space);
+    buf->head = (unsigned char)((head+space)&TXRINGMASK);
+    data += space;
+    len -= space;
+    jshUSARTKick(device); // set up interrupts if required
+  }
+}
+
+/* Return a device that has data waiting to be transmitted (or EV_NONE).
+ * Devices are checked round-robin, so one busy device can't starve the rest. */
 IOEventFlags jshGetDeviceToTransmit() {
-  if (!jshHasTransmitData()) return EV_NONE;
-  return IOEVENTFLAGS_GETTYPE(txBuffer[txTail].flags);
+  static unsigned int lastIdx = 0;
+  unsigned int n;
+  for (n=1;n<=TXBUFFER_COUNT;n++) {
+    unsigned int i = (lastIdx+n) % TXBUFFER_COUNT;
+    if (txBuffers[i].head != txBuffers[i].tail) {
+      lastIdx = i;
+      return jshGetTxBufferDevice(i);
+    }
+  }
+  return EV_NONE;
 }
 
 /**
- * Try and get a character for transmission.
- * \return The next byte to transmit or -1 if there is none.
+ * Get the next contiguous block of data waiting to be transmitted on a
+ * device. Once it has been sent (or copied), call jshTransmitChunkDone
+ * with the number of bytes that were used.
+ * \return The number of bytes available at *data (0 if none)
  */
-int jshGetCharToTransmit(
-    IOEventFlags device // The device being looked at for a transmission.
+unsigned int jshGetTransmitChunk(
+    IOEventFlags device,  //!< The device being looked at for a transmission.
+    unsigned char **data  //!< Set to point to the data to transmit
   ) {
+  static const unsigned char flowControlChars[2] = { 17/*XON*/, 19/*XOFF*/ };
+  TxBuffer *buf = jshGetTxBuffer(device);
+  if (!buf) return 0;
   if (DEVICE_IS_USART(device)) {
     JshSerialDeviceState *deviceState = &jshSerialDeviceStates[TO_SERIAL_DEVICE_STATE(device)];
-    if ((*deviceState)&SDS_XOFF_PENDING) {
-      (*deviceState) = ((*deviceState)&(~SDS_XOFF_PENDING)) | SDS_XOFF_SENT;
-      return 19/*XOFF*/;
-    }
-    if ((*deviceState)&SDS_XON_PENDING) {
-      (*deviceState) = ((*deviceState)&(~(SDS_XON_PENDING|SDS_XOFF_SENT)));
-      return 17/*XON*/;
+    if ((*deviceState)&(SDS_XOFF_PENDING|SDS_XON_PENDING)) {
+      // flow control characters go first, on their own
+      buf->flowControlChar = ((*deviceState)&SDS_XOFF_PENDING) ? 19/*XOFF*/ : 17/*XON*/;
+      *data = (unsigned char*)&flowControlChars[buf->flowControlChar==19];
+      return 1;
     }
   }
+  unsigned char head = buf->head, tail = buf->tail;
+  if (head==tail) return 0;
+  *data = (unsigned char*)&buf->data[tail];
+  if (head>tail) return (unsigned int)(head-tail);
+  return (unsigned int)(TXRINGMASK+1-tail); // up to the end of the buffer - the rest comes next time
+}
 
-  unsigned char tempTail = txTail;
-  while (txHead != tempTail) {
-    if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) {
-      unsigned char data = txBuffer[tempTail].data;
-      if (tempTail != txTail) { // so we weren't right at the back of the queue
-        // we need to work back from tempTail (until we hit tail), shifting everything forwards
-        unsigned char this = tempTail;
-        unsigned char last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
-        while (this!=txTail) { // if this==txTail, then last is before it, so stop here
-          txBuffer[this] = txBuffer[last];
-          this = last;
-          last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
-        }
-      }
-      txTail = (unsigned char)((txTail+1)&TXBUFFERMASK); // advance the tail
-      return data; // return data
-    }
-    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+/**
+ * Mark data returned by jshGetTransmitChunk as transmitted
+ */
+void jshTransmitChunkDone(
+    IOEventFlags device, //!< The device data was transmitted on
+    unsigned int len     //!< The number of bytes transmitted
+  ) {
+  TxBuffer *buf = jshGetTxBuffer(device);
+  if (!buf || !len) return;
+  if (buf->flowControlChar) {
+    JshSerialDeviceState *deviceState = &jshSerialDeviceStates[TO_SERIAL_DEVICE_STATE(device)];
+    if (buf->flowControlChar==19/*XOFF*/)
+      (*deviceState) = ((*deviceState)&(~SDS_XOFF_PENDING)) | SDS_XOFF_SENT;
+    else
+      (*deviceState) = ((*deviceState)&(~(SDS_XON_PENDING|SDS_XOFF_SENT)));
+    buf->flowControlChar = 0;
+    return;
   }
-  return -1; // no data :(
+  buf->tail = (unsigned char)((buf->tail+len)&TXRINGMASK);
+}
+
+/**
+ * Try and get a character for transmission.
+ * \return The next byte to transmit or -1 if there is none.
+ */
+int jshGetCharToTransmit(
+    IOEventFlags device // The device being looked at for a transmission.
+  ) {
+  unsigned char *data;
+  if (!jshGetTransmitChunk(device, &data)) return -1; // no data :(
+  int c = *data;
+  jshTransmitChunkDone(device, 1);
+  return c;
 }
 
 void jshTransmitFlush() {
@@ -218,21 +372,40 @@ void jshTransmitFlush() {
 void jshTransmitClearDevice(
     IOEventFlags device //!< The device to be cleared.
   ) {
-  // Keep requesting a character to transmit until there are no further characters.
-  while (jshGetCharToTransmit(device)>=0);
+  TxBuffer *buf = jshGetTxBuffer(device);
+  if (!buf) return;
+  jshInterruptOff();
+  buf->tail = buf->head;
+  buf->flowControlChar = 0;
+  jshInterruptOn();
 }
 
-/// Move all output from one device to another
+/**
+ * Move all output from one device to another. Whatever doesn't fit in the
+ * destination's buffer is sent with jshTransmit, which waits for space - so
+ * none of it is left behind to be sent on the old device.
+ */
 void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
-  jshInterruptOff();
-  unsigned char tempTail = txTail;
-  while (tempTail != txHead) {
-    if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == from) {
-      txBuffer[tempTail].flags = (txBuffer[tempTail].flags&~EV_TYPE_MASK) | to;
+  TxBuffer *fromBuf = jshGetTxBuffer(from);
+  TxBuffer *toBuf = jshGetTxBuffer(to);
+  if (!fromBuf || fromBuf==toBuf) return;
+  if (toBuf) {
+    // copy as much as fits in one go
+    jshInterruptOff();
+    while (fromBuf->tail != fromBuf->head) {
+      unsigned char toHeadNext = (unsigned char)((toBuf->head+1)&TXRINGMASK);
+      if (toHeadNext == toBuf->tail) break; // full
+      toBuf->data[toBuf->head] = fromBuf->data[fromBuf->tail];
+      toBuf->head = toHeadNext;
+      fromBuf->tail = (unsigned char)((fromBuf->tail+1)&TXRINGMASK);
     }
-    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+    jshInterruptOn();
+    jshUSARTKick(to);
   }
-  jshInterruptOn();
+  // anything left has to wait for space on 'to'
+  int c;
+  while ((c=jshGetCharToTransmit(from))>=0)
+    jshTransmit(to, (unsigned char)c);
 }
 
 /**
@@ -240,7 +413,11 @@ void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
  * \return True if we have data to transmit and false otherwise.
  */
 bool jshHasTransmitData() {
-  return txHead != txTail;
+  unsigned int i;
+  for (i=0;i<TXBUFFER_COUNT;i++)
+    if (txBuffers[i].head != txBuffers[i].tail)
+      return true;
+  return false;
 }
 
 /**
@@ -262,7 +439,7 @@ void jshPushIOCharEvent(
   // Check for a CTRL+C
   if (charData==3 && channel==jsiGetConsoleDevice()) {
     // Ctrl-C - force interrupt
-    execInfo.execute |= EXEC_CTRL_C;
+    consoleExecInfo.execute |= EXEC_CTRL_C;
     return;
   }
   // Check for existing buffer (we must have at least 2 in the queue to avoid dropping chars though!)
@@ -26,7 +26,7 @@ void jshInitDevices();
  * Called from jshReset */
 void jshResetDevices();
 
-/** Flags used to describe events put in the txBuffer and ioBuffer queues.
+/** Flags used to describe events put in the ioBuffer queue.
  *
  * This should be 1 byte. Bottom 6 bits are the type of device, and the
  * top 2 bits are extra info (number of characters, serial errors, whether
@@ -164,6 +164,8 @@ JsVar *jshGetDeviceObject(IOEventFlags device);
 //                                                         DATA TRANSMIT BUFFER
 /// Queue a character for transmission
 void jshTransmit(IOEventFlags device, unsigned char data);
+/// Queue several characters for transmission
+void jshTransmitMultiple(IOEventFlags device, const unsigned char *data, unsigned int len);
 /// Wait for transmit to finish
 void jshTransmitFlush();
 /// Clear everything from a device
@@ -176,6 +178,10 @@ bool jshHasTransmitData();
 IOEventFlags jshGetDeviceToTransmit();
 /// Try and get a character for transmission - could just return -1 if nothing
 int jshGetCharToTransmit(IOEventFlags device);
+/// Get the next contiguous block of data to transmit on a device, returning its length (or 0). Call jshTransmitChunkDone once it's sent.
+unsigned int jshGetTransmitChunk(IOEventFlags device, unsigned char **data);
+/// Mark 'len' bytes returned by jshGetTransmitChunk as transmitted
+void jshTransmitChunkDone(IOEventFlags device, unsigned int len);
 
 
 /// Set whether the host should transmit or not
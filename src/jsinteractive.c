@@ -20,6 +20,7 @@
 #include "jswrap_json.h"
 #include "jswrap_io.h"
 #include "jswrap_stream.h"
+#include "jswrap_serial.h"
 #include "jswrap_flash.h" // load and save to flash
 #include "jswrap_object.h" // jswrap_object_keys_or_property_names
 #include "jsnative.h" // jsnSanityTest
@@ -32,6 +33,14 @@
 
 #define CTRL_C_TIME_FOR_BREAK jshGetTimeFromMilliseconds(100)
 
+#ifdef LINUX
+#include "jscontext.h"
+/// Secondary contexts leave IO events, hardware timers and the console to the main one
+#define jsiIsSecondaryContext() jscIsSecondaryContext()
+#else
+#define jsiIsSecondaryContext() false
+#endif
+
 #ifdef ESP8266
 extern void jshPrintBanner(void); // prints a debugging banner while we're in beta
 extern void jshSoftInit(void);    // re-inits wifi after a soft-reset
@@ -47,28 +56,40 @@ typedef enum {
   IS_HAD_27_91_NUMBER, ///< Esc [ then 0-9
 } PACKED_FLAGS InputState;
 
-JsVar *events = 0; // Array of events to execute
-JsVarRef timerArray = 0; // Linked List of timers to check and run
-JsVarRef watchArray = 0; // Linked List of input watches to check and run
+JS_CONTEXT_LOCAL JsVar *events = 0; // Array of events to execute
+/// A queued microtask. The object and argument are referenced (not locked) while queued
+typedef struct {
+  JsVarRef object;
+  JsVarRef arg;
+  const char *callbackName; ///< static string - the name of the callbacks on object
+} JsiMicrotask;
+#define JSI_MICROTASKS_INITIAL 4 // initial size of the microtask ring - doubled when full
+
+JS_CONTEXT_LOCAL JsVar *microtasks = 0; // Flat string holding a ring of JsiMicrotask
+JS_CONTEXT_LOCAL unsigned int microtaskStart = 0; // Index of the first queued microtask in the ring
+JS_CONTEXT_LOCAL unsigned int microtaskCount = 0; // Amount of queued microtasks
+JS_CONTEXT_LOCAL bool isExecutingMicrotasks = false;
+JS_CONTEXT_LOCAL JsVarRef timerArray = 0; // Linked List of timers to check and run
+JS_CONTEXT_LOCAL JsVarRef watchArray = 0; // Linked List of input watches to check and run
 // ----------------------------------------------------------------------------
-IOEventFlags consoleDevice = DEFAULT_CONSOLE_DEVICE; ///< The console device for user interaction
+JS_CONTEXT_LOCAL IOEventFlags consoleDevice = DEFAULT_CONSOLE_DEVICE; ///< The console device for user interaction
 Pin pinBusyIndicator = DEFAULT_BUSY_PIN_INDICATOR;
 Pin pinSleepIndicator = DEFAULT_SLEEP_PIN_INDICATOR;
-JsiStatus jsiStatus;
-JsSysTime jsiLastIdleTime;  ///< The last time we went around the idle loop - use this for timers
-uint32_t jsiTimeSinceCtrlC;
+JS_CONTEXT_LOCAL JsiStatus jsiStatus;
+JS_CONTEXT_LOCAL JsSysTime jsiLastIdleTime;  ///< The last time we went around the idle loop - use this for timers
+JS_CONTEXT_LOCAL uint32_t jsiTimeSinceCtrlC;
 // ----------------------------------------------------------------------------
-JsVar *inputLine = 0; ///< The current input line
-JsvStringIterator inputLineIterator; ///< Iterator that points to the end of the input line
-int inputLineLength = -1;
-bool inputLineRemoved = false;
-size_t inputCursorPos = 0; ///< The position of the cursor in the input line
-InputState inputState = 0; ///< state for dealing with cursor keys
-uint16_t inputStateNumber; ///< Number from when `Esc [ 1234` is sent - for storing line number
-uint16_t jsiLineNumberOffset; ///< When we execute code, this is the 'offset' we apply to line numbers in error/debug
-bool hasUsedHistory = false; ///< Used to speed up - if we were cycling through history and then edit, we need to copy the string
-unsigned char loopsIdling; ///< How many times around the loop have we been entirely idle?
-bool interruptedDuringEvent; ///< Were we interrupted while executing an event? If so may want to clear timers
+JS_CONTEXT_LOCAL JsVar *inputLine = 0; ///< The current input line
+JS_CONTEXT_LOCAL JsvStringIterator inputLineIterator; ///< Iterator that points to the end of the input line
+JS_CONTEXT_LOCAL int inputLineLength = -1;
+JS_CONTEXT_LOCAL bool inputLineRemoved = false;
+JS_CONTEXT_LOCAL size_t inputCursorPos = 0; ///< The position of the cursor in the input line
+JS_CONTEXT_LOCAL InputState inputState = 0; ///< state for dealing with cursor keys
+JS_CONTEXT_LOCAL uint16_t inputStateNumber; ///< Number from when `Esc [ 1234` is sent - for storing line number
+JS_CONTEXT_LOCAL uint16_t jsiLineNumberOffset; ///< When we execute code, this is the 'offset' we apply to line numbers in error/debug
+JS_CONTEXT_LOCAL bool hasUsedHistory = false; ///< Used to speed up - if we were cycling through history and then edit, we need to copy the string
+JS_CONTEXT_LOCAL unsigned char loopsIdling; ///< How many times around the loop have we been entirely idle?
+JS_CONTEXT_LOCAL bool interruptedDuringEvent; ///< Were we interrupted while executing an event? If so may want to clear timers
 // ----------------------------------------------------------------------------
 
 #ifdef USE_DEBUGGER
@@ -179,8 +200,13 @@ NO_INLINE void jsiConsolePrintChar(char data) {
  */
 NO_INLINE void jsiConsolePrintString(const char *str) {
   while (*str) {
-    if (*str == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(*(str++));
+    // send everything up to the next newline in one go
+    const char *end = str;
+    while (*end && *end!='\n') end++;
+    if (end!=str) jshTransmitMultiple(consoleDevice, (const unsigned char*)str, (unsigned int)(end-str));
+    if (!*end) break;
+    jshTransmitMultiple(consoleDevice, (const unsigned char*)"\r\n", 2);
+    str = end+1;
   }
 }
 
@@ -425,11 +451,36 @@ static JsVarRef _jsiInitNamedArray(const char *name) {
   return arrayRef;
 }
 
+/// How many microtasks the ring can hold
+static unsigned int jsiGetMicrotaskCapacity() {
+  return (unsigned int)(jsvGetCharactersInVar(microtasks) / sizeof(JsiMicrotask));
+}
+
+/// Get the nth queued microtask (or the free slot after the last one if n==microtaskCount)
+static JsiMicrotask *jsiGetMicrotask(unsigned int n) {
+  JsiMicrotask *tasks = (JsiMicrotask*)jsvGetFlatStringPointer(microtasks);
+  return &tasks[(microtaskStart+n) % jsiGetMicrotaskCapacity()];
+}
+
+/// Mark anything referenced by queued microtasks as used - registered with jsvSetGarbageCollectMarkCallback
+static void jsiGarbageCollectMarkUsed() {
+  unsigned int i;
+  for (i=0;i<microtaskCount;i++) {
+    JsiMicrotask *task = jsiGetMicrotask(i);
+    jsvGarbageCollectMarkRef(task->object);
+    jsvGarbageCollectMarkRef(task->arg);
+  }
+}
+
 // Used when recovering after being flashed
 // 'claim' anything we are using
 void jsiSoftInit(bool hasBeenReset) {
   jsErrorFlags = 0;
   events = jsvNewEmptyArray();
+  microtasks = jsvNewFlatStringOfLength(JSI_MICROTASKS_INITIAL*(unsigned int)sizeof(JsiMicrotask));
+  microtaskStart = 0;
+  microtaskCount = 0;
+  jsvSetGarbageCollectMarkCallback(jsiGarbageCollectMarkUsed);
   inputLine = jsvNewFromEmptyString();
   inputCursorPos = 0;
   jsiLineNumberOffset = 0;
@@ -460,6 +511,7 @@ void jsiSoftInit(bool hasBeenReset) {
   if (initCode) {
     jsvUnLock2(jspEvaluateVar(initCode, 0, 0), initCode);
     jsvRemoveNamedChild(execInfo.hiddenRoot, JSI_INIT_CODE_NAME);
+    jsiExecuteMicrotasks();
   }
 
   // Check any existing watches and set up interrupts for them
@@ -678,12 +730,26 @@ void jsiSoftKill() {
   // kill any wrapped stuff
   jswKill();
   // Stop all active timer tasks
-  jstReset();
+  if (!jsiIsSecondaryContext())
+    jstReset();
   // Unref Watches/etc
   if (events) {
     jsvUnLock(events);
     events=0;
   }
+  if (microtasks) {
+    // drop anything that never got executed
+    while (microtaskCount) {
+      JsiMicrotask *task = jsiGetMicrotask(0);
+      microtaskStart = (microtaskStart+1) % jsiGetMicrotaskCapacity();
+      microtaskCount--;
+      jsvUnRefRef(task->object);
+      if (task->arg) jsvUnRefRef(task->arg);
+    }
+    jsvUnLock(microtasks);
+    microtasks=0;
+  }
+  jsvSetGarbageCollectMarkCallback(0);
   if (timerArray) {
     jsvUnRefRef(timerArray);
     timerArray=0;
@@ -724,6 +790,8 @@ void jsiSemiInit(bool autoLoad) {
   interruptedDuringEvent = false;
   // Set defaults
   jsiStatus = JSIS_NONE;
+  if (jsiIsSecondaryContext())
+    jsiStatus |= JSIS_ECHO_OFF; // no console of our own
   pinBusyIndicator = DEFAULT_BUSY_PIN_INDICATOR;
 
   /* If flash contains any code, then we should
@@ -1293,6 +1361,7 @@ void jsiHandleNewLine(bool execute) {
           jsiConsolePrint("\n");
         }
         jsvUnLock(v);
+        jsiExecuteMicrotasks();
       }
       jsiCheckErrors();
       // console will be returned next time around the input loop
@@ -1498,7 +1567,60 @@ void jsiExecuteObjectCallbacks(JsVar *object, const char *callbackName, JsVar **
   jsvUnLock(callback);
 }
 
+/** Queue the callbacks called `callbackName` on `object` to be run as a microtask -
+ * straight after the current callback (or command) has finished, before any other
+ * events or timers. The callbacks are looked up when they are run, not now.
+ * `callbackName` must be a static string. */
+void jsiQueueMicrotask(JsVar *object, const char *callbackName, JsVar *arg) {
+  if (!microtasks) return;
+  unsigned int capacity = jsiGetMicrotaskCapacity();
+  if (microtaskCount >= capacity) {
+    // ring is full - copy everything into one twice the size
+    JsVar *newTasks = jsvNewFlatStringOfLength(capacity*2*(unsigned int)sizeof(JsiMicrotask));
+    if (!newTasks) return; // out of memory
+    JsiMicrotask *to = (JsiMicrotask*)jsvGetFlatStringPointer(newTasks);
+    unsigned int i;
+    for (i=0;i<microtaskCount;i++)
+      to[i] = *jsiGetMicrotask(i);
+    jsvUnLock(microtasks);
+    microtasks = newTasks;
+    microtaskStart = 0;
+  }
+  JsiMicrotask *task = jsiGetMicrotask(microtaskCount);
+  task->object = jsvGetRef(jsvRef(object));
+  task->arg = arg ? jsvGetRef(jsvRef(arg)) : 0;
+  task->callbackName = callbackName;
+  microtaskCount++;
+}
+
+/// Execute any queued microtasks (including ones queued while doing so)
+void jsiExecuteMicrotasks() {
+  if (!microtasks || isExecutingMicrotasks) return;
+  isExecutingMicrotasks = true;
+  while (microtaskCount && !jspIsInterrupted()) {
+    JsiMicrotask task = *jsiGetMicrotask(0);
+    microtaskStart = (microtaskStart+1) % jsiGetMicrotaskCapacity();
+    microtaskCount--;
+    // swap our references for locks
+    JsVar *object = jsvLock(task.object);
+    jsvUnRef(object);
+    JsVar *arg = 0;
+    if (task.arg) {
+      arg = jsvLock(task.arg);
+      jsvUnRef(arg);
+    }
+    if (jsvIsObject(object)) {
+      JsVar *callback = jsvObjectGetChild(object, task.callbackName, 0);
+      if (callback) jsiExecuteEventCallback(object, callback, 1, &arg);
+      jsvUnLock(callback);
+    }
+    jsvUnLock2(object, arg);
+  }
+  isExecutingMicrotasks = false;
+}
+
 void jsiExecuteEvents() {
+  jsiExecuteMicrotasks(); // any left over from executing code
   bool hasEvents = !jsvArrayIsEmpty(events);
   if (hasEvents) jsiSetBusy(BUSY_INTERACTIVE, true);
   while (!jsvArrayIsEmpty(events)) {
@@ -1512,6 +1634,7 @@ void jsiExecuteEvents() {
     // now run..
     jsiExecuteEventCallbackArgsArray(thisVar, func, argsArray);
     jsvUnLock(argsArray);
+    jsiExecuteMicrotasks();
     //jsPrint("Event Done\n");
     jsvUnLock2(func, thisVar);
   }
@@ -1617,7 +1740,6 @@ int jsiHandleIOEventForUSART(JsVar *usartClass, IOEvent *event) {
     unsigned char c = (unsigned char)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "bytesize", 0));
     if (c>=7 && c<10) bytesize = c;
   }
-  jsvUnLock(options);
 
   JsVar *stringData = jsvNewFromEmptyString();
   if (stringData) {
@@ -1640,10 +1762,12 @@ int jsiHandleIOEventForUSART(JsVar *usartClass, IOEvent *event) {
     }
     jsvStringIteratorFree(&it);
 
-    // Now run the handler
-    jswrap_stream_pushData(usartClass, stringData, true);
+    // Now run the handler (or assemble lines/frames if the Serial port was set up to)
+    if (!jswrap_serial_pushFramedData(usartClass, options, stringData))
+      jswrap_stream_pushData(usartClass, stringData, true);
     jsvUnLock(stringData);
   }
+  jsvUnLock(options);
   return eventsHandled;
 }
 
@@ -1659,12 +1783,15 @@ void jsiIdle() {
   // It will be zeroed if we do stuff later
   if (loopsIdling<255) loopsIdling++;
 
+  // Promise reactions from code that has just run must happen before any timers or events
+  jsiExecuteMicrotasks();
+
   // Handle hardware-related idle stuff (like checking for pin events)
   bool wasBusy = false;
   IOEvent event;
   // ensure we can't get totally swamped by having more events than we can process.
   // Just process what was in the event queue at the start
-  int maxEvents = jshGetEventsUsed();
+  int maxEvents = jsiIsSecondaryContext() ? 0 : jshGetEventsUsed();
 
   while ((maxEvents--)>0 && jshPopIOEvent(&event)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
@@ -1682,6 +1809,7 @@ void jsiIdle() {
       JsVar *usartClass = jsvSkipNameAndUnLock(jsiGetClassNameFromDevice(IOEVENTFLAGS_GETTYPE(event.flags)));
       if (jsvIsObject(usartClass)) {
         maxEvents -= jsiHandleIOEventForUSART(usartClass, &event);
+        jsiExecuteMicrotasks();
       }
       jsvUnLock(usartClass);
     } else if (DEVICE_IS_USART_STATUS(eventType)) {
@@ -1779,6 +1907,7 @@ void jsiIdle() {
                 jsErrorFlags |= JSERR_CALLBACK;
                 watchRecurring = false;
               }
+              jsiExecuteMicrotasks();
               jsvUnLock(data);
               if (!watchRecurring) {
                 // free all
@@ -1866,6 +1995,7 @@ void jsiIdle() {
           execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
           jsvUnLock(argsArray);
         }
+        jsiExecuteMicrotasks();
         if (!execResult && interval) {
           jsError("Ctrl-C while processing interval - removing it.");
           jsErrorFlags |= JSERR_CALLBACK;
@@ -1957,7 +2087,7 @@ void jsiIdle() {
       // shut down everything and start up again
       jsiKill();
       jsvKill();
-      jshReset();
+      if (!jsiIsSecondaryContext()) jshReset(); // the hardware belongs to the main context
       jsvInit();
       jsiSemiInit(false); // don't autoload
     }
@@ -1969,7 +2099,7 @@ void jsiIdle() {
       jspSoftKill();
       jsvSoftKill();
       jsfSaveToFlash(SFF_SAVE_STATE, 0);
-      jshReset();
+      if (!jsiIsSecondaryContext()) jshReset();
       jsvSoftInit();
       jspSoftInit();
       jsiSoftInit(false /* not been reset */);
@@ -1980,7 +2110,7 @@ void jsiIdle() {
       jsiSoftKill();
       jspSoftKill();
       jsvSoftKill();
-      jshReset();
+      if (!jsiIsSecondaryContext()) jshReset();
       jsfLoadStateFromFlash();
       jsvSoftInit();
       jspSoftInit();
@@ -2005,6 +2135,12 @@ void jsiIdle() {
     jshKickWatchDog();
 
   // Go to sleep!
+#ifdef LINUX
+  if (jsiIsSecondaryContext()) {
+    // hardware events are the main context's problem - just wait for timers or queued code
+    if (loopsIdling>1) jscSleep(minTimeUntilNext);
+  } else
+#endif
   if (loopsIdling>1 && // once around the idle loop without having done any work already (just in case)
 #ifdef USB
       !jshIsUSBSERIALConnected() && // if USB is on, no point sleeping (later, sleep might be more drastic)
@@ -44,6 +44,10 @@ bool jsiIsWatchingPin(Pin pin); // are there any watches for the given pin?
 
 /// Queue a function, string, or array (of funcs/strings) to be executed next time around the idle loop
 void jsiQueueEvents(JsVar *object, JsVar *callback, JsVar **args, int argCount);
+/// Queue object's callbacks called callbackName to be executed as soon as the current callback or command has finished
+void jsiQueueMicrotask(JsVar *object, const char *callbackName, JsVar *arg);
+/// Execute any queued microtasks
+void jsiExecuteMicrotasks();
 /// Return true if the object has callbacks...
 bool jsiObjectHasCallbacks(JsVar *object, const char *callbackName);
 /// Queue up callbacks for other things (touchscreen? network?)
@@ -143,17 +147,17 @@ typedef enum {
   JSIS_ECHO_OFF_MASK = JSIS_ECHO_OFF|JSIS_ECHO_OFF_FOR_LINE
 } PACKED_FLAGS JsiStatus;
 
-extern JsiStatus jsiStatus;
+extern JS_CONTEXT_LOCAL JsiStatus jsiStatus;
 bool jsiEcho();
 
 extern Pin pinBusyIndicator;
 extern Pin pinSleepIndicator;
-extern JsSysTime jsiLastIdleTime; ///< The last time we went around the idle loop - use this for timers
+extern JS_CONTEXT_LOCAL JsSysTime jsiLastIdleTime; ///< The last time we went around the idle loop - use this for timers
 
 void jsiDumpState(vcbprintf_callback user_callback, void *user_data);
 #define TIMER_MIN_INTERVAL 0.1 // in milliseconds
-extern JsVarRef timerArray; // Linked List of timers to check and run
-extern JsVarRef watchArray; // Linked List of input watches to check and run
+extern JS_CONTEXT_LOCAL JsVarRef timerArray; // Linked List of timers to check and run
+extern JS_CONTEXT_LOCAL JsVarRef watchArray; // Linked List of input watches to check and run
 
 extern JsVarInt jsiTimerAdd(JsVar *timerPtr);
 extern void jsiTimersChanged(); // Flag timers changed so we can skip out of the loop if needed
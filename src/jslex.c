@@ -13,7 +13,7 @@
  */
 #include "jslex.h"
 
-JsLex *lex;
+JS_CONTEXT_LOCAL JsLex *lex;
 
 JsLex *jslSetLex(JsLex *l) {
   JsLex *old = lex;
@@ -210,7 +210,72 @@ static ALWAYS_INLINE void jslSingleChar() {
   jslGetNextCh();
 }
 
+#ifndef SAVE_ON_FLASH
+/** Could a '/' after this token start a RegExp literal? If the token ends a
+ * value (like `a` or `)`) it's a division instead */
+static bool jslIsRegexAllowed(int lastToken) {
+  switch (lastToken) {
+  case LEX_ID:
+  case LEX_INT:
+  case LEX_FLOAT:
+  case LEX_STR:
+  case LEX_REGEX:
+  case LEX_R_TRUE:
+  case LEX_R_FALSE:
+  case LEX_R_NULL:
+  case LEX_R_UNDEFINED:
+  case LEX_R_THIS:
+  case LEX_PLUSPLUS:
+  case LEX_MINUSMINUS:
+  case ')':
+  case ']':
+    return false;
+  default:
+    return true;
+  }
+}
+
+/// Lex a RegExp literal into tokenValue, as "/pattern/flags"
+static void jslLexRegex() {
+  lex->tokenValue = jsvNewFromEmptyString();
+  if (!lex->tokenValue) {
+    lex->tk = LEX_EOF;
+    return;
+  }
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, lex->tokenValue, 0);
+  jsvStringIteratorAppend(&it, '/');
+  jslGetNextCh();
+  bool inClass = false; // a '/' inside [...] doesn't end the RegExp
+  while (lex->currCh && lex->currCh!='\n' && (inClass || lex->currCh!='/')) {
+    if (lex->currCh=='\\') {
+      jsvStringIteratorAppend(&it, lex->currCh);
+      jslGetNextCh();
+      if (!lex->currCh || lex->currCh=='\n') break;
+    } else if (lex->currCh=='[') {
+      inClass = true;
+    } else if (lex->currCh==']') {
+      inClass = false;
+    }
+    jsvStringIteratorAppend(&it, lex->currCh);
+    jslGetNextCh();
+  }
+  lex->tk = LEX_UNFINISHED_REGEX;
+  if (lex->currCh=='/') {
+    lex->tk = LEX_REGEX;
+    do { // the closing '/' and then any flags
+      jsvStringIteratorAppend(&it, lex->currCh);
+      jslGetNextCh();
+    } while (isAlpha(lex->currCh));
+  }
+  jsvStringIteratorFree(&it);
+}
+#endif
+
 void jslGetNextToken() {
+#ifndef SAVE_ON_FLASH
+  int lastToken = lex->tk;
+#endif
   jslGetNextToken_start:
   // Skip whitespace
   while (isWhitespace(lex->currCh))
@@ -482,7 +547,14 @@ void jslGetNextToken() {
         lex->tk = LEX_MULEQUAL;
         jslGetNextCh();
       } break;
-      case JSLJT_FORWARDSLASH: jslSingleChar();
+      case JSLJT_FORWARDSLASH:
+#ifndef SAVE_ON_FLASH
+      if (jslIsRegexAllowed(lastToken)) {
+        jslLexRegex();
+        break;
+      }
+#endif
+      jslSingleChar();
       if (lex->currCh=='=') {
         lex->tk = LEX_DIVEQUAL;
         jslGetNextCh();
@@ -583,6 +655,7 @@ void jslSeekTo(size_t seekToChar) {
   jsvUnLock(lex->it.var); // see jslGetNextCh
   lex->tokenStart.it.var = 0;
   lex->tokenStart.currCh = 0;
+  lex->tk = LEX_EOF; // we're at the start of an expression, so '/' is a RegExp
   jslPreload();
 }
 
@@ -594,6 +667,7 @@ void jslSeekToP(JslCharPos *seekToChar) {
   lex->currCh = seekToChar->currCh;
   lex->tokenStart.it.var = 0;
   lex->tokenStart.currCh = 0;
+  lex->tk = LEX_EOF; // we're at the start of an expression, so '/' is a RegExp
   jslGetNextToken();
 }
 
@@ -619,6 +693,8 @@ void jslTokenAsString(int token, char *str, size_t len) {
   case LEX_FLOAT : strncpy(str, "FLOAT", len); return;
   case LEX_STR : strncpy(str, "STRING", len); return;
   case LEX_UNFINISHED_STR : strncpy(str, "UNFINISHED STRING", len); return;
+  case LEX_REGEX : strncpy(str, "REGEX", len); return;
+  case LEX_UNFINISHED_REGEX : strncpy(str, "UNFINISHED REGEX", len); return;
   }
   if (token>=LEX_EQUAL && token<LEX_R_LIST_END) {
     const char tokenNames[] =
@@ -25,6 +25,8 @@ typedef enum LEX_TYPES {
     LEX_FLOAT,
     LEX_STR,
     LEX_UNFINISHED_STR,
+    LEX_REGEX, ///< a RegExp literal - the token value is "/pattern/flags"
+    LEX_UNFINISHED_REGEX,
     LEX_UNFINISHED_COMMENT,
 
     LEX_EQUAL,
@@ -121,7 +123,7 @@ typedef struct JsLex
 } JsLex;
 
 // The lexer
-extern JsLex *lex;
+extern JS_CONTEXT_LOCAL JsLex *lex;
 /// Set the lexer - return the old one
 JsLex *jslSetLex(JsLex *l);
 
@@ -19,10 +19,16 @@
 #include "jswrap_functions.h" // insane check for eval in jspeFunctionCall
 #include "jswrap_json.h" // for jsfPrintJSON
 #include "jswrap_espruino.h" // for jswrap_espruino_memoryArea
+#include "jswrap_regexp.h" // for jswrap_regexp_constructor
 
 /* Info about execution when Parsing - this saves passing it on the stack
  * for each call */
-JsExecInfo execInfo;
+JS_CONTEXT_LOCAL JsExecInfo execInfo;
+#ifdef LINUX
+/// The main thread's execInfo (set by jspInit), or a dummy before that
+static JsExecInfo *mainExecInfo = 0;
+static JsExecInfo uninitialisedExecInfo;
+#endif
 
 // ----------------------------------------------- Forward decls
 JsVar *jspeAssignmentExpression();
@@ -44,6 +50,16 @@ void jspEnsureIsPrototype(JsVar *instanceOf, JsVar *prototypeName);
 #define JSP_HAS_ERROR (((execInfo.execute)&EXEC_ERROR_MASK)!=0)
 #define JSP_SHOULDNT_PARSE (((execInfo.execute)&EXEC_NO_PARSE_MASK)!=0)
 
+#ifdef LINUX
+#include "jscontext.h"
+/** Pick up interrupts requested by other threads (see jscInterrupt). This is
+ * done once per statement and loop iteration, so jspIsInterrupted only has to
+ * test execInfo */
+#define jspCheckContextInterrupt() jscCheckInterrupt()
+#else
+#define jspCheckContextInterrupt()
+#endif
+
 ALWAYS_INLINE void jspDebuggerLoopIfCtrlC() {
 #ifdef USE_DEBUGGER
   if (execInfo.execute & EXEC_CTRL_C_WAIT && JSP_SHOULD_EXECUTE)
@@ -1358,6 +1374,23 @@ NO_INLINE JsVar *jspeFactor() {
       JSP_ASSERT_MATCH(LEX_STR);
       return 0;
     }
+#ifndef SAVE_ON_FLASH
+  } else if (lex->tk==LEX_REGEX) {
+    JsVar *regex = 0;
+    if (JSP_SHOULD_EXECUTE) {
+      // the token is "/pattern/flags"
+      JsVar *str = jslGetTokenValueAsVar(lex);
+      size_t len = jsvGetStringLength(str);
+      size_t flagsIdx = len;
+      while (flagsIdx>1 && jsvGetCharInString(str, flagsIdx-1)!='/') flagsIdx--;
+      JsVar *pattern = jsvNewFromStringVar(str, 1, flagsIdx-2);
+      JsVar *flags = jsvNewFromStringVar(str, flagsIdx, JSVAPPENDSTRINGVAR_MAXLENGTH);
+      regex = jswrap_regexp_constructor(pattern, flags);
+      jsvUnLock3(str, pattern, flags);
+    }
+    JSP_ASSERT_MATCH(LEX_REGEX);
+    return regex;
+#endif
   } else if (lex->tk=='{') {
     return jspeFactorObject();
   } else if (lex->tk=='[') {
@@ -1927,6 +1960,7 @@ NO_INLINE JsVar *jspeStatementDoOrWhile(bool isWhile) {
     if (loopCond) {
       jslSeekToP(&whileBodyStart);
       execInfo.execute |= EXEC_IN_LOOP;
+      jspCheckContextInterrupt();
       jspDebuggerLoopIfCtrlC();
       jsvUnLock(jspeBlockOrStatement());
       if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
@@ -2021,6 +2055,7 @@ NO_INLINE JsVar *jspeStatementFor() {
 
               jslSeekToP(&forBodyStart);
               execInfo.execute |= EXEC_IN_LOOP;
+              jspCheckContextInterrupt();
               jspDebuggerLoopIfCtrlC();
               jsvUnLock(jspeBlockOrStatement());
               if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
@@ -2119,6 +2154,7 @@ NO_INLINE JsVar *jspeStatementFor() {
       if (JSP_SHOULD_EXECUTE && loopCond) {
         jslSeekToP(&forBodyStart);
         execInfo.execute |= EXEC_IN_LOOP;
+        jspCheckContextInterrupt();
         jspDebuggerLoopIfCtrlC();
         jsvUnLock(jspeBlockOrStatement());
         if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
@@ -2274,6 +2310,7 @@ NO_INLINE JsVar *jspeStatementFunctionDecl() {
 }
 
 NO_INLINE JsVar *jspeStatement() {
+  jspCheckContextInterrupt();
 #ifdef USE_DEBUGGER
   if (execInfo.execute&EXEC_DEBUGGER_NEXT_LINE &&
       lex->tk!=';' &&
@@ -2286,6 +2323,7 @@ NO_INLINE JsVar *jspeStatement() {
       lex->tk==LEX_INT ||
       lex->tk==LEX_FLOAT ||
       lex->tk==LEX_STR ||
+      lex->tk==LEX_REGEX ||
       lex->tk==LEX_R_NEW ||
       lex->tk==LEX_R_NULL ||
       lex->tk==LEX_R_UNDEFINED ||
@@ -2460,8 +2498,18 @@ void jspSoftKill() {
 
 void jspInit() {
   jspSoftInit();
+#ifdef LINUX
+  if (!jscIsSecondaryContext())
+    mainExecInfo = &execInfo;
+#endif
 }
 
+#ifdef LINUX
+JsExecInfo *jspGetConsoleExecInfo() {
+  return mainExecInfo ? mainExecInfo : &uninitialisedExecInfo;
+}
+#endif
+
 void jspKill() {
   jspSoftKill();
   // Unreffing this should completely kill everything attached to root
@@ -132,7 +132,16 @@ typedef struct {
 
 /* Info about execution when Parsing - this saves passing it on the stack
  * for each call */
-extern JsExecInfo execInfo;
+extern JS_CONTEXT_LOCAL JsExecInfo execInfo;
+
+#ifdef LINUX
+/** execInfo is thread-local on Linux, so the input thread uses this to get
+ * the main interpreter's (the one that owns the console) to signal Ctrl-C */
+JsExecInfo *jspGetConsoleExecInfo();
+#define consoleExecInfo (*jspGetConsoleExecInfo())
+#else
+#define consoleExecInfo execInfo
+#endif
 
 /// flags for jspParseFunction
 typedef enum {
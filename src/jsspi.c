@@ -181,7 +181,7 @@ bool jsspiGetSendFunction(
     // Debug
     // jsiConsolePrintf("SPI is software\n");
     JsVar *options = jsvObjectGetChild(spiDevice, DEVICE_OPTIONS_NAME, 0);
-    static JshSPIInfo inf;
+    static JS_CONTEXT_LOCAL JshSPIInfo inf;
     jsspiPopulateSPIInfo(&inf, options);
     jsvUnLock(options);
 
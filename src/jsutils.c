@@ -21,7 +21,7 @@
 
 /** Error flags for things that we don't really want to report on the console,
  * but which are good to know about */
-JsErrorFlags jsErrorFlags;
+JS_CONTEXT_LOCAL JsErrorFlags jsErrorFlags;
 
 
 bool isWhitespace(char ch) {
@@ -70,7 +70,7 @@ const char *escapeCharacter(char ch) {
   if (ch=='\t') return "\\t";
   if (ch=='\\') return "\\\\";
   if (ch=='"') return "\\\"";
-  static char buf[5];
+  static JS_CONTEXT_LOCAL char buf[5];
   if (ch<32 || ch>=127) {
     /** just encode as hex - it's more understandable
      * and doesn't have the issue of "\16"+"1" != "\161" */
@@ -466,6 +466,387 @@ unsigned char *flash_memcpy(unsigned char *dst, const unsigned char *src, size_t
 #endif
 
 
+/* Decimal string to double conversion. The digits are read into a 64 bit
+ * mantissa and power of 10, then we try (fastest first):
+ *
+ * * Clinger's fast path - if the mantissa and power of 10 are both exactly
+ *   representable as doubles, one multiply/divide is correctly rounded.
+ * * Eisel-Lemire - multiply by a 128 bit approximation of the power of 10,
+ *   which gives the correctly rounded result unless we're too close to
+ *   halfway between two doubles to tell.
+ * * Comparing all the digits against the halfway points of an approximate
+ *   result using big integers. Slow, but always correct.
+ */
+
+#define STRTOD_MAX_DIGITS 19 ///< maximum digits that fit in the 64 bit mantissa
+#define STRTOD_BIGNUM_MAX_DIGITS 100 ///< maximum digits used when comparing with big integers
+#define STRTOD_BIGNUM_WORDS 40 ///< 1280 bits - enough for 100 digits and any double
+
+static const double strtodPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/// Multiply two 64 bit numbers, returning the top 64 bits of the result and putting the bottom 64 in *lo
+static uint64_t strtodMul64(uint64_t a, uint64_t b, uint64_t *lo) {
+  const uint64_t M32 = 0xFFFFFFFFULL;
+  uint64_t ah = a >> 32, al = a & M32, bh = b >> 32, bl = b & M32;
+  uint64_t hh = ah*bh, lh = al*bh, hl = ah*bl, ll = al*bl;
+  uint64_t mid = (ll >> 32) + (hl & M32) + (lh & M32);
+  *lo = (mid << 32) | (ll & M32);
+  return hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+}
+
+static double strtodFromBits(uint64_t bits) {
+  union { double d; uint64_t u; } v;
+  v.u = bits;
+  return v.d;
+}
+
+static uint64_t strtodToBits(double d) {
+  union { double d; uint64_t u; } v;
+  v.d = d;
+  return v.u;
+}
+
+#ifndef SAVE_ON_FLASH
+#define STRTOD_POW10_MIN -64
+#define STRTOD_POW10_MAX 64
+/** 128 bit mantissas of 10^-64 to 10^64 (normalised so the top bit is set,
+ * rounded down) for Eisel-Lemire. Outside this range (which is rare) we use
+ * the slower big integer method. */
+static const uint64_t strtodPow10Mantissa[][2] = {
+  {0xA87FEA27A539E9A5ULL,0x3F2398D747B36224ULL}, {0xD29FE4B18E88640EULL,0x8EEC7F0D19A03AADULL},
+  {0x83A3EEEEF9153E89ULL,0x1953CF68300424ACULL}, {0xA48CEAAAB75A8E2BULL,0x5FA8C3423C052DD7ULL},
+  {0xCDB02555653131B6ULL,0x3792F412CB06794DULL}, {0x808E17555F3EBF11ULL,0xE2BBD88BBEE40BD0ULL},
+  {0xA0B19D2AB70E6ED6ULL,0x5B6ACEAEAE9D0EC4ULL}, {0xC8DE047564D20A8BULL,0xF245825A5A445275ULL},
+  {0xFB158592BE068D2EULL,0xEED6E2F0F0D56712ULL}, {0x9CED737BB6C4183DULL,0x55464DD69685606BULL},
+  {0xC428D05AA4751E4CULL,0xAA97E14C3C26B886ULL}, {0xF53304714D9265DFULL,0xD53DD99F4B3066A8ULL},
+  {0x993FE2C6D07B7FABULL,0xE546A8038EFE4029ULL}, {0xBF8FDB78849A5F96ULL,0xDE98520472BDD033ULL},
+  {0xEF73D256A5C0F77CULL,0x963E66858F6D4440ULL}, {0x95A8637627989AADULL,0xDDE7001379A44AA8ULL},
+  {0xBB127C53B17EC159ULL,0x5560C018580D5D52ULL}, {0xE9D71B689DDE71AFULL,0xAAB8F01E6E10B4A6ULL},
+  {0x9226712162AB070DULL,0xCAB3961304CA70E8ULL}, {0xB6B00D69BB55C8D1ULL,0x3D607B97C5FD0D22ULL},
+  {0xE45C10C42A2B3B05ULL,0x8CB89A7DB77C506AULL}, {0x8EB98A7A9A5B04E3ULL,0x77F3608E92ADB242ULL},
+  {0xB267ED1940F1C61CULL,0x55F038B237591ED3ULL}, {0xDF01E85F912E37A3ULL,0x6B6C46DEC52F6688ULL},
+  {0x8B61313BBABCE2C6ULL,0x2323AC4B3B3DA015ULL}, {0xAE397D8AA96C1B77ULL,0xABEC975E0A0D081AULL},
+  {0xD9C7DCED53C72255ULL,0x96E7BD358C904A21ULL}, {0x881CEA14545C7575ULL,0x7E50D64177DA2E54ULL},
+  {0xAA242499697392D2ULL,0xDDE50BD1D5D0B9E9ULL}, {0xD4AD2DBFC3D07787ULL,0x955E4EC64B44E864ULL},
+  {0x84EC3C97DA624AB4ULL,0xBD5AF13BEF0B113EULL}, {0xA6274BBDD0FADD61ULL,0xECB1AD8AEACDD58EULL},
+  {0xCFB11EAD453994BAULL,0x67DE18EDA5814AF2ULL}, {0x81CEB32C4B43FCF4ULL,0x80EACF948770CED7ULL},
+  {0xA2425FF75E14FC31ULL,0xA1258379A94D028DULL}, {0xCAD2F7F5359A3B3EULL,0x096EE45813A04330ULL},
+  {0xFD87B5F28300CA0DULL,0x8BCA9D6E188853FCULL}, {0x9E74D1B791E07E48ULL,0x775EA264CF55347DULL},
+  {0xC612062576589DDAULL,0x95364AFE032A819DULL}, {0xF79687AED3EEC551ULL,0x3A83DDBD83F52204ULL},
+  {0x9ABE14CD44753B52ULL,0xC4926A9672793542ULL}, {0xC16D9A0095928A27ULL,0x75B7053C0F178293ULL},
+  {0xF1C90080BAF72CB1ULL,0x5324C68B12DD6338ULL}, {0x971DA05074DA7BEEULL,0xD3F6FC16EBCA5E03ULL},
+  {0xBCE5086492111AEAULL,0x88F4BB1CA6BCF584ULL}, {0xEC1E4A7DB69561A5ULL,0x2B31E9E3D06C32E5ULL},
+  {0x9392EE8E921D5D07ULL,0x3AFF322E62439FCFULL}, {0xB877AA3236A4B449ULL,0x09BEFEB9FAD487C2ULL},
+  {0xE69594BEC44DE15BULL,0x4C2EBE687989A9B3ULL}, {0x901D7CF73AB0ACD9ULL,0x0F9D37014BF60A10ULL},
+  {0xB424DC35095CD80FULL,0x538484C19EF38C94ULL}, {0xE12E13424BB40E13ULL,0x2865A5F206B06FB9ULL},
+  {0x8CBCCC096F5088CBULL,0xF93F87B7442E45D3ULL}, {0xAFEBFF0BCB24AAFEULL,0xF78F69A51539D748ULL},
+  {0xDBE6FECEBDEDD5BEULL,0xB573440E5A884D1BULL}, {0x89705F4136B4A597ULL,0x31680A88F8953030ULL},
+  {0xABCC77118461CEFCULL,0xFDC20D2B36BA7C3DULL}, {0xD6BF94D5E57A42BCULL,0x3D32907604691B4CULL},
+  {0x8637BD05AF6C69B5ULL,0xA63F9A49C2C1B10FULL}, {0xA7C5AC471B478423ULL,0x0FCF80DC33721D53ULL},
+  {0xD1B71758E219652BULL,0xD3C36113404EA4A8ULL}, {0x83126E978D4FDF3BULL,0x645A1CAC083126E9ULL},
+  {0xA3D70A3D70A3D70AULL,0x3D70A3D70A3D70A3ULL}, {0xCCCCCCCCCCCCCCCCULL,0xCCCCCCCCCCCCCCCCULL},
+  {0x8000000000000000ULL,0x0000000000000000ULL}, {0xA000000000000000ULL,0x0000000000000000ULL},
+  {0xC800000000000000ULL,0x0000000000000000ULL}, {0xFA00000000000000ULL,0x0000000000000000ULL},
+  {0x9C40000000000000ULL,0x0000000000000000ULL}, {0xC350000000000000ULL,0x0000000000000000ULL},
+  {0xF424000000000000ULL,0x0000000000000000ULL}, {0x9896800000000000ULL,0x0000000000000000ULL},
+  {0xBEBC200000000000ULL,0x0000000000000000ULL}, {0xEE6B280000000000ULL,0x0000000000000000ULL},
+  {0x9502F90000000000ULL,0x0000000000000000ULL}, {0xBA43B74000000000ULL,0x0000000000000000ULL},
+  {0xE8D4A51000000000ULL,0x0000000000000000ULL}, {0x9184E72A00000000ULL,0x0000000000000000ULL},
+  {0xB5E620F480000000ULL,0x0000000000000000ULL}, {0xE35FA931A0000000ULL,0x0000000000000000ULL},
+  {0x8E1BC9BF04000000ULL,0x0000000000000000ULL}, {0xB1A2BC2EC5000000ULL,0x0000000000000000ULL},
+  {0xDE0B6B3A76400000ULL,0x0000000000000000ULL}, {0x8AC7230489E80000ULL,0x0000000000000000ULL},
+  {0xAD78EBC5AC620000ULL,0x0000000000000000ULL}, {0xD8D726B7177A8000ULL,0x0000000000000000ULL},
+  {0x878678326EAC9000ULL,0x0000000000000000ULL}, {0xA968163F0A57B400ULL,0x0000000000000000ULL},
+  {0xD3C21BCECCEDA100ULL,0x0000000000000000ULL}, {0x84595161401484A0ULL,0x0000000000000000ULL},
+  {0xA56FA5B99019A5C8ULL,0x0000000000000000ULL}, {0xCECB8F27F4200F3AULL,0x0000000000000000ULL},
+  {0x813F3978F8940984ULL,0x4000000000000000ULL}, {0xA18F07D736B90BE5ULL,0x5000000000000000ULL},
+  {0xC9F2C9CD04674EDEULL,0xA400000000000000ULL}, {0xFC6F7C4045812296ULL,0x4D00000000000000ULL},
+  {0x9DC5ADA82B70B59DULL,0xF020000000000000ULL}, {0xC5371912364CE305ULL,0x6C28000000000000ULL},
+  {0xF684DF56C3E01BC6ULL,0xC732000000000000ULL}, {0x9A130B963A6C115CULL,0x3C7F400000000000ULL},
+  {0xC097CE7BC90715B3ULL,0x4B9F100000000000ULL}, {0xF0BDC21ABB48DB20ULL,0x1E86D40000000000ULL},
+  {0x96769950B50D88F4ULL,0x1314448000000000ULL}, {0xBC143FA4E250EB31ULL,0x17D955A000000000ULL},
+  {0xEB194F8E1AE525FDULL,0x5DCFAB0800000000ULL}, {0x92EFD1B8D0CF37BEULL,0x5AA1CAE500000000ULL},
+  {0xB7ABC627050305ADULL,0xF14A3D9E40000000ULL}, {0xE596B7B0C643C719ULL,0x6D9CCD05D0000000ULL},
+  {0x8F7E32CE7BEA5C6FULL,0xE4820023A2000000ULL}, {0xB35DBF821AE4F38BULL,0xDDA2802C8A800000ULL},
+  {0xE0352F62A19E306EULL,0xD50B2037AD200000ULL}, {0x8C213D9DA502DE45ULL,0x4526F422CC340000ULL},
+  {0xAF298D050E4395D6ULL,0x9670B12B7F410000ULL}, {0xDAF3F04651D47B4CULL,0x3C0CDD765F114000ULL},
+  {0x88D8762BF324CD0FULL,0xA5880A69FB6AC800ULL}, {0xAB0E93B6EFEE0053ULL,0x8EEA0D047A457A00ULL},
+  {0xD5D238A4ABE98068ULL,0x72A4904598D6D880ULL}, {0x85A36366EB71F041ULL,0x47A6DA2B7F864750ULL},
+  {0xA70C3C40A64E6C51ULL,0x999090B65F67D924ULL}, {0xD0CF4B50CFE20765ULL,0xFFF4B4E3F741CF6DULL},
+  {0x82818F1281ED449FULL,0xBFF8F10E7A8921A4ULL}, {0xA321F2D7226895C7ULL,0xAFF72D52192B6A0DULL},
+  {0xCBEA6F8CEB02BB39ULL,0x9BF4F8A69F764490ULL}, {0xFEE50B7025C36A08ULL,0x02F236D04753D5B4ULL},
+  {0x9F4F2726179A2245ULL,0x01D762422C946590ULL}, {0xC722F0EF9D80AAD6ULL,0x424D3AD2B7B97EF5ULL},
+  {0xF8EBAD2B84E0D58BULL,0xD2E0898765A7DEB2ULL}, {0x9B934C3B330C8577ULL,0x63CC55F49F88EB2FULL},
+  {0xC2781F49FFCFA6D5ULL,0x3CBF6B71C76B25FBULL},
+};
+
+/** Eisel-Lemire: convert m*10^e (m!=0) to the nearest double. Returns false
+ * if the result can't be worked out this way */
+static bool strtodEiselLemire(uint64_t m, int e, double *result) {
+  if (e < STRTOD_POW10_MIN || e > STRTOD_POW10_MAX) return false;
+  const uint64_t *pow10 = strtodPow10Mantissa[e - STRTOD_POW10_MIN];
+  // normalise
+  int clz = 0, shift;
+  for (shift=32;shift;shift>>=1) {
+    if (!(m >> (64-shift))) {
+      m <<= shift;
+      clz += shift;
+    }
+  }
+  uint64_t exp2 = (uint64_t)(((217706*e) >> 16) + 64 + 1023 - clz); // floor(log2(10^e)) + bias
+  uint64_t xLo, xHi = strtodMul64(m, pow10[0], &xLo);
+  if ((xHi & 0x1FF) == 0x1FF && xLo+m < m) {
+    // the bottom bits might be affected by the truncated power of 10 - use the next 64 bits too
+    uint64_t yLo, yHi = strtodMul64(m, pow10[1], &yLo);
+    uint64_t mergedHi = xHi, mergedLo = xLo + yHi;
+    if (mergedLo < xLo) mergedHi++;
+    if ((mergedHi & 0x1FF) == 0x1FF && mergedLo+1 == 0 && yLo+m < m) return false;
+    xHi = mergedHi;
+    xLo = mergedLo;
+  }
+  // shift down to 54 bits
+  uint64_t msb = xHi >> 63;
+  uint64_t mantissa = xHi >> (msb + 9);
+  exp2 -= 1 ^ msb;
+  // exactly halfway? we can't tell which way to round
+  if (xLo == 0 && (xHi & 0x1FF) == 0 && (mantissa & 3) == 1) return false;
+  // round to 53 bits
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  if (mantissa >> 53) {
+    mantissa >>= 1;
+    exp2++;
+  }
+  if (exp2-1 >= 0x7FF-1) return false; // subnormal or infinite
+  *result = strtodFromBits((exp2 << 52) | (mantissa & ((1ULL<<52)-1)));
+  return true;
+}
+#endif
+
+/// Simple big integer for strtodCompare
+typedef struct {
+  uint32_t w[STRTOD_BIGNUM_WORDS]; ///< least significant word first
+  int len;
+} StrtodBignum;
+
+static void strtodBignumMulAdd(StrtodBignum *b, uint32_t mul, uint32_t add) {
+  uint64_t carry = add;
+  int i;
+  for (i=0;i<b->len;i++) {
+    carry += (uint64_t)b->w[i] * mul;
+    b->w[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  if (carry && b->len<STRTOD_BIGNUM_WORDS)
+    b->w[b->len++] = (uint32_t)carry;
+}
+
+static void strtodBignumMulPow5(StrtodBignum *b, int n) {
+  while (n >= 13) {
+    strtodBignumMulAdd(b, 1220703125, 0); // 5^13
+    n -= 13;
+  }
+  uint32_t m = 1;
+  while (n--) m *= 5;
+  strtodBignumMulAdd(b, m, 0);
+}
+
+static void strtodBignumShiftLeft(StrtodBignum *b, int n) {
+  int words = n >> 5, bits = n & 31, i;
+  if (b->len + words + 1 > STRTOD_BIGNUM_WORDS) {
+    assert(0); // can't happen for the numbers we use
+    return;
+  }
+  b->w[b->len] = 0;
+  for (i=b->len;i>=0;i--)
+    b->w[i+words] = (b->w[i] << bits) | ((bits && i) ? (b->w[i-1] >> (32-bits)) : 0);
+  for (i=0;i<words;i++) b->w[i] = 0;
+  b->len += words + 1;
+  while (b->len && !b->w[b->len-1]) b->len--;
+}
+
+static int strtodBignumCompare(const StrtodBignum *a, const StrtodBignum *b) {
+  if (a->len != b->len) return (a->len > b->len) ? 1 : -1;
+  int i;
+  for (i=a->len-1;i>=0;i--)
+    if (a->w[i] != b->w[i]) return (a->w[i] > b->w[i]) ? 1 : -1;
+  return 0;
+}
+
+/// Compare digits*10^e with m*2^e2 exactly - returns -1, 0 or 1
+static int strtodCompare(const StrtodBignum *digits, int e, uint64_t m, int e2) {
+  StrtodBignum a = *digits, b;
+  b.w[0] = (uint32_t)m;
+  b.w[1] = (uint32_t)(m >> 32);
+  b.len = b.w[1] ? 2 : (b.w[0] ? 1 : 0);
+  // digits*5^e*2^e vs m*2^e2
+  if (e >= 0) strtodBignumMulPow5(&a, e);
+  else strtodBignumMulPow5(&b, -e);
+  if (e > e2) strtodBignumShiftLeft(&a, e - e2);
+  else if (e2 > e) strtodBignumShiftLeft(&b, e2 - e);
+  return strtodBignumCompare(&a, &b);
+}
+
+/** Work out the correctly rounded value of the decimal digits between s and
+ * end (which may contain a '.') times 10^exp. Starting with an approximation
+ * of the value, step one double at a time until the digits are between the
+ * halfway points to the doubles on each side. */
+static NO_INLINE double strtodBignum(const char *s, const char *end, int exp, double approx) {
+  StrtodBignum digits;
+  digits.len = 0;
+  int n = 0; // digits used
+  bool afterPoint = false, sticky = false;
+  for (;s<end;s++) {
+    if (*s == '.') {
+      afterPoint = true;
+    } else if (n < STRTOD_BIGNUM_MAX_DIGITS) {
+      if (n || *s!='0') { // skip leading zeros
+        strtodBignumMulAdd(&digits, 10, (uint32_t)(*s - '0'));
+        n++;
+      }
+      if (afterPoint) exp--;
+    } else {
+      if (!afterPoint) exp++;
+      if (*s != '0') sticky = true;
+    }
+  }
+  if (sticky) {
+    /* Digits were ignored, so the real value is a bit more. Add a 1 on the
+     * end to represent that. This could give the wrong answer if the number
+     * is within 10^-100 of halfway between two doubles, but we're never
+     * given numbers that long anyway. */
+    strtodBignumMulAdd(&digits, 10, 1);
+    exp--;
+  }
+
+  uint64_t bits = strtodToBits(approx);
+  if (bits > 0x7FEFFFFFFFFFFFFFULL) bits = 0x7FEFFFFFFFFFFFFFULL; // Infinity -> largest double
+  int i;
+  for (i=0;i<64;i++) { // we should never need more than a few steps
+    int biasedE = (int)(bits >> 52);
+    uint64_t m = bits & ((1ULL<<52)-1);
+    int e2 = -1074;
+    if (biasedE) {
+      m |= 1ULL<<52;
+      e2 = biasedE - 1075;
+    }
+    // halfway to the next double up. If exactly halfway, round to the even one
+    int c = strtodCompare(&digits, exp, 2*m+1, e2-1);
+    if (c > 0 || (c==0 && (m&1))) {
+      if (bits == 0x7FEFFFFFFFFFFFFFULL) return INFINITY;
+      bits++;
+      continue;
+    }
+    // halfway to the next double down (which is closer if we're a power of 2)
+    if (bits) {
+      if (m == (1ULL<<52) && biasedE > 1)
+        c = strtodCompare(&digits, exp, 4*m-1, e2-2);
+      else
+        c = strtodCompare(&digits, exp, 2*m-1, e2-1);
+      if (c < 0 || (c==0 && (m&1))) {
+        bits--;
+        continue;
+      }
+    }
+    break;
+  }
+  return strtodFromBits(bits);
+}
+
+/** Parse a decimal number (without sign) at *str, and put the correctly rounded
+ * double in *result. Returns false (without moving *str) if there are no digits */
+static bool stringToFloatDecimal(const char **str, JsVarFloat *result) {
+  const char *s = *str;
+  const char *digitsStart = s;
+  uint64_t m = 0;
+  int sigDigits = 0, e = 0;
+  bool gotDigits = false, truncated = false;
+  while (*s >= '0' && *s <= '9') {
+    if (sigDigits < STRTOD_MAX_DIGITS) {
+      m = m*10 + (uint64_t)(*s - '0');
+      if (m) sigDigits++;
+    } else {
+      e++;
+      if (*s != '0') truncated = true;
+    }
+    gotDigits = true;
+    s++;
+  }
+  if (*s == '.') {
+    s++;
+    while (*s >= '0' && *s <= '9') {
+      if (sigDigits < STRTOD_MAX_DIGITS) {
+        m = m*10 + (uint64_t)(*s - '0');
+        if (m) sigDigits++;
+        e--;
+      } else if (*s != '0') truncated = true;
+      gotDigits = true;
+      s++;
+    }
+  }
+  if (!gotDigits) return false;
+  const char *digitsEnd = s;
+  int exp = 0;
+  if (*s == 'e' || *s == 'E') {
+    s++;
+    bool isENegated = false;
+    if (*s == '-' || *s == '+') {
+      isENegated = *s=='-';
+      s++;
+    }
+    while (*s >= '0' && *s <= '9') {
+      if (exp < 100000) exp = exp*10 + (*s - '0');
+      s++;
+    }
+    if (isENegated) exp = -exp;
+  }
+  *str = s;
+  e += exp;
+  if (!m) {
+    *result = 0;
+    return true;
+  }
+  // Clinger's fast path
+  if (!truncated && m <= (1ULL<<53) && e >= -22 && e <= 22) {
+    *result = (e >= 0) ? (JsVarFloat)m * strtodPow10[e] : (JsVarFloat)m / strtodPow10[-e];
+    return true;
+  }
+  // Too big or small to be anything but Infinity or 0 (sigDigits+e is the position of the decimal point)
+  if (sigDigits + e > 310) {
+    *result = INFINITY;
+    return true;
+  }
+  if (sigDigits + e < -343) {
+    *result = 0;
+    return true;
+  }
+  double approx;
+#ifndef SAVE_ON_FLASH
+  // Eisel-Lemire. If there were more digits than we could store, the real
+  // value is between m and m+1 - if they round to the same double we're done.
+  if (strtodEiselLemire(m, e, &approx)) {
+    double upper;
+    if (!truncated || (strtodEiselLemire(m+1, e, &upper) && upper==approx)) {
+      *result = approx;
+      return true;
+    }
+  } else
+#endif
+  {
+    // approximate answer - within a few ulp
+    approx = (JsVarFloat)m;
+    int e10 = e;
+    while (e10 > 22) { approx *= 1e22; e10 -= 22; }
+    while (e10 < -22) { approx /= 1e22; e10 += 22; }
+    approx = (e10 >= 0) ? approx * strtodPow10[e10] : approx / strtodPow10[-e10];
+  }
+  *result = strtodBignum(digitsStart, digitsEnd, exp, approx);
+  return true;
+}
+
 /**
  * Convert a string to a JS float variable where the string is of a specific radix.
  * \return A JS float variable.
@@ -489,59 +870,22 @@ JsVarFloat stringToFloatWithRadix(
 
   int radix = getRadix(&s, forceRadix, 0);
   if (!radix) return NAN;
+  // for decimal, getRadix can only have skipped a leading '0' - which is one of our digits
+  if (radix == 10) s = numberStart;
 
 
   JsVarFloat v = 0;
-  JsVarFloat mul = 0.1;
-
-  // handle integer part
-  while (*s) {
-    int digit = chtod(*s);
-    if (digit<0 || digit>=radix)
-      break;
-    v = (v*radix) + digit;
-    s++;
-  }
 
   if (radix == 10) {
-    // handle decimal point
-    if (*s == '.') {
-      s++; // skip .
-
-      while (*s) {
-        if (*s >= '0' && *s <= '9')
-          v += mul*(*s - '0');
-        else break;
-        mul /= 10;
-        s++;
-      }
-    }
-
-    // handle exponentials
-    if (*s == 'e' || *s == 'E') {
-      s++;  // skip E
-      bool isENegated = false;
-      if (*s == '-' || *s == '+') {
-        isENegated = *s=='-';
-        s++;
-      }
-      int e = 0;
-      while (*s) {
-        if (*s >= '0' && *s <= '9')
-          e = (e*10) + (*s - '0');
-        else break;
-        s++;
-      }
-      if (isENegated) e=-e;
-      // TODO: faster INTEGER pow? Normal pow has floating point inaccuracies
-      while (e>0) {
-        v*=10;
-        e--;
-      }
-      while (e<0) {
-        v/=10;
-        e++;
-      }
+    if (!stringToFloatDecimal(&s, &v)) return NAN;
+  } else {
+    // handle integer part
+    while (*s) {
+      int digit = chtod(*s);
+      if (digit<0 || digit>=radix)
+        break;
+      v = (v*radix) + digit;
+      s++;
     }
   }
   // check that we managed to parse something at least
@@ -593,6 +937,250 @@ void itostr_extra(JsVarInt vals,char *str,bool signedVal, unsigned int base) {
   str[digits] = 0;
 }
 
+#ifndef USE_NO_FLOATS
+/* Shortest decimal representation of a double that parses back to the same
+ * value, using Florian Loitsch's Grisu2 algorithm ("Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers", 2010). This always
+ * round-trips, and is the shortest possible for ~99.9% of values. */
+
+/// A floating point number f*2^e with a 64 bit mantissa
+typedef struct {
+  uint64_t f;
+  int e;
+} FtoaDiyFp;
+
+/** Normalised 10^k for k = -348, -340, ... 340. With SAVE_ON_FLASH we only
+ * keep 10^-60 to 10^60 (numbers from about 1e-50 to 1e50), and use the
+ * slower ftoa for anything else */
+static const struct { uint64_t f; int16_t e; } ftoaCachedPowers[] = {
+#ifndef SAVE_ON_FLASH
+  {0xFA8FD5A0081C0288ULL,-1220}, {0xBAAEE17FA23EBF76ULL,-1193}, {0x8B16FB203055AC76ULL,-1166},
+  {0xCF42894A5DCE35EAULL,-1140}, {0x9A6BB0AA55653B2DULL,-1113}, {0xE61ACF033D1A45DFULL,-1087},
+  {0xAB70FE17C79AC6CAULL,-1060}, {0xFF77B1FCBEBCDC4FULL,-1034}, {0xBE5691EF416BD60CULL,-1007},
+  {0x8DD01FAD907FFC3CULL,-980}, {0xD3515C2831559A83ULL,-954}, {0x9D71AC8FADA6C9B5ULL,-927},
+  {0xEA9C227723EE8BCBULL,-901}, {0xAECC49914078536DULL,-874}, {0x823C12795DB6CE57ULL,-847},
+  {0xC21094364DFB5637ULL,-821}, {0x9096EA6F3848984FULL,-794}, {0xD77485CB25823AC7ULL,-768},
+  {0xA086CFCD97BF97F4ULL,-741}, {0xEF340A98172AACE5ULL,-715}, {0xB23867FB2A35B28EULL,-688},
+  {0x84C8D4DFD2C63F3BULL,-661}, {0xC5DD44271AD3CDBAULL,-635}, {0x936B9FCEBB25C996ULL,-608},
+  {0xDBAC6C247D62A584ULL,-582}, {0xA3AB66580D5FDAF6ULL,-555}, {0xF3E2F893DEC3F126ULL,-529},
+  {0xB5B5ADA8AAFF80B8ULL,-502}, {0x87625F056C7C4A8BULL,-475}, {0xC9BCFF6034C13053ULL,-449},
+  {0x964E858C91BA2655ULL,-422}, {0xDFF9772470297EBDULL,-396}, {0xA6DFBD9FB8E5B88FULL,-369},
+  {0xF8A95FCF88747D94ULL,-343}, {0xB94470938FA89BCFULL,-316}, {0x8A08F0F8BF0F156BULL,-289},
+#endif
+  {0xCDB02555653131B6ULL,-263}, {0x993FE2C6D07B7FACULL,-236}, {0xE45C10C42A2B3B06ULL,-210},
+  {0xAA242499697392D3ULL,-183}, {0xFD87B5F28300CA0EULL,-157}, {0xBCE5086492111AEBULL,-130},
+  {0x8CBCCC096F5088CCULL,-103}, {0xD1B71758E219652CULL,-77}, {0x9C40000000000000ULL,-50},
+  {0xE8D4A51000000000ULL,-24}, {0xAD78EBC5AC620000ULL,3}, {0x813F3978F8940984ULL,30},
+  {0xC097CE7BC90715B3ULL,56}, {0x8F7E32CE7BEA5C70ULL,83}, {0xD5D238A4ABE98068ULL,109},
+  {0x9F4F2726179A2245ULL,136},
+#ifndef SAVE_ON_FLASH
+  {0xED63A231D4C4FB27ULL,162}, {0xB0DE65388CC8ADA8ULL,189}, {0x83C7088E1AAB65DBULL,216},
+  {0xC45D1DF942711D9AULL,242}, {0x924D692CA61BE758ULL,269}, {0xDA01EE641A708DEAULL,295},
+  {0xA26DA3999AEF774AULL,322}, {0xF209787BB47D6B85ULL,348}, {0xB454E4A179DD1877ULL,375},
+  {0x865B86925B9BC5C2ULL,402}, {0xC83553C5C8965D3DULL,428}, {0x952AB45CFA97A0B3ULL,455},
+  {0xDE469FBD99A05FE3ULL,481}, {0xA59BC234DB398C25ULL,508}, {0xF6C69A72A3989F5CULL,534},
+  {0xB7DCBF5354E9BECEULL,561}, {0x88FCF317F22241E2ULL,588}, {0xCC20CE9BD35C78A5ULL,614},
+  {0x98165AF37B2153DFULL,641}, {0xE2A0B5DC971F303AULL,667}, {0xA8D9D1535CE3B396ULL,694},
+  {0xFB9B7CD9A4A7443CULL,720}, {0xBB764C4CA7A44410ULL,747}, {0x8BAB8EEFB6409C1AULL,774},
+  {0xD01FEF10A657842CULL,800}, {0x9B10A4E5E9913129ULL,827}, {0xE7109BFBA19C0C9DULL,853},
+  {0xAC2820D9623BF429ULL,880}, {0x80444B5E7AA7CF85ULL,907}, {0xBF21E44003ACDD2DULL,933},
+  {0x8E679C2F5E44FF8FULL,960}, {0xD433179D9C8CB841ULL,986}, {0x9E19DB92B4E31BA9ULL,1013},
+  {0xEB96BF6EBADF77D9ULL,1039}, {0xAF87023B9BF0EE6BULL,1066},
+#endif
+};
+#ifdef SAVE_ON_FLASH
+#define FTOA_CACHED_POWER_FIRST 36
+#else
+#define FTOA_CACHED_POWER_FIRST 0
+#endif
+#define FTOA_CACHED_POWER_COUNT (sizeof(ftoaCachedPowers)/sizeof(ftoaCachedPowers[0]))
+
+static const uint64_t ftoaPow10[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+  10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static FtoaDiyFp ftoaDiyFpMultiply(FtoaDiyFp a, FtoaDiyFp b) {
+  const uint64_t M32 = 0xFFFFFFFFULL;
+  uint64_t ah = a.f >> 32, al = a.f & M32, bh = b.f >> 32, bl = b.f & M32;
+  uint64_t hh = ah*bh, lh = al*bh, hl = ah*bl, ll = al*bl;
+  uint64_t tmp = (ll >> 32) + (hl & M32) + (lh & M32) + (1ULL << 31); // round
+  FtoaDiyFp r;
+  r.f = hh + (hl >> 32) + (lh >> 32) + (tmp >> 32);
+  r.e = a.e + b.e + 64;
+  return r;
+}
+
+static FtoaDiyFp ftoaDiyFpNormalize(FtoaDiyFp v) {
+  int shift;
+  for (shift=32;shift;shift>>=1) { // binary search for the top bit
+    if (!(v.f >> (64-shift))) {
+      v.f <<= shift;
+      v.e -= shift;
+    }
+  }
+  return v;
+}
+
+/// Remove digits from the end of buffer while the result is still inside the rounding range, and closer to the real value
+static void ftoaGrisuRound(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpW) {
+  while (rest < wpW && delta - rest >= tenKappa &&
+         (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW)) {
+    buffer[len-1]--;
+    rest += tenKappa;
+  }
+}
+
+/** Write the shortest digits for val (>0, finite) into buffer (at least 18
+ * chars) and return how many there are. *K is set such that val = digits*10^K.
+ * Returns 0 if this can't be done (SAVE_ON_FLASH and out of range) */
+static int ftoaGrisu2(double val, char *buffer, int *K) {
+  union { double d; uint64_t u; } bits;
+  bits.d = val;
+  const uint64_t hiddenBit = 1ULL<<52;
+  int biasedE = (int)((bits.u >> 52) & 0x7FF);
+  FtoaDiyFp v;
+  v.f = bits.u & (hiddenBit-1);
+  if (biasedE) {
+    v.f += hiddenBit;
+    v.e = biasedE - 1075;
+  } else
+    v.e = -1074;
+  // the boundaries halfway to the next and previous doubles
+  FtoaDiyFp mPlus, mMinus;
+  mPlus.f = (v.f<<1)+1;
+  mPlus.e = v.e-1;
+  mPlus = ftoaDiyFpNormalize(mPlus);
+  if (v.f == hiddenBit) { // the previous double is closer if we're at a power of 2
+    mMinus.f = (v.f<<2)-1;
+    mMinus.e = v.e-2;
+  } else {
+    mMinus.f = (v.f<<1)-1;
+    mMinus.e = v.e-1;
+  }
+  mMinus.f <<= mMinus.e - mPlus.e;
+  mMinus.e = mPlus.e;
+  /* pick a power of 10 that'll put the exponent of the product between -60
+   * and -32: k = 347 + ceil((-61-e)*log10(2)). (x*78913)>>18 is
+   * floor(x*log10(2)) for 0<=x<=1650, and we avoid floating point here as
+   * it's slow on devices without a double precision FPU */
+  int x = -61 - mPlus.e;
+  int k = 347 + ((x>0) ? ((x*78913)>>18)+1 : -((-x*78913)>>18));
+  int index = (k >> 3) + 1;
+  if (index < FTOA_CACHED_POWER_FIRST || index >= (int)(FTOA_CACHED_POWER_FIRST+FTOA_CACHED_POWER_COUNT))
+    return 0;
+  FtoaDiyFp cmk;
+  cmk.f = ftoaCachedPowers[index-FTOA_CACHED_POWER_FIRST].f;
+  cmk.e = ftoaCachedPowers[index-FTOA_CACHED_POWER_FIRST].e;
+  *K = 348 - index*8; // decimal exponent of 1/cmk
+
+  FtoaDiyFp W = ftoaDiyFpMultiply(ftoaDiyFpNormalize(v), cmk);
+  FtoaDiyFp Wp = ftoaDiyFpMultiply(mPlus, cmk);
+  FtoaDiyFp Wm = ftoaDiyFpMultiply(mMinus, cmk);
+  Wm.f++; // allow for the error in the multiply
+  Wp.f--;
+
+  // generate digits of Wp until we're within delta of it
+  int oneE = -Wp.e;
+  uint64_t oneF = 1ULL << oneE;
+  uint64_t wpW = Wp.f - W.f;
+  uint64_t delta = Wp.f - Wm.f;
+  uint32_t p1 = (uint32_t)(Wp.f >> oneE);
+  uint64_t p2 = Wp.f & (oneF-1);
+  int kappa = 1;
+  while (kappa<10 && p1 >= ftoaPow10[kappa]) kappa++;
+  int len = 0;
+  while (kappa > 0) {
+    uint32_t d;
+    switch (kappa) { // constant divisors, so the compiler can use multiplies
+      case 10: d = p1 / 1000000000; p1 %= 1000000000; break;
+      case  9: d = p1 /  100000000; p1 %=  100000000; break;
+      case  8: d = p1 /   10000000; p1 %=   10000000; break;
+      case  7: d = p1 /    1000000; p1 %=    1000000; break;
+      case  6: d = p1 /     100000; p1 %=     100000; break;
+      case  5: d = p1 /      10000; p1 %=      10000; break;
+      case  4: d = p1 /       1000; p1 %=       1000; break;
+      case  3: d = p1 /        100; p1 %=        100; break;
+      case  2: d = p1 /         10; p1 %=         10; break;
+      default: d = p1; p1 = 0; break;
+    }
+    if (d || len) buffer[len++] = (char)('0'+d);
+    kappa--;
+    uint64_t rest = ((uint64_t)p1 << oneE) + p2;
+    if (rest <= delta) {
+      *K += kappa;
+      ftoaGrisuRound(buffer, len, delta, rest, ftoaPow10[kappa] << oneE, wpW);
+      return len;
+    }
+  }
+  while (true) {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> oneE);
+    if (d || len) buffer[len++] = (char)('0'+d);
+    p2 &= oneF-1;
+    kappa--;
+    if (p2 < delta) {
+      *K += kappa;
+      ftoaGrisuRound(buffer, len, delta, p2, oneF, (-kappa < 20) ? wpW*ftoaPow10[-kappa] : 0);
+      return len;
+    }
+  }
+}
+
+/** Write the shortest representation of val (>0, finite) in the same format
+ * as JavaScript's Number.toString(). Returns false if it can't be done */
+static bool ftoa_shortest(JsVarFloat val, char *str, size_t len) {
+  if (!len) return true;
+  char digits[20];
+  int K;
+  int n = ftoaGrisu2(val, digits, &K);
+  if (!n) return false;
+  char buf[32];
+  int i, l = 0;
+  int point = n + K; // position of the decimal point in digits
+  if (n <= point && point <= 21) { // integer - add trailing zeros
+    memcpy(buf, digits, (size_t)n);
+    l = n;
+    for (i=n;i<point;i++) buf[l++] = '0';
+  } else if (0 < point && point <= 21) { // 123.456
+    memcpy(buf, digits, (size_t)point);
+    l = point;
+    buf[l++] = '.';
+    memcpy(&buf[l], &digits[point], (size_t)(n-point));
+    l += n-point;
+  } else if (-6 < point && point <= 0) { // 0.00123
+    buf[l++] = '0';
+    buf[l++] = '.';
+    for (i=point;i<0;i++) buf[l++] = '0';
+    memcpy(&buf[l], digits, (size_t)n);
+    l += n;
+  } else { // 1.23e+45
+    buf[l++] = digits[0];
+    if (n>1) {
+      buf[l++] = '.';
+      memcpy(&buf[l], &digits[1], (size_t)(n-1));
+      l += n-1;
+    }
+    buf[l++] = 'e';
+    int e = point-1;
+    if (e<0) {
+      buf[l++] = '-';
+      e = -e;
+    } else buf[l++] = '+';
+    if (e>=100) buf[l++] = (char)('0'+(e/100));
+    if (e>=10) buf[l++] = (char)('0'+(e/10)%10);
+    buf[l++] = (char)('0'+(e%10));
+  }
+  if ((size_t)l >= len) l = (int)len-1; // bounds check
+  memcpy(str, buf, (size_t)l);
+  str[l] = 0;
+  return true;
+}
+#endif
+
 void ftoa_bounded_extra(JsVarFloat val,char *str, size_t len, int radix, int fractionalDigits) {
   const JsVarFloat stopAtError = 0.0000001;
   if (isnan(val)) strncpy(str,"NaN",len);
@@ -605,6 +1193,15 @@ void ftoa_bounded_extra(JsVarFloat val,char *str, size_t len, int radix, int fra
       *(str++) = '-';
       val = -val;
     }
+#ifndef USE_NO_FLOATS
+    if (radix==10 && fractionalDigits<0) {
+      if (val==0) {
+        strncpy(str,"0",len);
+        return;
+      }
+      if (ftoa_shortest(val, str, len)) return;
+    }
+#endif
 
     // what if we're really close to an integer? Just use that...
     if (((JsVarInt)(val+stopAtError)) == (1+(JsVarInt)val))
@@ -712,26 +1309,31 @@ void vcbprintf(
       case 'q':
       case 'v': {
         bool quoted = fmtChar=='q';
-        if (quoted) user_callback("\"",user_data);
         JsVar *v = jsvAsString(va_arg(argp, JsVar*), false/*no unlock*/);
-        buf[1] = 0;
-        if (jsvIsString(v)) {
+        if (quoted && jsvIsString(v)) {
+          jsfGetEscapedString(v, user_callback, user_data);
+        } else if (jsvIsString(v)) {
+          // send a block of the string at a time
           JsvStringIterator it;
           jsvStringIteratorNew(&it, v, 0);
-          // OPT: this could be faster than it is (sending whole blocks at once)
           while (jsvStringIteratorHasChar(&it)) {
-            buf[0] = jsvStringIteratorGetChar(&it);
-            if (quoted) {
-              user_callback(escapeCharacter(buf[0]), user_data);
-            } else {
+            size_t n;
+            const char *span = jsvStringIteratorGetSpan(&it, &n);
+            if (n > sizeof(buf)-1) n = sizeof(buf)-1;
+            const char *zero = memchr(span, 0, n);
+            if (zero) n = (size_t)(zero-span); // a 0 would end our string early
+            if (n) {
+              memcpy(buf, span, n);
+              buf[n] = 0;
               user_callback(buf,user_data);
-            }
-            jsvStringIteratorNext(&it);
+            } else n = 1; // skip the 0
+            jsvStringIteratorSkip(&it, n);
           }
           jsvStringIteratorFree(&it);
-          jsvUnLock(v);
+        } else if (quoted) {
+          user_callback("\"\"",user_data);
         }
-        if (quoted) user_callback("\"",user_data);
+        jsvUnLock(v);
       } break;
       case 'j': {
         JsVar *v = jsvAsString(va_arg(argp, JsVar*), false/*no unlock*/);
@@ -271,6 +271,15 @@ typedef int64_t JsSysTime;
 /// Used before functions that we want to ensure are not inlined (eg. "void NO_INLINE foo() {}")
 #define NO_INLINE __attribute__ ((noinline))
 
+/** Put before global variables that hold interpreter state (JsVar heap, execInfo,
+ * event queues). On Linux every thread can run its own interpreter context
+ * (see targets/linux/jscontext.h) so these are thread-local there. */
+#ifdef LINUX
+#define JS_CONTEXT_LOCAL __thread
+#else
+#define JS_CONTEXT_LOCAL
+#endif
+
 /// Put before functions that we always want inlined
 #if defined(__GNUC__) && !defined(__clang__)
  #if defined(LINK_TIME_OPTIMISATION) && !defined(SAVE_ON_FLASH) && !defined(DEBUG)
@@ -399,7 +408,7 @@ typedef enum {
 
 /** Error flags for things that we don't really want to report on the console,
  * but which are good to know about */
-extern JsErrorFlags jsErrorFlags;
+extern JS_CONTEXT_LOCAL JsErrorFlags jsErrorFlags;
 
 JsVarFloat stringToFloatWithRadix(const char *s, int forceRadix);
 JsVarFloat stringToFloat(const char *str);
@@ -36,8 +36,8 @@
  */
 
 #ifdef RESIZABLE_JSVARS
-JsVar **jsVarBlocks = 0;
-unsigned int jsVarsSize = 0;
+JS_CONTEXT_LOCAL JsVar **jsVarBlocks = 0;
+JS_CONTEXT_LOCAL unsigned int jsVarsSize = 0;
 #define JSVAR_BLOCK_SIZE 4096
 #define JSVAR_BLOCK_SHIFT 12
 #else
@@ -45,8 +45,19 @@ JsVar jsVars[JSVAR_CACHE_SIZE];
 unsigned int jsVarsSize = JSVAR_CACHE_SIZE;
 #endif
 
-volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
-volatile bool isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
+JS_CONTEXT_LOCAL volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
+JS_CONTEXT_LOCAL volatile bool isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
+static JS_CONTEXT_LOCAL JsvGarbageCollectMarkCallback gcMarkCallback = 0; ///< Marks variables that are only referenced from native code
+
+#ifdef LINUX
+/* Each thread has its own heap (JS_CONTEXT_LOCAL) and nothing allocates from
+ * another thread, so don't take the process-wide interrupt lock */
+#define jsvFreeListLock()
+#define jsvFreeListUnlock()
+#else
+#define jsvFreeListLock() jshInterruptOff() // to allow this to be used from an IRQ
+#define jsvFreeListUnlock() jshInterruptOn()
+#endif
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -243,8 +254,11 @@ void jsvInit() {
 void jsvKill() {
 #ifdef RESIZABLE_JSVARS
   unsigned int i;
+  /* jsvSetMemoryTotal allocates several blocks with one malloc, so only
+   * free the first block of each group */
   for (i=0;i<jsVarsSize>>JSVAR_BLOCK_SHIFT;i++)
-    free(jsVarBlocks[i]);
+    if (i==0 || jsVarBlocks[i]!=jsVarBlocks[i-1]+JSVAR_BLOCK_SIZE)
+      free(jsVarBlocks[i]);
   free(jsVarBlocks);
   jsVarBlocks = 0;
   jsVarsSize = 0;
@@ -285,32 +299,43 @@ unsigned int jsvGetMemoryTotal() {
   return jsVarsSize;
 }
 
-/// Try and allocate more memory - only works if RESIZABLE_JSVARS is defined
-void jsvSetMemoryTotal(unsigned int jsNewVarCount) {
+/// Try and allocate more memory - only works if RESIZABLE_JSVARS is defined. Returns false if it couldn't
+bool jsvSetMemoryTotal(unsigned int jsNewVarCount) {
 #ifdef RESIZABLE_JSVARS
   assert(!isMemoryBusy);
-  isMemoryBusy = true;
-  if (jsNewVarCount <= jsVarsSize) return; // never allow us to have less!
+  if (jsNewVarCount <= jsVarsSize) return false; // never allow us to have less!
   // When resizing, we just allocate a bunch more
   unsigned int oldSize = jsVarsSize;
   unsigned int oldBlockCount = jsVarsSize >> JSVAR_BLOCK_SHIFT;
   unsigned int newBlockCount = (jsNewVarCount+JSVAR_BLOCK_SIZE-1) >> JSVAR_BLOCK_SHIFT;
-  jsVarsSize = newBlockCount << JSVAR_BLOCK_SHIFT;
+  /* allocate the new blocks all at once, so they are contiguous and a
+   * flat string can span them (see jsvNewFlatStringOfLength) */
+  JsVar *vars = malloc(sizeof(JsVar) * JSVAR_BLOCK_SIZE * (newBlockCount-oldBlockCount));
+  if (!vars) return false;
   // resize block table
-  jsVarBlocks = realloc(jsVarBlocks, sizeof(JsVar*)*newBlockCount);
-  // allocate more blocks
+  JsVar **blocks = realloc(jsVarBlocks, sizeof(JsVar*)*newBlockCount);
+  if (!blocks) {
+    free(vars);
+    return false;
+  }
+  isMemoryBusy = true;
+  jsVarBlocks = blocks;
+  jsVarsSize = newBlockCount << JSVAR_BLOCK_SHIFT;
   unsigned int i;
   for (i=oldBlockCount;i<newBlockCount;i++)
-    jsVarBlocks[i] = malloc(sizeof(JsVar) * JSVAR_BLOCK_SIZE);
-  /** and now reset all the newly allocated vars. We know jsVarFirstEmpty
-   * is 0 (because jsiFreeMoreMemory returned 0) so we can just assign it.  */
-  assert(!jsVarFirstEmpty);
+    jsVarBlocks[i] = &vars[(i-oldBlockCount) * JSVAR_BLOCK_SIZE];
+  /** and now reset all the newly allocated vars, and add any vars that
+   * were already free onto the end of the list */
+  JsVarRef oldFirstEmpty = jsVarFirstEmpty;
   jsVarFirstEmpty = jsvInitJsVars(oldSize+1, jsVarsSize-oldSize);
+  jsvSetNextSibling(jsvGetAddressOf((JsVarRef)jsVarsSize), oldFirstEmpty);
   // jsiConsolePrintf("Resized memory from %d blocks to %d\n", oldBlockCount, newBlockCount);
   isMemoryBusy = false;
+  return true;
 #else
   NOT_USED(jsNewVarCount);
   assert(0);
+  return false;
 #endif
 }
 
@@ -382,10 +407,10 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
     return 0;
   }
   if (jsVarFirstEmpty!=0) {
-    jshInterruptOff(); // to allow this to be used from an IRQ
+    jsvFreeListLock();
     JsVar *v = jsvGetAddressOf(jsVarFirstEmpty); // jsvResetVariable will lock
     jsVarFirstEmpty = jsvGetNextSibling(v); // move our reference to the next in the fr
-    jshInterruptOn();
+    jsvFreeListUnlock();
     assert(v->flags == JSV_UNUSED);
     // Cope with IRQs/multi-threading when getting a new free variable
  /*   JsVarRef empty;
@@ -413,29 +438,30 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
   }
   /* We couldn't claim any more memory by Garbage collecting... */
 #ifdef RESIZABLE_JSVARS
-  jsvSetMemoryTotal(jsVarsSize*2);
-  return jsvNewWithFlags(flags);
-#else
-  // On a micro, we're screwed.
+  if (jsvSetMemoryTotal(jsVarsSize*2))
+    return jsvNewWithFlags(flags);
+#endif
+  // On a micro (or if we couldn't allocate more), we're screwed.
   if (!(jsErrorFlags&JSERR_MEMORY))
     jsError("Out of Memory!");
   jsErrorFlags |= JSERR_MEMORY;
   jspSetInterrupted(true);
   return 0;
-#endif
 }
 
 ALWAYS_INLINE void jsvFreePtrInternal(JsVar *var) {
   assert(jsvGetLocks(var)==0);
   var->flags = JSV_UNUSED;
   // add this to our free list
-  jshInterruptOff(); // to allow this to be used from an IRQ
+  jsvFreeListLock();
   jsvSetNextSibling(var, jsVarFirstEmpty);
   jsVarFirstEmpty = jsvGetRef(var);
-  jshInterruptOn();
+  jsvFreeListUnlock();
 }
 
 ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
+  // Arrays keep their index offset in nextSibling - see jsvArrayShift
+  if (jsvIsArray(var)) jsvSetNextSibling(var, 0);
   /* To be here, we're not supposed to be part of anything else. If
    * we were, we'd have been freed by jsvGarbageCollect */
   assert((!jsvGetNextSibling(var) && !jsvGetPrevSibling(var)) || // check that next/prevSibling are not set
@@ -682,8 +708,14 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
 #ifdef RESIZABLE_JSVARS
       /** With RESIZABLE_JSVARS (Linux), we have chunks of variables that may
        * not be contiguous - so we can't allocate a flat string across them!  */
-      if (var != lastVar+1)
+      if (var != lastVar+1) {
+        // add the blocks we'd counted back to the free list
+        for (j=(JsVarRef)(i-blockCount);j<i;j++) {
+          jsvSetNextSibling(lastEmpty, j);
+          lastEmpty = jsvGetAddressOf(j);
+        }
         blockCount = 0;
+      }
       lastVar = var;
 #endif
       blockCount++;
@@ -727,6 +759,14 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
   jsvSetNextSibling(lastEmpty, 0);
   jsVarFirstEmpty = jsvGetNextSibling(&firstVar);
   isMemoryBusy = false;
+#ifdef RESIZABLE_JSVARS
+  /* If we need a big area of memory (eg. for a large ArrayBuffer), allocate
+   * more. New blocks are contiguous so it'll definitely fit. */
+  if (!flatString && blocks >= JSVAR_BLOCK_SIZE/4) {
+    if (jsvSetMemoryTotal(jsVarsSize + (unsigned int)blocks))
+      return jsvNewFlatStringOfLength(byteLength);
+  }
+#endif
   // Return whatever we had (0 if we couldn't manage it)
   return flatString;
 }
@@ -962,7 +1002,7 @@ JsVar *jsvNewArrayBufferFromString(JsVar *str, unsigned int lengthOrZero) {
   arr->varData.arraybuffer.type = ARRAYBUFFERVIEW_ARRAYBUFFER;
   assert(arr->varData.arraybuffer.byteOffset == 0);
   if (lengthOrZero==0) lengthOrZero = (unsigned int)jsvGetStringLength(str);
-  arr->varData.arraybuffer.length = (unsigned short)lengthOrZero;
+  arr->varData.arraybuffer.length = (JsVarArrayBufferLength)lengthOrZero;
   return arr;
 }
 
@@ -1075,21 +1115,27 @@ size_t jsvGetString(const JsVar *v, char *str, size_t len) {
     return strlen(str);
   } else if (jsvHasCharacterData(v)) {
     assert(!jsvIsStringExt(v));
-    size_t l = len;
+    size_t l = 0;
     JsvStringIterator it;
     jsvStringIteratorNewConst(&it, v, 0);
     while (jsvStringIteratorHasChar(&it)) {
-      if (l--<=1) {
-        *str = 0;
+      size_t n;
+      const char *span = jsvStringIteratorGetSpan(&it, &n);
+      if (l+n >= len) { // not enough space (with a trailing 0) - truncate
+        if (len) {
+          memcpy(&str[l], span, len-1-l);
+          str[len-1] = 0;
+        }
         jsvStringIteratorFree(&it);
         return len;
       }
-      *(str++) = jsvStringIteratorGetChar(&it);
-      jsvStringIteratorNext(&it);
+      memcpy(&str[l], span, n);
+      l += n;
+      jsvStringIteratorSkip(&it, n);
     }
     jsvStringIteratorFree(&it);
-    *str = 0;
-    return len-l;
+    str[l] = 0;
+    return l;
   } else {
     // Try and get as a JsVar string, and try again
     JsVar *stringVar = jsvAsString((JsVar*)v, false); // we know we're casting to non-const here
@@ -1108,20 +1154,24 @@ size_t jsvGetString(const JsVar *v, char *str, size_t len) {
 /// Get len bytes of string data from this string. Does not error if string len is not equal to len
 size_t jsvGetStringChars(const JsVar *v, size_t startChar, char *str, size_t len) {
   assert(jsvHasCharacterData(v));
-  size_t l = len;
+  size_t l = 0;
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, v, startChar);
   while (jsvStringIteratorHasChar(&it)) {
-    if (l--<=0) {
+    if (l>=len) {
       jsvStringIteratorFree(&it);
       return len;
     }
-    *(str++) = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorNext(&it);
+    size_t n;
+    const char *span = jsvStringIteratorGetSpan(&it, &n);
+    if (n > len-l) n = len-l;
+    memcpy(&str[l], span, n);
+    l += n;
+    jsvStringIteratorSkip(&it, n);
   }
   jsvStringIteratorFree(&it);
-  *str = 0;
-  return len-l;
+  str[l] = 0;
+  return l;
 }
 
 /// Set the Data in this string. This must JUST overwrite - not extend or shrink
@@ -1131,10 +1181,14 @@ void jsvSetString(JsVar *v, const char *str, size_t len) {
 
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, 0);
-  size_t i;
-  for (i=0;i<len;i++) {
-    jsvStringIteratorSetChar(&it, str[i]);
-    jsvStringIteratorNext(&it);
+  while (len && jsvStringIteratorHasChar(&it)) {
+    size_t n;
+    char *span = (char*)jsvStringIteratorGetSpan(&it, &n);
+    if (n > len) n = len;
+    memcpy(span, str, n);
+    str += n;
+    len -= n;
+    jsvStringIteratorSkip(&it, n);
   }
   jsvStringIteratorFree(&it);
 }
@@ -1300,8 +1354,12 @@ char *jsvGetDataPointer(JsVar *v, size_t *len) {
     char *r = jsvGetDataPointer(d, len);
     jsvUnLock(d);
     if (r) {
-      r += v->varData.arraybuffer.byteOffset;
+      size_t byteOffset = v->varData.arraybuffer.byteOffset;
+      r += byteOffset;
+      // never go past the end of the backing string, even if the view says we can
+      size_t available = *len>byteOffset ? (*len-byteOffset) / JSV_ARRAYBUFFER_GET_SIZE(v->varData.arraybuffer.type) : 0;
       *len = v->varData.arraybuffer.length;
+      if (*len > available) *len = available;
     }
     return r;
   }
@@ -1405,11 +1463,7 @@ void jsvAppendString(JsVar *var, const char *str) {
   JsvStringIterator dst;
   jsvStringIteratorNew(&dst, var, 0);
   jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-   * and is less likely to break :) */
-  while (*str)
-    jsvStringIteratorAppend(&dst, *(str++));
+  jsvStringIteratorAppendBuf(&dst, str, strlen(str));
   jsvStringIteratorFree(&dst);
 }
 
@@ -1419,20 +1473,13 @@ void jsvAppendStringBuf(JsVar *var, const char *str, size_t length) {
   JsvStringIterator dst;
   jsvStringIteratorNew(&dst, var, 0);
   jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-   * and is less likely to break :) */
-  while (length) {
-    jsvStringIteratorAppend(&dst, *(str++));
-    length--;
-  }
+  jsvStringIteratorAppendBuf(&dst, str, length);
   jsvStringIteratorFree(&dst);
 }
 
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
 void jsvStringIteratorPrintfCallback(const char *str, void *user_data) {
-  while (*str)
-    jsvStringIteratorAppend((JsvStringIterator *)user_data, *(str++));
+  jsvStringIteratorAppendBuf((JsvStringIterator *)user_data, str, strlen(str));
 }
 
 void jsvAppendPrintf(JsVar *var, const char *fmt, ...) {
@@ -1471,15 +1518,16 @@ void jsvAppendStringVar(JsVar *var, const JsVar *str, size_t stridx, size_t maxL
   JsvStringIterator dst;
   jsvStringIteratorNew(&dst, var, 0);
   jsvStringIteratorGotoEnd(&dst);
-  // now start appending
-  /* This isn't as fast as something single-purpose, but it's not that bad,
-     * and is less likely to break :) */
+  // now append a block of str at a time
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, str, stridx);
-  while (jsvStringIteratorHasChar(&it) && (maxLength-->0)) {
-    char ch = jsvStringIteratorGetChar(&it);
-    jsvStringIteratorAppend(&dst, ch);
-    jsvStringIteratorNext(&it);
+  while (maxLength && jsvStringIteratorHasChar(&it)) {
+    size_t n;
+    const char *span = jsvStringIteratorGetSpan(&it, &n);
+    if (n > maxLength) n = maxLength;
+    jsvStringIteratorAppendBuf(&dst, span, n);
+    maxLength -= n;
+    jsvStringIteratorSkip(&it, n);
   }
   jsvStringIteratorFree(&it);
   jsvStringIteratorFree(&dst);
@@ -1523,6 +1571,83 @@ int jsvGetStringIndexOf(JsVar *str, char ch) {
   return -1;
 }
 
+/** Find 'search' in a string that is all in one contiguous block of memory
+ * (flat or native), using Boyer-Moore-Horspool */
+static int jsvGetContiguousStringIndexOf(const char *str, size_t startIdx, size_t lastIdx, bool backwards, const char *needle, size_t needleLen, JsVar *strVar, JsVar *search, size_t searchLen) {
+  if (backwards) {
+    size_t s = startIdx+1;
+    while (s-- > 0) {
+      if (str[s]==needle[0] && !memcmp(&str[s], needle, needleLen) &&
+          (searchLen==needleLen || !jsvCompareString(strVar, search, s+needleLen, needleLen, true)))
+        return (int)s;
+    }
+    return -1;
+  }
+  if (needleLen==1) {
+    const char *p = (const char*)memchr(&str[startIdx], needle[0], lastIdx+1-startIdx);
+    return p ? (int)(p-str) : -1;
+  }
+  // how far we can move forwards when we find each character at the end of needle
+  unsigned char shift[256];
+  memset(shift, (int)needleLen, sizeof(shift));
+  size_t i;
+  for (i=0;i<needleLen-1;i++)
+    shift[(unsigned char)needle[i]] = (unsigned char)(needleLen-1-i);
+  char lastCh = needle[needleLen-1];
+  size_t s = startIdx;
+  while (s <= lastIdx) {
+    char ch = str[s+needleLen-1];
+    if (ch==lastCh && !memcmp(&str[s], needle, needleLen-1) &&
+        (searchLen==needleLen || !jsvCompareString(strVar, search, s+needleLen, needleLen, true)))
+      return (int)s;
+    s += shift[(unsigned char)ch];
+  }
+  return -1;
+}
+
+/** Get the index of 'search' in 'str', starting at startIdx and searching
+ * forwards (or backwards), or -1. Used by indexOf/lastIndexOf/split/replace */
+int jsvGetStringIndexOfString(JsVar *str, JsVar *search, size_t startIdx, bool backwards) {
+  size_t strLen = jsvGetStringLength(str);
+  size_t searchLen = jsvGetStringLength(search);
+  if (startIdx > strLen) startIdx = strLen; // like JS, clamp to the string's length
+  if (!searchLen) return (int)startIdx; // the empty string is found wherever we start
+  if (searchLen > strLen) return -1;
+  size_t lastIdx = strLen - searchLen; // the last place search could start
+  if (startIdx > lastIdx) {
+    if (!backwards) return -1;
+    startIdx = lastIdx;
+  }
+
+#ifdef ESP8266
+  if (jsvIsFlatString(str)) { // native strings may be in flash, so must use the iterator
+#else
+  if (jsvIsFlatString(str) || jsvIsNativeString(str)) {
+#endif
+    char needle[JSV_STRING_SEARCH_BUFFER];
+    size_t needleLen = jsvGetStringChars(search, 0, needle, sizeof(needle));
+    const char *ptr = jsvIsFlatString(str) ? jsvGetFlatStringPointer(str) : (const char*)str->varData.nativeStr.ptr;
+    return jsvGetContiguousStringIndexOf(ptr, startIdx, lastIdx, backwards, needle, needleLen, str, search, searchLen);
+  }
+
+  JsvStringIterator it;
+  int idx;
+  if (backwards) { // we can only go forwards, so remember the last match
+    jsvStringIteratorNew(&it, str, 0);
+    int found;
+    idx = -1;
+    while ((found = jsvStringIteratorFindString(&it, search)) >= 0 && found <= (int)startIdx) {
+      idx = found;
+      jsvStringIteratorNext(&it);
+    }
+  } else {
+    jsvStringIteratorNew(&it, str, startIdx);
+    idx = jsvStringIteratorFindString(&it, search);
+  }
+  jsvStringIteratorFree(&it);
+  return idx;
+}
+
 /** Does this string contain only Numeric characters (with optional '-'/'+' at the front)? NOT '.'/'e' and similar (allowDecimalPoint is for '.' only) */
 bool jsvIsStringNumericInt(const JsVar *var, bool allowDecimalPoint) {
   assert(jsvIsString(var));
@@ -2023,6 +2148,7 @@ JsVar *jsvCopyNameOnly(JsVar *src, bool linkChildren, bool keepAsName) {
 }
 
 JsVar *jsvCopy(JsVar *src) {
+  jsvArrayNormaliseIndices(src); // so the copied keys are right
   if (jsvIsFlatString(src)) {
     // Copy a Flat String into a non-flat string - it's just safer
     return jsvNewFromStringVar(src, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
@@ -2089,13 +2215,45 @@ JsVar *jsvCopy(JsVar *src) {
   return dst;
 }
 
-void jsvAddName(JsVar *parent, JsVar *namedChild) {
+/* Arrays that have been used as a queue (jsvArrayShift/jsvArrayUnshift) don't
+ * renumber their elements each time. Instead the array's (otherwise unused)
+ * nextSibling holds an offset that is added to every non-negative integer key,
+ * so the element at index i is stored with the key i+offset. Anything that
+ * exposes keys (iterators, copies, adding a new name) calls
+ * jsvArrayNormaliseIndices first, so the offset is invisible outside jsvar.c */
+static ALWAYS_INLINE JsVarInt jsvArrayGetIndexOffset(const JsVar *arr) {
+  return (JsVarInt)jsvGetNextSibling(arr);
+}
+
+/// Add 'amount' to every non-negative integer key in the array
+static void jsvArrayAddToIndices(JsVar *arr, JsVarInt amount) {
+  JsVarRef childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsInt(child) && child->varData.integer>=0)
+      child->varData.integer += amount;
+    childref = jsvGetNextSibling(child);
+  }
+}
+
+/// If the array's keys are stored with an offset (see jsvArrayShift), renumber them so they are not
+void jsvArrayNormaliseIndices(JsVar *arr) {
+  if (!jsvIsArray(arr)) return;
+  JsVarInt offset = jsvArrayGetIndexOffset(arr);
+  if (!offset) return;
+  jsvArrayAddToIndices(arr, -offset);
+  jsvSetNextSibling(arr, 0);
+}
+
+/// Add a name - if parent is an array then the name's index must already include the array's offset
+static void jsvAddNameWithOffset(JsVar *parent, JsVar *namedChild) {
   namedChild = jsvRef(namedChild); // ref here VERY important as adding to structure!
   assert(jsvIsName(namedChild));
 
   // update array length
   if (jsvIsArray(parent) && jsvIsInt(namedChild)) {
     JsVarInt index = namedChild->varData.integer;
+    if (index >= 0) index -= jsvArrayGetIndexOffset(parent);
     if (index >= jsvGetArrayLength(parent)) {
       jsvSetArrayLength(parent, index + 1, false);
     }
@@ -2143,6 +2301,11 @@ void jsvAddName(JsVar *parent, JsVar *namedChild) {
   }
 }
 
+void jsvAddName(JsVar *parent, JsVar *namedChild) {
+  jsvArrayNormaliseIndices(parent);
+  jsvAddNameWithOffset(parent, namedChild);
+}
+
 JsVar *jsvAddNamedChild(JsVar *parent, JsVar *child, const char *name) {
   JsVar *namedChild = jsvMakeIntoVariableName(jsvNewFromString(name), child);
   if (!namedChild) return 0; // Out of memory
@@ -2278,6 +2441,25 @@ JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound)
   JsVar *child;
   JsVarRef childref = jsvGetFirstChild(parent);
 
+  if (jsvIsArray(parent) && jsvArrayGetIndexOffset(parent) &&
+      jsvIsInt(childName) && childName->varData.integer>=0) {
+    // array used as a queue - look up the stored key without renumbering
+    JsVarInt index = childName->varData.integer + jsvArrayGetIndexOffset(parent);
+    while (childref) {
+      child = jsvGetAddressOf(childref);
+      if (jsvIsInt(child) && child->varData.integer == index)
+        return jsvLockAgain(child);
+      childref = jsvGetNextSibling(child);
+    }
+    child = 0;
+    if (addIfNotFound) {
+      child = jsvMakeIntoVariableName(jsvNewFromInteger(index), 0);
+      if (child) // could be out of memory
+        jsvAddNameWithOffset(parent, child);
+    }
+    return child;
+  }
+
   while (childref) {
     child = jsvLock(childref);
     if (jsvIsBasicVarEqual(child, childName)) {
@@ -2413,6 +2595,7 @@ int jsvGetChildren(JsVar *v) {
 /// Get the first child's name from an object,array or function
 JsVar *jsvGetFirstName(JsVar *v) {
   assert(jsvHasChildren(v));
+  jsvArrayNormaliseIndices(v); // we return the key
   if (!jsvGetFirstChild(v)) return 0;
   return jsvLock(jsvGetFirstChild(v));
 }
@@ -2498,6 +2681,8 @@ size_t jsvCountJsVarsUsed(JsVar *v) {
 
 
 JsVar *jsvGetArrayItem(const JsVar *arr, JsVarInt index) {
+  if (index>=0 && jsvIsArray(arr))
+    index += jsvArrayGetIndexOffset(arr);
   JsVarRef childref = jsvGetLastChild(arr);
   JsVarInt lastArrayIndex = 0;
   // Look at last non-string element!
@@ -2569,6 +2754,7 @@ void jsvGetArrayItems(JsVar *arr, unsigned int itemCount, JsVar **itemPtr) {
 JsVar *jsvGetArrayIndexOf(JsVar *arr, JsVar *value, bool matchExact) {
   JsVarRef indexref;
   assert(jsvIsArray(arr) || jsvIsObject(arr));
+  jsvArrayNormaliseIndices(arr); // we return the key
   indexref = jsvGetFirstChild(arr);
   while (indexref) {
     JsVar *childIndex = jsvLock(indexref);
@@ -2589,6 +2775,7 @@ JsVar *jsvGetArrayIndexOf(JsVar *arr, JsVar *value, bool matchExact) {
 /// Adds new elements to the end of an array, and returns the new length. initialValue is the item index when no items are currently in the array.
 JsVarInt jsvArrayAddToEnd(JsVar *arr, JsVar *value, JsVarInt initialValue) {
   assert(jsvIsArray(arr));
+  jsvArrayNormaliseIndices(arr);
   JsVarInt index = initialValue;
   if (jsvGetLastChild(arr)) {
     JsVar *last = jsvLock(jsvGetLastChild(arr));
@@ -2609,13 +2796,13 @@ JsVarInt jsvArrayAddToEnd(JsVar *arr, JsVar *value, JsVarInt initialValue) {
 /// Adds new elements to the end of an array, and returns the new length
 JsVarInt jsvArrayPush(JsVar *arr, JsVar *value) {
   assert(jsvIsArray(arr));
-  JsVarInt index = jsvGetArrayLength(arr);
+  JsVarInt index = jsvGetArrayLength(arr) + jsvArrayGetIndexOffset(arr);
   JsVar *idx = jsvMakeIntoVariableName(jsvNewFromInteger(index), value);
   if (!idx) {
     jsWarn("Out of memory while appending to array");
     return 0;
   }
-  jsvAddName(arr, idx);
+  jsvAddNameWithOffset(arr, idx);
   jsvUnLock(idx);
   return jsvGetArrayLength(arr);
 }
@@ -2650,7 +2837,7 @@ JsVar *jsvArrayPop(JsVar *arr) {
       }
       // check if the last integer key really is the last element
       if (child) {
-        if (jsvGetInteger(child) == length) {
+        if (jsvGetInteger(child) == length + jsvArrayGetIndexOffset(arr)) {
           // child is the last element - remove it
           jsvRemoveChild(arr, child);
         } else {
@@ -2689,6 +2876,96 @@ JsVar *jsvArrayPopFirst(JsVar *arr) {
   }
 }
 
+/// Removes the first element of an array and moves the others down one, returning that element (or 0 if empty). Includes the NAME
+JsVar *jsvArrayShift(JsVar *arr) {
+  assert(jsvIsArray(arr));
+  JsVarInt length = jsvGetArrayLength(arr);
+  if (length <= 0) return 0;
+  JsVarInt offset = jsvArrayGetIndexOffset(arr);
+  if (offset >= JSVARREF_MAX) {
+    // offset would no longer fit - renumber now, then carry on
+    jsvArrayNormaliseIndices(arr);
+    offset = 0;
+  }
+  // find the first non-negative integer key (there may be negative ones before it)
+  JsVar *child = 0;
+  JsVarRef childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *v = jsvGetAddressOf(childref);
+    if (!jsvIsInt(v)) break; // string keys come after all integer keys
+    if (v->varData.integer >= 0) {
+      if (v->varData.integer == offset) // only remove it if it's element 0
+        child = jsvLockAgain(v);
+      break;
+    }
+    childref = jsvGetNextSibling(v);
+  }
+  if (child) jsvRemoveChild(arr, child);
+  // Everything else moves down one just by changing the offset
+  length--;
+  jsvSetArrayLength(arr, length, false);
+  jsvSetNextSibling(arr, length ? (JsVarRef)(offset+1) : 0);
+  return child;
+}
+
+/// Adds all elements of 'elements' to the start of an array, moving existing elements up. Returns false if this couldn't be done
+bool jsvArrayUnshift(JsVar *arr, JsVar *elements) {
+  assert(jsvIsArray(arr) && jsvIsArray(elements));
+  JsVarInt count = jsvGetArrayLength(elements);
+  if (count <= 0) return true;
+  if (count > JSVARREF_MAX) return false;
+  JsVarInt length = jsvGetArrayLength(arr);
+  JsVarInt offset = jsvArrayGetIndexOffset(arr);
+  if (offset < count) {
+    /* Not enough room below the first element. Renumber once, leaving
+     * room for about as many elements again as the array holds now so
+     * that repeated unshifts only renumber every so often */
+    JsVarInt newOffset = count + (length < JSVARREF_MAX-count ? length : JSVARREF_MAX-count);
+    jsvArrayAddToIndices(arr, newOffset - offset);
+    offset = newOffset;
+  }
+  // insert before the first non-negative integer key
+  JsVarRef beforeRef = jsvGetFirstChild(arr);
+  while (beforeRef) {
+    JsVar *v = jsvGetAddressOf(beforeRef);
+    if (!jsvIsInt(v) || v->varData.integer >= 0) break;
+    beforeRef = jsvGetNextSibling(v);
+  }
+  JsVarInt index = offset - count;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, elements);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *key = jsvObjectIteratorGetKey(&it);
+    JsVar *value = jsvSkipName(key);
+    JsVar *idx = jsvMakeIntoVariableName(jsvNewFromInteger(index + jsvGetInteger(key)), value);
+    jsvUnLock2(key, value);
+    if (!idx) break; // out of memory
+    JsVarRef idxRef = jsvGetRef(jsvRef(idx));
+    if (beforeRef) {
+      JsVar *before = jsvGetAddressOf(beforeRef);
+      JsVarRef prev = jsvGetPrevSibling(before);
+      if (prev) jsvSetNextSibling(jsvGetAddressOf(prev), idxRef);
+      else jsvSetFirstChild(arr, idxRef);
+      jsvSetPrevSibling(idx, prev);
+      jsvSetNextSibling(idx, beforeRef);
+      jsvSetPrevSibling(before, idxRef);
+    } else {
+      // no non-negative integer keys - just stick it on the end
+      JsVarRef last = jsvGetLastChild(arr);
+      if (last) jsvSetNextSibling(jsvGetAddressOf(last), idxRef);
+      else jsvSetFirstChild(arr, idxRef);
+      jsvSetPrevSibling(idx, last);
+      jsvSetLastChild(arr, idxRef);
+    }
+    jsvUnLock(idx);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvSetNextSibling(arr, (JsVarRef)(offset - count));
+  jsvSetArrayLength(arr, length + count, false);
+  return true;
+}
+
 /// Adds a new variable element to the end of an array (IF it was not already there). Return true if successful
 void jsvArrayAddUnique(JsVar *arr, JsVar *v) {
   JsVar *idx = jsvGetArrayIndexOf(arr, v, false); // did it already exist?
@@ -2802,6 +3079,7 @@ bool jsvMathsOpTypeEqual(JsVar *a, JsVar *b) {
     // Check whether both are numbers, otherwise check the variable
     // type flags themselves
     eql = ((jsvIsInt(a)||jsvIsFloat(a)) && (jsvIsInt(b)||jsvIsFloat(b))) ||
+        (jsvIsString(a) && jsvIsString(b)) || // normal, flat and native strings
         ((a->flags & JSV_VARTYPEMASK) == (b->flags & JSV_VARTYPEMASK));
   }
   if (eql) {
@@ -3152,6 +3430,19 @@ static void jsvGarbageCollectMarkUsed(JsVar *var) {
   }
 }
 
+/** Mark a variable (and anything it references) as used during a garbage
+ * collection. For native code that holds references rather than locks. */
+void jsvGarbageCollectMarkRef(JsVarRef ref) {
+  if (!ref) return;
+  JsVar *var = jsvGetAddressOf(ref);
+  if (var->flags & JSV_GARBAGE_COLLECT)
+    jsvGarbageCollectMarkUsed(var);
+}
+
+void jsvSetGarbageCollectMarkCallback(JsvGarbageCollectMarkCallback callback) {
+  gcMarkCallback = callback;
+}
+
 /** Run a garbage collection sweep - return true if things have been freed */
 bool jsvGarbageCollect() {
   if (isMemoryBusy) return false;
@@ -3177,6 +3468,8 @@ bool jsvGarbageCollect() {
     if (jsvIsFlatString(var))
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
   }
+  // add things that are only referenced from native code
+  if (gcMarkCallback) gcMarkCallback();
   /* now sweep for things that we can GC!
    * Also update the free list - this means that every new variable that
    * gets allocated gets allocated towards the start of memory, which
@@ -118,11 +118,22 @@ typedef enum {
 #define JSV_ARRAYBUFFER_IS_FLOAT(T) (((T)&ARRAYBUFFERVIEW_FLOAT)!=0)
 #define JSV_ARRAYBUFFER_IS_CLAMPED(T) (((T)&ARRAYBUFFERVIEW_CLAMPED)!=0)
 
+#ifdef LARGE_ARRAYBUFFERS
+/* 32 bit offsets/lengths. This doesn't fit in JSVAR_DATA_STRING_NAME_LEN,
+ * so spills into nextSibling - which is unused for ArrayBuffers */
+#if JSVARREF_SIZE<4
+#error LARGE_ARRAYBUFFERS needs 32 bit JsVarRefs
+#endif
+typedef uint32_t JsVarArrayBufferLength;
+#define JSV_ARRAYBUFFER_MAX_LENGTH 0x7FFFFFFF
+#else
+typedef unsigned short JsVarArrayBufferLength;
 #define JSV_ARRAYBUFFER_MAX_LENGTH 65535
+#endif
 
 typedef struct {
-  unsigned short byteOffset;
-  unsigned short length;
+  JsVarArrayBufferLength byteOffset;
+  JsVarArrayBufferLength length;
   JsVarDataArrayBufferViewType type;
 } PACKED_FLAGS JsVarDataArrayBufferView;
 
@@ -297,8 +308,8 @@ unsigned int jsvGetMemoryTotal(); ///< Get total amount of memory records
 bool jsvIsMemoryFull(); ///< Get whether memory is full or not
 bool jsvMoreFreeVariablesThan(unsigned int vars); ///< Return whether there are more free variables than the parameter (faster than checking no of vars used)
 void jsvShowAllocated(); ///< Show what is still allocated, for debugging memory problems
-/// Try and allocate more memory - only works if RESIZABLE_JSVARS is defined
-void jsvSetMemoryTotal(unsigned int jsNewVarCount);
+/// Try and allocate more memory - only works if RESIZABLE_JSVARS is defined. Returns false if it couldn't
+bool jsvSetMemoryTotal(unsigned int jsNewVarCount);
 
 
 // Note that jsvNew* don't REF a variable for you, but the do LOCK it
@@ -543,6 +554,7 @@ void jsvAppendStringVar(JsVar *var, const JsVar *str, size_t stridx, size_t maxL
 void jsvAppendStringVarComplete(JsVar *var, const JsVar *str); ///< Append all of str to var. Both must be strings.
 char jsvGetCharInString(JsVar *v, size_t idx);
 int jsvGetStringIndexOf(JsVar *str, char ch); ///< Get the index of a character in a string, or -1
+int jsvGetStringIndexOfString(JsVar *str, JsVar *search, size_t startIdx, bool backwards); ///< Get the index of search in str (at or after startIdx, or at or before it if backwards), or -1
 
 JsVarInt jsvGetInteger(const JsVar *v);
 void jsvSetInteger(JsVar *v, JsVarInt value); ///< Set an integer value (use carefully!)
@@ -676,6 +688,9 @@ JsVarInt jsvArrayPush(JsVar *arr, JsVar *value); ///< Adds a new element to the
 JsVarInt jsvArrayPushAndUnLock(JsVar *arr, JsVar *value); ///< Adds a new element to the end of an array, unlocks it, and returns the new length
 JsVar *jsvArrayPop(JsVar *arr); ///< Removes the last element of an array, and returns that element (or 0 if empty). includes the NAME
 JsVar *jsvArrayPopFirst(JsVar *arr); ///< Removes the first element of an array, and returns that element (or 0 if empty) includes the NAME. DOES NOT RENUMBER.
+JsVar *jsvArrayShift(JsVar *arr); ///< Removes the first element of an array and moves the others down one, returning that element (or 0 if empty). Includes the NAME
+bool jsvArrayUnshift(JsVar *arr, JsVar *elements); ///< Adds all elements of 'elements' to the start of an array, moving existing elements up. Returns false if this couldn't be done
+void jsvArrayNormaliseIndices(JsVar *arr); ///< Make sure an array that's been used as a queue stores its real indices as keys. Call before reading keys directly
 void jsvArrayAddUnique(JsVar *arr, JsVar *v); ///< Adds a new variable element to the end of an array (IF it was not already there). Return true if successful
 JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler); ///< Join all elements of an array together into a string
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element); ///< Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
@@ -684,6 +699,14 @@ static ALWAYS_INLINE bool jsvArrayIsEmpty(JsVar *arr) { assert(jsvIsArray(arr));
 /** Write debug info for this Var out to the console */
 void jsvTrace(JsVar *var, int indent);
 
+/// Mark a variable as used during a garbage collection - for references held by native code
+void jsvGarbageCollectMarkRef(JsVarRef ref);
+
+/// Called by jsvGarbageCollect to mark (with jsvGarbageCollectMarkRef) anything only referenced from native code
+typedef void (*JsvGarbageCollectMarkCallback)();
+/// Set the function jsvGarbageCollect uses to find references held by native code (or 0 for none)
+void jsvSetGarbageCollectMarkCallback(JsvGarbageCollectMarkCallback callback);
+
 /** Run a garbage collection sweep - return true if things have been freed */
 bool jsvGarbageCollect();
 
@@ -190,6 +190,20 @@ void jsvStringIteratorNext(JsvStringIterator *it) {
   jsvStringIteratorNextInline(it);
 }
 
+void jsvStringIteratorSkip(JsvStringIterator *it, size_t count) {
+  while (count && it->ptr) {
+    size_t n = it->charsInVar - it->charIdx;
+    if (count < n) {
+      it->charIdx += count;
+      return;
+    }
+    // move to the start of the next block
+    count -= n;
+    it->charIdx = it->charsInVar-1;
+    jsvStringIteratorNext(it);
+  }
+}
+
 void jsvStringIteratorGotoEnd(JsvStringIterator *it) {
   assert(it->var);
   while (jsvGetLastChild(it->var)) {
@@ -238,10 +252,92 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
   jsvSetCharactersInVar(it->var, it->charsInVar);
 }
 
+void jsvStringIteratorAppendBuf(JsvStringIterator *it, const char *buf, size_t len) {
+  while (len) {
+    // Append one char the normal way - this allocates a new block if needed
+    jsvStringIteratorAppend(it, *(buf++));
+    len--;
+    if (!it->var) return; // out of memory
+    // then copy as much as will fit into the rest of the block in one go
+    size_t maxChars = jsvGetMaxCharactersInVar(it->var);
+    if (len && it->charsInVar < maxChars) {
+      size_t n = maxChars - it->charsInVar;
+      if (n > len) n = len;
+      memcpy(&it->ptr[it->charsInVar], buf, n);
+      buf += n;
+      len -= n;
+      it->charsInVar += n;
+      it->charIdx = it->charsInVar-1;
+      jsvSetCharactersInVar(it->var, it->charsInVar);
+    }
+  }
+}
+
+/** Does the string at the iterator's position start with needle (the first
+ * needleLen chars of search) and then the rest of search? The iterator isn't moved. */
+static bool jsvStringIteratorStartsWith(JsvStringIterator *it, const char *needle, size_t needleLen, JsVar *search, size_t searchLen) {
+  // fast path - it's all in this block
+  if (needleLen==searchLen && it->charIdx+needleLen <= it->charsInVar
+#ifdef ESP8266
+      && !jsvIsNativeString(it->var) // may be in flash
+#endif
+      )
+    return memcmp(&it->ptr[it->charIdx], needle, needleLen)==0;
+  // otherwise compare a block at a time
+  JsvStringIterator i = jsvStringIteratorClone(it);
+  bool match = true;
+  while (match && needleLen) {
+    size_t n;
+    const char *span = jsvStringIteratorGetSpan(&i, &n);
+    if (!n) { match = false; break; } // end of string
+    if (n > needleLen) n = needleLen;
+    match = memcmp(span, needle, n)==0;
+    needle += n;
+    needleLen -= n;
+    jsvStringIteratorSkip(&i, n);
+  }
+  if (match && searchLen > JSV_STRING_SEARCH_BUFFER) {
+    // search was too big for the buffer - compare the rest a character at a time
+    JsvStringIterator s;
+    jsvStringIteratorNew(&s, search, JSV_STRING_SEARCH_BUFFER);
+    while (match && jsvStringIteratorHasChar(&s)) {
+      match = jsvStringIteratorHasChar(&i) && jsvStringIteratorGetChar(&i)==jsvStringIteratorGetChar(&s);
+      jsvStringIteratorNext(&i);
+      jsvStringIteratorNext(&s);
+    }
+    jsvStringIteratorFree(&s);
+  }
+  jsvStringIteratorFree(&i);
+  return match;
+}
+
+int jsvStringIteratorFindString(JsvStringIterator *it, JsVar *search) {
+  size_t searchLen = jsvGetStringLength(search);
+  if (!searchLen) return it->ptr ? (int)(it->varIndex + it->charIdx) : -1;
+  char needle[JSV_STRING_SEARCH_BUFFER];
+  size_t needleLen = jsvGetStringChars(search, 0, needle, sizeof(needle));
+  while (jsvStringIteratorHasChar(it)) {
+    size_t n;
+    const char *span = jsvStringIteratorGetSpan(it, &n);
+    // use memchr to skip straight to anything that matches the first character
+    const char *p = (const char*)memchr(span, needle[0], n);
+    if (!p) { // move on to the next block
+      jsvStringIteratorSkip(it, n);
+      continue;
+    }
+    it->charIdx += (size_t)(p-span);
+    if (jsvStringIteratorStartsWith(it, needle, needleLen, search, searchLen))
+      return (int)(it->varIndex + it->charIdx);
+    jsvStringIteratorNext(it);
+  }
+  return -1;
+}
+
 // --------------------------------------------------------------------------------------------
 
 void jsvObjectIteratorNew(JsvObjectIterator *it, JsVar *obj) {
   assert(jsvIsArray(obj) || jsvIsObject(obj) || jsvIsFunction(obj));
+  jsvArrayNormaliseIndices(obj); // so keys are the real array indices
   it->var = jsvGetFirstChild(obj) ? jsvLock(jsvGetFirstChild(obj)) : 0;
 }
 
@@ -294,6 +390,35 @@ void   jsvArrayBufferIteratorNew(JsvArrayBufferIterator *it, JsVar *arrayBuffer,
   jsvStringIteratorNew(&it->it, arrayBufferData, (size_t)it->byteOffset);
   jsvUnLock(arrayBufferData);
   it->hasAccessedElement = false;
+  it->littleEndian = true;
+}
+
+void   jsvArrayBufferIteratorNewBytes(JsvArrayBufferIterator *it, JsVar *arrayBuffer, size_t byteOffset) {
+  assert(jsvIsArrayBuffer(arrayBuffer));
+  JsVarDataArrayBufferViewType type = arrayBuffer->varData.arraybuffer.type;
+  it->index = byteOffset;
+  it->type = ARRAYBUFFERVIEW_UINT8;
+  it->byteLength = arrayBuffer->varData.arraybuffer.byteOffset + arrayBuffer->varData.arraybuffer.length * JSV_ARRAYBUFFER_GET_SIZE(type);
+  it->byteOffset = arrayBuffer->varData.arraybuffer.byteOffset + byteOffset;
+  if (it->byteOffset >= it->byteLength) {
+    it->type = ARRAYBUFFERVIEW_UNDEFINED;
+    return;
+  }
+  JsVar *arrayBufferData = jsvGetArrayBufferBackingString(arrayBuffer);
+  jsvStringIteratorNew(&it->it, arrayBufferData, (size_t)it->byteOffset);
+  jsvUnLock(arrayBufferData);
+  it->hasAccessedElement = false;
+  it->littleEndian = true;
+}
+
+/// Swap the byte order of a value (for big endian data)
+static void jsvArrayBufferIteratorReverseData(char *data, unsigned int dataLen) {
+  unsigned int i;
+  for (i=0;i<dataLen/2;i++) {
+    char t = data[i];
+    data[i] = data[dataLen-1-i];
+    data[dataLen-1-i] = t;
+  }
 }
 
 /// Clone the iterator
@@ -311,6 +436,7 @@ static void jsvArrayBufferIteratorGetValueData(JsvArrayBufferIterator *it, char
     data[i] = jsvStringIteratorGetChar(&it->it);
     if (dataLen!=1) jsvStringIteratorNext(&it->it);
   }
+  if (!it->littleEndian) jsvArrayBufferIteratorReverseData(data, dataLen);
   if (dataLen!=1) it->hasAccessedElement = true;
 }
 
@@ -376,7 +502,10 @@ JsVarFloat jsvArrayBufferIteratorGetFloatValue(JsvArrayBufferIterator *it) {
   if (JSV_ARRAYBUFFER_IS_FLOAT(it->type)) {
     return jsvArrayBufferIteratorDataToFloat(it, data);
   } else {
-    return (JsVarFloat)jsvArrayBufferIteratorDataToInt(it, data);
+    JsVarInt i = jsvArrayBufferIteratorDataToInt(it, data);
+    if (it->type == ARRAYBUFFERVIEW_UINT32)
+      return (JsVarFloat)(uint32_t)i;
+    return (JsVarFloat)i;
   }
 }
 
@@ -412,6 +541,28 @@ void jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt
   } else {
     jsvArrayBufferIteratorIntToData(data, dataLen, it->type, v);
   }
+  if (!it->littleEndian) jsvArrayBufferIteratorReverseData(data, dataLen);
+
+  for (i=0;i<dataLen;i++) {
+    jsvStringIteratorSetChar(&it->it, data[i]);
+    if (dataLen!=1) jsvStringIteratorNext(&it->it);
+  }
+  if (dataLen!=1) it->hasAccessedElement = true;
+}
+
+void jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat v) {
+  if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return;
+  assert(!it->hasAccessedElement); // we just haven't implemented this case yet
+  char data[8];
+  unsigned int i,dataLen = JSV_ARRAYBUFFER_GET_SIZE(it->type);
+
+  if (JSV_ARRAYBUFFER_IS_FLOAT(it->type)) {
+    jsvArrayBufferIteratorFloatToData(data, dataLen, it->type, v);
+  } else {
+    if (!isfinite(v)) v = 0;
+    jsvArrayBufferIteratorIntToData(data, dataLen, it->type, (JsVarInt)(long long)v);
+  }
+  if (!it->littleEndian) jsvArrayBufferIteratorReverseData(data, dataLen);
 
   for (i=0;i<dataLen;i++) {
     jsvStringIteratorSetChar(&it->it, data[i]);
@@ -431,6 +582,7 @@ void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value)
   } else {
     jsvArrayBufferIteratorIntToData(data, dataLen, it->type, jsvGetInteger(value));
   }
+  if (!it->littleEndian) jsvArrayBufferIteratorReverseData(data, dataLen);
 
   for (i=0;i<dataLen;i++) {
     jsvStringIteratorSetChar(&it->it, data[i]);
@@ -463,7 +615,7 @@ JsVar* jsvArrayBufferIteratorGetIndex(JsvArrayBufferIterator *it) {
 bool   jsvArrayBufferIteratorHasElement(JsvArrayBufferIterator *it) {
   if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return false;
   if (it->hasAccessedElement) return true;
-  return it->byteOffset <= (it->byteLength-JSV_ARRAYBUFFER_GET_SIZE(it->type));
+  return it->byteOffset+JSV_ARRAYBUFFER_GET_SIZE(it->type) <= it->byteLength;
 }
 
 void   jsvArrayBufferIteratorNext(JsvArrayBufferIterator *it) {
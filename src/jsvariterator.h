@@ -37,6 +37,9 @@ typedef struct JsvStringIterator {
   size_t varIndex; ///< index in string of the start of this var
   JsVar *var; ///< current StringExt we're looking at
   char  *ptr; ///< a pointer to string data
+#ifdef ESP8266
+  char flashBuf[16]; ///< Native strings may be in flash, so jsvStringIteratorGetSpan copies them here
+#endif
 } JsvStringIterator;
 
 // slight hack to enure we can use string iterator with const JsVars
@@ -98,6 +101,29 @@ static ALWAYS_INLINE void jsvStringIteratorNextInline(JsvStringIterator *it) {
   }
 }
 
+/** Get a pointer to the characters at the iterator's position, and in len the
+ * number of them that are stored contiguously (in this block). len is 0 at the
+ * end of the string. Use jsvStringIteratorSkip to move past them.
+ * On ESP8266 a native string may point to flash, which can't be read a byte at
+ * a time - so a few characters at a time are copied into the iterator instead */
+static ALWAYS_INLINE const char *jsvStringIteratorGetSpan(JsvStringIterator *it, size_t *len) {
+  *len = it->charIdx < it->charsInVar ? it->charsInVar - it->charIdx : 0;
+  if (!it->ptr) return 0;
+#ifdef ESP8266
+  if (jsvIsNativeString(it->var)) {
+    size_t i;
+    if (*len > sizeof(it->flashBuf)) *len = sizeof(it->flashBuf);
+    for (i=0;i<*len;i++)
+      it->flashBuf[i] = (char)READ_FLASH_UINT8(&it->ptr[it->charIdx+i]);
+    return it->flashBuf;
+  }
+#endif
+  return &it->ptr[it->charIdx];
+}
+
+/// Move forwards 'count' characters (a whole block at a time)
+void jsvStringIteratorSkip(JsvStringIterator *it, size_t count);
+
 
 /// Go to the end of the string iterator - for use with jsvStringIteratorAppend
 void jsvStringIteratorGotoEnd(JsvStringIterator *it);
@@ -105,6 +131,9 @@ void jsvStringIteratorGotoEnd(JsvStringIterator *it);
 /// Append a character TO THE END of a string iterator
 void jsvStringIteratorAppend(JsvStringIterator *it, char ch);
 
+/// Append 'len' characters TO THE END of a string iterator, filling each block with memcpy
+void jsvStringIteratorAppendBuf(JsvStringIterator *it, const char *buf, size_t len);
+
 static ALWAYS_INLINE void jsvStringIteratorFree(JsvStringIterator *it) {
   jsvUnLock(it->var);
 }
@@ -112,6 +141,12 @@ static ALWAYS_INLINE void jsvStringIteratorFree(JsvStringIterator *it) {
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
 void jsvStringIteratorPrintfCallback(const char *str, void *user_data);
 
+#define JSV_STRING_SEARCH_BUFFER 64 ///< How much of a string being searched for is copied onto the stack
+
+/** Move the iterator forwards to the next place that 'search' starts (using
+ * memchr on each block of the string). Returns its index, or -1 if it wasn't found */
+int jsvStringIteratorFindString(JsvStringIterator *it, JsVar *search);
+
 // --------------------------------------------------------------------------------------------
 typedef struct JsvObjectIterator {
   JsVar *var;
@@ -159,6 +194,7 @@ typedef struct JsvArrayBufferIterator {
   size_t byteOffset;
   size_t index;
   bool hasAccessedElement;
+  bool littleEndian; ///< byte order of values (true unless changed after jsvArrayBufferIteratorNew)
 } JsvArrayBufferIterator;
 
 /* TODO: can we add it->getIntegerValue/etc that get set by jsvArrayBufferIteratorNew?
@@ -167,6 +203,11 @@ typedef struct JsvArrayBufferIterator {
 
 void   jsvArrayBufferIteratorNew(JsvArrayBufferIterator *it, JsVar *arrayBuffer, size_t index);
 
+/** Iterate over the bytes of an ArrayBuffer or typed array, starting byteOffset
+ * bytes in. it->type can then be changed before each value is read or written,
+ * to read a mix of types from the same data (as DataView does) */
+void   jsvArrayBufferIteratorNewBytes(JsvArrayBufferIterator *it, JsVar *arrayBuffer, size_t byteOffset);
+
 /// Clone the iterator
 JsvArrayBufferIterator jsvArrayBufferIteratorClone(JsvArrayBufferIterator *it);
 
@@ -180,6 +221,7 @@ JsVarFloat jsvArrayBufferIteratorGetFloatValue(JsvArrayBufferIterator *it);
 void   jsvArrayBufferIteratorSetValue(JsvArrayBufferIterator *it, JsVar *value);
 void   jsvArrayBufferIteratorSetValueAndRewind(JsvArrayBufferIterator *it, JsVar *value);
 void   jsvArrayBufferIteratorSetIntegerValue(JsvArrayBufferIterator *it, JsVarInt value);
+void   jsvArrayBufferIteratorSetFloatValue(JsvArrayBufferIterator *it, JsVarFloat value);
 void   jsvArrayBufferIteratorSetByteValue(JsvArrayBufferIterator *it, char c); ///< special case for when we know we're writing to a byte array
 JsVar* jsvArrayBufferIteratorGetIndex(JsvArrayBufferIterator *it);
 bool   jsvArrayBufferIteratorHasElement(JsvArrayBufferIterator *it);
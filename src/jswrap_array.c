@@ -179,6 +179,67 @@ Remove and return the value on the end of this array.
 This is the opposite of `[1,2,3].shift()`, which removes an element from the beginning of the array.
  */
 
+/** How many of the (up to maxArgs) arguments that we'd normally give a callback
+ * are actually worth creating. A JS function gets an (unnamed) parameter for
+ * every extra argument that is passed, so if it didn't name them and doesn't
+ * use `arguments` we can just skip them. */
+static int _jswrap_array_get_callback_arg_count(JsVar *funcVar, int maxArgs) {
+  if (jsvIsNative(funcVar)) return maxArgs;
+  int paramCount = 0;
+  bool usesArguments = true;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, funcVar);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *param = jsvObjectIteratorGetKey(&it);
+    if (jsvIsFunctionParameter(param)) {
+      JsVar *value = jsvSkipName(param);
+      if (!value) paramCount++; // bound parameters don't take arguments
+      jsvUnLock(value);
+    } else if (jsvIsStringEqual(param, JSPARSE_FUNCTION_CODE_NAME)) {
+      JsVar *code = jsvSkipName(param);
+      JsVar *search = jsvNewFromString("arguments");
+      if (code && search)
+        usesArguments = jsvGetStringIndexOfString(code, search, 0, false)>=0;
+      jsvUnLock2(search, code);
+    }
+    jsvUnLock(param);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  if (usesArguments || paramCount>maxArgs) return maxArgs;
+  return paramCount;
+}
+
+/** Return a variable containing idx, reusing indexVar if the last
+ * callback didn't keep hold of it */
+static JsVar *_jswrap_array_get_index_var(JsVar *indexVar, JsVarInt idx) {
+  if (indexVar && jsvGetRefs(indexVar)==0 && jsvGetLocks(indexVar)==1) {
+    jsvSetInteger(indexVar, idx);
+    return indexVar;
+  }
+  jsvUnLock(indexVar);
+  return jsvNewFromInteger(idx);
+}
+
+/** Get the index of the iterator's current element, or return false if it
+ * isn't an array element (eg. a non-numeric key). Typed arrays and strings are
+ * dense, so we can skip creating a variable for the key */
+static bool _jswrap_array_iterator_get_index(JsvIterator *it, JsVarInt *idx) {
+  if (it->type == JSVI_ARRAYBUFFER) {
+    *idx = (JsVarInt)it->it.buf.index;
+    return true;
+  }
+  if (it->type == JSVI_STRING) {
+    *idx = (JsVarInt)jsvStringIteratorGetIndex(&it->it.str);
+    return true;
+  }
+  JsVar *key = jsvIteratorGetKey(it);
+  bool isIndex = jsvIsInt(key);
+  if (isIndex) *idx = jsvGetInteger(key);
+  jsvUnLock(key);
+  return isIndex;
+}
+
 JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVar *funcVar, JsVar *thisVar, bool wantArray, bool isBoolCallback, bool expectedValue) {
   if (!jsvIsIterable(parent)) {
     jsExceptionHere(JSET_ERROR, "Array.%s can only be called on something iterable", name);
@@ -197,19 +258,19 @@ JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVa
     result = jsvNewEmptyArray();
   bool isDone = false;
   if (result || !wantArray) {
+    int argCount = _jswrap_array_get_callback_arg_count(funcVar, 3);
+    JsVar *args[3] = { 0, 0, parent };
     JsvIterator it;
     jsvIteratorNew(&it, parent);
     while (jsvIteratorHasElement(&it) && !isDone) {
-      JsVar *index = jsvIteratorGetKey(&it);
-      if (jsvIsInt(index)) {
-        JsVarInt idxValue = jsvGetInteger(index);
-
-        JsVar *args[3], *cb_result;
-        args[0] = jsvIteratorGetValue(&it);
-        args[1] = jsvNewFromInteger(idxValue); // child is a variable name, create a new variable for the index
-        args[2] = parent;
-        cb_result = jspeFunctionCall(funcVar, 0, thisVar, false, 3, args);
-        jsvUnLockMany(2,args);
+      JsVarInt idxValue;
+      if (_jswrap_array_iterator_get_index(&it, &idxValue)) {
+        JsVar *cb_result;
+        args[0] = argCount>0 ? jsvIteratorGetValue(&it) : 0;
+        if (argCount>1) // child is a variable name, so we need a separate variable for the index
+          args[1] = _jswrap_array_get_index_var(args[1], idxValue);
+        cb_result = jspeFunctionCall(funcVar, 0, thisVar, false, argCount, args);
+        jsvUnLock(args[0]);
         if (cb_result) {
           bool matched;
           if (isBoolCallback)
@@ -235,10 +296,10 @@ JsVar *_jswrap_array_iterate_with_callback(const char *name, JsVar *parent, JsVa
           jsvUnLock(cb_result);
         }
       }
-      jsvUnLock(index);
       jsvIteratorNext(&it);
     }
     jsvIteratorFree(&it);
+    jsvUnLock(args[1]);
   }
   /* boolean result depends on whether the loop terminated
      early for 'some' or completed for 'every' */
@@ -362,35 +423,33 @@ JsVar *jswrap_array_reduce(JsVar *parent, JsVar *funcVar, JsVar *initialValue) {
   if (!previousValue) {
     bool isDone = false;
     while (!isDone && jsvIteratorHasElement(&it)) {
-      JsVar *index = jsvIteratorGetKey(&it);
-      if (jsvIsInt(index)) {
+      JsVarInt idxValue;
+      if (_jswrap_array_iterator_get_index(&it, &idxValue)) {
         previousValue = jsvIteratorGetValue(&it);
         isDone = true;
       }
-      jsvUnLock(index);
       jsvIteratorNext(&it);
     }
     if (!previousValue) {
       jsExceptionHere(JSET_ERROR, "Array.%s without initial value required non-empty array", name);
     }
   }
+  int argCount = _jswrap_array_get_callback_arg_count(funcVar, 4);
+  JsVar *args[4] = { 0, 0, 0, parent };
   while (jsvIteratorHasElement(&it)) {
-    JsVar *index = jsvIteratorGetKey(&it);
-    if (jsvIsInt(index)) {
-      JsVarInt idxValue = jsvGetInteger(index);
-
-      JsVar *args[4];
+    JsVarInt idxValue;
+    if (_jswrap_array_iterator_get_index(&it, &idxValue)) {
       args[0] = previousValue;
-      args[1] = jsvIteratorGetValue(&it);
-      args[2] = jsvNewFromInteger(idxValue); // child is a variable name, create a new variable for the index
-      args[3] = parent;
-      previousValue = jspeFunctionCall(funcVar, 0, 0, false, 4, args);
-      jsvUnLockMany(3,args);
+      args[1] = argCount>1 ? jsvIteratorGetValue(&it) : 0;
+      if (argCount>2) // child is a variable name, so we need a separate variable for the index
+        args[2] = _jswrap_array_get_index_var(args[2], idxValue);
+      previousValue = jspeFunctionCall(funcVar, 0, 0, false, argCount, args);
+      jsvUnLock2(args[0], args[1]);
     }
-    jsvUnLock(index);
     jsvIteratorNext(&it);
   }
   jsvIteratorFree(&it);
+  jsvUnLock(args[2]);
 
   return previousValue;
 }
@@ -497,9 +556,14 @@ JsVar *jswrap_array_splice(JsVar *parent, JsVarInt index, JsVar *howManyVar, JsV
 Remove and return the first element of the array.
 
 This is the opposite of `[1,2,3].pop()`, which takes an element off the end.
+
+The remaining elements aren't renumbered each time, so `push` and `shift`
+can be used to implement a queue without slowing down as the queue grows.
  */
 JsVar *jswrap_array_shift(JsVar *parent) {
-  // just use splice, as this does all the hard work for us
+  if (jsvIsArray(parent))
+    return jsvSkipNameAndUnLock(jsvArrayShift(parent));
+  // otherwise just use splice, as this does all the hard work for us
   JsVar *nRemove = jsvNewFromInteger(1);
   JsVar *elements = jsvNewEmptyArray();
   JsVar *arr = jswrap_array_splice(parent, 0, nRemove, elements);
@@ -528,7 +592,9 @@ Add one or more items to the start of the array, and return its new length.
 This is the opposite of `[1,2,3].push(4)`, which puts one or more elements on the end.
  */
 JsVarInt jswrap_array_unshift(JsVar *parent, JsVar *elements) {
-  // just use splice, as this does all the hard work for us
+  if (jsvIsArray(parent) && jsvArrayUnshift(parent, elements))
+    return jsvGetArrayLength(parent);
+  // otherwise just use splice, as this does all the hard work for us
   JsVar *nRemove = jsvNewFromInteger(0);
   jsvUnLock2(jswrap_array_splice(parent, 0, nRemove, elements), nRemove);
   // return new length
@@ -692,6 +758,235 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
     _jswrap_array_sort(head, nlo, compareFn);
 }
 
+#ifndef SAVE_ON_FLASH
+/* Native sorting. Typed arrays with no compare function are sorted
+ * numerically, in place on their data. Plain arrays with no compare function
+ * have each element converted to a string once, then the array's names are
+ * sorted in a C array and relinked in the new order. Anything else (or not
+ * enough stack) uses _jswrap_array_sort above. */
+
+typedef int (*JswSortCompare)(const char *a, const char *b);
+
+static int _jswrap_sort_compare_uint8(const char *a, const char *b) { return (int)*(const uint8_t*)a - (int)*(const uint8_t*)b; }
+static int _jswrap_sort_compare_int8(const char *a, const char *b) { return (int)*(const int8_t*)a - (int)*(const int8_t*)b; }
+static int _jswrap_sort_compare_uint16(const char *a, const char *b) { return (int)*(const uint16_t*)a - (int)*(const uint16_t*)b; }
+static int _jswrap_sort_compare_int16(const char *a, const char *b) { return (int)*(const int16_t*)a - (int)*(const int16_t*)b; }
+static int _jswrap_sort_compare_uint32(const char *a, const char *b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x>y) - (x<y);
+}
+static int _jswrap_sort_compare_int32(const char *a, const char *b) {
+  int32_t x = *(const int32_t*)a, y = *(const int32_t*)b;
+  return (x>y) - (x<y);
+}
+/// Numeric order, but with -0 before +0 and NaN at the end (as TypedArray.sort requires)
+static int _jswrap_sort_compare_double(double x, double y) {
+  if (x<y) return -1;
+  if (x>y) return 1;
+  if (x==y) return (x==0) ? (signbit(y)!=0) - (signbit(x)!=0) : 0;
+  return isnan(x) - isnan(y);
+}
+static int _jswrap_sort_compare_float32(const char *a, const char *b) { return _jswrap_sort_compare_double(*(const float*)a, *(const float*)b); }
+static int _jswrap_sort_compare_float64(const char *a, const char *b) { return _jswrap_sort_compare_double(*(const double*)a, *(const double*)b); }
+
+static JswSortCompare _jswrap_sort_get_compare(JsVarDataArrayBufferViewType type) {
+  if (JSV_ARRAYBUFFER_IS_CLAMPED(type)) type &= ~ARRAYBUFFERVIEW_CLAMPED; // sorts the same as Uint8Array
+  switch (type) {
+  case ARRAYBUFFERVIEW_UINT8: return _jswrap_sort_compare_uint8;
+  case ARRAYBUFFERVIEW_INT8: return _jswrap_sort_compare_int8;
+  case ARRAYBUFFERVIEW_UINT16: return _jswrap_sort_compare_uint16;
+  case ARRAYBUFFERVIEW_INT16: return _jswrap_sort_compare_int16;
+  case ARRAYBUFFERVIEW_UINT32: return _jswrap_sort_compare_uint32;
+  case ARRAYBUFFERVIEW_INT32: return _jswrap_sort_compare_int32;
+  case ARRAYBUFFERVIEW_FLOAT32: return _jswrap_sort_compare_float32;
+  case ARRAYBUFFERVIEW_FLOAT64: return _jswrap_sort_compare_float64;
+  default: return 0;
+  }
+}
+
+static ALWAYS_INLINE void _jswrap_sort_swap(char *a, char *b, size_t size) {
+  while (size--) {
+    char t = *a;
+    *(a++) = *b;
+    *(b++) = t;
+  }
+}
+
+static void _jswrap_sort_heap(char *base, size_t n, size_t size, JswSortCompare cmp) {
+  size_t start = n/2, end = n;
+  while (end > 1) {
+    if (start > 0) start--; // still building the heap
+    else _jswrap_sort_swap(base, base + (--end)*size, size); // move the biggest to the end
+    size_t root = start;
+    while (root*2+1 < end) { // sift down
+      size_t child = root*2+1;
+      if (child+1 < end && cmp(base+child*size, base+(child+1)*size) < 0) child++;
+      if (cmp(base+root*size, base+child*size) >= 0) break;
+      _jswrap_sort_swap(base+root*size, base+child*size, size);
+      root = child;
+    }
+  }
+}
+
+/// Introsort - quicksort with median of 3, falling back to heapsort if it recurses too deeply
+static void _jswrap_sort_intro(char *base, size_t n, size_t size, JswSortCompare cmp, int depth) {
+  while (n > 12) {
+    if (depth-- <= 0) {
+      _jswrap_sort_heap(base, n, size, cmp);
+      return;
+    }
+    char *mid = base + (n/2)*size;
+    char *last = base + (n-1)*size;
+    if (cmp(mid, base) < 0) _jswrap_sort_swap(mid, base, size);
+    if (cmp(last, mid) < 0) {
+      _jswrap_sort_swap(last, mid, size);
+      if (cmp(mid, base) < 0) _jswrap_sort_swap(mid, base, size);
+    }
+    // pivot goes at the start, 'last' is now >= pivot so stops the scan
+    _jswrap_sort_swap(base, mid, size);
+    char *i = base, *j = base + n*size;
+    while (true) {
+      do i += size; while (cmp(i, base) < 0);
+      do j -= size; while (cmp(j, base) > 0);
+      if (i >= j) break;
+      _jswrap_sort_swap(i, j, size);
+    }
+    _jswrap_sort_swap(base, j, size);
+    // recurse into the smaller half, loop on the bigger one
+    size_t nlo = (size_t)(j-base)/size;
+    size_t nhi = n - nlo - 1;
+    if (nlo < nhi) {
+      _jswrap_sort_intro(base, nlo, size, cmp, depth);
+      base = j + size;
+      n = nhi;
+    } else {
+      _jswrap_sort_intro(j + size, nhi, size, cmp, depth);
+      n = nlo;
+    }
+  }
+  // insertion sort for what's left
+  size_t a, b;
+  for (a=1;a<n;a++)
+    for (b=a; b>0 && cmp(base+b*size, base+(b-1)*size) < 0; b--)
+      _jswrap_sort_swap(base+b*size, base+(b-1)*size, size);
+}
+
+/// Sort a typed array numerically. Returns false if it couldn't be done natively
+static bool _jswrap_array_sort_typed(JsVar *array) {
+  JsVarDataArrayBufferViewType type = array->varData.arraybuffer.type;
+  JswSortCompare cmp = _jswrap_sort_get_compare(type);
+  if (!cmp) return false;
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  size_t n = jsvGetArrayBufferLength(array);
+  size_t len;
+  char *data = jsvGetDataPointer(array, &len);
+  if (data && len<n) n = len;
+  int depth = 0;
+  size_t i;
+  for (i=n;i;i>>=1) depth+=2;
+
+  if (data && !((size_t)data & ((size>4?4:size)-1))) {
+    // contiguous and aligned - sort in place
+    _jswrap_sort_intro(data, n, size, cmp, depth);
+    return true;
+  }
+  // Otherwise copy the data onto the stack, sort it, and copy it back
+  if (jsuGetFreeStack() < 256+n*size) return false;
+  JsVar *backing = jsvGetArrayBufferBackingString(array);
+  size_t byteOffset = array->varData.arraybuffer.byteOffset;
+  double *buf = (double*)alloca(n*size + sizeof(double)); // double for alignment
+  jsvGetStringChars(backing, byteOffset, (char*)buf, n*size);
+  _jswrap_sort_intro((char*)buf, n, size, cmp, depth);
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, backing, byteOffset);
+  for (i=0;i<n*size;i++) {
+    jsvStringIteratorSetChar(&it, ((char*)buf)[i]);
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(backing);
+  return true;
+}
+
+typedef struct {
+  JsVar *name; ///< The array element's name (index)
+  JsVar *str;  ///< The element's value as a string, which is what we compare
+} JswSortItem;
+
+/// Merge sort (so it's stable) items by string value, using tmp as scratch space
+static void _jswrap_sort_items(JswSortItem *items, JswSortItem *tmp, int n) {
+  int width, i;
+  for (width=1; width<n; width*=2) {
+    for (i=0; i<n; i+=2*width) {
+      int lo = i, mid = i+width, hi = i+2*width;
+      if (mid > n) mid = n;
+      if (hi > n) hi = n;
+      int a = lo, b = mid, o = lo;
+      while (a<mid && b<hi)
+        tmp[o++] = (jsvCompareString(items[b].str, items[a].str, 0, 0, false) < 0) ? items[b++] : items[a++];
+      while (a<mid) tmp[o++] = items[a++];
+      while (b<hi) tmp[o++] = items[b++];
+    }
+    memcpy(items, tmp, sizeof(JswSortItem)*(size_t)n);
+  }
+}
+
+/** Sort an array with no compare function by relinking its names. Returns false
+ * if it couldn't be done natively (keys that aren't array indices, or not enough stack) */
+static bool _jswrap_array_sort_default(JsVar *array) {
+  int n = jsvGetChildren(array);
+  if (jsuGetFreeStack() < 256+sizeof(JswSortItem)*2*(size_t)n) return false;
+  JswSortItem *items = (JswSortItem*)alloca(sizeof(JswSortItem)*(size_t)n);
+  JswSortItem *tmp = (JswSortItem*)alloca(sizeof(JswSortItem)*(size_t)n);
+  // gather names - defined values first, then undefined (which always sort to the end)
+  int defined = 0, undefinedCount = 0, i;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, array);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *name = jsvObjectIteratorGetKey(&it);
+    if (!jsvIsInt(name) || jsvGetInteger(name)<0) {
+      jsvUnLock(name);
+      break;
+    }
+    JsVar *value = jsvSkipName(name);
+    if (jsvIsUndefined(value)) {
+      tmp[undefinedCount].name = name;
+      tmp[undefinedCount++].str = 0;
+    } else {
+      items[defined].name = name;
+      items[defined].str = jsvAsString(value, false);
+      if (!items[defined++].str) { // out of memory
+        jsvUnLock(value);
+        break;
+      }
+    }
+    jsvUnLock(value);
+    jsvObjectIteratorNext(&it);
+  }
+  bool ok = !jsvObjectIteratorHasValue(&it);
+  jsvObjectIteratorFree(&it);
+  for (i=0;i<undefinedCount;i++)
+    items[defined+i] = tmp[i];
+  n = defined + undefinedCount;
+
+  if (ok) {
+    _jswrap_sort_items(items, tmp, defined);
+    // relink the names in order, renumbering as we go. Holes end up at the end.
+    for (i=0;i<n;i++) {
+      JsVar *name = items[i].name;
+      jsvSetPrevSibling(name, i ? jsvGetRef(items[i-1].name) : 0);
+      jsvSetNextSibling(name, (i<n-1) ? jsvGetRef(items[i+1].name) : 0);
+      name->varData.integer = i;
+    }
+    jsvSetFirstChild(array, n ? jsvGetRef(items[0].name) : 0);
+    jsvSetLastChild(array, n ? jsvGetRef(items[n-1].name) : 0);
+  }
+  for (i=0;i<n;i++)
+    jsvUnLock2(items[i].name, items[i].str);
+  return ok;
+}
+#endif
+
 /*JSON{
   "type" : "method",
   "class" : "Array",
@@ -710,6 +1005,13 @@ JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
     jsExceptionHere(JSET_ERROR, "Expecting compare function, got %t", compareFn);
     return 0;
   }
+#ifndef SAVE_ON_FLASH
+  if (jsvIsUndefined(compareFn)) {
+    if ((jsvIsArrayBuffer(array) && _jswrap_array_sort_typed(array)) ||
+        (jsvIsArray(array) && _jswrap_array_sort_default(array)))
+      return jsvLockAgain(array);
+  }
+#endif
   JsvIterator it;
 
   /* Arrays can be sparse and the iterators don't handle this
@@ -145,13 +145,16 @@ Instantiate this in order to efficiently store arrays of data (Espruino's normal
   "return" : ["JsVar","An ArrayBuffer object"]
 }
 Create an Array Buffer object
+
+ArrayBuffers can be at most 65535 bytes long, except on Linux where they can
+be much larger (limited only by available memory).
  */
 JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
-  if (byteLength < 0 || byteLength>65535) {
+  if (byteLength < 0) {
     jsExceptionHere(JSET_ERROR, "Invalid length for ArrayBuffer\n");
     return 0;
   }
-  if (byteLength > JSV_ARRAYBUFFER_MAX_LENGTH) {
+  if ((size_t)byteLength > JSV_ARRAYBUFFER_MAX_LENGTH) {
     jsExceptionHere(JSET_ERROR, "ArrayBuffer too long\n");
     return 0;
   }
@@ -161,6 +164,14 @@ JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
    * It's faster to allocate and can use less memory (if it fits into one block) */
   if (byteLength > JSV_FLAT_STRING_BREAK_EVEN)
     arrData = jsvNewFlatStringOfLength((unsigned int)byteLength);
+#ifdef LARGE_ARRAYBUFFERS
+  /* jsvNewFlatStringOfLength allocates more memory for big buffers, so if
+   * that failed there's no point trying to spread one out */
+  if (!arrData && byteLength > 65535) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory for ArrayBuffer");
+    return 0;
+  }
+#endif
   // if we haven't found one, spread it out
   if (!arrData)
     arrData = jsvNewStringOfLength((unsigned int)byteLength);
@@ -171,6 +182,15 @@ JsVar *jswrap_arraybuffer_constructor(JsVarInt byteLength) {
 }
 
 
+/// Create an ArrayBuffer big enough for length elements of the given type
+static JsVar *jswrap_typedarray_newBuffer(JsVarDataArrayBufferViewType type, JsVarInt length) {
+  if (length > 0 && (size_t)length > JSV_ARRAYBUFFER_MAX_LENGTH / JSV_ARRAYBUFFER_GET_SIZE(type)) {
+    jsExceptionHere(JSET_ERROR, "ArrayBuffer too long\n");
+    return 0;
+  }
+  return jswrap_arraybuffer_constructor((JsVarInt)JSV_ARRAYBUFFER_GET_SIZE(type)*length);
+}
+
 /*
  * Potential invocations:
  * Uint8Array Uint8Array(unsigned long length);
@@ -326,23 +346,31 @@ JsVar *jswrap_typedarray_constructor(JsVarDataArrayBufferViewType type, JsVar *a
   } else if (jsvIsNumeric(arr)) {
     length = jsvGetInteger(arr);
     byteOffset = 0;
-    arrayBuffer = jswrap_arraybuffer_constructor((int)JSV_ARRAYBUFFER_GET_SIZE(type)*length);
+    arrayBuffer = jswrap_typedarray_newBuffer(type, length);
   } else if (jsvIsArray(arr) || jsvIsArrayBuffer(arr)) {
     length = (JsVarInt)jsvGetLength(arr);
     byteOffset = 0;
-    arrayBuffer = jswrap_arraybuffer_constructor((int)JSV_ARRAYBUFFER_GET_SIZE(type)*length);
+    arrayBuffer = jswrap_typedarray_newBuffer(type, length);
     copyData = true; // so later on we'll populate this
   }
   if (!arrayBuffer) {
     jsExceptionHere(JSET_ERROR, "Unsupported first argument of type %t\n", arr);
     return 0;
   }
-  if (length==0) length = (JsVarInt)(jsvGetArrayBufferLength(arrayBuffer) / JSV_ARRAYBUFFER_GET_SIZE(type));
+  JsVarInt bufferLength = (JsVarInt)jsvGetArrayBufferLength(arrayBuffer);
+  JsVarInt size = (JsVarInt)JSV_ARRAYBUFFER_GET_SIZE(type);
+  if (byteOffset<0 || byteOffset>bufferLength) byteOffset = -1;
+  else if (length==0) length = (bufferLength-byteOffset) / size;
+  if (byteOffset<0 || length<0 || byteOffset+length*size > bufferLength) {
+    jsExceptionHere(JSET_ERROR, "byteOffset/length outside of the ArrayBuffer");
+    jsvUnLock(arrayBuffer);
+    return 0;
+  }
   JsVar *typedArr = jsvNewWithFlags(JSV_ARRAYBUFFER);
   if (typedArr) {
     typedArr->varData.arraybuffer.type = type;
-    typedArr->varData.arraybuffer.byteOffset = (unsigned short)byteOffset;
-    typedArr->varData.arraybuffer.length = (unsigned short)length;
+    typedArr->varData.arraybuffer.byteOffset = (JsVarArrayBufferLength)byteOffset;
+    typedArr->varData.arraybuffer.length = (JsVarArrayBufferLength)length;
     jsvSetFirstChild(typedArr, jsvGetRef(jsvRef(arrayBuffer)));
 
     if (copyData) {
@@ -390,7 +418,7 @@ The length, in bytes, of the view
   "type" : "property",
   "class" : "ArrayBufferView",
   "name" : "byteOffset",
-  "generate_full" : "parent->varData.arraybuffer.byteOffset",
+  "generate_full" : "(JsVarInt)parent->varData.arraybuffer.byteOffset",
   "return" : ["int","The byte Offset"]
 }
 The offset, in bytes, to the first byte of the view within the ArrayBuffer
@@ -545,7 +573,8 @@ Join all elements of this array together into one string, using 'separator' betw
   "return" : ["JsVar","This array object"],
   "return_object" : "ArrayBufferView"
 }
-Do an in-place quicksort of the array
+Do an in-place quicksort of the array. With no compare function, elements are
+sorted numerically (NaN at the end) directly on the array's data.
  */
 /*JSON{
   "type" : "method",
@@ -0,0 +1,333 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript DataView class
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_dataview.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+/*JSON{
+  "type" : "class",
+  "class" : "DataView",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Read and write values of different types, in either byte order, from an
+`ArrayBuffer`. This is handy for decoding binary protocols:
+
+```
+var d = new DataView(E.toArrayBuffer(packet));
+var temp = d.getInt16(0, true) / 100;
+var pressure = d.getUint32(2, true);
+```
+
+To decode a whole structure in one go, see `E.unpack`.
+ */
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "DataView",
+  "name" : "DataView",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_dataview_constructor",
+  "params" : [
+    ["buffer","JsVar","The `ArrayBuffer` to base this on"],
+    ["byteOffset","int","(optional) The offset of this view in bytes"],
+    ["byteLength","JsVar","(optional) The length in bytes"]
+  ],
+  "return" : ["JsVar","A DataView object"],
+  "return_object" : "DataView"
+}
+Create a `DataView` object that can be used to access the data in an `ArrayBuffer`.
+ */
+JsVar *jswrap_dataview_constructor(JsVar *buffer, int byteOffset, JsVar *byteLength) {
+  if (!jsvIsArrayBuffer(buffer) || buffer->varData.arraybuffer.type!=ARRAYBUFFERVIEW_ARRAYBUFFER) {
+    jsExceptionHere(JSET_TYPEERROR, "DataView expects an ArrayBuffer, got %t", buffer);
+    return 0;
+  }
+  JsVarInt bufferLength = (JsVarInt)jsvGetArrayBufferLength(buffer);
+  JsVarInt length = jsvIsUndefined(byteLength) ? bufferLength-byteOffset : jsvGetInteger(byteLength);
+  if (byteOffset<0 || length<0 || byteOffset+length>bufferLength) {
+    jsExceptionHere(JSET_ERROR, "DataView offset/length out of range");
+    return 0;
+  }
+  JsVar *dataview = jspNewObject(0, "DataView");
+  if (!dataview) return 0;
+  jsvObjectSetChild(dataview, "buffer", buffer);
+  jsvObjectSetChildAndUnLock(dataview, "byteOffset", jsvNewFromInteger(byteOffset));
+  jsvObjectSetChildAndUnLock(dataview, "byteLength", jsvNewFromInteger(length));
+  return dataview;
+}
+
+/** Start an iterator for reading/writing a value of the given type. Returns
+ * false (with an exception) if it's out of range */
+static bool jswrap_dataview_iterator(JsvArrayBufferIterator *it, JsVar *dataview, JsVarDataArrayBufferViewType type, int byteOffset, bool littleEndian) {
+  JsVar *buffer = jsvObjectGetChild(dataview, "buffer", 0);
+  JsVarInt viewOffset = jsvGetIntegerAndUnLock(jsvObjectGetChild(dataview, "byteOffset", 0));
+  JsVarInt viewLength = jsvGetIntegerAndUnLock(jsvObjectGetChild(dataview, "byteLength", 0));
+  if (!jsvIsArrayBuffer(buffer)) {
+    jsvUnLock(buffer);
+    jsExceptionHere(JSET_TYPEERROR, "Not a DataView");
+    return false;
+  }
+  if (byteOffset<0 || byteOffset+(JsVarInt)JSV_ARRAYBUFFER_GET_SIZE(type)>viewLength) {
+    jsvUnLock(buffer);
+    jsExceptionHere(JSET_ERROR, "DataView offset %d out of range", byteOffset);
+    return false;
+  }
+  jsvArrayBufferIteratorNewBytes(it, buffer, (size_t)(viewOffset+byteOffset));
+  jsvUnLock(buffer);
+  if (it->type == ARRAYBUFFERVIEW_UNDEFINED) return false;
+  it->type = type;
+  it->littleEndian = littleEndian;
+  return true;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getFloat32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_FLOAT32, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read a 32 bit floating point number from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getFloat64",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_FLOAT64, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read a 64 bit floating point number from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getInt8",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_INT8, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read a signed 8 bit integer from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getInt16",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_INT16, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read a signed 16 bit integer from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getInt32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_INT32, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read a signed 32 bit integer from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getUint8",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_UINT8, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read an unsigned 8 bit integer from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getUint16",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_UINT16, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read an unsigned 16 bit integer from the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "getUint32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_get(parent, ARRAYBUFFERVIEW_UINT32, byteOffset, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to read from"],
+    ["littleEndian","bool","Whether to read in little endian - if false or undefined data is read as big endian"]
+  ],
+  "return" : ["JsVar","the value read"]
+}
+Read an unsigned 32 bit integer from the given offset
+ */
+JsVar *jswrap_dataview_get(JsVar *dataview, JsVarDataArrayBufferViewType type, int byteOffset, bool littleEndian) {
+  JsvArrayBufferIterator it;
+  if (!jswrap_dataview_iterator(&it, dataview, type, byteOffset, littleEndian)) return 0;
+  JsVar *value = jsvArrayBufferIteratorGetValue(&it);
+  jsvArrayBufferIteratorFree(&it);
+  return value;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setFloat32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_FLOAT32, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write a 32 bit floating point number at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setFloat64",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_FLOAT64, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write a 64 bit floating point number at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setInt8",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_INT8, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write a signed 8 bit integer at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setInt16",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_INT16, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write a signed 16 bit integer at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setInt32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_INT32, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write a signed 32 bit integer at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setUint8",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_UINT8, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write an unsigned 8 bit integer at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setUint16",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_UINT16, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write an unsigned 16 bit integer at the given offset
+ */
+/*JSON{
+  "type" : "method",
+  "class" : "DataView",
+  "name" : "setUint32",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate_full" : "jswrap_dataview_set(parent, ARRAYBUFFERVIEW_UINT32, byteOffset, value, littleEndian)",
+  "params" : [
+    ["byteOffset","int","The offset in bytes to write to"],
+    ["value","JsVar","The value to write"],
+    ["littleEndian","bool","Whether to write in little endian - if false or undefined data is written as big endian"]
+  ]
+}
+Write an unsigned 32 bit integer at the given offset
+ */
+void jswrap_dataview_set(JsVar *dataview, JsVarDataArrayBufferViewType type, int byteOffset, JsVar *value, bool littleEndian) {
+  JsvArrayBufferIterator it;
+  if (!jswrap_dataview_iterator(&it, dataview, type, byteOffset, littleEndian)) return;
+  jsvArrayBufferIteratorSetValue(&it, value);
+  jsvArrayBufferIteratorFree(&it);
+}
@@ -253,6 +253,269 @@ JsVarFloat jswrap_espruino_variance(JsVar *arr, JsVarFloat mean) {
   return variance;
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "stats",
+  "generate" : "jswrap_espruino_stats",
+  "params" : [
+    ["arr","JsVar","The array to work out statistics for"]
+  ],
+  "return" : ["JsVar","An object containing `count`, `mean`, `variance`, `min` and `max`"]
+}
+Work out the number of elements, mean, variance, minimum and maximum of the
+contents of the given Array, String or ArrayBuffer in a single pass.
+
+```
+E.stats([1,2,3,4]) == {count:4, mean:2.5, variance:1.25, min:1, max:4}
+```
+
+**Note:** `variance` here is the mean of the squared differences from the mean
+(the population variance), whereas `E.variance` returns their sum.
+For an empty array, `mean`, `variance`, `min` and `max` are `NaN`.
+ */
+JsVar *jswrap_espruino_stats(JsVar *arr) {
+  if (!(jsvIsIterable(arr))) {
+    jsExceptionHere(JSET_ERROR, "Expecting first argument to be iterable, not %t", arr);
+    return 0;
+  }
+  JsVarInt count = 0;
+  JsVarFloat mean = 0, m2 = 0, min = NAN, max = NAN;
+
+  JsvIterator itsrc;
+  jsvIteratorNew(&itsrc, arr);
+  while (jsvIteratorHasElement(&itsrc)) {
+    JsVarFloat val = jsvIteratorGetFloatValue(&itsrc);
+    // Welford's method - doesn't lose precision when the mean is large
+    count++;
+    JsVarFloat d = val - mean;
+    mean += d / (JsVarFloat)count;
+    m2 += d * (val - mean);
+    if (count==1 || val<min) min = val;
+    if (count==1 || val>max) max = val;
+    jsvIteratorNext(&itsrc);
+  }
+  jsvIteratorFree(&itsrc);
+
+  JsVar *result = jsvNewObject();
+  if (!result) return 0;
+  jsvObjectSetChildAndUnLock(result, "count", jsvNewFromInteger(count));
+  jsvObjectSetChildAndUnLock(result, "mean", jsvNewFromFloat(count ? mean : NAN));
+  jsvObjectSetChildAndUnLock(result, "variance", jsvNewFromFloat(count ? m2/(JsVarFloat)count : NAN));
+  jsvObjectSetChildAndUnLock(result, "min", jsvNewFromFloat(min));
+  jsvObjectSetChildAndUnLock(result, "max", jsvNewFromFloat(max));
+  return result;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "histogram",
+  "generate" : "jswrap_espruino_histogram",
+  "params" : [
+    ["arr","JsVar","The array of values to count"],
+    ["bins","JsVar","An array of N+1 ascending bin edges"],
+    ["outBuf","JsVar","(optional) An array of at least N elements to write the counts into"]
+  ],
+  "return" : ["JsVar","outBuf, or a new Uint32Array containing the count for each bin"]
+}
+Count how many of the values in `arr` fall into each bin. A value `v` is
+counted in bin `i` when `bins[i] <= v < bins[i+1]`, except that the last bin
+also includes its upper edge. Values outside the range of the bins (and `NaN`)
+are not counted.
+
+```
+E.histogram([1,2,2,3,9], [0,2,4,6]) == new Uint32Array([1,3,0])
+```
+
+Evenly spaced bins are looked up directly rather than searched for.
+ */
+JsVar *jswrap_espruino_histogram(JsVar *arr, JsVar *bins, JsVar *outBuf) {
+  if (!jsvIsIterable(arr) || !jsvIsIterable(bins)) {
+    jsExceptionHere(JSET_ERROR, "Expecting first 2 arguments to be iterable, not %t and %t", arr, bins);
+    return 0;
+  }
+  if (!jsvIsUndefined(outBuf) && !jsvIsIterable(outBuf)) {
+    jsExceptionHere(JSET_ERROR, "Expecting outBuf to be iterable or undefined, not %t", outBuf);
+    return 0;
+  }
+  size_t edgeCount = (size_t)jsvGetLength(bins);
+  if (edgeCount<2) {
+    jsExceptionHere(JSET_ERROR, "Expecting at least 2 bin edges");
+    return 0;
+  }
+  size_t binCount = edgeCount-1;
+  if (!jsvIsUndefined(outBuf) && (size_t)jsvGetLength(outBuf)<binCount) {
+    jsExceptionHere(JSET_ERROR, "outBuf needs at least %d elements", (int)binCount);
+    return 0;
+  }
+  // edges and counts in one block
+  JsVar *tmp = jsvNewFlatStringOfLength((unsigned int)(edgeCount*sizeof(JsVarFloat) + binCount*sizeof(uint32_t)));
+  if (!tmp) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory for %d bins", (int)binCount);
+    return 0;
+  }
+  JsVarFloat *edges = (JsVarFloat*)jsvGetFlatStringPointer(tmp);
+  uint32_t *counts = (uint32_t*)&edges[edgeCount];
+  memset(counts, 0, binCount*sizeof(uint32_t));
+
+  JsvIterator it;
+  size_t i = 0;
+  jsvIteratorNew(&it, bins);
+  while (jsvIteratorHasElement(&it) && i<edgeCount) {
+    edges[i++] = jsvIteratorGetFloatValue(&it);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  JsVarFloat first = edges[0], last = edges[binCount];
+  JsVarFloat width = (last - first) / (JsVarFloat)binCount;
+  bool isEven = true;
+  for (i=0;i<binCount;i++) {
+    if (!(edges[i] < edges[i+1])) {
+      jsExceptionHere(JSET_ERROR, "Bin edges must be ascending");
+      jsvUnLock(tmp);
+      return 0;
+    }
+    JsVarFloat d = edges[i] - (first + width*(JsVarFloat)i);
+    if (d<0) d=-d;
+    if (d > width*1E-9) isEven = false;
+  }
+
+  jsvIteratorNew(&it, arr);
+  while (jsvIteratorHasElement(&it)) {
+    JsVarFloat v = jsvIteratorGetFloatValue(&it);
+    jsvIteratorNext(&it);
+    if (!(v>=first && v<=last)) continue; // also skips NaN
+    size_t bin;
+    if (isEven) {
+      bin = (size_t)((v - first) / width);
+      if (bin>=binCount) bin = binCount-1;
+      // rounding may have put us one bin out
+      if (bin>0 && v<edges[bin]) bin--;
+      else if (bin+1<binCount && v>=edges[bin+1]) bin++;
+    } else {
+      // find the last edge <= v
+      size_t lo = 0, hi = binCount;
+      while (hi-lo > 1) {
+        size_t mid = (lo+hi)/2;
+        if (v<edges[mid]) hi = mid;
+        else lo = mid;
+      }
+      bin = lo;
+    }
+    counts[bin]++;
+  }
+  jsvIteratorFree(&it);
+
+  JsVar *result = jsvIsUndefined(outBuf) ?
+      jsvNewTypedArray(ARRAYBUFFERVIEW_UINT32, (JsVarInt)binCount) :
+      jsvLockAgain(outBuf);
+  if (result) {
+    i = 0;
+    jsvIteratorNew(&it, result);
+    while (jsvIteratorHasElement(&it) && i<binCount) {
+      jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromInteger((JsVarInt)counts[i++])));
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+  }
+  jsvUnLock(tmp);
+  return result;
+}
+
+/* Rearrange a so that a[k] is the value that would be there if it were
+ * sorted, with everything before it <= and everything after it >= it.
+ * (Wirth's selection algorithm - O(n) on average) */
+static JsVarFloat jswrap_espruino_select(JsVarFloat *a, size_t n, size_t k) {
+  size_t l = 0, m = n-1;
+  while (l<m) {
+    JsVarFloat x = a[k];
+    size_t i = l, j = m;
+    do {
+      while (a[i]<x) i++;
+      while (x<a[j]) j--;
+      if (i<=j) {
+        JsVarFloat t = a[i]; a[i] = a[j]; a[j] = t;
+        i++;
+        if (j==0) break;
+        j--;
+      }
+    } while (i<=j);
+    if (j<k) l = i;
+    if (k<i) m = j;
+  }
+  return a[k];
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "percentile",
+  "generate" : "jswrap_espruino_percentile",
+  "params" : [
+    ["arr","JsVar","The array to work out the percentile of"],
+    ["p","float","The percentile, between 0 and 100"]
+  ],
+  "return" : ["float","The p-th percentile of the values in the array"]
+}
+Work out the given percentile of the contents of the given Array, String or
+ArrayBuffer, interpolating linearly between the two nearest values. For example
+`E.percentile(arr,50)` is the median, and `E.percentile(arr,100)` the maximum.
+
+The array isn't sorted or modified - the values are copied and the
+percentile found by selection, which takes O(n) time on average. `NaN` values
+are ignored, and `NaN` is returned if the array is empty.
+ */
+JsVarFloat jswrap_espruino_percentile(JsVar *arr, JsVarFloat p) {
+  if (!(jsvIsIterable(arr))) {
+    jsExceptionHere(JSET_ERROR, "Expecting first argument to be iterable, not %t", arr);
+    return NAN;
+  }
+  if (!(p>=0 && p<=100)) {
+    jsExceptionHere(JSET_ERROR, "Percentile should be between 0 and 100");
+    return NAN;
+  }
+  size_t n = (size_t)jsvGetLength(arr);
+  if (!n) return NAN;
+  JsVar *tmp = jsvNewFlatStringOfLength((unsigned int)(n*sizeof(JsVarFloat)));
+  if (!tmp) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory to copy %d values", (int)n);
+    return NAN;
+  }
+  JsVarFloat *values = (JsVarFloat*)jsvGetFlatStringPointer(tmp);
+  size_t count = 0;
+  JsvIterator it;
+  jsvIteratorNew(&it, arr);
+  while (jsvIteratorHasElement(&it) && count<n) {
+    JsVarFloat v = jsvIteratorGetFloatValue(&it);
+    if (!isnan(v)) values[count++] = v;
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+
+  JsVarFloat result = NAN;
+  if (count) {
+    JsVarFloat pos = p * (JsVarFloat)(count-1) / 100;
+    size_t k = (size_t)pos;
+    if (k>=count) k = count-1;
+    JsVarFloat frac = pos - (JsVarFloat)k;
+    result = jswrap_espruino_select(values, count, k);
+    if (frac>0 && k+1<count) {
+      // everything after k is >= it, so the next value is the smallest of those
+      JsVarFloat next = values[k+1];
+      size_t i;
+      for (i=k+2;i<count;i++)
+        if (values[i]<next) next = values[i];
+      result += (next - result) * frac;
+    }
+  }
+  jsvUnLock(tmp);
+  return result;
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -381,6 +644,170 @@ short FFT(short int dir,long m,double *x,double *y)
   return(TRUE);
 }
 
+/* In-place FFT on single precision data. re/im point to the first real and
+ * imaginary values, and 'stride' is the number of floats between
+ * consecutive values (1 for separate arrays, 2 for interleaved). Twiddles are
+ * computed with the same recurrence as FFT() above, in double precision - but
+ * that's only n-1 complex multiplies in total, and all the butterflies are
+ * single precision. Not scaled. */
+static void jswrap_espruino_FFT_f32(float *re, float *im, size_t stride, int order, bool inverse) {
+  size_t n = (size_t)1<<order;
+  size_t i, j, k;
+  // bit reversal
+  j = 0;
+  for (i=0;i+1<n;i++) {
+    if (i < j) {
+      float t = re[i*stride]; re[i*stride] = re[j*stride]; re[j*stride] = t;
+      t = im[i*stride]; im[i*stride] = im[j*stride]; im[j*stride] = t;
+    }
+    k = n >> 1;
+    while (k <= j) {
+      j -= k;
+      k >>= 1;
+    }
+    j += k;
+  }
+  // butterflies
+  double c1 = -1.0, c2 = 0.0;
+  size_t l1, l2 = 1;
+  for (l1=1; l1<n; l1=l2) {
+    l2 = l1 << 1;
+    double u1 = 1.0, u2 = 0.0;
+    for (j=0;j<l1;j++) {
+      float ur = (float)u1, ui = (float)u2;
+      for (i=j;i<n;i+=l2) {
+        float *ar = &re[i*stride], *ai = &im[i*stride];
+        float *br = &re[(i+l1)*stride], *bi = &im[(i+l1)*stride];
+        float tr = ur * *br - ui * *bi;
+        float ti = ur * *bi + ui * *br;
+        *br = *ar - tr;
+        *bi = *ai - ti;
+        *ar += tr;
+        *ai += ti;
+      }
+      double z = u1 * c1 - u2 * c2;
+      u2 = u1 * c2 + u2 * c1;
+      u1 = z;
+    }
+    c2 = jswrap_math_sqrt((1.0 - c1) / 2.0);
+    if (!inverse) c2 = -c2;
+    c1 = jswrap_math_sqrt((1.0 + c1) / 2.0);
+  }
+}
+
+/* FFT of n=2^order real values in place, by doing an n/2 point complex FFT
+ * of the even/odd values and then splitting the result. Leaves X[0] and X[n/2]
+ * (which are real) in x[0] and x[1], and X[k] in x[2k],x[2k+1] for 0<k<n/2. */
+static void jswrap_espruino_FFT_real_f32(float *x, int order, bool inverse) {
+  size_t h = (size_t)1<<(order-1);
+  jswrap_espruino_FFT_f32(x, x+1, 2, order-1, inverse);
+  float z0r = x[0], z0i = x[1];
+  x[0] = z0r + z0i;
+  x[1] = z0r - z0i;
+  double angle = PI / (double)h;
+  double sr = jswrap_math_sin(angle + (PI/2)), si = jswrap_math_sin(angle);
+  if (!inverse) si = -si;
+  double wr = 1, wi = 0;
+  size_t k;
+  for (k=1;k<=h/2;k++) {
+    double t = wr*sr - wi*si;
+    wi = wr*si + wi*sr;
+    wr = t;
+    float *a = &x[2*k], *b = &x[2*(h-k)];
+    // E = (Z[k] + conj(Z[h-k]))/2, O = (Z[k] - conj(Z[h-k]))/2i
+    float er = (a[0] + b[0]) * 0.5f, ei = (a[1] - b[1]) * 0.5f;
+    float odr = (a[1] + b[1]) * 0.5f, odi = (b[0] - a[0]) * 0.5f;
+    float tr = (float)wr*odr - (float)wi*odi;
+    float ti = (float)wr*odi + (float)wi*odr;
+    // X[k] = E + W^k.O, X[h-k] = conj(E - W^k.O)
+    a[0] = er + tr;
+    a[1] = ei + ti;
+    if (a!=b) {
+      b[0] = er - tr;
+      b[1] = ti - ei;
+    }
+  }
+}
+
+/// In-place forward FFT of Q15 data, halving at each stage (so the result is scaled by 1/n)
+static void jswrap_espruino_FFT_q15(int16_t *re, int16_t *im, int order) {
+  size_t n = (size_t)1<<order;
+  size_t i, j, k;
+  j = 0;
+  for (i=0;i+1<n;i++) {
+    if (i < j) {
+      int16_t t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+    k = n >> 1;
+    while (k <= j) {
+      j -= k;
+      k >>= 1;
+    }
+    j += k;
+  }
+  double c1 = -1.0, c2 = 0.0;
+  size_t l1, l2 = 1;
+  for (l1=1; l1<n; l1=l2) {
+    l2 = l1 << 1;
+    double u1 = 1.0, u2 = 0.0;
+    for (j=0;j<l1;j++) {
+      int32_t ur = (int32_t)(u1*32767 + (u1<0 ? -0.5 : 0.5));
+      int32_t ui = (int32_t)(u2*32767 + (u2<0 ? -0.5 : 0.5));
+      for (i=j;i<n;i+=l2) {
+        int32_t br = re[i+l1], bi = im[i+l1];
+        int32_t tr = (ur*br - ui*bi + 16384) >> 15;
+        int32_t ti = (ur*bi + ui*br + 16384) >> 15;
+        int32_t ar = re[i], ai = im[i];
+        re[i+l1] = (int16_t)((ar - tr) >> 1);
+        im[i+l1] = (int16_t)((ai - ti) >> 1);
+        re[i] = (int16_t)((ar + tr) >> 1);
+        im[i] = (int16_t)((ai + ti) >> 1);
+      }
+      double z = u1 * c1 - u2 * c2;
+      u2 = u1 * c2 + u2 * c1;
+      u1 = z;
+    }
+    c2 = -jswrap_math_sqrt((1.0 - c1) / 2.0);
+    c1 = jswrap_math_sqrt((1.0 + c1) / 2.0);
+  }
+}
+
+/// If 'arr' is a typed array of the given type with 2^order elements stored contiguously, return a pointer to its data
+static void *jswrap_espruino_FFT_getData(JsVar *arr, JsVarDataArrayBufferViewType type, size_t length) {
+  if (!jsvIsArrayBuffer(arr) || arr->varData.arraybuffer.type!=type) return 0;
+  size_t len;
+  char *data = jsvGetDataPointer(arr, &len);
+  if (!data || len!=length || ((size_t)data & (JSV_ARRAYBUFFER_GET_SIZE(type)-1))) return 0;
+  return data;
+}
+
+/// Write the magnitude (or power) of the FFT result in arrReal/arrImag into 'out'. If arrImag is undefined, arrReal already contains magnitudes
+static void jswrap_espruino_FFT_output(JsVar *out, JsVar *arrReal, JsVar *arrImag, bool power) {
+  if (!jsvIsIterable(out)) return;
+  JsvIterator itr, iti, ito;
+  jsvIteratorNew(&itr, arrReal);
+  if (jsvIsIterable(arrImag)) jsvIteratorNew(&iti, arrImag);
+  jsvIteratorNew(&ito, out);
+  while (jsvIteratorHasElement(&ito) && jsvIteratorHasElement(&itr)) {
+    JsVarFloat r = jsvIteratorGetFloatValue(&itr), i = 0, f;
+    if (jsvIsIterable(arrImag)) {
+      i = jsvIteratorGetFloatValue(&iti);
+      jsvIteratorNext(&iti);
+      f = r*r + i*i;
+      if (!power) f = jswrap_math_sqrt(f);
+    } else {
+      f = power ? r*r : r;
+    }
+    jsvUnLock(jsvIteratorSetValue(&ito, jsvNewFromFloat(f)));
+    jsvIteratorNext(&itr);
+    jsvIteratorNext(&ito);
+  }
+  jsvIteratorFree(&ito);
+  if (jsvIsIterable(arrImag)) jsvIteratorFree(&iti);
+  jsvIteratorFree(&itr);
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -390,17 +817,28 @@ short FFT(short int dir,long m,double *x,double *y)
   "params" : [
     ["arrReal","JsVar","An array of real values"],
     ["arrImage","JsVar","An array of imaginary values (or if undefined, all values will be taken to be 0)"],
-    ["inverse","bool","Set this to true if you want an inverse FFT - otherwise leave as 0"]
+    ["inverse","bool","Set this to true if you want an inverse FFT - otherwise leave as 0"],
+    ["options","JsVar","(optional) An object containing `magnitude` and/or `power` - arrays that the magnitude `sqrt(r*r+i*i)` or power `r*r+i*i` of each result will be written into"]
   ]
 }
 Performs a Fast Fourier Transform (fft) on the supplied data and writes it back into the original arrays. Note that if only one array is supplied, the data written back is the modulus of the complex result `sqrt(r*r+i*i)`.
+
+If the arrays are `Float32Array`s whose length is a power of 2, the FFT is
+done in place in single precision without using any extra memory - and if
+only `arrReal` is supplied, a faster real-input FFT is used. A forward FFT of
+two `Int16Array`s whose length is a power of 2 is done in place in fixed point.
+Anything else is copied onto the stack and done in double precision.
  */
-void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
+void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse, JsVar *options) {
   if (!(jsvIsIterable(arrReal)) ||
       !(jsvIsUndefined(arrImag) || jsvIsIterable(arrImag))) {
     jsExceptionHere(JSET_ERROR, "Expecting first 2 arguments to be iterable or undefined, not %t and %t", arrReal, arrImag);
     return;
   }
+  if (!jsvIsUndefined(options) && !jsvIsObject(options)) {
+    jsExceptionHere(JSET_ERROR, "Expecting options to be an object, got %t", options);
+    return;
+  }
 
   // get length and work out power of 2
   size_t l = (size_t)jsvGetLength(arrReal);
@@ -411,68 +849,118 @@ void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse) {
     order++;
   }
 
-  if (jsuGetFreeStack() < 100+sizeof(double)*pow2*2) {
-    jsExceptionHere(JSET_ERROR, "Insufficient stack for computing FFT");
-    return;
+  unsigned int i;
+  bool done = false;
+  if (l==pow2 && order>0) {
+    // Can we do this in place?
+    float *fr = (float*)jswrap_espruino_FFT_getData(arrReal, ARRAYBUFFERVIEW_FLOAT32, l);
+    if (fr && jsvIsUndefined(arrImag) && order>1) {
+      jswrap_espruino_FFT_real_f32(fr, order, inverse);
+      // convert to magnitudes in place - see jswrap_espruino_FFT_real_f32 for layout
+      float scale = inverse ? 1.0f : 1.0f/(float)l;
+      float m0 = fabsf(fr[0]), mh = fabsf(fr[1]);
+      for (i=1;i<l/2;i++)
+        fr[i] = sqrtf(fr[2*i]*fr[2*i] + fr[2*i+1]*fr[2*i+1]) * scale;
+      fr[0] = m0 * scale;
+      fr[l/2] = mh * scale;
+      for (i=1;i<l/2;i++)
+        fr[l-i] = fr[i];
+      done = true;
+    } else if (fr) {
+      float *fi = (float*)jswrap_espruino_FFT_getData(arrImag, ARRAYBUFFERVIEW_FLOAT32, l);
+      if (fi) {
+        jswrap_espruino_FFT_f32(fr, fi, 1, order, inverse);
+        if (!inverse) {
+          float scale = 1.0f/(float)l;
+          for (i=0;i<l;i++) {
+            fr[i] *= scale;
+            fi[i] *= scale;
+          }
+        }
+        done = true;
+      }
+    } else if (!inverse) {
+      int16_t *ir = (int16_t*)jswrap_espruino_FFT_getData(arrReal, ARRAYBUFFERVIEW_INT16, l);
+      int16_t *ii = (int16_t*)jswrap_espruino_FFT_getData(arrImag, ARRAYBUFFERVIEW_INT16, l);
+      if (ir && ii) {
+        jswrap_espruino_FFT_q15(ir, ii, order);
+        done = true;
+      }
+    }
   }
 
-  double *vReal = (double*)alloca(sizeof(double)*pow2);
-  double *vImag = (double*)alloca(sizeof(double)*pow2);
+  if (!done) {
+    if (jsuGetFreeStack() < 100+sizeof(double)*pow2*2) {
+      jsExceptionHere(JSET_ERROR, "Insufficient stack for computing FFT");
+      return;
+    }
 
-  unsigned int i;
-  for (i=0;i<pow2;i++) {
-    vReal[i]=0;
-    vImag[i]=0;
-  }
+    double *vReal = (double*)alloca(sizeof(double)*pow2);
+    double *vImag = (double*)alloca(sizeof(double)*pow2);
 
-  // load data
-  JsvIterator it;
-  jsvIteratorNew(&it, arrReal);
-  i=0;
-  while (jsvIteratorHasElement(&it)) {
-    vReal[i++] = jsvIteratorGetFloatValue(&it);
-    jsvIteratorNext(&it);
-  }
-  jsvIteratorFree(&it);
+    for (i=0;i<pow2;i++) {
+      vReal[i]=0;
+      vImag[i]=0;
+    }
 
-  if (jsvIsIterable(arrImag)) {
-    jsvIteratorNew(&it, arrImag);
+    // load data
+    JsvIterator it;
+    jsvIteratorNew(&it, arrReal);
     i=0;
-    while (i<pow2 && jsvIteratorHasElement(&it)) {
-      vImag[i++] = jsvIteratorGetFloatValue(&it);
+    while (jsvIteratorHasElement(&it)) {
+      vReal[i++] = jsvIteratorGetFloatValue(&it);
       jsvIteratorNext(&it);
     }
     jsvIteratorFree(&it);
-  }
 
-  // do FFT
-  FFT(inverse ? -1 : 1, order, vReal, vImag);
+    if (jsvIsIterable(arrImag)) {
+      jsvIteratorNew(&it, arrImag);
+      i=0;
+      while (i<pow2 && jsvIteratorHasElement(&it)) {
+        vImag[i++] = jsvIteratorGetFloatValue(&it);
+        jsvIteratorNext(&it);
+      }
+      jsvIteratorFree(&it);
+    }
 
-  // Put the results back
-  bool useModulus = jsvIsIterable(arrImag);
+    // do FFT
+    FFT(inverse ? -1 : 1, order, vReal, vImag);
 
-  jsvIteratorNew(&it, arrReal);
-  i=0;
-  while (jsvIteratorHasElement(&it)) {
-    JsVarFloat f;
-    if (useModulus)
-      f = jswrap_math_sqrt(vReal[i]*vReal[i] + vImag[i]*vImag[i]);
-    else
-      f = vReal[i];
-
-    jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(f)));
-    i++;
-    jsvIteratorNext(&it);
-  }
-  jsvIteratorFree(&it);
-  if (jsvIsIterable(arrImag)) {
-    jsvIteratorNew(&it, arrImag);
+    // Put the results back
+    bool useModulus = !jsvIsIterable(arrImag);
+
+    jsvIteratorNew(&it, arrReal);
     i=0;
     while (jsvIteratorHasElement(&it)) {
-      jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(vImag[i++])));
+      JsVarFloat f;
+      if (useModulus)
+        f = jswrap_math_sqrt(vReal[i]*vReal[i] + vImag[i]*vImag[i]);
+      else
+        f = vReal[i];
+
+      jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(f)));
+      i++;
       jsvIteratorNext(&it);
     }
     jsvIteratorFree(&it);
+    if (jsvIsIterable(arrImag)) {
+      jsvIteratorNew(&it, arrImag);
+      i=0;
+      while (jsvIteratorHasElement(&it)) {
+        jsvUnLock(jsvIteratorSetValue(&it, jsvNewFromFloat(vImag[i++])));
+        jsvIteratorNext(&it);
+      }
+      jsvIteratorFree(&it);
+    }
+  }
+
+  if (jsvIsObject(options)) {
+    JsVar *out = jsvObjectGetChild(options, "magnitude", 0);
+    jswrap_espruino_FFT_output(out, arrReal, arrImag, false);
+    jsvUnLock(out);
+    out = jsvObjectGetChild(options, "power", 0);
+    jswrap_espruino_FFT_output(out, arrReal, arrImag, true);
+    jsvUnLock(out);
   }
 }
 
@@ -728,6 +1216,328 @@ JsVar *jswrap_espruino_toUint8Array(JsVar *args) {
   return arr;
 }
 
+#ifndef SAVE_ON_FLASH
+/// One field of a format string for E.pack/E.unpack
+typedef struct {
+  const char *fmt;
+  size_t fmtLen, pos;
+  bool littleEndian;
+  size_t nameStart, nameLen; ///< where the field's name is in the format string (nameLen==0 if none)
+  int count; ///< how many values (or the length in bytes for 's')
+  char code;
+  JsVarDataArrayBufferViewType type; ///< the type of each value
+} JsStructField;
+
+static void jswrap_espruino_structInit(JsStructField *f, const char *fmt, size_t fmtLen) {
+  f->fmt = fmt;
+  f->fmtLen = fmtLen;
+  f->pos = 0;
+  f->littleEndian = true;
+  if (fmtLen && strchr("<>!=@", fmt[0])) {
+    f->littleEndian = fmt[0]!='>' && fmt[0]!='!';
+    f->pos++;
+  }
+}
+
+/** Parse the next field of a struct format string like `<2h:pos 3B f` into f.
+ * Returns false at the end (or on error, with an exception) */
+static bool jswrap_espruino_structNext(JsStructField *f) {
+  while (f->pos<f->fmtLen && isWhitespace(f->fmt[f->pos])) f->pos++;
+  if (f->pos>=f->fmtLen) return false;
+  // name:
+  size_t p = f->pos;
+  while (p<f->fmtLen && (isAlpha(f->fmt[p]) || isNumeric(f->fmt[p]))) p++;
+  f->nameLen = 0;
+  if (p<f->fmtLen && f->fmt[p]==':' && p>f->pos) {
+    f->nameStart = f->pos;
+    f->nameLen = p-f->pos;
+    f->pos = p+1;
+  }
+  // count
+  f->count = 1;
+  if (f->pos<f->fmtLen && isNumeric(f->fmt[f->pos])) {
+    f->count = 0;
+    while (f->pos<f->fmtLen && isNumeric(f->fmt[f->pos]))
+      f->count = f->count*10 + f->fmt[f->pos++] - '0';
+  }
+  f->code = (f->pos<f->fmtLen) ? f->fmt[f->pos++] : 0;
+  switch (f->code) {
+  case 'x':
+  case 'c':
+  case 's':
+  case 'B':
+  case '?': f->type = ARRAYBUFFERVIEW_UINT8; break;
+  case 'b': f->type = ARRAYBUFFERVIEW_INT8; break;
+  case 'h': f->type = ARRAYBUFFERVIEW_INT16; break;
+  case 'H': f->type = ARRAYBUFFERVIEW_UINT16; break;
+  case 'i':
+  case 'l': f->type = ARRAYBUFFERVIEW_INT32; break;
+  case 'I':
+  case 'L': f->type = ARRAYBUFFERVIEW_UINT32; break;
+  case 'f': f->type = ARRAYBUFFERVIEW_FLOAT32; break;
+  case 'd': f->type = ARRAYBUFFERVIEW_FLOAT64; break;
+  default:
+    jsExceptionHere(JSET_ERROR, "Unknown format character '%c'", f->code);
+    return false;
+  }
+  return true;
+}
+
+/// The number of bytes in this field
+static size_t jswrap_espruino_structFieldSize(JsStructField *f) {
+  return JSV_ARRAYBUFFER_GET_SIZE(f->type) * (size_t)f->count;
+}
+
+/// Does a format string contain names (so should be packed from/unpacked to an object)?
+static bool jswrap_espruino_structHasNames(const char *fmt, size_t fmtLen) {
+  return memchr(fmt, ':', fmtLen)!=0;
+}
+
+/// Read one value of a field
+static JsVar *jswrap_espruino_unpackValue(JsStructField *f, JsvArrayBufferIterator *it) {
+  it->type = f->type;
+  it->littleEndian = f->littleEndian;
+  JsVar *v;
+  if (f->code=='c') {
+    char buf[2] = { (char)jsvArrayBufferIteratorGetIntegerValue(it), 0 };
+    v = jsvNewFromString(buf);
+  } else if (f->code=='?') {
+    v = jsvNewFromBool(jsvArrayBufferIteratorGetIntegerValue(it)!=0);
+  } else
+    v = jsvArrayBufferIteratorGetValue(it);
+  jsvArrayBufferIteratorNext(it);
+  return v;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "unpack",
+  "generate" : "jswrap_espruino_unpack",
+  "params" : [
+    ["format","JsVar","The format of the data (see below)"],
+    ["data","JsVar","An ArrayBuffer, typed array or String to read from"],
+    ["offset","int","(optional) The offset in bytes to start reading at"]
+  ],
+  "return" : ["JsVar","An array of values, or an object if the fields in `format` are named"]
+}
+Decode binary data in one go, using a format string like Python's `struct` module.
+
+The format may start with `<` (little endian - the default) or `>` (big endian).
+Each field is then an optional count followed by one of:
+
+* `x` - a pad byte (no value)
+* `c` - a character, as a 1 character String
+* `b`/`B` - a signed/unsigned 8 bit integer
+* `?` - a boolean (one byte)
+* `h`/`H` - a signed/unsigned 16 bit integer
+* `i`/`I` (or `l`/`L`) - a signed/unsigned 32 bit integer
+* `f` - a 32 bit float
+* `d` - a 64 bit float
+* `s` - a String of `count` bytes
+
+No alignment padding is ever added. For example `E.unpack("<hhB", data)` returns
+an array of 3 values.
+
+Fields can also be named with `name:`, in which case an object is returned
+(and unnamed fields are skipped). Named fields with a count return an Array:
+
+```
+E.unpack("<id:H temp:h 3B acc:3h", data)
+// {id:..., temp:..., acc:[x,y,z]}
+```
+ */
+JsVar *jswrap_espruino_unpack(JsVar *format, JsVar *data, int offset) {
+  if (jsvIsString(data)) {
+    data = jswrap_espruino_toArrayBuffer(data);
+  } else if (jsvIsArrayBuffer(data)) {
+    data = jsvLockAgain(data);
+  } else {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting an ArrayBuffer or String, got %t", data);
+    return 0;
+  }
+  format = jsvAsString(format, false);
+  if (!data || !format || offset<0) {
+    jsvUnLock2(data, format);
+    return 0;
+  }
+  JSV_GET_AS_CHAR_ARRAY(fmtPtr, fmtLen, format);
+  bool named = jswrap_espruino_structHasNames(fmtPtr, fmtLen);
+  JsVar *result = named ? jsvNewObject() : jsvNewEmptyArray();
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNewBytes(&it, data, (size_t)offset);
+  JsStructField f;
+  jswrap_espruino_structInit(&f, fmtPtr, fmtLen);
+  while (result && jswrap_espruino_structNext(&f)) {
+    size_t size = jswrap_espruino_structFieldSize(&f);
+    if (size && (it.type==ARRAYBUFFERVIEW_UNDEFINED || it.byteOffset+size>it.byteLength)) {
+      jsExceptionHere(JSET_ERROR, "Not enough data to unpack");
+      break;
+    }
+    int i;
+    JsVar *value = 0;
+    if (f.code=='x') {
+      it.type = ARRAYBUFFERVIEW_UINT8;
+      for (i=0;i<f.count;i++) jsvArrayBufferIteratorNext(&it);
+      continue;
+    } else if (f.code=='s') {
+      value = jsvNewFromEmptyString();
+      if (!value) break;
+      JsvStringIterator dst;
+      jsvStringIteratorNew(&dst, value, 0);
+      it.type = ARRAYBUFFERVIEW_UINT8;
+      for (i=0;i<f.count;i++) {
+        jsvStringIteratorAppend(&dst, (char)jsvArrayBufferIteratorGetIntegerValue(&it));
+        jsvArrayBufferIteratorNext(&it);
+      }
+      jsvStringIteratorFree(&dst);
+    } else if (named && f.count!=1) {
+      value = jsvNewEmptyArray();
+      for (i=0;i<f.count && value;i++)
+        jsvArrayPushAndUnLock(value, jswrap_espruino_unpackValue(&f, &it));
+    } else if (!named) {
+      // unnamed fields with a count give separate values, like Python
+      for (i=0;i<f.count;i++)
+        jsvArrayPushAndUnLock(result, jswrap_espruino_unpackValue(&f, &it));
+      continue;
+    } else {
+      value = jswrap_espruino_unpackValue(&f, &it);
+    }
+    if (!named) {
+      jsvArrayPush(result, value);
+    } else if (f.nameLen) {
+      JsVar *name = jsvNewFromStringVar(format, f.nameStart, f.nameLen);
+      if (name) jsvUnLock(jsvSetValueOfName(jsvFindChildFromVar(result, name, true), value));
+      jsvUnLock(name);
+    }
+    jsvUnLock(value);
+  }
+  jsvArrayBufferIteratorFree(&it);
+  jsvUnLock2(data, format);
+  return result;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "pack",
+  "generate" : "jswrap_espruino_pack",
+  "params" : [
+    ["format","JsVar","The format of the data (see `E.unpack`)"],
+    ["values","JsVar","An Array of values (or an Object if the fields in `format` are named)"]
+  ],
+  "return" : ["JsVar","A Uint8Array containing the packed data"],
+  "return_object" : "Uint8Array"
+}
+Encode values into binary data, using a format string like Python's `struct`
+module. This is the opposite of `E.unpack`:
+
+```
+E.pack("<HhB", [1,-2,3]) // new Uint8Array([1,0,254,255,3])
+E.pack(">id:H temp:h", {id:1, temp:-2})
+```
+ */
+JsVar *jswrap_espruino_pack(JsVar *format, JsVar *values) {
+  format = jsvAsString(format, false);
+  if (!format) return 0;
+  JSV_GET_AS_CHAR_ARRAY(fmtPtr, fmtLen, format);
+  bool named = jswrap_espruino_structHasNames(fmtPtr, fmtLen);
+  if (named ? !jsvIsObject(values) : !jsvIsIterable(values)) {
+    jsExceptionHere(JSET_TYPEERROR, named ? "Expecting an Object, got %t" : "Expecting an Array, got %t", values);
+    jsvUnLock(format);
+    return 0;
+  }
+  // Work out the size first
+  JsStructField f;
+  size_t size = 0;
+  jswrap_espruino_structInit(&f, fmtPtr, fmtLen);
+  while (jswrap_espruino_structNext(&f))
+    size += jswrap_espruino_structFieldSize(&f);
+  JsVar *result = jspHasError() ? 0 : jsvNewTypedArray(ARRAYBUFFERVIEW_UINT8, (JsVarInt)size);
+  if (!result || !size) {
+    jsvUnLock(format);
+    return result;
+  }
+
+  JsvIterator itsrc; // the values, if they're not named
+  if (!named) jsvIteratorNew(&itsrc, values);
+  JsvArrayBufferIterator it;
+  jsvArrayBufferIteratorNewBytes(&it, result, 0);
+  jswrap_espruino_structInit(&f, fmtPtr, fmtLen);
+  while (jswrap_espruino_structNext(&f)) {
+    JsVar *value = 0; // for named fields, or 's'
+    if (f.code=='s' || (named && f.code!='x')) {
+      if (!named) {
+        if (jsvIteratorHasElement(&itsrc)) {
+          value = jsvIteratorGetValue(&itsrc);
+          jsvIteratorNext(&itsrc);
+        }
+      } else if (f.nameLen) {
+        JsVar *name = jsvNewFromStringVar(format, f.nameStart, f.nameLen);
+        if (name) value = jsvSkipNameAndUnLock(jsvFindChildFromVar(values, name, false));
+        jsvUnLock(name);
+      }
+    }
+    int i;
+    if (f.code=='x' || f.code=='s') {
+      JsvStringIterator str;
+      if (f.code=='s') {
+        value = jsvAsString(value, true);
+        jsvStringIteratorNew(&str, value, 0);
+      }
+      it.type = ARRAYBUFFERVIEW_UINT8;
+      for (i=0;i<f.count;i++) {
+        // strings are padded with zeros (or truncated)
+        char ch = 0;
+        if (f.code=='s' && jsvStringIteratorHasChar(&str)) {
+          ch = jsvStringIteratorGetChar(&str);
+          jsvStringIteratorNext(&str);
+        }
+        jsvArrayBufferIteratorSetByteValue(&it, ch);
+        jsvArrayBufferIteratorNext(&it);
+      }
+      if (f.code=='s') jsvStringIteratorFree(&str);
+    } else {
+      JsvIterator itarr; // for named fields with a count
+      bool isArray = named && f.count!=1 && jsvIsIterable(value);
+      if (isArray) jsvIteratorNew(&itarr, value);
+      for (i=0;i<f.count;i++) {
+        JsVar *v = 0;
+        if (isArray) {
+          if (jsvIteratorHasElement(&itarr)) {
+            v = jsvIteratorGetValue(&itarr);
+            jsvIteratorNext(&itarr);
+          }
+        } else if (named) {
+          v = jsvLockAgainSafe(value);
+        } else if (jsvIteratorHasElement(&itsrc)) {
+          v = jsvIteratorGetValue(&itsrc);
+          jsvIteratorNext(&itsrc);
+        }
+        if (f.code=='c' && jsvIsString(v)) {
+          JsVar *ch = jsvNewFromInteger((unsigned char)jsvGetCharInString(v, 0));
+          jsvUnLock(v);
+          v = ch;
+        }
+        it.type = f.type;
+        it.littleEndian = f.littleEndian;
+        jsvArrayBufferIteratorSetValue(&it, v);
+        jsvArrayBufferIteratorNext(&it);
+        jsvUnLock(v);
+      }
+      if (isArray) jsvIteratorFree(&itarr);
+    }
+    jsvUnLock(value);
+  }
+  jsvArrayBufferIteratorFree(&it);
+  if (!named) jsvIteratorFree(&itsrc);
+  jsvUnLock(format);
+  return result;
+}
+#endif
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "E",
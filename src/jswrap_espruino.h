@@ -19,8 +19,11 @@ JsVar *jswrap_espruino_nativeCall(JsVarInt addr, JsVar *signature, JsVar *data);
 JsVarFloat jswrap_espruino_clip(JsVarFloat x, JsVarFloat min, JsVarFloat max);
 JsVarFloat jswrap_espruino_sum(JsVar *arr);
 JsVarFloat jswrap_espruino_variance(JsVar *arr, JsVarFloat mean);
+JsVar *jswrap_espruino_stats(JsVar *arr);
+JsVar *jswrap_espruino_histogram(JsVar *arr, JsVar *bins, JsVar *outBuf);
+JsVarFloat jswrap_espruino_percentile(JsVar *arr, JsVarFloat p);
 JsVarFloat jswrap_espruino_convolve(JsVar *a, JsVar *b, int offset);
-void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse);
+void jswrap_espruino_FFT(JsVar *arrReal, JsVar *arrImag, bool inverse, JsVar *options);
 
 JsVarFloat jswrap_espruino_interpolate(JsVar *array, JsVarFloat findex);
 JsVarFloat jswrap_espruino_interpolate2d(JsVar *array, int width, JsVarFloat x, JsVarFloat y);
@@ -31,6 +34,8 @@ JsVar *jswrap_espruino_getErrorFlags();
 JsVar *jswrap_espruino_toArrayBuffer(JsVar *str);
 JsVar *jswrap_espruino_toUint8Array(JsVar *args);
 JsVar *jswrap_espruino_toString(JsVar *args);
+JsVar *jswrap_espruino_unpack(JsVar *format, JsVar *data, int offset);
+JsVar *jswrap_espruino_pack(JsVar *format, JsVar *values);
 JsVar *jswrap_espruino_memoryArea(int addr, int len);
 void jswrap_espruino_setBootCode(JsVar *code, bool alwaysExec);
 int jswrap_espruino_setClock(JsVar *options);
@@ -0,0 +1,356 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * FIR and IIR filters for streams of samples
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_filter.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+#define JS_FILTER_DATA_NAME JS_HIDDEN_CHAR_STR"flt" // the coefficients and state of each Filter
+
+#ifndef SAVE_ON_FLASH
+
+typedef enum {
+  JSWFILTER_FIR,
+  JSWFILTER_BIQUAD,
+} JswFilterType;
+
+/* Everything is stored in one flat string, so it can be processed without
+ * walking JsVars: this header followed by floats.
+ *
+ * FIR    : taps coefficients, then a delay line of 2*taps samples. Each
+ *          sample is written twice (taps apart) so the last `taps` samples
+ *          are always in order starting at `pos`, and the inner loop never
+ *          has to wrap.
+ * BIQUAD : 5 coefficients (b0,b1,b2,a1,a2) per section, then 2 state values
+ *          per section (Transposed Direct Form II) */
+typedef struct {
+  unsigned char type; ///< JswFilterType
+  unsigned short count; ///< number of taps (FIR) or sections (BIQUAD)
+  unsigned short pos; ///< FIR: where the newest sample is in the delay line
+} JswFilterHeader;
+
+#define JSWFILTER_DATA_OFFSET ((sizeof(JswFilterHeader)+3)&~(size_t)3)
+
+static float *jswrap_filter_getCoeffs(JswFilterHeader *f) {
+  return (float*)(((char*)f) + JSWFILTER_DATA_OFFSET);
+}
+
+static float *jswrap_filter_getState(JswFilterHeader *f) {
+  return jswrap_filter_getCoeffs(f) + ((f->type==JSWFILTER_FIR) ? f->count : f->count*5);
+}
+
+static size_t jswrap_filter_getStateSize(JswFilterHeader *f) {
+  return sizeof(float) * f->count * 2; // delay line for FIR, 2 per section for BIQUAD
+}
+
+/// Get the filter data (which must be unlocked after use), or 0 and throw an error
+static JsVar *jswrap_filter_getData(JsVar *filter, JswFilterHeader **f) {
+  JsVar *data = jsvIsObject(filter) ? jsvObjectGetChild(filter, JS_FILTER_DATA_NAME, 0) : 0;
+  if (!jsvIsFlatString(data)) {
+    jsvUnLock(data);
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a Filter, got %t", filter);
+    return 0;
+  }
+  *f = (JswFilterHeader*)jsvGetFlatStringPointer(data);
+  return data;
+}
+
+/// Filter one sample
+static ALWAYS_INLINE float jswrap_filter_step(JswFilterHeader *f, float *coeffs, float *state, float x) {
+  unsigned int i, n = f->count;
+  if (f->type==JSWFILTER_FIR) {
+    unsigned int pos = f->pos ? (unsigned int)f->pos-1 : n-1;
+    f->pos = (unsigned short)pos;
+    state[pos] = x;
+    state[pos+n] = x;
+    const float *d = &state[pos];
+    float y = 0;
+    for (i=0;i<n;i++)
+      y += coeffs[i] * d[i];
+    return y;
+  } else {
+    for (i=0;i<n;i++) {
+      const float *c = &coeffs[i*5];
+      float *s = &state[i*2];
+      float y = c[0]*x + s[0];
+      s[0] = c[1]*x - c[3]*y + s[1];
+      s[1] = c[2]*x - c[4]*y;
+      x = y;
+    }
+    return x;
+  }
+}
+
+/*JSON{
+  "type" : "class",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Filter"
+}
+A digital filter, which keeps its state between calls so it can be used on a
+continuous stream of samples (for instance from a `Waveform`).
+
+```
+// 5 point moving average
+var f = new Filter({fir:[0.2,0.2,0.2,0.2,0.2]});
+// Filter each buffer of analog data as it is recorded
+var w = new Waveform(128,{doubleBuffer:true, bits:16});
+var out = new Float32Array(128);
+w.on("buffer", function(buf) {
+  f.process(buf, out);
+  // ... use out
+});
+w.startInput(A0,2000,{repeat:true});
+```
+ */
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "Filter",
+  "name" : "Filter",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_filter_constructor",
+  "params" : [
+    ["options","JsVar","An object containing either `fir` or `biquad` (see below)"]
+  ],
+  "return" : ["JsVar","A Filter object"]
+}
+Create a new filter. `options` is one of:
+
+* `{fir : coefficients}` - a Finite Impulse Response filter, where
+`coefficients` is an array of taps (newest sample first):
+`y[n] = c[0]*x[n] + c[1]*x[n-1] + ...`
+* `{biquad : coefficients}` - an Infinite Impulse Response filter made of a
+cascade of second order sections. `coefficients` contains 5 values for each
+section, `b0,b1,b2,a1,a2`, with `a0` normalised to 1:
+`y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]`
+
+Coefficients and state are stored as 32 bit floats.
+ */
+JsVar *jswrap_filter_constructor(JsVar *options) {
+  JswFilterType type;
+  JsVar *coeffs = 0;
+  if (jsvIsObject(options) && (coeffs = jsvObjectGetChild(options, "fir", 0))) {
+    type = JSWFILTER_FIR;
+  } else if (jsvIsObject(options) && (coeffs = jsvObjectGetChild(options, "biquad", 0))) {
+    type = JSWFILTER_BIQUAD;
+  } else {
+    jsExceptionHere(JSET_ERROR, "Expecting an object containing 'fir' or 'biquad', got %t", options);
+    return 0;
+  }
+  JsVarInt len = jsvIsIterable(coeffs) ? jsvGetLength(coeffs) : 0;
+  JsVarInt count = (type==JSWFILTER_FIR) ? len : len/5;
+  if (count<=0 || count>0xFFFF || (type==JSWFILTER_BIQUAD && len%5)) {
+    jsExceptionHere(JSET_ERROR, (type==JSWFILTER_FIR) ?
+        "Expecting an array of coefficients, got %t" :
+        "Expecting an array of 5 coefficients per section, got %t", coeffs);
+    jsvUnLock(coeffs);
+    return 0;
+  }
+
+  JswFilterHeader hdr;
+  hdr.type = (unsigned char)type;
+  hdr.count = (unsigned short)count;
+  hdr.pos = 0;
+  size_t size = JSWFILTER_DATA_OFFSET + sizeof(float)*(size_t)len + jswrap_filter_getStateSize(&hdr);
+  JsVar *data = jsvNewFlatStringOfLength((unsigned int)size);
+  JsVar *filter = data ? jspNewObject(0, "Filter") : 0;
+  if (!filter) {
+    if (!data) jsExceptionHere(JSET_ERROR, "Not enough memory to allocate Filter");
+    jsvUnLock2(data, coeffs);
+    return 0;
+  }
+  JswFilterHeader *f = (JswFilterHeader*)jsvGetFlatStringPointer(data);
+  memset(f, 0, size);
+  *f = hdr;
+  float *c = jswrap_filter_getCoeffs(f);
+  JsvIterator it;
+  jsvIteratorNew(&it, coeffs);
+  while (jsvIteratorHasElement(&it)) {
+    *(c++) = (float)jsvIteratorGetFloatValue(&it);
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  jsvUnLock(coeffs);
+
+  jsvObjectSetChildAndUnLock(filter, JS_FILTER_DATA_NAME, data);
+  return filter;
+}
+
+/// If arr is a typed array stored in one block, return a pointer to its data and update *n with the minimum length
+static char *jswrap_filter_getDataPointer(JsVar *arr, size_t *n) {
+  if (!jsvIsArrayBuffer(arr)) return 0;
+  JsVarDataArrayBufferViewType type = arr->varData.arraybuffer.type;
+  if (JSV_ARRAYBUFFER_IS_CLAMPED(type) || type==ARRAYBUFFERVIEW_ARRAYBUFFER)
+    return 0;
+  size_t len;
+  char *data = jsvGetDataPointer(arr, &len);
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  if (!data || ((size_t)data & ((size>4?4:size)-1))) return 0;
+  if (len < *n) *n = len;
+  return data;
+}
+
+static ALWAYS_INLINE float jswrap_filter_load(const char *p, JsVarDataArrayBufferViewType type, size_t i) {
+  switch (type) {
+  case ARRAYBUFFERVIEW_UINT8: return ((const uint8_t*)p)[i];
+  case ARRAYBUFFERVIEW_INT8: return ((const int8_t*)p)[i];
+  case ARRAYBUFFERVIEW_UINT16: return ((const uint16_t*)p)[i];
+  case ARRAYBUFFERVIEW_INT16: return ((const int16_t*)p)[i];
+  case ARRAYBUFFERVIEW_UINT32: return (float)((const uint32_t*)p)[i];
+  case ARRAYBUFFERVIEW_INT32: return (float)((const int32_t*)p)[i];
+  case ARRAYBUFFERVIEW_FLOAT32: return ((const float*)p)[i];
+  case ARRAYBUFFERVIEW_FLOAT64: return (float)((const double*)p)[i];
+  default: return 0;
+  }
+}
+
+static ALWAYS_INLINE void jswrap_filter_store(char *p, JsVarDataArrayBufferViewType type, size_t i, float v) {
+  if (JSV_ARRAYBUFFER_IS_FLOAT(type)) {
+    if (type==ARRAYBUFFERVIEW_FLOAT32) ((float*)p)[i] = v;
+    else ((double*)p)[i] = v;
+    return;
+  }
+  /* same as writing a number into the array from JS. Anything outside the
+   * range of int64_t (or NaN) can't be converted directly - but floats that
+   * big are all multiples of 2^32, so would wrap to 0 anyway */
+  int64_t iv = (v > -9223372036854775808.0f && v < 9223372036854775808.0f) ? (int64_t)v : 0;
+  switch (type) {
+  case ARRAYBUFFERVIEW_UINT8:
+  case ARRAYBUFFERVIEW_INT8: ((uint8_t*)p)[i] = (uint8_t)iv; break;
+  case ARRAYBUFFERVIEW_UINT16:
+  case ARRAYBUFFERVIEW_INT16: ((uint16_t*)p)[i] = (uint16_t)iv; break;
+  case ARRAYBUFFERVIEW_UINT32:
+  case ARRAYBUFFERVIEW_INT32: ((uint32_t*)p)[i] = (uint32_t)iv; break;
+  default: break;
+  }
+}
+
+/// A Waveform can be given in place of an array, in which case we use its buffer
+static JsVar *jswrap_filter_getArray(JsVar *v) {
+  if (jsvIsObject(v)) {
+    JsVar *buf = jsvObjectGetChild(v, "buffer", 0);
+    if (jsvIsArrayBuffer(buf)) return buf;
+    jsvUnLock(buf);
+  }
+  return jsvLockAgainSafe(v);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Filter",
+  "name" : "process",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_filter_process",
+  "params" : [
+    ["input","JsVar","An array, typed array or `Waveform` of samples"],
+    ["output","JsVar","(optional) An array, typed array or `Waveform` to write the filtered samples into. If not specified, `input` is overwritten"]
+  ]
+}
+Filter all the samples in `input`, writing the result into `output`. The
+state of the filter is kept, so the next call carries on where this one left
+off.
+
+If `output` is shorter than `input`, only as many samples as fit in `output`
+are processed. Values written into integer arrays are truncated, just as they
+would be if written from JavaScript.
+ */
+void jswrap_filter_process(JsVar *filter, JsVar *input, JsVar *output) {
+  JswFilterHeader *f;
+  JsVar *data = jswrap_filter_getData(filter, &f);
+  if (!data) return;
+  JsVar *in = jswrap_filter_getArray(input);
+  JsVar *out = jsvIsUndefined(output) ? jsvLockAgainSafe(in) : jswrap_filter_getArray(output);
+  if (!jsvIsIterable(in) || !(jsvIsArray(out) || jsvIsArrayBuffer(out))) {
+    jsExceptionHere(JSET_ERROR, "Expecting an iterable for input, and an Array or typed array for output, got %t and %t", in, out);
+    jsvUnLock3(data, in, out);
+    return;
+  }
+  float *coeffs = jswrap_filter_getCoeffs(f);
+  float *state = jswrap_filter_getState(f);
+
+  size_t i, n = jsvIsArrayBuffer(in) ? jsvGetArrayBufferLength(in) : 0;
+  char *pin = jswrap_filter_getDataPointer(in, &n);
+  char *pout = pin ? jswrap_filter_getDataPointer(out, &n) : 0;
+  if (pin && pout) {
+    JsVarDataArrayBufferViewType tin = in->varData.arraybuffer.type;
+    JsVarDataArrayBufferViewType tout = out->varData.arraybuffer.type;
+    if (tin==ARRAYBUFFERVIEW_FLOAT32 && tout==ARRAYBUFFERVIEW_FLOAT32) {
+      for (i=0;i<n;i++)
+        ((float*)pout)[i] = jswrap_filter_step(f, coeffs, state, ((float*)pin)[i]);
+    } else {
+      for (i=0;i<n;i++)
+        jswrap_filter_store(pout, tout, i, jswrap_filter_step(f, coeffs, state, jswrap_filter_load(pin, tin, i)));
+    }
+  } else {
+    JsvIterator itin, itout;
+    jsvIteratorNew(&itin, in);
+    jsvIteratorNew(&itout, out);
+    while (jsvIteratorHasElement(&itin) && jsvIteratorHasElement(&itout)) {
+      float y = jswrap_filter_step(f, coeffs, state, (float)jsvIteratorGetFloatValue(&itin));
+      if (itout.type == JSVI_ARRAYBUFFER)
+        jsvArrayBufferIteratorSetFloatValue(&itout.it.buf, y);
+      else
+        jsvUnLock(jsvIteratorSetValue(&itout, jsvNewFromFloat(y)));
+      jsvIteratorNext(&itin);
+      jsvIteratorNext(&itout);
+    }
+    jsvIteratorFree(&itout);
+    jsvIteratorFree(&itin);
+  }
+  jsvUnLock3(data, in, out);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Filter",
+  "name" : "sample",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_filter_sample",
+  "params" : [
+    ["x","float","The next sample"]
+  ],
+  "return" : ["float","The filtered value"]
+}
+Filter a single sample. This is much slower than `Filter.process` when there
+are many samples to filter.
+ */
+JsVarFloat jswrap_filter_sample(JsVar *filter, JsVarFloat x) {
+  JswFilterHeader *f;
+  JsVar *data = jswrap_filter_getData(filter, &f);
+  if (!data) return NAN;
+  float y = jswrap_filter_step(f, jswrap_filter_getCoeffs(f), jswrap_filter_getState(f), (float)x);
+  jsvUnLock(data);
+  return y;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Filter",
+  "name" : "reset",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_filter_reset"
+}
+Clear the filter's state, as if it had only ever been given zeros.
+ */
+void jswrap_filter_reset(JsVar *filter) {
+  JswFilterHeader *f;
+  JsVar *data = jswrap_filter_getData(filter, &f);
+  if (!data) return;
+  memset(jswrap_filter_getState(f), 0, jswrap_filter_getStateSize(f));
+  f->pos = 0;
+  jsvUnLock(data);
+}
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * FIR and IIR filters for streams of samples
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_filter_constructor(JsVar *options);
+void jswrap_filter_process(JsVar *filter, JsVar *input, JsVar *output);
+JsVarFloat jswrap_filter_sample(JsVar *filter, JsVarFloat x);
+void jswrap_filter_reset(JsVar *filter);
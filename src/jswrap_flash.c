@@ -459,7 +459,11 @@ void jsfLoadStateFromFlash() {
     fread(&jsVarCount, sizeof(unsigned int), 1, f);
 
     jsiConsolePrintf("\nDecompressing to %d bytes...", jsVarCount*sizeof(JsVar));
-    jsvSetMemoryTotal(jsVarCount);
+    if (jsVarCount > jsvGetMemoryTotal() && !jsvSetMemoryTotal(jsVarCount)) {
+      jsiConsolePrintf("Not enough memory\n");
+      fclose(f);
+      return;
+    }
     /*JsVarRef i;
     for (i=1;i<=jsVarCount;i++) {
       fread(_jsvGetAddressOf(i),1,sizeof(JsVar),f);
@@ -28,7 +28,7 @@
 }
 A variable containing the arguments given to the function
  */
-extern JsExecInfo execInfo;
+extern JS_CONTEXT_LOCAL JsExecInfo execInfo;
 JsVar *jswrap_arguments() {
   JsVar *scope = 0;
   if (execInfo.scopeCount>0)
@@ -199,23 +199,289 @@ bool jswrap_isNaN(JsVar *v) {
 }
 
 
-NO_INLINE static int jswrap_btoa_encode(int c) {
-  c = c & 0x3F;
-  if (c<26) return 'A'+c;
-  if (c<52) return 'a'+c-26;
-  if (c<62) return '0'+c-52;
-  if (c==62) return '+';
-  return '/'; // c==63
+static const char jswrap_base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char jswrap_hexChars[] = "0123456789abcdef";
+/// Value of each base64 character (including URL-safe '-' and '_'), or -1 for anything else (which is skipped)
+static const signed char jswrap_base64Values[128] = {
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+  -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,62,-1,62,-1,63,
+  52,53,54,55,56,57,58,59,60,61,-1,-1,-1,-1,-1,-1,
+  -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,
+  15,16,17,18,19,20,21,22,23,24,25,-1,-1,-1,-1,63,
+  -1,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40,
+  41,42,43,44,45,46,47,48,49,50,51,-1,-1,-1,-1,-1,
+};
+
+/// Reads bytes from a String, ArrayBuffer or array - a block at a time where possible
+typedef struct {
+  const unsigned char *ptr; ///< if the data is all in one area of memory, a pointer to it
+  size_t len; ///< bytes left in ptr (or in the string, if isString)
+  bool isString, isIterator;
+  JsvStringIterator itstr;
+  JsvIterator it;
+} JswCodecReader;
+
+static void jswrap_codec_readerNew(JswCodecReader *r, JsVar *data) {
+  r->ptr = 0;
+  r->len = 0;
+  r->isString = false;
+  r->isIterator = false;
+  bool isByteArray = jsvIsArrayBuffer(data) && JSV_ARRAYBUFFER_GET_SIZE(data->varData.arraybuffer.type)==1;
+  if (jsvIsString(data) || isByteArray)
+    r->ptr = (const unsigned char *)jsvGetDataPointer(data, &r->len);
+  if (r->ptr) return;
+  if (isByteArray) { // read the string behind the ArrayBuffer
+    JsVar *backing = jsvGetArrayBufferBackingString(data);
+    jsvStringIteratorNew(&r->itstr, backing, data->varData.arraybuffer.byteOffset);
+    jsvUnLock(backing);
+    r->len = data->varData.arraybuffer.length;
+    r->isString = true;
+  } else if (jsvIsString(data)) {
+    jsvStringIteratorNew(&r->itstr, data, 0);
+    r->len = jsvGetStringLength(data);
+    r->isString = true;
+  } else {
+    jsvIteratorNew(&r->it, data);
+    r->isIterator = true;
+  }
+}
+
+/** Get up to maxLen bytes. *data is set to point either straight at the data
+ * or at buf, which it has been copied into. Returns the number of bytes (0 at the end) */
+static size_t jswrap_codec_read(JswCodecReader *r, unsigned char *buf, size_t maxLen, const unsigned char **data) {
+  size_t n = 0;
+  if (r->ptr) {
+    n = (r->len < maxLen) ? r->len : maxLen;
+    *data = r->ptr;
+    r->ptr += n;
+    r->len -= n;
+    return n;
+  }
+  *data = buf;
+  if (r->isString) {
+    while (n<maxLen && r->len && jsvStringIteratorHasChar(&r->itstr)) {
+      size_t l;
+      const char *span = jsvStringIteratorGetSpan(&r->itstr, &l);
+      if (l > maxLen-n) l = maxLen-n;
+      if (l > r->len) l = r->len;
+      memcpy(&buf[n], span, l);
+      n += l;
+      r->len -= l;
+      jsvStringIteratorSkip(&r->itstr, l);
+    }
+  } else if (r->isIterator) {
+    while (n<maxLen && jsvIteratorHasElement(&r->it)) {
+      buf[n++] = (unsigned char)jsvIteratorGetIntegerValue(&r->it);
+      jsvIteratorNext(&r->it);
+    }
+  }
+  return n;
 }
 
-NO_INLINE static int jswrap_atob_decode(int c) {
-  c = c & 0xFF;
-  if (c>='A' && c<='Z') return c-'A';
-  if (c>='a' && c<='z') return 26+c-'a';
-  if (c>='0' && c<='9') return 52+c-'0';
-  if (c=='+') return 62;
-  if (c=='/') return 63;
-  return -1; // not found
+static void jswrap_codec_readerFree(JswCodecReader *r) {
+  if (r->isString) jsvStringIteratorFree(&r->itstr);
+  if (r->isIterator) jsvIteratorFree(&r->it);
+}
+
+/// Writes bytes to a new String, or into an ArrayBuffer - straight into memory where possible
+typedef struct {
+  unsigned char *ptr; ///< if we can write straight to memory, where to write
+  size_t len; ///< bytes left at ptr
+  bool isString, isArrayBuffer;
+  JsvStringIterator itstr; ///< for appending to a String
+  JsvArrayBufferIterator it; ///< for writing elements of an ArrayBuffer
+  size_t written;
+} JswCodecWriter;
+
+/** Write to a new String (if target==0) of length expectedLen (or 0 if not
+ * known), or to target (an ArrayBuffer) starting at element offset. Returns
+ * the String, or 0 */
+static JsVar *jswrap_codec_writerNew(JswCodecWriter *w, JsVar *target, size_t offset, size_t expectedLen) {
+  w->ptr = 0;
+  w->len = 0;
+  w->isString = false;
+  w->isArrayBuffer = false;
+  w->written = 0;
+  if (target) {
+    size_t len = (size_t)jsvGetArrayBufferLength(target);
+    if (offset > len) offset = len;
+    if (JSV_ARRAYBUFFER_GET_SIZE(target->varData.arraybuffer.type)==1)
+      w->ptr = (unsigned char *)jsvGetDataPointer(target, &len);
+    if (w->ptr) {
+      w->ptr += offset;
+      w->len = len - offset;
+    } else {
+      jsvArrayBufferIteratorNew(&w->it, target, offset);
+      w->isArrayBuffer = true;
+    }
+    return 0;
+  }
+  JsVar *str = 0;
+  if (expectedLen > JSV_FLAT_STRING_BREAK_EVEN) {
+    str = jsvNewFlatStringOfLength((unsigned int)expectedLen);
+    if (str) {
+      w->ptr = (unsigned char *)jsvGetFlatStringPointer(str);
+      w->len = expectedLen;
+      return str;
+    }
+  }
+  str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  jsvStringIteratorNew(&w->itstr, str, 0);
+  w->isString = true;
+  return str;
+}
+
+/** If we can write n bytes straight to memory, return a pointer to write
+ * them to (and count them as written). Otherwise return 0 and use jswrap_codec_write */
+static unsigned char *jswrap_codec_writePtr(JswCodecWriter *w, size_t n) {
+  if (!w->ptr || w->len < n) return 0;
+  unsigned char *p = w->ptr;
+  w->ptr += n;
+  w->len -= n;
+  w->written += n;
+  return p;
+}
+
+static void jswrap_codec_write(JswCodecWriter *w, const unsigned char *data, size_t n) {
+  if (w->ptr) {
+    if (n > w->len) n = w->len; // truncate if the ArrayBuffer is full
+    memcpy(w->ptr, data, n);
+    w->ptr += n;
+    w->len -= n;
+    w->written += n;
+  } else if (w->isString) {
+    jsvStringIteratorAppendBuf(&w->itstr, (const char*)data, n);
+    w->written += n;
+  } else if (w->isArrayBuffer) {
+    while (n-- && jsvArrayBufferIteratorHasElement(&w->it)) {
+      jsvArrayBufferIteratorSetIntegerValue(&w->it, *(data++));
+      jsvArrayBufferIteratorNext(&w->it);
+      w->written++;
+    }
+  }
+}
+
+static void jswrap_codec_writerFree(JswCodecWriter *w) {
+  if (w->isString) jsvStringIteratorFree(&w->itstr);
+  if (w->isArrayBuffer) jsvArrayBufferIteratorFree(&w->it);
+}
+
+/// Encode n bytes as base64 (n should be a multiple of 3 except at the end). Returns the number of characters
+static size_t jswrap_base64_encode(const unsigned char *in, size_t n, unsigned char *out) {
+  size_t i, o = 0;
+  for (i=0;i+2<n;i+=3) {
+    uint32_t triple = ((uint32_t)in[i]<<16) | ((uint32_t)in[i+1]<<8) | in[i+2];
+    out[o++] = (unsigned char)jswrap_base64Chars[triple >> 18];
+    out[o++] = (unsigned char)jswrap_base64Chars[(triple >> 12) & 63];
+    out[o++] = (unsigned char)jswrap_base64Chars[(triple >> 6) & 63];
+    out[o++] = (unsigned char)jswrap_base64Chars[triple & 63];
+  }
+  if (i<n) { // 1 or 2 bytes left - pad with '='
+    uint32_t triple = ((uint32_t)in[i]<<16) | ((i+1<n) ? ((uint32_t)in[i+1]<<8) : 0);
+    out[o++] = (unsigned char)jswrap_base64Chars[triple >> 18];
+    out[o++] = (unsigned char)jswrap_base64Chars[(triple >> 12) & 63];
+    out[o++] = (unsigned char)((i+1<n) ? jswrap_base64Chars[(triple >> 6) & 63] : '=');
+    out[o++] = '=';
+  }
+  return o;
+}
+
+static size_t jswrap_hex_encode(const unsigned char *in, size_t n, unsigned char *out) {
+  size_t i;
+  for (i=0;i<n;i++) {
+    *(out++) = (unsigned char)jswrap_hexChars[in[i] >> 4];
+    *(out++) = (unsigned char)jswrap_hexChars[in[i] & 15];
+  }
+  return n*2;
+}
+
+/** Decode base64 or hex characters, skipping any that aren't valid (eg.
+ * whitespace). Partly decoded bytes are kept in *bits and *count for the next
+ * call. Returns the number of bytes written to out. */
+static size_t jswrap_codec_decode(bool hex, const unsigned char *in, size_t n, unsigned char *out, uint32_t *bits, int *count) {
+  size_t i, o = 0;
+  for (i=0;i<n;i++) {
+    unsigned char ch = in[i];
+    if (hex) {
+      int v = chtod((char)ch);
+      if (v<0 || v>15) continue;
+      *bits = (*bits << 4) | (uint32_t)v;
+      if (++*count == 2) {
+        out[o++] = (unsigned char)*bits;
+        *bits = 0;
+        *count = 0;
+      }
+    } else {
+      int v = (ch<128) ? jswrap_base64Values[ch] : -1;
+      if (v<0) continue;
+      *bits = (*bits << 6) | (uint32_t)v;
+      if (++*count == 4) {
+        out[o++] = (unsigned char)(*bits >> 16);
+        out[o++] = (unsigned char)(*bits >> 8);
+        out[o++] = (unsigned char)*bits;
+        *bits = 0;
+        *count = 0;
+      }
+    }
+  }
+  return o;
+}
+
+/** Encode data as base64 or hex, or decode it. The result goes in a new String,
+ * or if target is an ArrayBuffer, into it starting at element offset (and the
+ * number of bytes written is returned) */
+static JsVar *jswrap_codec(JsVar *data, bool hex, bool encode, JsVar *target, JsVarInt offset) {
+  if (!jsvIsIterable(data)) {
+    jsExceptionHere(JSET_ERROR, "Expecting a string or array, got %t", data);
+    return 0;
+  }
+  if (jsvIsUndefined(target)) target = 0;
+  if (target && !jsvIsArrayBuffer(target)) {
+    jsExceptionHere(JSET_ERROR, "Expecting an ArrayBuffer or typed array, got %t", target);
+    return 0;
+  }
+  if (offset<0) offset = 0;
+  // if we know how long the data is, we can make a flat string of the right size
+  size_t expectedLen = 0;
+  if (encode && (jsvIsString(data) || jsvIsArrayBuffer(data))) {
+    size_t l = jsvIsString(data) ? jsvGetStringLength(data) : (size_t)jsvGetArrayBufferLength(data);
+    expectedLen = hex ? l*2 : ((l+2)/3)*4;
+  }
+
+  JswCodecReader r;
+  JswCodecWriter w;
+  JsVar *result = jswrap_codec_writerNew(&w, target, (size_t)offset, expectedLen);
+  if (!target && !result) return 0; // out of memory
+  jswrap_codec_readerNew(&r, data);
+  unsigned char in[64], out[64];
+  const unsigned char *src;
+  size_t n;
+  uint32_t bits = 0;
+  int count = 0;
+  // 48 bytes -> 64 base64 chars, 32 bytes -> 64 hex chars. Decoding writes at most 48
+  size_t chunk = encode ? (hex ? 32 : 48) : 64;
+  while ((n = jswrap_codec_read(&r, in, chunk, &src)) && !jspIsInterrupted()) {
+    if (encode) {
+      size_t outLen = hex ? n*2 : ((n+2)/3)*4;
+      unsigned char *dst = jswrap_codec_writePtr(&w, outLen);
+      if (hex) jswrap_hex_encode(src, n, dst ? dst : out);
+      else jswrap_base64_encode(src, n, dst ? dst : out);
+      if (!dst) jswrap_codec_write(&w, out, outLen);
+    } else {
+      jswrap_codec_write(&w, out, jswrap_codec_decode(hex, src, n, out, &bits, &count));
+    }
+  }
+  if (!encode && !hex && count>1) { // base64 without the final 4 characters
+    out[0] = (unsigned char)(bits >> (count==2 ? 4 : 10));
+    out[1] = (unsigned char)(bits >> 2);
+    jswrap_codec_write(&w, out, (size_t)(count-1));
+  }
+  jswrap_codec_readerFree(&r);
+  jswrap_codec_writerFree(&w);
+  if (target) return jsvNewFromInteger((JsVarInt)w.written);
+  return result;
 }
 
 /*JSON{
@@ -231,47 +497,7 @@ NO_INLINE static int jswrap_atob_decode(int c) {
 Encode the supplied string (or array) into a base64 string
  */
 JsVar *jswrap_btoa(JsVar *binaryData) {
-  if (!jsvIsIterable(binaryData)) {
-    jsExceptionHere(JSET_ERROR, "Expecting a string or array, got %t", binaryData);
-    return 0;
-  }
-  JsVar* base64Data = jsvNewFromEmptyString();
-  if (!base64Data) return 0;
-  JsvIterator itsrc;
-  JsvStringIterator itdst;
-  jsvIteratorNew(&itsrc, binaryData);
-  jsvStringIteratorNew(&itdst, base64Data, 0);
-
-
-  int padding = 0;
-  while (jsvIteratorHasElement(&itsrc) && !jspIsInterrupted()) {
-    int octet_a = (unsigned char)jsvIteratorGetIntegerValue(&itsrc)&255;
-    jsvIteratorNext(&itsrc);
-    int octet_b = 0, octet_c = 0;
-    if (jsvIteratorHasElement(&itsrc)) {
-      octet_b = jsvIteratorGetIntegerValue(&itsrc)&255;
-      jsvIteratorNext(&itsrc);
-      if (jsvIteratorHasElement(&itsrc)) {
-        octet_c = jsvIteratorGetIntegerValue(&itsrc)&255;
-        jsvIteratorNext(&itsrc);
-        padding = 0;
-      } else
-        padding = 1;
-    } else
-      padding = 2;
-
-    int triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
-
-    jsvStringIteratorAppend(&itdst, (char)jswrap_btoa_encode(triple >> 18));
-    jsvStringIteratorAppend(&itdst, (char)jswrap_btoa_encode(triple >> 12));
-    jsvStringIteratorAppend(&itdst, (char)((padding>1)?'=':jswrap_btoa_encode(triple >> 6)));
-    jsvStringIteratorAppend(&itdst, (char)((padding>0)?'=':jswrap_btoa_encode(triple)));
-  }
-
-  jsvIteratorFree(&itsrc);
-  jsvStringIteratorFree(&itdst);
-
-  return base64Data;
+  return jswrap_codec(binaryData, false, true, 0, 0);
 }
 
 /*JSON{
@@ -291,40 +517,93 @@ JsVar *jswrap_atob(JsVar *base64Data) {
     jsExceptionHere(JSET_ERROR, "Expecting a string, got %t", base64Data);
     return 0;
   }
-  JsVar* binaryData = jsvNewFromEmptyString();
-  if (!binaryData) return 0;
-  JsvStringIterator itsrc;
-  JsvStringIterator itdst;
-  jsvStringIteratorNew(&itsrc, base64Data, 0);
-  jsvStringIteratorNew(&itdst, binaryData, 0);
-  // skip whitespace
-  while (jsvStringIteratorHasChar(&itsrc) &&
-      isWhitespace(jsvStringIteratorGetChar(&itsrc)))
-    jsvStringIteratorNext(&itsrc);
-
-  while (jsvStringIteratorHasChar(&itsrc) && !jspIsInterrupted()) {
-    uint32_t triple = 0;
-    int i, valid=0;
-    for (i=0;i<4;i++) {
-      if (jsvStringIteratorHasChar(&itsrc)) {
-        int sextet = jswrap_atob_decode(jsvStringIteratorGetChar(&itsrc));
-        jsvStringIteratorNext(&itsrc);
-        if (sextet>=0) {
-          triple |= (unsigned int)(sextet) << ((3-i)*6);
-          valid=i;
-        }
-      }
-    }
+  return jswrap_codec(base64Data, false, false, 0, 0);
+}
 
-    if (valid>0) jsvStringIteratorAppend(&itdst, (char)(triple >> 16));
-    if (valid>1) jsvStringIteratorAppend(&itdst, (char)(triple >> 8));
-    if (valid>2) jsvStringIteratorAppend(&itdst, (char)(triple));
-  }
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "toBase64",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_E_toBase64",
+  "params" : [
+    ["data","JsVar","A String, ArrayBuffer or array of bytes to encode"],
+    ["target","JsVar","(optional) An ArrayBuffer to write the base64 characters into, instead of returning a String"],
+    ["offset","int","(optional) The index in `target` to start writing at"]
+  ],
+  "return" : ["JsVar","A base64 encoded String, or the number of bytes written into `target`"]
+}
+Encode data as base64. This is the same as `btoa`, but can also write into an
+existing `ArrayBuffer` or typed array (for instance one that is being used to
+build up a packet) without creating a String. If `target` is too small, the
+result is truncated.
+
+Data in Strings and `Uint8Array`s is encoded a block at a time, so this is fast.
+ */
+JsVar *jswrap_E_toBase64(JsVar *data, JsVar *target, JsVarInt offset) {
+  return jswrap_codec(data, false, true, target, offset);
+}
 
-  jsvStringIteratorFree(&itsrc);
-  jsvStringIteratorFree(&itdst);
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "fromBase64",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_E_fromBase64",
+  "params" : [
+    ["data","JsVar","A String (or ArrayBuffer/array of characters) of base64 data"],
+    ["target","JsVar","(optional) An ArrayBuffer to write the decoded bytes into, instead of returning a String"],
+    ["offset","int","(optional) The index in `target` to start writing at"]
+  ],
+  "return" : ["JsVar","A String of the decoded data, or the number of bytes written into `target`"]
+}
+Decode base64 data. This is the same as `atob`, but can also decode straight
+into an existing `ArrayBuffer` or typed array. URL-safe base64 (using `-` and
+`_`) is also accepted, and whitespace is ignored.
+ */
+JsVar *jswrap_E_fromBase64(JsVar *data, JsVar *target, JsVarInt offset) {
+  return jswrap_codec(data, false, false, target, offset);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "toHex",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_E_toHex",
+  "params" : [
+    ["data","JsVar","A String, ArrayBuffer or array of bytes to encode"],
+    ["target","JsVar","(optional) An ArrayBuffer to write the hex characters into, instead of returning a String"],
+    ["offset","int","(optional) The index in `target` to start writing at"]
+  ],
+  "return" : ["JsVar","A String of hexadecimal, or the number of bytes written into `target`"]
+}
+Encode data as a String of lowercase hexadecimal, two characters per byte. For
+example `E.toHex([1,2,255])=="0102ff"`.
+ */
+JsVar *jswrap_E_toHex(JsVar *data, JsVar *target, JsVarInt offset) {
+  return jswrap_codec(data, true, true, target, offset);
+}
 
-  return binaryData;
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "E",
+  "name" : "fromHex",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_E_fromHex",
+  "params" : [
+    ["data","JsVar","A String (or ArrayBuffer/array of characters) of hexadecimal"],
+    ["target","JsVar","(optional) An ArrayBuffer to write the decoded bytes into, instead of returning a String"],
+    ["offset","int","(optional) The index in `target` to start writing at"]
+  ],
+  "return" : ["JsVar","A String of the decoded data, or the number of bytes written into `target`"]
+}
+Decode a String of hexadecimal (upper or lower case) into bytes. Characters
+that aren't hex digits (such as spaces) are ignored, so `E.fromHex("01 02 ff")`
+works.
+ */
+JsVar *jswrap_E_fromHex(JsVar *data, JsVar *target, JsVarInt offset) {
+  return jswrap_codec(data, true, false, target, offset);
 }
 
 /*JSON{
@@ -23,5 +23,9 @@ bool jswrap_isNaN(JsVar *v);
 
 JsVar *jswrap_btoa(JsVar *binaryData);
 JsVar *jswrap_atob(JsVar *base64Data);
+JsVar *jswrap_E_toBase64(JsVar *data, JsVar *target, JsVarInt offset);
+JsVar *jswrap_E_fromBase64(JsVar *data, JsVar *target, JsVarInt offset);
+JsVar *jswrap_E_toHex(JsVar *data, JsVar *target, JsVarInt offset);
+JsVar *jswrap_E_fromHex(JsVar *data, JsVar *target, JsVarInt offset);
 JsVar *jswrap_encodeURIComponent(JsVar *arg);
 JsVar *jswrap_decodeURIComponent(JsVar *arg);
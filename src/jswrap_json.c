@@ -153,6 +153,843 @@ JsVar *jswrap_json_parse(JsVar *v) {
   return res;
 }
 
+#ifndef SAVE_ON_FLASH
+/*JSON{
+  "type" : "class",
+  "class" : "JSONParser",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+An incremental JSON parser, created with `JSON.createParser()`. JSON text can
+be written to it in chunks as it arrives (for instance from a Serial or HTTP
+`data` event) and values are emitted as soon as they are complete, so the
+whole document never has to be in memory as one String.
+
+```
+var parser = JSON.createParser({depth:1});
+parser.on('value', function(value, path) {
+  console.log(path, value); // [0] {a:1}, then [1] {a:2}
+});
+parser.write('[{"a":1},{"a"');
+parser.write(':2}]');
+parser.end();
+```
+ */
+/*JSON{
+  "type" : "event",
+  "class" : "JSONParser",
+  "name" : "value",
+  "params" : [
+    ["value","JsVar","The value that was parsed"],
+    ["path","JsVar","An array of the keys and array indices that lead to `value` in the document"]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Called when a value `depth` levels deep in the document (see
+`JSON.createParser`) has been parsed. This happens straight away, from inside
+`write` or `end` - so `write` can't be called from it.
+ */
+
+#define JSON_PARSER_INFO_NAME JS_HIDDEN_CHAR_STR"inf"
+#define JSON_PARSER_STACK_NAME JS_HIDDEN_CHAR_STR"stk"
+#define JSON_PARSER_PATH_NAME JS_HIDDEN_CHAR_STR"pth"
+#define JSON_PARSER_TOKEN_NAME JS_HIDDEN_CHAR_STR"tok"
+#define JSON_PARSER_BUSY_NAME JS_HIDDEN_CHAR_STR"bsy" // set while we're inside write/end
+#define JSON_PARSER_BUFFER_SIZE 32 // longest number or literal we can parse
+
+typedef enum {
+  JSONP_VALUE,       ///< Expecting a value (or the end of an array)
+  JSONP_KEY,         ///< Expecting an object key (or the end of an object)
+  JSONP_COLON,       ///< Expecting the ':' after a key
+  JSONP_AFTER_VALUE, ///< Expecting ',' or the end of an array/object
+  JSONP_STRING,      ///< Inside a String
+  JSONP_NUMBER,      ///< Inside a number
+  JSONP_LITERAL,     ///< Inside true/false/null
+} JsonParserState;
+
+/// Parser state that's kept between calls to write (as a flat String)
+typedef struct {
+  unsigned char state;   ///< JsonParserState
+  bool isKey;            ///< The String we're in is an object key
+  unsigned char escape;  ///< 1 after a backslash, 2..5 while reading the 4 digits of \uXXXX
+  unsigned char unicode; ///< The \u character so far - like jslex we only keep the bottom 8 bits
+  unsigned char bufLen;
+  char buf[JSON_PARSER_BUFFER_SIZE]; ///< The number or literal so far
+  JsVarInt depth;        ///< Emit values that are this deep in the document
+} JsonParserInfo;
+
+typedef struct {
+  JsVar *parser;
+  JsVar *stack;  ///< The arrays/objects we're inside
+  JsVar *path;   ///< For each item in stack, the current key or array index
+  JsVar *token;  ///< The String we're in
+  char run[64];  ///< Characters for token that haven't been appended yet
+  size_t runLen;
+  JsonParserInfo info;
+} JsonParser;
+
+static bool jsonParserLoad(JsonParser *p, JsVar *parser) {
+  JsVar *busy = jsvObjectGetChild(parser, JSON_PARSER_BUSY_NAME, 0);
+  if (busy) {
+    jsvUnLock(busy);
+    jsExceptionHere(JSET_ERROR, "Can't write to a JSONParser from its own 'value' event");
+    return false;
+  }
+  char buf[sizeof(JsonParserInfo)+1/*trailing zero*/];
+  JsVar *infoVar = jsvObjectGetChild(parser, JSON_PARSER_INFO_NAME, 0);
+  bool ok = infoVar && jsvGetString(infoVar, buf, sizeof(buf))==sizeof(JsonParserInfo);
+  jsvUnLock(infoVar);
+  if (!ok) return false;
+  memcpy(&p->info, buf, sizeof(JsonParserInfo));
+  p->parser = parser;
+  p->stack = jsvObjectGetChild(parser, JSON_PARSER_STACK_NAME, JSV_ARRAY);
+  p->path = jsvObjectGetChild(parser, JSON_PARSER_PATH_NAME, JSV_ARRAY);
+  p->token = jsvObjectGetChild(parser, JSON_PARSER_TOKEN_NAME, 0);
+  p->runLen = 0;
+  if (!p->stack || !p->path) {
+    jsvUnLock3(p->stack, p->path, p->token);
+    return false;
+  }
+  jsvObjectSetChildAndUnLock(parser, JSON_PARSER_BUSY_NAME, jsvNewFromBool(true));
+  return true;
+}
+
+/// Store the parser's state and unlock everything. If reset is set, go back to the start of a document
+static void jsonParserSave(JsonParser *p, bool reset) {
+  if (reset) {
+    p->info.state = JSONP_VALUE;
+    p->info.escape = 0;
+    jsvRemoveNamedChild(p->parser, JSON_PARSER_STACK_NAME);
+    jsvRemoveNamedChild(p->parser, JSON_PARSER_PATH_NAME);
+  }
+  if (p->info.state==JSONP_STRING && p->token)
+    jsvObjectSetChild(p->parser, JSON_PARSER_TOKEN_NAME, p->token);
+  else
+    jsvRemoveNamedChild(p->parser, JSON_PARSER_TOKEN_NAME);
+  JsVar *infoVar = jsvNewStringOfLength(sizeof(JsonParserInfo));
+  if (infoVar) {
+    jsvSetString(infoVar, (char*)&p->info, sizeof(JsonParserInfo));
+    jsvObjectSetChildAndUnLock(p->parser, JSON_PARSER_INFO_NAME, infoVar);
+  }
+  jsvRemoveNamedChild(p->parser, JSON_PARSER_BUSY_NAME);
+  jsvUnLock3(p->stack, p->path, p->token);
+}
+
+/// Add characters in the String we're in to p->token
+static void jsonParserFlushRun(JsonParser *p) {
+  if (p->runLen && p->token)
+    jsvAppendStringBuf(p->token, p->run, p->runLen);
+  p->runLen = 0;
+}
+
+static ALWAYS_INLINE void jsonParserAppend(JsonParser *p, char ch) {
+  if (p->runLen == sizeof(p->run))
+    jsonParserFlushRun(p);
+  p->run[p->runLen++] = ch;
+}
+
+static bool jsonParserUnexpected(char ch) {
+  jsExceptionHere(JSET_SYNTAXERROR, "Unexpected character '%c' in JSON", ch);
+  return false;
+}
+
+/// Is the innermost container we're in an array?
+static bool jsonParserInArray(JsonParser *p) {
+  JsVarInt depth = jsvGetArrayLength(p->stack);
+  if (!depth) return false;
+  JsVar *container = jsvGetArrayItem(p->stack, depth-1);
+  bool isArray = jsvIsArray(container);
+  jsvUnLock(container);
+  return isArray;
+}
+
+/** A value has been parsed - emit it, or add it to the array/object it's in.
+ * Returns false if a 'value' listener threw an exception */
+static bool jsonParserGotValue(JsonParser *p, JsVar *value) {
+  JsVarInt depth = jsvGetArrayLength(p->stack);
+  JsVar *container = depth ? jsvGetArrayItem(p->stack, depth-1) : 0;
+  JsVar *key = depth ? jsvGetArrayItem(p->path, depth-1) : 0;
+  if (depth == p->info.depth) {
+    JsVar *args[2] = { value, jsvCopy(p->path) };
+    jsiExecuteObjectCallbacks(p->parser, JS_EVENT_PREFIX"value", args, 2);
+    jsvUnLock(args[1]);
+  } else if (depth > p->info.depth) {
+    if (jsvIsArray(container)) {
+      jsvArrayPush(container, value);
+    } else if (container) {
+      JsVar *name = jsvAsName(key); // like JSON.parse, we don't check for duplicate keys
+      if (name) {
+        jsvSetValueOfName(name, value);
+        jsvAddName(container, name);
+        jsvUnLock(name);
+      }
+    }
+  } // else we're above the depth we emit at, so everything inside value has already gone
+  if (jsvIsArray(container)) { // move on to the next array index
+    jsvUnLock(jsvArrayPop(p->path));
+    jsvArrayPushAndUnLock(p->path, jsvNewFromInteger(jsvGetInteger(key)+1));
+  }
+  jsvUnLock2(container, key);
+  p->info.state = depth ? JSONP_AFTER_VALUE : JSONP_VALUE;
+  return !jspHasError();
+}
+
+/// Is this a number as JSON defines it - `-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?`
+static bool jsonParserIsNumber(const char *s) {
+  if (*s=='-') s++;
+  if (*s=='0') s++;
+  else if (isNumeric(*s)) while (isNumeric(*s)) s++;
+  else return false;
+  if (*s=='.') {
+    s++;
+    if (!isNumeric(*s)) return false;
+    while (isNumeric(*s)) s++;
+  }
+  if (*s=='e' || *s=='E') {
+    s++;
+    if (*s=='+' || *s=='-') s++;
+    if (!isNumeric(*s)) return false;
+    while (isNumeric(*s)) s++;
+  }
+  return !*s;
+}
+
+/// The end of a number or literal
+static bool jsonParserEndToken(JsonParser *p) {
+  char *s = p->info.buf;
+  s[p->info.bufLen] = 0;
+  JsVar *value = 0;
+  if (p->info.state == JSONP_NUMBER) {
+    bool isFloat = false;
+    size_t i;
+    for (i=0;i<p->info.bufLen;i++)
+      if (s[i]=='.' || s[i]=='e' || s[i]=='E') isFloat = true;
+    if (!jsonParserIsNumber(s)) {
+      // value stays 0, so we report the error below
+    } else if (!isFloat && p->info.bufLen<19) {
+      bool hasError = false;
+      long long v = stringToIntWithRadix(s, 10, &hasError);
+      if (!hasError) value = jsvNewFromLongInteger(v);
+    } else {
+      value = jsvNewFromFloat(stringToFloat(s));
+    }
+  } else {
+    if (!strcmp(s, "true")) value = jsvNewFromBool(true);
+    else if (!strcmp(s, "false")) value = jsvNewFromBool(false);
+    else if (!strcmp(s, "null")) value = jsvNewWithFlags(JSV_NULL);
+  }
+  if (!value) {
+    jsExceptionHere(JSET_SYNTAXERROR, "Invalid value '%s' in JSON", s);
+    return false;
+  }
+  bool ok = jsonParserGotValue(p, value);
+  jsvUnLock(value);
+  return ok;
+}
+
+/// The end of an array or object
+static bool jsonParserEndContainer(JsonParser *p) {
+  JsVar *container = jsvSkipNameAndUnLock(jsvArrayPop(p->stack));
+  jsvUnLock(jsvArrayPop(p->path));
+  bool ok = jsonParserGotValue(p, container);
+  jsvUnLock(container);
+  return ok;
+}
+
+/// The end of a String
+static bool jsonParserEndString(JsonParser *p) {
+  jsonParserFlushRun(p);
+  if (p->info.isKey) {
+    JsVar *key = jsvAsArrayIndexAndUnLock(p->token);
+    jsvUnLock(jsvArrayPop(p->path));
+    jsvArrayPushAndUnLock(p->path, key);
+    p->info.state = JSONP_COLON;
+    p->token = 0;
+    return true;
+  }
+  bool ok = jsonParserGotValue(p, p->token);
+  jsvUnLock(p->token);
+  p->token = 0;
+  return ok;
+}
+
+/// Handle a character after a backslash in a String
+static void jsonParserEscape(JsonParser *p, char ch) {
+  if (p->info.escape > 1) { // \uXXXX
+    p->info.unicode = (unsigned char)((p->info.unicode<<4) | (chtod(ch)&15));
+    if (++p->info.escape <= 5) return;
+    ch = (char)p->info.unicode;
+  } else switch (ch) {
+    case 'b': ch = '\b'; break;
+    case 'f': ch = '\f'; break;
+    case 'n': ch = '\n'; break;
+    case 'r': ch = '\r'; break;
+    case 't': ch = '\t'; break;
+    case 'u':
+      p->info.escape = 2;
+      p->info.unicode = 0;
+      return;
+    default: break; // '"', '\\', '/' and anything else stay as they are
+  }
+  jsonParserAppend(p, ch);
+  p->info.escape = 0;
+}
+
+/// Start a String, number or literal, or handle a character between values
+static bool jsonParserChar(JsonParser *p, char ch) {
+  switch (p->info.state) {
+  case JSONP_VALUE:
+    if (ch=='"') {
+      p->token = jsvNewFromEmptyString();
+      if (!p->token) return false;
+      p->info.state = JSONP_STRING;
+      p->info.isKey = false;
+    } else if (ch=='-' || isNumeric(ch) || isAlpha(ch)) {
+      p->info.state = isAlpha(ch) ? JSONP_LITERAL : JSONP_NUMBER;
+      p->info.buf[0] = ch;
+      p->info.bufLen = 1;
+    } else if (ch=='[' || ch=='{') {
+      JsVar *container = (ch=='[') ? jsvNewEmptyArray() : jsvNewObject();
+      if (!container) return false;
+      jsvArrayPushAndUnLock(p->stack, container);
+      jsvArrayPushAndUnLock(p->path, (ch=='[') ? jsvNewFromInteger(0) : jsvNewFromEmptyString());
+      p->info.state = (ch=='[') ? JSONP_VALUE : JSONP_KEY;
+    } else if (ch==']' && jsonParserInArray(p)) { // we allow trailing commas, like JSON.parse
+      return jsonParserEndContainer(p);
+    } else return jsonParserUnexpected(ch);
+    return true;
+  case JSONP_KEY:
+    if (ch=='"') {
+      p->token = jsvNewFromEmptyString();
+      if (!p->token) return false;
+      p->info.state = JSONP_STRING;
+      p->info.isKey = true;
+    } else if (ch=='}') {
+      return jsonParserEndContainer(p);
+    } else return jsonParserUnexpected(ch);
+    return true;
+  case JSONP_COLON:
+    if (ch!=':') return jsonParserUnexpected(ch);
+    p->info.state = JSONP_VALUE;
+    return true;
+  case JSONP_AFTER_VALUE: {
+    bool inArray = jsonParserInArray(p);
+    if (ch==',') p->info.state = inArray ? JSONP_VALUE : JSONP_KEY;
+    else if (ch==(inArray ? ']' : '}')) return jsonParserEndContainer(p);
+    else return jsonParserUnexpected(ch);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+static void jsonParserWrite(JsonParser *p, JsVar *str) {
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  bool ok = true;
+  while (ok && jsvStringIteratorHasChar(&it)) {
+    char ch = jsvStringIteratorGetChar(&it);
+    bool consumed = true;
+    switch (p->info.state) {
+    case JSONP_STRING:
+      if (p->info.escape) jsonParserEscape(p, ch);
+      else if (ch=='\\') p->info.escape = 1;
+      else if (ch=='"') ok = jsonParserEndString(p);
+      else jsonParserAppend(p, ch);
+      break;
+    case JSONP_NUMBER:
+    case JSONP_LITERAL:
+      if (p->info.state==JSONP_NUMBER ?
+          (isNumeric(ch) || ch=='.' || ch=='e' || ch=='E' || ch=='+' || ch=='-') :
+          isAlpha(ch)) {
+        if (p->info.bufLen < JSON_PARSER_BUFFER_SIZE-1) {
+          p->info.buf[p->info.bufLen++] = ch;
+        } else {
+          jsExceptionHere(JSET_SYNTAXERROR, "Value too long in JSON");
+          ok = false;
+        }
+      } else {
+        ok = jsonParserEndToken(p);
+        consumed = false; // this character starts whatever's next
+      }
+      break;
+    default:
+      if (!isWhitespace(ch))
+        ok = jsonParserChar(p, ch);
+      break;
+    }
+    if (consumed) jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  jsonParserFlushRun(p);
+  jsonParserSave(p, !ok);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "JSON",
+  "name" : "createParser",
+  "generate" : "jswrap_json_createParser",
+  "params" : [
+    ["options","JsVar","[optional] An object containing `{depth:int}` - emit values this many arrays/objects deep in the document (default 0)"]
+  ],
+  "return" : ["JsVar","A `JSONParser`"],
+  "return_object" : "JSONParser",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Create a parser that JSON text can be written to a piece at a time, which
+emits a `value` event for each value it finds.
+
+With the default `depth` of 0, each complete document (several can be written
+one after the other) is emitted. With `depth:1` each item of the outermost
+array or object is emitted as soon as it is parsed and then forgotten, so very
+large arrays can be handled with little memory.
+ */
+JsVar *jswrap_json_createParser(JsVar *options) {
+  JsonParserInfo info;
+  memset(&info, 0, sizeof(info));
+  info.state = JSONP_VALUE;
+  if (jsvIsObject(options)) {
+    info.depth = jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "depth", 0));
+    if (info.depth<0) info.depth = 0;
+  } else if (!jsvIsUndefined(options)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting options to be undefined or an Object, not %t", options);
+    return 0;
+  }
+  JsVar *parser = jspNewObject(0, "JSONParser");
+  JsVar *infoVar = jsvNewStringOfLength(sizeof(JsonParserInfo));
+  if (!parser || !infoVar) {
+    jsvUnLock2(parser, infoVar);
+    return 0;
+  }
+  jsvSetString(infoVar, (char*)&info, sizeof(JsonParserInfo));
+  jsvObjectSetChildAndUnLock(parser, JSON_PARSER_INFO_NAME, infoVar);
+  return parser;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONParser",
+  "name" : "write",
+  "generate" : "jswrap_json_parser_write",
+  "params" : [
+    ["data","JsVar","The next part of the JSON text"]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Parse the next part of the JSON text. If it isn't valid JSON an exception is
+thrown and the parser goes back to waiting for the start of a document.
+ */
+void jswrap_json_parser_write(JsVar *parent, JsVar *data) {
+  JsonParser p;
+  if (!jsonParserLoad(&p, parent)) return;
+  JsVar *str = jsvAsString(data, false);
+  if (str) jsonParserWrite(&p, str);
+  else jsonParserSave(&p, false);
+  jsvUnLock(str);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONParser",
+  "name" : "end",
+  "generate" : "jswrap_json_parser_end",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Tell the parser there's no more JSON text. This emits a number at the very end
+of the text (which can't be known to be complete until now), and throws an
+exception if a document was only partly written.
+ */
+void jswrap_json_parser_end(JsVar *parent) {
+  JsonParser p;
+  if (!jsonParserLoad(&p, parent)) return;
+  bool ok = true;
+  if (p.info.state==JSONP_NUMBER || p.info.state==JSONP_LITERAL)
+    ok = jsonParserEndToken(&p);
+  if (ok && (p.info.state!=JSONP_VALUE || jsvGetArrayLength(p.stack))) {
+    jsExceptionHere(JSET_SYNTAXERROR, "Unexpected end of JSON");
+  }
+  jsonParserSave(&p, true);
+}
+#endif
+
+/// Is this property left out of an object's JSON?
+static bool jsonIsHiddenProperty(JsVar *index, JsVar *item, JSONFlags flags) {
+  return jsvIsInternalObjectKey(index) ||
+      ((flags & JSON_IGNORE_FUNCTIONS) && jsvIsFunction(item)) ||
+      ((flags&JSON_NO_UNDEFINED) && jsvIsUndefined(item));
+}
+
+/** Write the start of the JSON for an ArrayBuffer. If it is all zeros, the
+ * whole thing is written and false is returned */
+static bool jsonArrayBufferStart(JsVar *var, vcbprintf_callback user_callback, void *user_data) {
+  JsvArrayBufferIterator it;
+  bool allZero = true;
+  jsvArrayBufferIteratorNew(&it, var, 0);
+  while (allZero && jsvArrayBufferIteratorHasElement(&it)) {
+    if (jsvArrayBufferIteratorGetFloatValue(&it)!=0)
+      allZero = false;
+    jsvArrayBufferIteratorNext(&it);
+  }
+  jsvArrayBufferIteratorFree(&it);
+  if (allZero) {
+    cbprintf(user_callback, user_data, "new %s(%d)", jswGetBasicObjectName(var), jsvGetArrayBufferLength(var));
+    return false;
+  }
+  cbprintf(user_callback, user_data, "new %s([", jswGetBasicObjectName(var));
+  return true;
+}
+
+/** Write the characters of a string (without quotes) escaped for JSON,
+ * stopping once at least maxChars characters have been output. Returns how
+ * many characters of the string were used */
+static size_t jsonWriteEscapedChars(JsvStringIterator *it, size_t maxChars, vcbprintf_callback user_callback, void *user_data) {
+  char buf[64+1]; // characters that don't need escaping are sent out in batches
+  size_t n = 0, written = 0, count = 0;
+  while (written<maxChars && jsvStringIteratorHasChar(it)) {
+    size_t l, i;
+    const char *span = jsvStringIteratorGetSpan(it, &l);
+    for (i=0;i<l && written<maxChars;i++) {
+      char ch = span[i];
+      bool needsEscape = ch<32 || ch>=127 || ch=='\\' || ch=='"';
+      if ((needsEscape && n) || n==sizeof(buf)-1) {
+        buf[n] = 0;
+        user_callback(buf, user_data);
+        n = 0;
+      }
+      if (needsEscape) {
+        const char *esc = escapeCharacter(ch);
+        user_callback(esc, user_data);
+        written += strlen(esc);
+      } else {
+        buf[n++] = ch;
+        written++;
+      }
+    }
+    jsvStringIteratorSkip(it, i);
+    count += i;
+  }
+  buf[n] = 0;
+  if (n) user_callback(buf, user_data);
+  return count;
+}
+
+#ifndef SAVE_ON_FLASH
+/*JSON{
+  "type" : "class",
+  "class" : "JSONStringifier",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+A readable stream of the JSON for a value, created with
+`JSON.createStringifier`. The JSON is only produced as it is read, so it can be
+piped to a Serial port, Socket or File without the whole JSON string ever being
+in memory:
+
+```
+JSON.createStringifier(bigLog).pipe(socket);
+```
+
+The value shouldn't be modified until the stream has finished.
+ */
+
+#define JSON_STRINGIFIER_STACK_NAME JS_HIDDEN_CHAR_STR"stk"
+#define JSON_STRINGIFIER_POS_NAME JS_HIDDEN_CHAR_STR"pos"
+#define JSON_STRINGIFIER_FLAGS (JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED)
+
+typedef struct {
+  JsVar *stack;      ///< The values we're part way through writing (the array holds a reference to each)
+  JsVar *pos;        ///< For each item in stack, how far through it we are and a reference to the next child (see jsonStringifierStep)
+  JsvStringIterator it; ///< Where we write the output
+  size_t len;        ///< How much we've written
+  size_t maxLen;     ///< How much we've been asked for
+  bool pushed;       ///< Something new was pushed onto stack
+} JsonStringifier;
+
+static void jsonStringifierCallback(const char *str, void *user_data) {
+  JsonStringifier *s = (JsonStringifier*)user_data;
+  s->len += strlen(str);
+  jsvStringIteratorPrintfCallback(str, &s->it);
+}
+
+/** Write a value inside an array or object. Anything big is pushed onto the
+ * stack to be written a piece at a time - in which case return true */
+static bool jsonStringifierValue(JsonStringifier *s, JsVar *var) {
+  bool isBig = jsvIsArray(var) || jsvIsObject(var) || jsvIsArrayBuffer(var) ||
+      (jsvIsString(var) && s->len + jsvGetStringLength(var) > s->maxLen);
+  if (!isBig) {
+    jsfGetJSONWithCallback(var, JSON_STRINGIFIER_FLAGS, jsonStringifierCallback, s);
+    return false;
+  }
+  JsVar *idx = jsvGetArrayIndexOf(s->stack, var, true);
+  if (idx) { // recursive - as jsfGetJSONWithCallback does
+    jsvUnLock(idx);
+    jsonStringifierCallback(" ... ", s);
+    return false;
+  }
+  jsvArrayPush(s->stack, var);
+  s->pushed = true;
+  return true;
+}
+
+/** Push the next child (name) to write onto 'pos'. We hold a reference to
+ * it, so it can't be freed while we're not looking. This is done by hand
+ * because jsvArrayPush would store the value of an integer name rather
+ * than the name itself */
+static void jsonStringifierPushChild(JsVar *pos, JsVar *child) {
+  JsVar *idx = jsvMakeIntoVariableName(jsvNewFromInteger(jsvGetArrayLength(pos)), 0);
+  if (!idx) return;
+  if (child) jsvSetFirstChild(idx, jsvGetRef(jsvRef(child)));
+  jsvAddName(pos, idx);
+  jsvUnLock(idx);
+}
+
+/// Pop the next child pushed with jsonStringifierPushChild (or 0), locked
+static JsVar *jsonStringifierPopChild(JsVar *pos) {
+  JsVar *idx = jsvArrayPop(pos);
+  JsVar *child = 0;
+  if (jsvIsName(idx) && !jsvIsNameWithValue(idx) && jsvGetFirstChild(idx))
+    child = jsvLock(jsvGetFirstChild(idx));
+  jsvUnLock(idx);
+  if (!jsvIsName(child)) {
+    jsvUnLock(child);
+    child = 0;
+  }
+  return child;
+}
+
+/** Is 'child' still one of var's children? The value shouldn't be modified
+ * while it's being written, but if it is we'd rather stop than carry on down
+ * a list it has been removed from */
+static bool jsonStringifierIsChild(JsVar *var, JsVar *child) {
+  JsVarRef ref = jsvGetRef(child);
+  JsVarRef prev = jsvGetPrevSibling(child);
+  if (!prev) return jsvGetFirstChild(var)==ref;
+  JsVar *prevName = jsvLock(prev);
+  bool isChild = jsvGetNextSibling(prevName)==ref;
+  jsvUnLock(prevName);
+  return isChild;
+}
+
+/// Move on to the next child in the list, unlocking the current one
+static JsVar *jsonStringifierNextChild(JsVar *child) {
+  JsVarRef next = jsvGetNextSibling(child);
+  jsvUnLock(child);
+  return next ? jsvLock(next) : 0;
+}
+
+/** Write more of the value at the top of the stack, until we have written
+ * enough or have pushed something else onto the stack. Returns true when it is
+ * finished. 'pos' is 0 when we haven't started, otherwise 1 + how far through.
+ * For arrays and objects, 'child' is the next child (name) to write, so we
+ * never have to search for where we got to */
+static bool jsonStringifierStep(JsonStringifier *s, JsVar *var, JsVarInt *pos, JsVar **child) {
+  bool done = false;
+  if (jsvIsArray(var)) {
+    jsvArrayNormaliseIndices(var); // we compare keys with the index below
+    if (!*pos) {
+      jsonStringifierCallback("[", s);
+      *pos = 1;
+      jsvUnLock(*child);
+      *child = jsvGetFirstChild(var) ? jsvLock(jsvGetFirstChild(var)) : 0;
+    } else if (*child && !jsonStringifierIsChild(var, *child)) {
+      jsvUnLock(*child);
+      *child = 0;
+    }
+    JsVarInt length = jsvGetArrayLength(var);
+    while (s->len < s->maxLen && !jspIsInterrupted()) {
+      JsVarInt i = (*pos)-1;
+      if (i >= length) {
+        jsonStringifierCallback("]", s);
+        done = true;
+        break;
+      }
+      if (i>0) jsonStringifierCallback(",", s);
+      JsVar *item = 0;
+      if (jsvIsInt(*child) && jsvGetInteger(*child)==i) { // otherwise there's a gap in the array
+        item = jsvSkipName(*child);
+        *child = jsonStringifierNextChild(*child);
+      }
+      if (jsvIsUndefined(item)) item = jsvNewWithFlags(JSV_NULL);
+      (*pos)++;
+      bool pushed = jsonStringifierValue(s, item);
+      jsvUnLock(item);
+      if (pushed) break;
+    }
+  } else if (jsvIsObject(var)) {
+    // pos is 1 + (whether we've written any)
+    if (!*pos) {
+      jsonStringifierCallback("{", s);
+      *pos = 1;
+      jsvUnLock(*child);
+      *child = jsvGetFirstChild(var) ? jsvLock(jsvGetFirstChild(var)) : 0;
+    } else if (*child && !jsonStringifierIsChild(var, *child)) {
+      jsvUnLock(*child);
+      *child = 0;
+    }
+    bool hadItem = *pos > 1;
+    while (!jspIsInterrupted()) {
+      if (!*child) {
+        jsonStringifierCallback("}", s);
+        done = true;
+        break;
+      }
+      if (s->len >= s->maxLen) break;
+      JsVar *item = jsvSkipName(*child);
+      bool pushed = false;
+      if (!jsonIsHiddenProperty(*child, item, JSON_STRINGIFIER_FLAGS)) {
+        if (hadItem) jsonStringifierCallback(",", s);
+        hadItem = true;
+        cbprintf(jsonStringifierCallback, s, "%q:", *child);
+        pushed = jsonStringifierValue(s, item);
+      }
+      *child = jsonStringifierNextChild(*child);
+      jsvUnLock(item);
+      if (pushed) break;
+    }
+    *pos = hadItem ? 2 : 1;
+  } else if (jsvIsArrayBuffer(var)) {
+    JsvArrayBufferIterator it;
+    if (!*pos) {
+      if (!jsonArrayBufferStart(var, jsonStringifierCallback, s))
+        return true;
+      *pos = 1;
+    }
+    jsvArrayBufferIteratorNew(&it, var, (size_t)((*pos)-1));
+    while (jsvArrayBufferIteratorHasElement(&it) && s->len < s->maxLen) {
+      if (it.index>0) jsonStringifierCallback(",", s);
+      JsVar *item = jsvArrayBufferIteratorGetValue(&it);
+      jsfGetJSONWithCallback(item, JSON_STRINGIFIER_FLAGS, jsonStringifierCallback, s);
+      jsvUnLock(item);
+      jsvArrayBufferIteratorNext(&it);
+      (*pos)++;
+    }
+    if (!jsvArrayBufferIteratorHasElement(&it)) {
+      jsonStringifierCallback("])", s);
+      done = true;
+    }
+    jsvArrayBufferIteratorFree(&it);
+  } else if (jsvIsString(var)) {
+    if (!*pos) {
+      jsonStringifierCallback("\"", s);
+      *pos = 1;
+    }
+    JsvStringIterator it;
+    jsvStringIteratorNew(&it, var, (size_t)((*pos)-1));
+    if (s->len < s->maxLen)
+      *pos += (JsVarInt)jsonWriteEscapedChars(&it, s->maxLen - s->len, jsonStringifierCallback, s);
+    if (!jsvStringIteratorHasChar(&it)) {
+      jsonStringifierCallback("\"", s);
+      done = true;
+    }
+    jsvStringIteratorFree(&it);
+  } else { // anything else is small
+    jsfGetJSONWithCallback(var, JSON_STRINGIFIER_FLAGS, jsonStringifierCallback, s);
+    done = true;
+  }
+  return done;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "JSON",
+  "name" : "createStringifier",
+  "generate" : "jswrap_json_createStringifier",
+  "params" : [
+    ["data","JsVar","The data to be converted to JSON"]
+  ],
+  "return" : ["JsVar","A `JSONStringifier`"],
+  "return_object" : "JSONStringifier",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Create a stream that the JSON for `data` (as written by `JSON.stringify`) can
+be read from a piece at a time, or piped to another stream. This needs far less
+memory than `JSON.stringify` for big values.
+ */
+JsVar *jswrap_json_createStringifier(JsVar *data) {
+  JsVar *stringifier = jspNewObject(0, "JSONStringifier");
+  JsVar *stack = jsvNewEmptyArray();
+  JsVar *pos = jsvNewEmptyArray();
+  if (!stringifier || !stack || !pos) {
+    jsvUnLock3(stringifier, stack, pos);
+    return 0;
+  }
+  jsvArrayPush(stack, data);
+  jsvArrayPushAndUnLock(pos, jsvNewFromInteger(0));
+  jsonStringifierPushChild(pos, 0);
+  jsvObjectSetChildAndUnLock(stringifier, JSON_STRINGIFIER_STACK_NAME, stack);
+  jsvObjectSetChildAndUnLock(stringifier, JSON_STRINGIFIER_POS_NAME, pos);
+  return stringifier;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONStringifier",
+  "name" : "read",
+  "generate" : "jswrap_json_stringifier_read",
+  "params" : [
+    ["chars","int","The number of characters to read"]
+  ],
+  "return" : ["JsVar","The next part of the JSON, or `undefined` when it has all been read"],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Get the next part of the JSON. This may be a little longer than `chars` if a
+number or other short value doesn't fit.
+ */
+JsVar *jswrap_json_stringifier_read(JsVar *parent, int chars) {
+  JsonStringifier s;
+  s.stack = jsvObjectGetChild(parent, JSON_STRINGIFIER_STACK_NAME, 0);
+  s.pos = jsvObjectGetChild(parent, JSON_STRINGIFIER_POS_NAME, 0);
+  JsVar *result = 0;
+  if (jsvIsArray(s.stack) && jsvIsArray(s.pos) && jsvGetArrayLength(s.stack))
+    result = jsvNewFromEmptyString();
+  if (result) {
+    s.len = 0;
+    s.maxLen = (chars>0) ? (size_t)chars : 1;
+    jsvStringIteratorNew(&s.it, result, 0);
+    while (s.len < s.maxLen && !jspIsInterrupted()) {
+      JsVarInt depth = jsvGetArrayLength(s.stack);
+      if (!depth) break;
+      JsVar *var = jsvGetArrayItem(s.stack, depth-1);
+      // take the position off the stack, so anything pushed goes after it
+      JsVar *child = jsonStringifierPopChild(s.pos);
+      JsVarInt pos = jsvGetIntegerAndUnLock(jsvSkipNameAndUnLock(jsvArrayPop(s.pos)));
+      s.pushed = false;
+      bool done = jsonStringifierStep(&s, var, &pos, &child);
+      jsvUnLock(var);
+      if (done) jsvUnLock(jsvArrayPop(s.stack));
+      else {
+        jsvArrayPushAndUnLock(s.pos, jsvNewFromInteger(pos));
+        jsonStringifierPushChild(s.pos, child);
+      }
+      jsvUnLock(child);
+      if (s.pushed) {
+        jsvArrayPushAndUnLock(s.pos, jsvNewFromInteger(0));
+        jsonStringifierPushChild(s.pos, 0);
+      }
+    }
+    jsvStringIteratorFree(&s.it);
+  }
+  jsvUnLock2(s.stack, s.pos);
+  return result;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "JSONStringifier",
+  "name" : "pipe",
+  "generate" : "jswrap_pipe",
+  "params" : [
+    ["destination","JsVar","The destination file/stream that will receive the JSON."],
+    ["options","JsVar",["An optional object `{ chunkSize : int=32, end : bool=true, complete : function }`","chunkSize : The amount of data to pipe from source to destination at a time","complete : a function to call when the pipe activity is complete","end : call the 'end' function on the destination when the source is finished"]]
+  ],
+  "ifndef" : "SAVE_ON_FLASH"
+}
+Pipe the JSON to a stream (an object with a 'write' method). If the
+destination's `write` returns `false` (as a Socket's does), the next part of
+the JSON isn't produced until it emits `drain`.
+ */
+#endif
+
 /* This is like jsfGetJSONWithCallback, but handles ONLY functions (and does not print the initial 'function' text) */
 void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data) {
   assert(jsvIsFunction(var));
@@ -200,11 +1037,7 @@ void jsfGetEscapedString(JsVar *var, vcbprintf_callback user_callback, void *use
   user_callback("\"",user_data);
   JsvStringIterator it;
   jsvStringIteratorNew(&it, var, 0);
-  while (jsvStringIteratorHasChar(&it)) {
-    char ch = jsvStringIteratorGetChar(&it);
-    user_callback(escapeCharacter(ch), user_data);
-    jsvStringIteratorNext(&it);
-  }
+  jsonWriteEscapedChars(&it, (size_t)-1, user_callback, user_data);
   jsvStringIteratorFree(&it);
   user_callback("\"",user_data);
 }
@@ -264,20 +1097,8 @@ void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user
       if (needNewLine) jsonNewLine(flags, user_callback, user_data);
       cbprintf(user_callback, user_data, (flags&JSON_PRETTY)?" ]":"]");
     } else if (jsvIsArrayBuffer(var)) {
-      JsvArrayBufferIterator it;
-      bool allZero = true;
-      jsvArrayBufferIteratorNew(&it, var, 0);
-      while (jsvArrayBufferIteratorHasElement(&it)) {
-        if (jsvArrayBufferIteratorGetFloatValue(&it)!=0)
-          allZero = false;
-        jsvArrayBufferIteratorNext(&it);
-      }
-      jsvArrayBufferIteratorFree(&it);
-
-      if (allZero) {
-        cbprintf(user_callback, user_data, "new %s(%d)", jswGetBasicObjectName(var), jsvGetArrayBufferLength(var));
-      } else {
-        cbprintf(user_callback, user_data, "new %s([", jswGetBasicObjectName(var));
+      if (jsonArrayBufferStart(var, user_callback, user_data)) {
+        JsvArrayBufferIterator it;
         size_t length = jsvGetArrayBufferLength(var);
         bool limited = (flags&JSON_LIMIT) && (length>JSON_LIMIT_AMOUNT);
         // no newlines needed for array buffers as they only contain simple stuff
@@ -310,10 +1131,7 @@ void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user
         while (jsvObjectIteratorHasValue(&it) && !jspIsInterrupted()) {
           JsVar *index = jsvObjectIteratorGetKey(&it);
           JsVar *item = jsvObjectIteratorGetValue(&it);
-          bool hidden = jsvIsInternalObjectKey(index) ||
-              ((flags & JSON_IGNORE_FUNCTIONS) && jsvIsFunction(item)) ||
-              ((flags&JSON_NO_UNDEFINED) && jsvIsUndefined(item));
-          if (!hidden) {
+          if (!jsonIsHiddenProperty(index, item, flags)) {
             sinceNewLine++;
             if (!first) cbprintf(user_callback, user_data, (flags&JSON_PRETTY)?", ":",");
             bool newNeedsNewLine = (flags&JSON_NEWLINES) && jsonNeedsNewLine(item);
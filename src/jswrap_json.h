@@ -15,6 +15,11 @@
 
 JsVar *jswrap_json_stringify(JsVar *v);
 JsVar *jswrap_json_parse(JsVar *v);
+JsVar *jswrap_json_createParser(JsVar *options);
+void jswrap_json_parser_write(JsVar *parent, JsVar *data);
+void jswrap_json_parser_end(JsVar *parent);
+JsVar *jswrap_json_createStringifier(JsVar *data);
+JsVar *jswrap_json_stringifier_read(JsVar *parent, int chars);
 
 typedef enum {
   JSON_NONE,
@@ -30,6 +35,8 @@ typedef enum {
 
 /* This is like jsfGetJSONWithCallback, but handles ONLY functions (and does not print the initial 'function' text) */
 void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data);
+/* Print a string in quotes, with characters escaped as needed */
+void jsfGetEscapedString(JsVar *var, vcbprintf_callback user_callback, void *user_data);
 /* Dump to JSON, using the given callbacks for printing data */
 void jsfGetJSONWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data);
 
@@ -32,30 +32,15 @@
 This is the built-in class for ES6 Promises
 */
 
-void _jswrap_promise_resolve(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvObjectGetChild(promise, JS_PROMISE_THEN_NAME, 0);
-  jsiExecuteEventCallback(promise, fn, 1, &data);
-  jsvUnLock(fn);
-}
+/* Resolving or rejecting doesn't call the callbacks right away, but queues them as
+ * a microtask - they are then looked up and called as soon as the current
+ * callback has finished, ahead of any timers or IO */
 void _jswrap_promise_queueresolve(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvNewNativeFunction((void (*)(void))_jswrap_promise_resolve, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-  if (!fn) return;
-  jsvObjectSetChild(fn, JSPARSE_FUNCTION_THIS_NAME, promise);
-  jsiQueueEvents(promise, fn, &data, 1);
-  jsvUnLock(fn);
+  jsiQueueMicrotask(promise, JS_PROMISE_THEN_NAME, data);
 }
 
-void _jswrap_promise_reject(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvObjectGetChild(promise, JS_PROMISE_CATCH_NAME, 0);
-  jsiExecuteEventCallback(promise, fn, 1, &data);
-  jsvUnLock(fn);
-}
 void _jswrap_promise_queuereject(JsVar *promise, JsVar *data) {
-  JsVar *fn = jsvNewNativeFunction((void (*)(void))_jswrap_promise_reject, JSWAT_VOID|JSWAT_THIS_ARG|(JSWAT_JSVAR<<JSWAT_BITS));
-  if (!fn) return;
-  jsvObjectSetChild(fn, JSPARSE_FUNCTION_THIS_NAME, promise);
-  jsiQueueEvents(promise, fn, &data, 1);
-  jsvUnLock(fn);
+  jsiQueueMicrotask(promise, JS_PROMISE_CATCH_NAME, data);
 }
 
 void jswrap_promise_all_resolve(JsVar *promise, JsVar *data) {
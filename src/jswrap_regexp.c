@@ -0,0 +1,1227 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * JavaScript methods for Regular Expressions
+ *
+ * Patterns are compiled into a small program for a Pike VM (Thompson NFA
+ * with capture groups). The string is scanned once, running every possible
+ * match in lock-step, so there is no backtracking and matching is linear in
+ * the length of the string.
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_regexp.h"
+#include "jsparse.h"
+#include "jsvariterator.h"
+
+#define JS_REGEX_PROGRAM_NAME JS_HIDDEN_CHAR_STR"rx" // the compiled program in each RegExp
+
+#define RX_MAX_PROGRAM 512 ///< Maximum size of a compiled RegExp in bytes
+#define RX_MAX_GROUPS 16 ///< Maximum number of capture groups (including the whole match)
+#define RX_MAX_DEPTH 16 ///< Maximum nesting of brackets
+#define RX_MAX_LOOPS 16 ///< Maximum nesting of repeats that could match the empty string (bits in a uint16_t)
+
+// The program header
+#define RX_HDR_FLAGS 0
+#define RX_HDR_GROUPS 1 ///< Number of capture groups, including the whole match
+#define RX_HDR_THREADS 2 ///< 16 bit. Max number of threads that can be waiting on a character
+#define RX_HDR_FIRSTCH 4 ///< If RXF_FIRSTCHAR, the character every match starts with
+#define RX_HDR_SIZE 5
+
+typedef enum {
+  RXF_GLOBAL = 1,
+  RXF_IGNORECASE = 2,
+  RXF_MULTILINE = 4,
+  RXF_FIRSTCHAR = 8, ///< every match starts with RX_HDR_FIRSTCH, so we can memchr for it
+} RegexFlags;
+
+typedef enum {
+  RX_CHAR,      ///< c - match a character
+  RX_ANY,       ///< match anything but a newline
+  RX_CLASS,     ///< flags, n, n*(lo,hi) - match a character class (see RegexClassFlags)
+  RX_BOL,       ///< start of the string (or line)
+  RX_EOL,       ///< end of the string (or line)
+  RX_WORDB,     ///< word boundary
+  RX_NWORDB,    ///< not a word boundary
+  RX_SPLIT,     ///< off16 - carry on to the next instruction, and also to pc+off
+  RX_SPLIT_JMP, ///< off16 - go to pc+off, and also carry on to the next instruction
+  RX_JMP,       ///< off16 - go to pc+off
+  RX_SAVE,      ///< n - save the position in capture slot n
+  RX_CLEAR,     ///< lo, hi - clear capture slots lo..hi (at the start of each repeat of a group)
+  RX_LOOP_START,///< n - note that iteration of loop n started at this position
+  RX_LOOP_CLEAR,///< n - forget where loop n started (its first iteration may be empty)
+  RX_LOOP_CHECK,///< n - fail if this iteration of loop n didn't match any characters
+  RX_MATCH,     ///< we have a match!
+} RegexOp;
+
+typedef enum {
+  RXC_NEGATE = 1,
+  RXC_DIGIT = 2,
+  RXC_NDIGIT = 4,
+  RXC_WORD = 8,
+  RXC_NWORD = 16,
+  RXC_SPACE = 32,
+  RXC_NSPACE = 64,
+} RegexClassFlags;
+
+static size_t rxOpLength(const unsigned char *op) {
+  switch (*op) {
+  case RX_CHAR:
+  case RX_SAVE:
+  case RX_LOOP_START:
+  case RX_LOOP_CLEAR:
+  case RX_LOOP_CHECK: return 2;
+  case RX_CLEAR: return 3;
+  case RX_CLASS: return 3 + 2*(size_t)op[2];
+  case RX_SPLIT:
+  case RX_SPLIT_JMP:
+  case RX_JMP: return 3;
+  default: return 1;
+  }
+}
+
+static int rxGetOffset(const unsigned char *op) {
+  return (int16_t)(op[1] | (op[2]<<8));
+}
+
+static bool rxIsDigit(int ch) { return ch>='0' && ch<='9'; }
+static bool rxIsWord(int ch) { return (ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || rxIsDigit(ch) || ch=='_'; }
+static bool rxIsSpace(int ch) { return ch==' ' || (ch>=9 && ch<=13) || ch==0xA0; }
+static bool rxIsNewLine(int ch) { return ch=='\n' || ch=='\r'; }
+static int rxLower(int ch) { return (ch>='A' && ch<='Z') ? ch+'a'-'A' : ch; }
+static int rxUpper(int ch) { return (ch>='a' && ch<='z') ? ch+'A'-'a' : ch; }
+
+static bool rxClassMatchChar(const unsigned char *op, int ch) {
+  int f = op[1];
+  if (((f&RXC_DIGIT) && rxIsDigit(ch)) || ((f&RXC_NDIGIT) && !rxIsDigit(ch)) ||
+      ((f&RXC_WORD) && rxIsWord(ch)) || ((f&RXC_NWORD) && !rxIsWord(ch)) ||
+      ((f&RXC_SPACE) && rxIsSpace(ch)) || ((f&RXC_NSPACE) && !rxIsSpace(ch)))
+    return true;
+  const unsigned char *r = &op[3];
+  int i;
+  for (i=0;i<op[2];i++,r+=2)
+    if (ch>=r[0] && ch<=r[1]) return true;
+  return false;
+}
+
+static bool rxClassMatch(const unsigned char *op, int ch, bool ignoreCase) {
+  bool match = rxClassMatchChar(op, ch) ||
+      (ignoreCase && (rxClassMatchChar(op, rxLower(ch)) || rxClassMatchChar(op, rxUpper(ch))));
+  return match != ((op[1]&RXC_NEGATE)!=0);
+}
+
+// ----------------------------------------------------------------------------------------------
+//                                                                                      Compiler
+// ----------------------------------------------------------------------------------------------
+
+typedef struct {
+  const char *pat; ///< the pattern
+  size_t patLen, pos; ///< its length, and where we are in it
+  bool ignoreCase;
+  int groups; ///< capture groups so far
+  int depth; ///< bracket nesting
+  bool error;
+  size_t len; ///< length of the code so far
+  unsigned char code[RX_MAX_PROGRAM];
+} RegexCompiler;
+
+static void rxError(RegexCompiler *c, const char *msg) {
+  if (!c->error) jsExceptionHere(JSET_SYNTAXERROR, "Invalid RegExp: %s", msg);
+  c->error = true;
+}
+
+static int rxPeek(RegexCompiler *c) {
+  return (c->pos < c->patLen) ? (unsigned char)c->pat[c->pos] : -1;
+}
+
+static int rxGetCh(RegexCompiler *c) {
+  int ch = rxPeek(c);
+  if (ch>=0) c->pos++;
+  return ch;
+}
+
+static void rxInsert(RegexCompiler *c, size_t at, const unsigned char *data, size_t n) {
+  if (c->error) return;
+  if (c->len+n > RX_MAX_PROGRAM) {
+    rxError(c, "too long");
+    return;
+  }
+  memmove(&c->code[at+n], &c->code[at], c->len-at);
+  memcpy(&c->code[at], data, n);
+  c->len += n;
+}
+
+static void rxEmit(RegexCompiler *c, const unsigned char *data, size_t n) {
+  rxInsert(c, c->len, data, n);
+}
+
+static void rxEmitOp(RegexCompiler *c, RegexOp op, int arg) {
+  unsigned char d[2] = { (unsigned char)op, (unsigned char)arg };
+  rxEmit(c, d, (op==RX_CHAR || op==RX_SAVE) ? 2 : 1);
+}
+
+/// Insert a jump instruction. The offset is from 'at' to the target *after* the insertion
+static void rxInsertJump(RegexCompiler *c, size_t at, RegexOp op, int offset) {
+  unsigned char d[3] = { (unsigned char)op, (unsigned char)(offset&255), (unsigned char)((offset>>8)&255) };
+  rxInsert(c, at, d, 3);
+}
+
+/// Can the code between start and end match without using up any characters?
+static bool rxIsNullable(RegexCompiler *c, size_t start, size_t end) {
+  unsigned char reached[RX_MAX_PROGRAM/8];
+  memset(reached, 0, sizeof(reached));
+  reached[start>>3] |= (unsigned char)(1<<(start&7));
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    size_t pc;
+    for (pc=start; pc<end; pc+=rxOpLength(&c->code[pc])) {
+      if (!(reached[pc>>3] & (1<<(pc&7)))) continue;
+      const unsigned char *op = &c->code[pc];
+      if (*op==RX_CHAR || *op==RX_ANY || *op==RX_CLASS) continue;
+      size_t next[2] = { pc+rxOpLength(op), pc };
+      if (*op==RX_SPLIT || *op==RX_SPLIT_JMP || *op==RX_JMP)
+        next[1] = (size_t)((int)pc+rxGetOffset(op));
+      if (*op==RX_JMP) next[0] = next[1];
+      int i;
+      for (i=0;i<2;i++) {
+        if (next[i]==end) return true;
+        if (next[i]>start && next[i]<end && !(reached[next[i]>>3] & (1<<(next[i]&7)))) {
+          reached[next[i]>>3] |= (unsigned char)(1<<(next[i]&7));
+          changed = true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/** Make the code between start and end repeat - kind is '?', '*' or '+'. For
+ * '?', skipping it also skips any code after end (so x{0,3} can be x(x(x)?)?) */
+static void rxRepeat(RegexCompiler *c, size_t start, size_t end, char kind, bool lazy) {
+  if (c->error) return;
+  bool guard = rxIsNullable(c, start, end);
+  /* Every LOOP_CHECK comes after its own LOOP_START or LOOP_CLEAR, and only a
+   * '+' (with LOOP_CLEAR) can leave its loop without moving on a character with
+   * its bit changed. So we only need a different loop number to any '+' inside */
+  int n = 0;
+  size_t pc;
+  for (pc=start; guard && pc<end; pc+=rxOpLength(&c->code[pc])) {
+    if (c->code[pc]==RX_LOOP_CLEAR && c->code[pc+1]>=n)
+      n = c->code[pc+1]+1;
+  }
+  if (n>=RX_MAX_LOOPS) {
+    rxError(c, "too complex");
+    return;
+  }
+  /* Like JS, if the atom could match nothing then an optional iteration that does doesn't count:
+   *   '?': SPLIT out; LOOP_START n; atom; LOOP_CHECK n; ...; out:
+   *   '*': start: SPLIT out; LOOP_START n; atom; LOOP_CHECK n; JMP start; out:
+   *   '+': LOOP_CLEAR n; first: atom; LOOP_CHECK n; LOOP_START n; SPLIT_JMP first */
+  unsigned char check[4] = { RX_LOOP_CHECK, (unsigned char)n, RX_LOOP_START, (unsigned char)n };
+  if (kind=='?') {
+    if (guard) {
+      rxInsert(c, end, check, 2);
+      rxInsert(c, start, &check[2], 2);
+    }
+    rxInsertJump(c, start, lazy?RX_SPLIT_JMP:RX_SPLIT, (int)(c->len+3-start));
+  } else if (guard) {
+    if (kind=='*') {
+      rxInsert(c, end, check, 2);
+      rxInsert(c, start, &check[2], 2);
+      rxInsertJump(c, start, lazy?RX_SPLIT_JMP:RX_SPLIT, (int)(end+10-start));
+      rxInsertJump(c, end+7, RX_JMP, (int)start-(int)(end+7));
+    } else {
+      unsigned char clear[2] = { RX_LOOP_CLEAR, (unsigned char)n };
+      rxInsert(c, end, check, 4);
+      rxInsertJump(c, end+4, lazy?RX_SPLIT:RX_SPLIT_JMP, (int)start-(int)(end+4));
+      rxInsert(c, start, clear, 2);
+    }
+  } else if (kind=='*') {
+    // start: SPLIT out; atom; JMP start; out:
+    rxInsertJump(c, start, lazy?RX_SPLIT_JMP:RX_SPLIT, (int)(end+6-start));
+    rxInsertJump(c, end+3, RX_JMP, (int)start-(int)(end+3));
+  } else { // '+'
+    rxInsertJump(c, end, lazy?RX_SPLIT:RX_SPLIT_JMP, (int)start-(int)end);
+  }
+}
+
+/// Append a copy of some code, and return where it starts
+static size_t rxCopy(RegexCompiler *c, size_t from, size_t n) {
+  size_t at = c->len;
+  if (c->len+n > RX_MAX_PROGRAM) {
+    rxError(c, "too long");
+    return at;
+  }
+  memcpy(&c->code[at], &c->code[from], n);
+  c->len += n;
+  return at;
+}
+
+static int rxHexDigit(int ch) {
+  if (ch>='0' && ch<='9') return ch-'0';
+  if (ch>='a' && ch<='f') return ch+10-'a';
+  if (ch>='A' && ch<='F') return ch+10-'A';
+  return -1;
+}
+
+/** Parse what comes after a '\'. Returns the character, or -1 with classFlags
+ * set for things like \d */
+static int rxEscape(RegexCompiler *c, int *classFlags) {
+  *classFlags = 0;
+  int ch = rxGetCh(c);
+  switch (ch) {
+  case -1: rxError(c, "\\ at end of pattern"); return 0;
+  case 'd': *classFlags = RXC_DIGIT; return -1;
+  case 'D': *classFlags = RXC_NDIGIT; return -1;
+  case 'w': *classFlags = RXC_WORD; return -1;
+  case 'W': *classFlags = RXC_NWORD; return -1;
+  case 's': *classFlags = RXC_SPACE; return -1;
+  case 'S': *classFlags = RXC_NSPACE; return -1;
+  case 'n': return '\n';
+  case 'r': return '\r';
+  case 't': return '\t';
+  case 'v': return '\v';
+  case 'f': return '\f';
+  case '0': return 0;
+  case 'c': return rxGetCh(c)&31;
+  case 'x':
+  case 'u': {
+    // We don't support unicode, so just keep the bottom 8 bits
+    int digits = (ch=='x') ? 2 : 4;
+    int v = 0;
+    while (digits--) {
+      int d = rxHexDigit(rxGetCh(c));
+      if (d<0) {
+        rxError(c, "invalid escape");
+        return 0;
+      }
+      v = (v<<4) | d;
+    }
+    return v&255;
+  }
+  default:
+    if (ch>='1' && ch<='9') {
+      rxError(c, "backreferences not supported");
+      return 0;
+    }
+    return ch;
+  }
+}
+
+static void rxChar(RegexCompiler *c, int ch) {
+  rxEmitOp(c, RX_CHAR, c->ignoreCase ? rxLower(ch) : ch);
+}
+
+/// Parse a character class, after the '['
+static void rxClass(RegexCompiler *c) {
+  size_t start = c->len;
+  unsigned char hdr[3] = { RX_CLASS, 0, 0 };
+  rxEmit(c, hdr, 3);
+  if (rxPeek(c)=='^') {
+    c->pos++;
+    c->code[start+1] |= RXC_NEGATE;
+  }
+  while (!c->error) {
+    int flags;
+    int lo = rxGetCh(c);
+    if (lo<0) {
+      rxError(c, "unterminated character class");
+      return;
+    }
+    if (lo==']') return;
+    if (lo=='\\') {
+      if (rxPeek(c)=='b') { // backspace in a class
+        c->pos++;
+        lo = 8;
+      } else {
+        lo = rxEscape(c, &flags);
+        if (flags) {
+          c->code[start+1] |= (unsigned char)flags;
+          continue;
+        }
+      }
+    }
+    int hi = lo;
+    if (rxPeek(c)=='-' && c->pos+1<c->patLen && c->pat[c->pos+1]!=']') {
+      c->pos++;
+      hi = rxGetCh(c);
+      if (hi=='\\') {
+        hi = rxEscape(c, &flags);
+        if (flags) rxError(c, "invalid class range");
+      }
+      if (hi<lo) rxError(c, "class range out of order");
+    }
+    if (c->code[start+2]==255) rxError(c, "class too big");
+    if (c->error) return;
+    unsigned char r[2] = { (unsigned char)lo, (unsigned char)hi };
+    rxEmit(c, r, 2);
+    c->code[start+2]++;
+  }
+}
+
+static void rxAlternation(RegexCompiler *c);
+
+static void rxAtom(RegexCompiler *c) {
+  int ch = rxGetCh(c);
+  switch (ch) {
+  case '.': rxEmitOp(c, RX_ANY, 0); break;
+  case '^': rxEmitOp(c, RX_BOL, 0); break;
+  case '$': rxEmitOp(c, RX_EOL, 0); break;
+  case '[': rxClass(c); break;
+  case '(': {
+    int group = -1;
+    if (++c->depth > RX_MAX_DEPTH) {
+      rxError(c, "too deeply nested");
+      return;
+    }
+    if (rxPeek(c)=='?') {
+      c->pos++;
+      if (rxGetCh(c)!=':') {
+        rxError(c, "lookahead not supported");
+        return;
+      }
+    } else {
+      group = c->groups++;
+      if (group >= RX_MAX_GROUPS) {
+        rxError(c, "too many groups");
+        return;
+      }
+      rxEmitOp(c, RX_SAVE, group*2);
+    }
+    rxAlternation(c);
+    if (rxGetCh(c)!=')') {
+      rxError(c, "missing )");
+      return;
+    }
+    if (group>=0) rxEmitOp(c, RX_SAVE, group*2+1);
+    c->depth--;
+  } break;
+  case '\\': {
+    if (rxPeek(c)=='b' || rxPeek(c)=='B') {
+      rxEmitOp(c, rxGetCh(c)=='b' ? RX_WORDB : RX_NWORDB, 0);
+      break;
+    }
+    int flags;
+    int e = rxEscape(c, &flags);
+    if (flags) {
+      unsigned char cls[3] = { RX_CLASS, (unsigned char)flags, 0 };
+      rxEmit(c, cls, 3);
+    } else rxChar(c, e);
+  } break;
+  case '*':
+  case '+':
+  case '?':
+    rxError(c, "nothing to repeat");
+    break;
+  default:
+    rxChar(c, ch);
+  }
+}
+
+/// Parse a number for {n,m}, or return -1
+static int rxParseInt(RegexCompiler *c) {
+  int n = -1;
+  while (rxIsDigit(rxPeek(c))) {
+    n = (n<0 ? 0 : n*10) + rxGetCh(c) - '0';
+    if (n > RX_MAX_PROGRAM) n = RX_MAX_PROGRAM; // would be too long anyway
+  }
+  return n;
+}
+
+/// Apply any quantifier to the atom that starts at atomStart
+static void rxQuantifier(RegexCompiler *c, size_t atomStart) {
+  int min, max; // max<0 means no limit
+  int ch = rxPeek(c);
+  if (ch=='*') { min=0; max=-1; }
+  else if (ch=='+') { min=1; max=-1; }
+  else if (ch=='?') { min=0; max=1; }
+  else if (ch=='{') {
+    size_t start = c->pos++;
+    min = rxParseInt(c);
+    max = min;
+    if (min>=0 && rxPeek(c)==',') {
+      c->pos++;
+      max = rxParseInt(c);
+    }
+    if (min<0 || rxPeek(c)!='}') {
+      c->pos = start; // not a quantifier, so '{' is just a character
+      return;
+    }
+    if (max>=0 && max<min) {
+      rxError(c, "numbers out of order in {}");
+      return;
+    }
+  } else return;
+  c->pos++;
+  bool lazy = rxPeek(c)=='?';
+  if (lazy) c->pos++;
+
+  int i;
+  if (max!=1) {
+    // Like JS, groups in the atom start off unmatched each time it's repeated
+    int lo = 255, hi = -1;
+    size_t pc;
+    for (pc=atomStart; pc<c->len; pc+=rxOpLength(&c->code[pc])) {
+      if (c->code[pc]==RX_SAVE) {
+        if (c->code[pc+1]<lo) lo = c->code[pc+1];
+        if (c->code[pc+1]>hi) hi = c->code[pc+1];
+      }
+    }
+    if (hi>=0) {
+      unsigned char clear[3] = { RX_CLEAR, (unsigned char)lo, (unsigned char)hi };
+      rxInsert(c, atomStart, clear, 3);
+    }
+  }
+  size_t atomLen = c->len - atomStart;
+  if (max==0) { // x{0} - remove it
+    c->len = atomStart;
+  } else {
+    // Copies of the atom, with the optional ones nested like x(x(x)?)? so they're tried in the right order
+    int copies = max<0 ? (min ? min : 1) : max;
+    for (i=1;i<copies && !c->error;i++)
+      rxCopy(c, atomStart, atomLen);
+    if (max<0) {
+      rxRepeat(c, atomStart+(size_t)(copies-1)*atomLen, c->len, min ? '+' : '*', lazy);
+    } else {
+      for (i=max-1;i>=min;i--)
+        rxRepeat(c, atomStart+(size_t)i*atomLen, atomStart+(size_t)(i+1)*atomLen, '?', lazy);
+    }
+  }
+}
+
+static void rxSequence(RegexCompiler *c) {
+  while (!c->error) {
+    int ch = rxPeek(c);
+    if (ch<0 || ch=='|' || ch==')') return;
+    size_t atomStart = c->len;
+    rxAtom(c);
+    if (!c->error) rxQuantifier(c, atomStart);
+  }
+}
+
+static void rxAlternation(RegexCompiler *c) {
+  size_t start = c->len;
+  rxSequence(c);
+  /* JMPs to the end of the alternation. Until we know where that is,
+   * each holds the position of the one before (or -1) */
+  int pendingJump = -1;
+  while (!c->error && rxPeek(c)=='|') {
+    c->pos++;
+    // SPLIT to the next alternative (after the JMP we're about to add)
+    rxInsertJump(c, start, RX_SPLIT, (int)(c->len+6-start));
+    rxInsertJump(c, c->len, RX_JMP, pendingJump);
+    pendingJump = (int)c->len-3;
+    start = c->len;
+    rxSequence(c);
+  }
+  while (pendingJump>=0 && !c->error) {
+    int prev = rxGetOffset(&c->code[pendingJump]);
+    int offset = (int)c->len - pendingJump;
+    c->code[pendingJump+1] = (unsigned char)(offset&255);
+    c->code[pendingJump+2] = (unsigned char)((offset>>8)&255);
+    pendingJump = prev;
+  }
+}
+
+/// Compile a pattern into a program (in a flat string if possible). Returns 0 (with an exception) on error
+static JsVar *rxCompile(JsVar *pattern, int flags) {
+  JSV_GET_AS_CHAR_ARRAY(patPtr, patLen, pattern);
+  if (!patPtr && patLen) return 0;
+  RegexCompiler c;
+  c.pat = patPtr;
+  c.patLen = patLen;
+  c.pos = 0;
+  c.ignoreCase = (flags&RXF_IGNORECASE)!=0;
+  c.groups = 1;
+  c.depth = 0;
+  c.error = false;
+  c.len = RX_HDR_SIZE;
+  rxEmitOp(&c, RX_SAVE, 0);
+  rxAlternation(&c);
+  if (c.pos < c.patLen) rxError(&c, "unmatched )");
+  rxEmitOp(&c, RX_SAVE, 1);
+  rxEmitOp(&c, RX_MATCH, 0);
+  if (c.error) return 0;
+  // Work out how many threads we could need - one for each instruction that waits for a character
+  unsigned int threads = 0;
+  size_t pc;
+  for (pc=RX_HDR_SIZE; pc<c.len; pc+=rxOpLength(&c.code[pc])) {
+    unsigned char op = c.code[pc];
+    if (op==RX_CHAR || op==RX_ANY || op==RX_CLASS || op==RX_MATCH)
+      threads++;
+  }
+  // If a match can only start with one character we can skip straight to it
+  c.code[RX_HDR_FIRSTCH] = 0;
+  if (!c.ignoreCase && c.code[RX_HDR_SIZE+2]==RX_CHAR) {
+    flags |= RXF_FIRSTCHAR;
+    c.code[RX_HDR_FIRSTCH] = c.code[RX_HDR_SIZE+3];
+  }
+  c.code[RX_HDR_FLAGS] = (unsigned char)flags;
+  c.code[RX_HDR_GROUPS] = (unsigned char)c.groups;
+  c.code[RX_HDR_THREADS] = (unsigned char)(threads&255);
+  c.code[RX_HDR_THREADS+1] = (unsigned char)(threads>>8);
+
+  JsVar *prog = jsvNewFlatStringOfLength((unsigned int)c.len);
+  if (prog) {
+    memcpy(jsvGetFlatStringPointer(prog), c.code, c.len);
+  } else {
+    prog = jsvNewStringOfLength((unsigned int)c.len);
+    if (prog) jsvSetString(prog, (char*)c.code, c.len);
+  }
+  return prog;
+}
+
+// ----------------------------------------------------------------------------------------------
+//                                                                                       Matcher
+// ----------------------------------------------------------------------------------------------
+
+/** rxAddThread's work list. If pc>=0, follow the program from pc with the given
+ * loops. Otherwise restore caps[-1-pc] to cap (the paths through a SAVE/CLEAR are done) */
+typedef struct {
+  int16_t pc;
+  uint16_t loops;
+  int cap;
+} RegexStep;
+
+typedef struct {
+  const unsigned char *prog;
+  int flags;
+  int nCaps; ///< capture slots (2 per group)
+  uint16_t *marks; ///< for each pc, the generation it was last added to a list in
+  uint16_t *markLoops; ///< for each pc, the loops that had started at this position when it was marked
+  uint16_t gen;
+  int *list; ///< threads - each is pc followed by nCaps capture positions
+  int count; ///< number of threads in list
+  RegexStep *steps; ///< stack for rxAddThread
+  int maxSteps;
+  int pos; ///< current position in the string
+  int prevCh, ch; ///< the characters before and at pos (or -1)
+} RegexVM;
+
+/** Follow all the non-consuming instructions from pc, adding threads for the ones that wait for a character.
+ * Bit n of loops is set if an iteration of loop n started at this position (so an iteration can't be empty).
+ * Paths are followed depth first (so threads are added in priority order) using vm->steps rather than
+ * recursion, as long chains of instructions could otherwise overflow the stack. Returns false if vm->steps
+ * wasn't big enough */
+static bool rxAddThread(RegexVM *vm, int pc, int *caps, uint16_t loops) {
+  int sp = 0;
+  vm->steps[sp].pc = (int16_t)pc;
+  vm->steps[sp++].loops = loops;
+  while (sp) {
+    RegexStep *step = &vm->steps[--sp];
+    pc = step->pc;
+    loops = step->loops;
+    if (pc<0) {
+      caps[-1-pc] = step->cap;
+      continue;
+    }
+    // worst case we push a restore for every capture slot, and the next pc
+    if (sp+vm->nCaps+2 > vm->maxSteps) {
+      jsExceptionHere(JSET_ERROR, "RegExp too complex");
+      return false;
+    }
+    const unsigned char *op = &vm->prog[pc];
+    bool waits = *op==RX_CHAR || *op==RX_ANY || *op==RX_CLASS || *op==RX_MATCH;
+    // A thread that got here first had a higher priority. If it was in the same loops it'll do everything we would
+    if (vm->marks[pc]==vm->gen && (waits || vm->markLoops[pc]==loops)) continue;
+    vm->marks[pc] = vm->gen;
+    vm->markLoops[pc] = loops;
+    int next = -1; // the pc to follow next (steps[sp] is pushed with it)
+    switch (*op) {
+    case RX_JMP:
+      next = pc+rxGetOffset(op);
+      break;
+    case RX_SPLIT: // the first path to follow is pushed last
+      vm->steps[sp].pc = (int16_t)(pc+rxGetOffset(op));
+      vm->steps[sp++].loops = loops;
+      next = pc+3;
+      break;
+    case RX_SPLIT_JMP:
+      vm->steps[sp].pc = (int16_t)(pc+3);
+      vm->steps[sp++].loops = loops;
+      next = pc+rxGetOffset(op);
+      break;
+    case RX_SAVE:
+      vm->steps[sp].pc = (int16_t)(-1-op[1]);
+      vm->steps[sp++].cap = caps[op[1]];
+      caps[op[1]] = vm->pos;
+      next = pc+2;
+      break;
+    case RX_CLEAR: {
+      int i;
+      for (i=op[1];i<=op[2];i++) {
+        vm->steps[sp].pc = (int16_t)(-1-i);
+        vm->steps[sp++].cap = caps[i];
+        caps[i] = -1;
+      }
+      next = pc+3;
+    } break;
+    case RX_LOOP_START:
+      loops = (uint16_t)(loops | (1<<op[1]));
+      next = pc+2;
+      break;
+    case RX_LOOP_CLEAR:
+      loops = (uint16_t)(loops & ~(1<<op[1]));
+      next = pc+2;
+      break;
+    case RX_LOOP_CHECK:
+      if (!(loops & (1<<op[1])))
+        next = pc+2;
+      break;
+    case RX_BOL:
+      if (vm->prevCh<0 || ((vm->flags&RXF_MULTILINE) && rxIsNewLine(vm->prevCh)))
+        next = pc+1;
+      break;
+    case RX_EOL:
+      if (vm->ch<0 || ((vm->flags&RXF_MULTILINE) && rxIsNewLine(vm->ch)))
+        next = pc+1;
+      break;
+    case RX_WORDB:
+    case RX_NWORDB:
+      if ((rxIsWord(vm->prevCh)!=rxIsWord(vm->ch)) == (*op==RX_WORDB))
+        next = pc+1;
+      break;
+    default: {
+      int *t = &vm->list[vm->count++ * (1+vm->nCaps)];
+      t[0] = pc;
+      memcpy(&t[1], caps, sizeof(int)*(size_t)vm->nCaps);
+    }
+    }
+    if (next>=0) {
+      vm->steps[sp].pc = (int16_t)next;
+      vm->steps[sp++].loops = loops;
+    }
+  }
+  return true;
+}
+
+/** Run a compiled program on str, looking for the first match at or after
+ * startIdx. Returns true and fills in caps (2 per group, -1 if the group
+ * wasn't matched) if there was one. */
+static bool rxExec(JsVar *progVar, JsVar *str, size_t startIdx, int *caps) {
+  JSV_GET_AS_CHAR_ARRAY(progPtr, progLen, progVar);
+  if (!progPtr || startIdx > jsvGetStringLength(str)) return false;
+  RegexVM vm;
+  vm.prog = (const unsigned char*)progPtr;
+  vm.flags = vm.prog[RX_HDR_FLAGS];
+  vm.nCaps = 2*vm.prog[RX_HDR_GROUPS];
+  bool ignoreCase = (vm.flags&RXF_IGNORECASE)!=0;
+  size_t threads = (size_t)(vm.prog[RX_HDR_THREADS] | (vm.prog[RX_HDR_THREADS+1]<<8));
+  size_t entry = (size_t)(1+vm.nCaps);
+  size_t listSize = threads*entry*sizeof(int);
+  /* Room for every instruction to be waiting on rxAddThread's stack once, plus
+   * the capture slots it has to put back - it throws if that isn't enough */
+  int maxSteps = (int)progLen + vm.nCaps + 2;
+  if (2*listSize + 2*progLen*sizeof(uint16_t) + (size_t)maxSteps*sizeof(RegexStep) + 256 > jsuGetFreeStack()) {
+    jsExceptionHere(JSET_ERROR, "Not enough stack memory to run RegExp");
+    return false;
+  }
+  int *clist = (int*)alloca(listSize); // threads for this character
+  int *nlist = (int*)alloca(listSize); // threads that matched it, and are waiting for the next
+  vm.marks = (uint16_t*)alloca(progLen*sizeof(uint16_t));
+  memset(vm.marks, 0, progLen*sizeof(uint16_t));
+  vm.markLoops = (uint16_t*)alloca(progLen*sizeof(uint16_t));
+  vm.steps = (RegexStep*)alloca((size_t)maxSteps*sizeof(RegexStep));
+  vm.maxSteps = maxSteps;
+  vm.gen = 0;
+  int initCaps[RX_MAX_GROUPS*2];
+  int i;
+  for (i=0;i<vm.nCaps;i++) initCaps[i] = -1;
+
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, startIdx);
+  vm.pos = (int)startIdx;
+  vm.prevCh = startIdx ? (unsigned char)jsvGetCharInString(str, startIdx-1) : -1;
+  int nCount = 0;
+  bool matched = false;
+  while (true) {
+    vm.ch = jsvStringIteratorHasChar(&it) ? (unsigned char)jsvStringIteratorGetChar(&it) : -1;
+    if (!nCount && !matched && (vm.flags&RXF_FIRSTCHAR) && vm.ch!=vm.prog[RX_HDR_FIRSTCH]) {
+      // Nothing in progress - skip a block at a time to where a match could start
+      char first = (char)vm.prog[RX_HDR_FIRSTCH];
+      while (jsvStringIteratorHasChar(&it)) {
+        size_t n;
+        const char *span = jsvStringIteratorGetSpan(&it, &n);
+        const char *p = (const char*)memchr(span, first, n);
+        jsvStringIteratorSkip(&it, p ? (size_t)(p-span) : n);
+        if (p) break;
+      }
+      if (!jsvStringIteratorHasChar(&it)) break;
+      vm.pos = (int)jsvStringIteratorGetIndex(&it);
+      vm.ch = (unsigned char)first;
+    }
+    // Follow on from the threads that matched the last character (in priority order), then try starting a match here
+    if (++vm.gen == 0) {
+      memset(vm.marks, 0, progLen*sizeof(uint16_t));
+      vm.gen = 1;
+    }
+    vm.list = clist;
+    vm.count = 0;
+    bool added = true;
+    for (i=0;i<nCount && added;i++)
+      added = rxAddThread(&vm, nlist[(size_t)i*entry], &nlist[(size_t)i*entry+1], 0);
+    if (added && !matched)
+      added = rxAddThread(&vm, RX_HDR_SIZE, initCaps, 0);
+    if (!added) {
+      matched = false;
+      break;
+    }
+    // Now see which threads match this character
+    nCount = 0;
+    for (i=0;i<vm.count;i++) {
+      int *t = &clist[(size_t)i*entry];
+      const unsigned char *op = &vm.prog[t[0]];
+      bool ok = false;
+      switch (*op) {
+      case RX_MATCH:
+        matched = true;
+        memcpy(caps, &t[1], sizeof(int)*(size_t)vm.nCaps);
+        i = vm.count; // lower priority threads are dropped
+        continue;
+      case RX_CHAR: ok = vm.ch==op[1] || (ignoreCase && vm.ch>=0 && rxLower(vm.ch)==op[1]); break;
+      case RX_ANY: ok = vm.ch>=0 && !rxIsNewLine(vm.ch); break;
+      case RX_CLASS: ok = vm.ch>=0 && rxClassMatch(op, vm.ch, ignoreCase); break;
+      }
+      if (ok) {
+        int *nt = &nlist[(size_t)nCount++*entry];
+        nt[0] = t[0] + (int)rxOpLength(op);
+        memcpy(&nt[1], &t[1], sizeof(int)*(size_t)vm.nCaps);
+      }
+    }
+    if (vm.ch<0 || (matched && !nCount)) break;
+    vm.prevCh = vm.ch;
+    vm.pos++;
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  return matched;
+}
+
+// ----------------------------------------------------------------------------------------------
+//                                                                                    JavaScript
+// ----------------------------------------------------------------------------------------------
+
+static JsVar *rxGetProgram(JsVar *regex) {
+  return jsvIsObject(regex) ? jsvObjectGetChild(regex, JS_REGEX_PROGRAM_NAME, 0) : 0;
+}
+
+/// Get the program for a RegExp, throwing an exception if it isn't one
+static JsVar *rxGetProgramOrError(JsVar *regex) {
+  JsVar *prog = rxGetProgram(regex);
+  if (!prog) jsExceptionHere(JSET_TYPEERROR, "Expecting a RegExp, got %t", regex);
+  return prog;
+}
+
+static int rxGetHeader(JsVar *prog, size_t idx) {
+  return (unsigned char)jsvGetCharInString(prog, idx);
+}
+
+/// Copy n characters from src to the end of dst, moving src on
+static void rxCopyChars(JsvStringIterator *dst, JsvStringIterator *src, size_t n) {
+  while (n && jsvStringIteratorHasChar(src)) {
+    size_t l;
+    const char *span = jsvStringIteratorGetSpan(src, &l);
+    if (l > n) l = n;
+    jsvStringIteratorAppendBuf(dst, span, l);
+    jsvStringIteratorSkip(src, l);
+    n -= l;
+  }
+}
+
+/// Append n characters of str from start to the end of dst
+static void rxAppendSubstring(JsvStringIterator *dst, JsVar *str, size_t start, size_t n) {
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, start);
+  rxCopyChars(dst, &it, n);
+  jsvStringIteratorFree(&it);
+}
+
+/// Get capture group n as a string, or 0 if it wasn't matched
+static JsVar *rxGetGroup(JsVar *str, int *caps, int n) {
+  if (caps[n*2]<0 || caps[n*2+1]<0) return 0;
+  return jsvNewFromStringVar(str, (size_t)caps[n*2], (size_t)(caps[n*2+1]-caps[n*2]));
+}
+
+/// Set lastIndex on a RegExp
+static void rxSetLastIndex(JsVar *regex, int idx) {
+  jsvObjectSetChildAndUnLock(regex, "lastIndex", jsvNewFromInteger(idx));
+}
+
+/// Where the next match after this one should be searched from (so we don't get stuck on empty matches)
+static size_t rxNextIndex(int *caps) {
+  return (size_t)(caps[1]>caps[0] ? caps[1] : caps[1]+1);
+}
+
+/// Escape any '/' or newline in a pattern, so that `/${source}/` is a valid RegExp literal
+static JsVar *rxEscapeSource(JsVar *pattern) {
+  JsVar *source = jsvNewFromEmptyString();
+  if (!source) return 0;
+  JsvStringIterator it, dst;
+  jsvStringIteratorNew(&it, pattern, 0);
+  jsvStringIteratorNew(&dst, source, 0);
+  bool escaped = false, inClass = false;
+  while (jsvStringIteratorHasChar(&it)) {
+    char ch = jsvStringIteratorGetChar(&it);
+    if (ch=='\n' || ch=='\r') {
+      jsvStringIteratorAppend(&dst, '\\');
+      ch = (ch=='\n') ? 'n' : 'r';
+    } else if (!escaped && !inClass && ch=='/') {
+      jsvStringIteratorAppend(&dst, '\\');
+    }
+    jsvStringIteratorAppend(&dst, ch);
+    if (!escaped) {
+      if (ch=='[') inClass = true;
+      else if (ch==']') inClass = false;
+    }
+    escaped = !escaped && ch=='\\';
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  jsvStringIteratorFree(&dst);
+  return source;
+}
+
+/*JSON{
+  "type" : "class",
+  "class" : "RegExp",
+  "ifndef" : "SAVE_ON_FLASH"
+}
+The built-in class for handling Regular Expressions
+
+Patterns are compiled once into a small program which is matched without
+backtracking, so matching takes time proportional to the length of the
+string. Supported are `.` `^` `$` `|` `(...)` `(?:...)` `[...]` `[^...]`
+`\d \D \w \W \s \S \b \B`, and `* + ? {n} {n,} {n,m}` (and their lazy
+versions like `*?`), with the flags `g`, `i` and `m`.
+
+Backreferences and lookahead are not supported.
+*/
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "RegExp",
+  "name" : "RegExp",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_regexp_constructor",
+  "params" : [
+    ["regex","JsVar","A regular expression as a string"],
+    ["flags","JsVar","Flags for the regular expression as a string"]
+  ],
+  "return" : ["JsVar","A RegExp object"],
+  "return_object" : "RegExp"
+}
+Creates a RegExp object, for instance `new RegExp("ab+c","i")`. You can
+also use a literal, like `/ab+c/i`.
+ */
+JsVar *jswrap_regexp_constructor(JsVar *str, JsVar *flags) {
+  JsVar *source, *flagStr;
+  if (jswrap_regexp_isRegExp(str)) {
+    source = jsvObjectGetChild(str, "source", 0);
+    flagStr = jsvIsUndefined(flags) ? jsvObjectGetChild(str, "flags", 0) : jsvAsString(flags, false);
+  } else {
+    source = jsvIsUndefined(str) ? jsvNewFromString("(?:)") : jsvAsString(str, false);
+    flagStr = jsvIsUndefined(flags) ? jsvNewFromEmptyString() : jsvAsString(flags, false);
+  }
+  if (!source || !flagStr) {
+    jsvUnLock2(source, flagStr);
+    return 0;
+  }
+  int f = 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, flagStr, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    char ch = jsvStringIteratorGetChar(&it);
+    if (ch=='g') f |= RXF_GLOBAL;
+    else if (ch=='i') f |= RXF_IGNORECASE;
+    else if (ch=='m') f |= RXF_MULTILINE;
+    else {
+      jsExceptionHere(JSET_SYNTAXERROR, "Invalid RegExp flag %q", flagStr);
+      f = -1;
+      break;
+    }
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+
+  JsVar *regex = 0;
+  JsVar *prog = (f>=0) ? rxCompile(source, f) : 0;
+  if (prog) regex = jspNewObject(0, "RegExp");
+  if (regex) {
+    jsvObjectSetChild(regex, JS_REGEX_PROGRAM_NAME, prog);
+    jsvObjectSetChildAndUnLock(regex, "source", rxEscapeSource(source));
+    jsvObjectSetChild(regex, "flags", flagStr);
+    rxSetLastIndex(regex, 0);
+  }
+  jsvUnLock3(prog, source, flagStr);
+  return regex;
+}
+
+bool jswrap_regexp_isRegExp(JsVar *regex) {
+  JsVar *prog = rxGetProgram(regex);
+  jsvUnLock(prog);
+  return prog!=0;
+}
+
+/** Exec a RegExp, using and updating lastIndex if it's global. Returns the
+ * number of groups if there was a match, or 0 */
+static int rxExecLastIndex(JsVar *regex, JsVar *str, int *caps) {
+  JsVar *prog = rxGetProgramOrError(regex);
+  if (!prog) return 0;
+  int groups = 0;
+  bool global = (rxGetHeader(prog, RX_HDR_FLAGS)&RXF_GLOBAL)!=0;
+  JsVarInt startIdx = global ? jsvGetIntegerAndUnLock(jsvObjectGetChild(regex, "lastIndex", 0)) : 0;
+  if (startIdx>=0 && rxExec(prog, str, (size_t)startIdx, caps))
+    groups = rxGetHeader(prog, RX_HDR_GROUPS);
+  if (global) rxSetLastIndex(regex, groups ? caps[1] : 0);
+  jsvUnLock(prog);
+  return groups;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RegExp",
+  "name" : "exec",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_regexp_exec",
+  "params" : [
+    ["str","JsVar","A string to match on"]
+  ],
+  "return" : ["JsVar","A result array, or null"]
+}
+Match this regular expression against a string. Returns `null` if there is no
+match, or an array of the matched text followed by any capture groups, with
+`index` (where the match starts) and `input` properties.
+
+If the RegExp has the `g` flag, matching starts from `lastIndex`, which is
+then set to the end of the match (or 0 if there wasn't one).
+
+```
+/(\d+),(\d+)/.exec("pos 12,34") == ["12,34", "12", "34"] // index = 4
+```
+ */
+JsVar *jswrap_regexp_exec(JsVar *parent, JsVar *str) {
+  str = jsvAsString(str, false);
+  if (!str) return 0;
+  int caps[RX_MAX_GROUPS*2];
+  int groups = rxExecLastIndex(parent, str, caps);
+  JsVar *arr = groups ? jsvNewEmptyArray() : jsvNewWithFlags(JSV_NULL);
+  if (groups && arr) {
+    int i;
+    for (i=0;i<groups;i++)
+      jsvArrayPushAndUnLock(arr, rxGetGroup(str, caps, i));
+    jsvObjectSetChildAndUnLock(arr, "index", jsvNewFromInteger(caps[0]));
+    jsvObjectSetChild(arr, "input", str);
+  }
+  jsvUnLock(str);
+  return arr;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RegExp",
+  "name" : "test",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_regexp_test",
+  "params" : [
+    ["str","JsVar","A string to match on"]
+  ],
+  "return" : ["bool","true if the regular expression matches the string"]
+}
+Test this regular expression against a string - returns `true` if there is a match
+ */
+bool jswrap_regexp_test(JsVar *parent, JsVar *str) {
+  str = jsvAsString(str, false);
+  if (!str) return false;
+  int caps[RX_MAX_GROUPS*2];
+  bool match = rxExecLastIndex(parent, str, caps)!=0;
+  jsvUnLock(str);
+  return match;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "RegExp",
+  "name" : "toString",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_regexp_toString",
+  "return" : ["JsVar","A String"]
+}
+Return the regular expression as a string, like `/ab+c/i`
+ */
+JsVar *jswrap_regexp_toString(JsVar *parent) {
+  JsVar *source = jsvObjectGetChild(parent, "source", 0);
+  JsVar *flags = jsvObjectGetChild(parent, "flags", 0);
+  JsVar *str = jsvVarPrintf("/%v/%v", source, flags);
+  jsvUnLock2(source, flags);
+  return str;
+}
+
+JsVar *jswrap_regexp_match(JsVar *regex, JsVar *str) {
+  JsVar *prog = rxGetProgramOrError(regex);
+  if (!prog) return 0;
+  if (!(rxGetHeader(prog, RX_HDR_FLAGS)&RXF_GLOBAL)) {
+    jsvUnLock(prog);
+    return jswrap_regexp_exec(regex, str);
+  }
+  // global - return an array of every match
+  str = jsvAsString(str, false);
+  JsVar *arr = 0;
+  int caps[RX_MAX_GROUPS*2];
+  size_t idx = 0;
+  while (str && !jspIsInterrupted() && rxExec(prog, str, idx, caps)) {
+    if (!arr) arr = jsvNewEmptyArray();
+    if (!arr) break;
+    jsvArrayPushAndUnLock(arr, rxGetGroup(str, caps, 0));
+    idx = rxNextIndex(caps);
+  }
+  rxSetLastIndex(regex, 0);
+  jsvUnLock2(prog, str);
+  return arr ? arr : jsvNewWithFlags(JSV_NULL);
+}
+
+/// Append a replacement string to dst, expanding $&, $1, etc
+static void rxExpandReplacement(JsvStringIterator *dst, JsVar *replacement, JsVar *str, int *caps, int groups) {
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, replacement, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    char ch = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+    if (ch=='$') {
+      char next = jsvStringIteratorGetChar(&it);
+      int group = -1;
+      if (next=='&') {
+        group = 0;
+      } else if (next>='1' && next<='9' && next-'0'<groups) {
+        group = next-'0';
+        // two digit group numbers
+        JsvStringIterator n = jsvStringIteratorClone(&it);
+        jsvStringIteratorNext(&n);
+        char d = jsvStringIteratorGetChar(&n);
+        if (d>='0' && d<='9' && group*10+d-'0'<groups) {
+          group = group*10+d-'0';
+          jsvStringIteratorNext(&it);
+        }
+        jsvStringIteratorFree(&n);
+      } else if (next=='`') {
+        rxAppendSubstring(dst, str, 0, (size_t)caps[0]);
+        jsvStringIteratorNext(&it);
+        continue;
+      } else if (next=='\'') {
+        rxAppendSubstring(dst, str, (size_t)caps[1], JSVAPPENDSTRINGVAR_MAXLENGTH);
+        jsvStringIteratorNext(&it);
+        continue;
+      } else if (next=='$') {
+        jsvStringIteratorNext(&it);
+      }
+      if (group>=0) {
+        jsvStringIteratorNext(&it);
+        if (caps[group*2]>=0 && caps[group*2+1]>=0)
+          rxAppendSubstring(dst, str, (size_t)caps[group*2], (size_t)(caps[group*2+1]-caps[group*2]));
+        continue;
+      }
+    }
+    jsvStringIteratorAppend(dst, ch);
+  }
+  jsvStringIteratorFree(&it);
+}
+
+JsVar *jswrap_regexp_replace(JsVar *regex, JsVar *str, JsVar *replacement) {
+  JsVar *prog = rxGetProgramOrError(regex);
+  if (!prog) return 0;
+  bool global = (rxGetHeader(prog, RX_HDR_FLAGS)&RXF_GLOBAL)!=0;
+  int groups = rxGetHeader(prog, RX_HDR_GROUPS);
+  str = jsvAsString(str, false);
+  bool isFunction = jsvIsFunction(replacement);
+  replacement = isFunction ? jsvLockAgain(replacement) : jsvAsString(replacement, false);
+  JsVar *result = jsvNewFromEmptyString();
+  if (!str || !replacement || !result) {
+    jsvUnLock2(prog, str);
+    jsvUnLock2(replacement, result);
+    return 0;
+  }
+  bool replacementIsPlain = !isFunction && jsvGetStringIndexOf(replacement, '$')<0;
+  JsvStringIterator dst, src;
+  jsvStringIteratorNew(&dst, result, 0);
+  jsvStringIteratorNew(&src, str, 0); // follows behind, copying out the parts that weren't matched
+  size_t srcIdx = 0;
+  size_t idx = 0;
+  int caps[RX_MAX_GROUPS*2];
+  while (!jspIsInterrupted() && rxExec(prog, str, idx, caps)) {
+    rxCopyChars(&dst, &src, (size_t)caps[0]-srcIdx);
+    jsvStringIteratorSkip(&src, (size_t)(caps[1]-caps[0]));
+    srcIdx = (size_t)caps[1];
+    if (isFunction) {
+      // replacement(match, p1, p2, ..., offset, string)
+      JsVar *args[RX_MAX_GROUPS+2];
+      int i, argCount = 0;
+      for (i=0;i<groups;i++)
+        args[argCount++] = rxGetGroup(str, caps, i);
+      args[argCount++] = jsvNewFromInteger(caps[0]);
+      args[argCount++] = jsvLockAgain(str);
+      JsVar *r = jsvAsString(jspExecuteFunction(replacement, 0, argCount, args), true);
+      jsvUnLockMany((unsigned int)argCount, args);
+      if (r) rxAppendSubstring(&dst, r, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
+      jsvUnLock(r);
+    } else if (replacementIsPlain) {
+      rxAppendSubstring(&dst, replacement, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
+    } else {
+      rxExpandReplacement(&dst, replacement, str, caps, groups);
+    }
+    if (!global) break;
+    idx = rxNextIndex(caps);
+  }
+  // finally copy the rest of the string
+  rxCopyChars(&dst, &src, JSVAPPENDSTRINGVAR_MAXLENGTH);
+  jsvStringIteratorFree(&src);
+  jsvStringIteratorFree(&dst);
+  if (global) rxSetLastIndex(regex, 0);
+  jsvUnLock3(prog, str, replacement);
+  return result;
+}
+
+JsVar *jswrap_regexp_split(JsVar *regex, JsVar *str) {
+  JsVar *prog = rxGetProgramOrError(regex);
+  if (!prog) return 0;
+  int groups = rxGetHeader(prog, RX_HDR_GROUPS);
+  str = jsvAsString(str, false);
+  JsVar *arr = jsvNewEmptyArray();
+  if (!str || !arr) {
+    jsvUnLock3(prog, str, arr);
+    return 0;
+  }
+  int caps[RX_MAX_GROUPS*2];
+  size_t len = jsvGetStringLength(str);
+  if (!len) {
+    // an empty string gives [""], unless the RegExp matches it
+    if (!rxExec(prog, str, 0, caps))
+      jsvArrayPushAndUnLock(arr, jsvNewFromEmptyString());
+    jsvUnLock2(prog, str);
+    return arr;
+  }
+  size_t p = 0; // the end of the last separator
+  size_t q = 0; // where we search from
+  while (q<len && !jspIsInterrupted()) {
+    if (!rxExec(prog, str, q, caps) || (size_t)caps[0]>=len) break;
+    if ((size_t)caps[1]==p) { // empty match right after the last one - move on
+      q = (size_t)caps[0]+1;
+      continue;
+    }
+    jsvArrayPushAndUnLock(arr, jsvNewFromStringVar(str, p, (size_t)caps[0]-p));
+    int i;
+    for (i=1;i<groups;i++)
+      jsvArrayPushAndUnLock(arr, rxGetGroup(str, caps, i));
+    p = q = (size_t)caps[1];
+  }
+  jsvArrayPushAndUnLock(arr, jsvNewFromStringVar(str, p, JSVAPPENDSTRINGVAR_MAXLENGTH));
+  jsvUnLock2(prog, str);
+  return arr;
+}
@@ -0,0 +1,28 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * JavaScript methods for Regular Expressions
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_regexp_constructor(JsVar *str, JsVar *flags);
+JsVar *jswrap_regexp_exec(JsVar *parent, JsVar *str);
+bool jswrap_regexp_test(JsVar *parent, JsVar *str);
+JsVar *jswrap_regexp_toString(JsVar *parent);
+
+/// Is this a RegExp object (created with jswrap_regexp_constructor)?
+bool jswrap_regexp_isRegExp(JsVar *regex);
+/// String.match with a RegExp
+JsVar *jswrap_regexp_match(JsVar *regex, JsVar *str);
+/// String.replace with a RegExp. replacement may be a String or a Function
+JsVar *jswrap_regexp_replace(JsVar *regex, JsVar *str, JsVar *replacement);
+/// String.split with a RegExp
+JsVar *jswrap_regexp_split(JsVar *regex, JsVar *str);
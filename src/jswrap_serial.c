@@ -14,9 +14,16 @@
  * ----------------------------------------------------------------------------
  */
 #include "jswrap_serial.h"
+#include "jswrap_stream.h"
 #include "jsdevices.h"
 #include "jsinteractive.h"
 
+#define SERIAL_FRAME_BUFFER_NAME JS_HIDDEN_CHAR_STR"fbuf" // the line/frame received so far, when framing
+#define SERIAL_FRAME_STATE_NAME JS_HIDDEN_CHAR_STR"fst" // characters of the line terminator received, or the length of the frame+1
+#define SERIAL_MAX_LINE_TERMINATOR 8
+#define SERIAL_MAX_LINE_LENGTH 1024 // lines longer than this are discarded
+#define SERIAL_LINE_DISCARDING 0x100 // set in SERIAL_FRAME_STATE_NAME while skipping the rest of a line that was too long
+
 /*JSON{
   "type" : "class",
   "class" : "Serial"
@@ -62,6 +69,38 @@ passed to the `data` handler.
  */
 // this is created in jsiIdle based on EV_SERIALx_STATUS ecents
 
+/*JSON{
+  "type" : "event",
+  "class" : "Serial",
+  "name" : "line",
+  "params" : [
+    ["line","JsVar","A complete line of received data, without the line terminator"]
+  ]
+}
+If `Serial.setup` was called with the `line` option, the `line` event is called
+with each complete line of data that is received. Lines are assembled natively,
+so this is much faster than joining up `data` events and searching for newlines
+in JavaScript:
+
+```
+Serial1.setup(9600, {line:"\r\n"});
+Serial1.on('line', function(l) { print(JSON.stringify(l)); });
+```
+
+Lines longer than 1024 characters are discarded.
+ */
+/*JSON{
+  "type" : "event",
+  "class" : "Serial",
+  "name" : "frame",
+  "params" : [
+    ["frame","JsVar","A String containing one complete frame of received data"]
+  ]
+}
+If `Serial.setup` was called with the `frameLength` or `framePrefix` option, the
+`frame` event is called with each complete frame of data that is received.
+ */
+
 /*JSON{
   "type" : "staticmethod",
   "class" : "Serial",
@@ -183,12 +222,20 @@ Unless `force` is set to true, changes in the connection state of the board
   "generate" : "jswrap_serial_setup",
   "params" : [
     ["baudrate","JsVar","The baud rate - the default is 9600"],
-    ["options","JsVar",["An optional structure containing extra information on initialising the serial port.","```{rx:pin,tx:pin,bytesize:8,parity:null/'none'/'o'/'odd'/'e'/'even',stopbits:1,flow:null/undefined/'none'/'xon'}```","You can find out which pins to use by looking at [your board's reference page](#boards) and searching for pins with the `UART`/`USART` markers.","Note that even after changing the RX and TX pins, if you have called setup before then the previous RX and TX pins will still be connected to the Serial port as well - until you set them to something else using digitalWrite"]]
+    ["options","JsVar",["An optional structure containing extra information on initialising the serial port.","```{rx:pin,tx:pin,bytesize:8,parity:null/'none'/'o'/'odd'/'e'/'even',stopbits:1,flow:null/undefined/'none'/'xon',line:undefined/'\\n'/'\\r\\n',frameLength:undefined/int,framePrefix:undefined/1/2}```","`line`, `frameLength` and `framePrefix` assemble received data into `line` or `frame` events - see below","You can find out which pins to use by looking at [your board's reference page](#boards) and searching for pins with the `UART`/`USART` markers.","Note that even after changing the RX and TX pins, if you have called setup before then the previous RX and TX pins will still be connected to the Serial port as well - until you set them to something else using digitalWrite"]]
   ]
 }
 Setup this Serial port with the given baud rate and options.
 
 If not specified in options, the default pins are used (usually the lowest numbered pins on the lowest port that supports this peripheral)
+
+Received data can also be split into messages before it reaches JavaScript. Only one of these can be used:
+
+* `line` - a String (eg. `"\n"` or `"\r\n"`). Each complete line is sent to the `line` event. Lines longer than 1024 characters are discarded
+* `frameLength` - every `frameLength` bytes are sent to the `frame` event
+* `framePrefix` - each frame starts with its length as a 1 or 2 byte (little endian) integer. The rest of the frame is sent to the `frame` event
+
+`data` events are still called if there is a handler for them, but data isn't buffered for `Serial.read`.
  */
 void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
   IOEventFlags device = jsiGetDeviceFromClass(parent);
@@ -204,6 +251,8 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
 
   JsVar *parity = 0;
   JsVar *flow = 0;
+  JsVar *line = 0;
+  JsVarInt frameLength = 0, framePrefix = 0;
   jsvConfigObject configs[] = {
       {"rx", JSV_PIN, &inf.pinRX},
       {"tx", JSV_PIN, &inf.pinTX},
@@ -212,6 +261,12 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
       {"stopbits", JSV_INTEGER, &inf.stopbits},
       {"parity", JSV_OBJECT /* a variable */, &parity},
       {"flow", JSV_OBJECT /* a variable */, &flow},
+      {"line", JSV_OBJECT /* a variable */, &line},
+      {"frameLength", JSV_INTEGER, &frameLength},
+      {"framePrefix", JSV_INTEGER, &framePrefix},
+#ifdef LINUX
+      {"path", 0, 0}, // handled below
+#endif
   };
 
 
@@ -252,6 +307,21 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
       }
     }
 
+    if (ok) {
+      int framings = (line?1:0) + (frameLength?1:0) + (framePrefix?1:0);
+      size_t lineLen = jsvIsString(line) ? jsvGetStringLength(line) : 0;
+      if (framings>1) {
+        jsExceptionHere(JSET_ERROR, "Only one of line, frameLength and framePrefix can be used");
+        ok = false;
+      } else if (line && (lineLen<1 || lineLen>SERIAL_MAX_LINE_TERMINATOR)) {
+        jsExceptionHere(JSET_ERROR, "Invalid line terminator %q", line);
+        ok = false;
+      } else if (frameLength<0 || frameLength>0xFFFF || framePrefix<0 || framePrefix>2) {
+        jsExceptionHere(JSET_ERROR, "Invalid frameLength or framePrefix");
+        ok = false;
+      }
+    }
+
 #ifdef LINUX
     if (ok && jsvIsObject(options))
       jsvObjectSetChildAndUnLock(parent, "path", jsvObjectGetChild(options, "path", 0));
@@ -259,12 +329,17 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
   }
   jsvUnLock(parity);
   jsvUnLock(flow);
+  jsvUnLock(line);
   if (!ok) {
     jsvUnLock(options);
     return;
   }
+  // forget any partly received line/frame
+  jsvRemoveNamedChild(parent, SERIAL_FRAME_BUFFER_NAME);
+  jsvRemoveNamedChild(parent, SERIAL_FRAME_STATE_NAME);
 
-  jshUSARTSetup(device, &inf);
+  if (device!=EV_LOOPBACKA && device!=EV_LOOPBACKB) // no hardware to set up
+    jshUSARTSetup(device, &inf);
   // Set baud rate in object, so we can initialise it on startup
   jsvObjectSetChildAndUnLock(parent, USART_BAUDRATE_NAME, jsvNewFromInteger(inf.baudRate));
   // Do the same for options
@@ -275,22 +350,207 @@ void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options) {
 }
 
 
+/// A line/frame being assembled by jswrap_serial_pushFramedData
+typedef struct {
+  JsVar *parent;
+  JsVar *buf; ///< the line/frame so far
+  JsvStringIterator it; ///< for appending to buf
+  size_t len; ///< the length of buf
+} SerialFrame;
+
+static void _jswrap_serial_frame_new(SerialFrame *f, JsVar *buf) {
+  f->buf = buf ? buf : jsvNewFromEmptyString();
+  f->len = f->buf ? jsvGetStringLength(f->buf) : 0;
+  if (f->buf) {
+    jsvStringIteratorNew(&f->it, f->buf, 0);
+    jsvStringIteratorGotoEnd(&f->it);
+  }
+}
+
+static void _jswrap_serial_frame_free(SerialFrame *f) {
+  if (!f->buf) return;
+  jsvStringIteratorFree(&f->it);
+  jsvUnLock(f->buf);
+  f->buf = 0;
+}
+
+static void _jswrap_serial_frame_append(SerialFrame *f, const char *data, size_t len) {
+  if (!f->buf) return;
+  jsvStringIteratorAppendBuf(&f->it, data, len);
+  f->len += len;
+}
+
+/// Emit the line/frame so far (or just throw it away if eventName==0), and start a new one
+static void _jswrap_serial_frame_emit(SerialFrame *f, const char *eventName) {
+  JsVar *buf = jsvLockAgainSafe(f->buf);
+  _jswrap_serial_frame_free(f);
+  if (buf && eventName)
+    jsiExecuteObjectCallbacks(f->parent, eventName, &buf, 1);
+  jsvUnLock(buf);
+  _jswrap_serial_frame_new(f, 0);
+}
+
+/** After 'matched' characters of the line terminator and then 'ch' (which
+ * didn't match), how many characters at the end are still the start of a
+ * terminator? */
+static size_t _jswrap_serial_line_fallback(const char *term, size_t matched, char ch) {
+  size_t k, j;
+  for (k=matched;k>0;k--) {
+    // does term[0..matched-1]+ch end with term[0..k-1]?
+    for (j=0;j<k;j++) {
+      size_t idx = matched+1-k+j;
+      if ((idx<matched ? term[idx] : ch) != term[j]) break;
+    }
+    if (j==k) return k;
+  }
+  return 0;
+}
+
+/** If the Serial port was set up with the 'line', 'frameLength' or
+ * 'framePrefix' option, add the data to the line/frame being received and
+ * emit each complete one. Returns false if there's no framing, so the data
+ * should be handled as normal */
+bool jswrap_serial_pushFramedData(JsVar *parent, JsVar *options, JsVar *data) {
+  if (!jsvIsObject(options)) return false;
+  JsVar *line = jsvObjectGetChild(options, "line", 0);
+  size_t frameLength = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "frameLength", 0));
+  size_t framePrefix = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(options, "framePrefix", 0));
+  char term[SERIAL_MAX_LINE_TERMINATOR+1];
+  size_t termLen = jsvIsString(line) ? jsvGetString(line, term, sizeof(term)) : 0;
+  jsvUnLock(line);
+  if (!termLen && !frameLength && !framePrefix) return false;
+
+  // still send 'data' events if anyone wants them (but don't buffer it up for read())
+  JsVar *callback = jsvFindChildFromString(parent, STREAM_CALLBACK_NAME, false);
+  if (callback) {
+    jsvUnLock(callback);
+    jswrap_stream_pushData(parent, data, true);
+  }
+
+  SerialFrame f;
+  f.parent = parent;
+  _jswrap_serial_frame_new(&f, jsvObjectGetChild(parent, SERIAL_FRAME_BUFFER_NAME, 0));
+  size_t state = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChild(parent, SERIAL_FRAME_STATE_NAME, 0));
+  bool discarding = termLen && (state & SERIAL_LINE_DISCARDING);
+  if (termLen) state &= ~(size_t)SERIAL_LINE_DISCARDING;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, data, 0);
+  while (f.buf && jsvStringIteratorHasChar(&it)) {
+    size_t n, i = 0;
+    const char *span = jsvStringIteratorGetSpan(&it, &n);
+    while (f.buf && i<n) {
+      if (termLen) {
+        /* 'state' is how many characters of the terminator we've seen. They're
+         * not added to the line until we know they're not a terminator. */
+        if (!state) {
+          // copy everything up to a possible terminator in one go
+          const char *p = (const char*)memchr(&span[i], term[0], n-i);
+          size_t run = p ? (size_t)(p-&span[i]) : n-i;
+          if (!discarding) _jswrap_serial_frame_append(&f, &span[i], run);
+          i += run;
+        }
+        if (i<n) {
+          char ch = span[i++];
+          if (ch==term[state]) {
+            if (++state == termLen) {
+              // if we were discarding, this is the end of the line that was too long
+              _jswrap_serial_frame_emit(&f, discarding ? 0 : JS_EVENT_PREFIX"line");
+              discarding = false;
+              state = 0;
+            }
+          } else {
+            size_t k = _jswrap_serial_line_fallback(term, state, ch);
+            size_t drop = state+1-k; // characters that can't be part of a terminator now
+            if (!discarding) {
+              _jswrap_serial_frame_append(&f, term, drop<state ? drop : state);
+              if (drop>state) _jswrap_serial_frame_append(&f, &ch, 1);
+            }
+            state = k;
+          }
+        }
+        if (!discarding && f.len > SERIAL_MAX_LINE_LENGTH) {
+          // throw away what we have, and everything else up to the next terminator
+          jsErrorFlags |= JSERR_BUFFER_FULL;
+          _jswrap_serial_frame_emit(&f, 0);
+          discarding = true;
+        }
+      } else if (frameLength) {
+        size_t c = frameLength - f.len;
+        if (c > n-i) c = n-i;
+        _jswrap_serial_frame_append(&f, &span[i], c);
+        i += c;
+        if (f.len == frameLength)
+          _jswrap_serial_frame_emit(&f, JS_EVENT_PREFIX"frame");
+      } else { // framePrefix
+        /* 'state' is 0 while we're reading the length, or the frame length+1 */
+        if (!state) {
+          _jswrap_serial_frame_append(&f, &span[i++], 1);
+          if (f.len == framePrefix) {
+            state = 1 + (unsigned char)jsvGetCharInString(f.buf, 0);
+            if (framePrefix>1) state += (size_t)((unsigned char)jsvGetCharInString(f.buf, 1))<<8;
+            _jswrap_serial_frame_emit(&f, 0);
+          }
+        } else {
+          size_t c = state-1 - f.len;
+          if (c > n-i) c = n-i;
+          _jswrap_serial_frame_append(&f, &span[i], c);
+          i += c;
+        }
+        if (state && f.len == state-1) { // also handles empty frames
+          _jswrap_serial_frame_emit(&f, JS_EVENT_PREFIX"frame");
+          state = 0;
+        }
+      }
+    }
+    jsvStringIteratorSkip(&it, n);
+  }
+  jsvStringIteratorFree(&it);
+  // Store what we have so far for next time
+  if (f.buf && f.len)
+    jsvObjectSetChild(parent, SERIAL_FRAME_BUFFER_NAME, f.buf);
+  else
+    jsvRemoveNamedChild(parent, SERIAL_FRAME_BUFFER_NAME);
+  if (discarding) state |= SERIAL_LINE_DISCARDING;
+  if (state)
+    jsvObjectSetChildAndUnLock(parent, SERIAL_FRAME_STATE_NAME, jsvNewFromInteger((JsVarInt)state));
+  else
+    jsvRemoveNamedChild(parent, SERIAL_FRAME_STATE_NAME);
+  _jswrap_serial_frame_free(&f);
+  return true;
+}
+
+/// Characters waiting to be sent with jshTransmitMultiple by _jswrap_serial_print
+typedef struct {
+  IOEventFlags device;
+  unsigned int len;
+  unsigned char data[32];
+} SerialPrintBuffer;
+
+static void _jswrap_serial_print_flush(SerialPrintBuffer *buf) {
+  jshTransmitMultiple(buf->device, buf->data, buf->len);
+  buf->len = 0;
+}
 static void _jswrap_serial_print_cb(int data, void *userData) {
-  IOEventFlags device = *(IOEventFlags*)userData;
-  jshTransmit(device, (unsigned char)data);
+  SerialPrintBuffer *buf = (SerialPrintBuffer*)userData;
+  buf->data[buf->len++] = (unsigned char)data;
+  if (buf->len >= sizeof(buf->data))
+    _jswrap_serial_print_flush(buf);
 }
 void _jswrap_serial_print(JsVar *parent, JsVar *arg, bool isPrint, bool newLine) {
   NOT_USED(parent);
-  IOEventFlags device = jsiGetDeviceFromClass(parent);
-  if (!DEVICE_IS_USART(device)) return;
+  SerialPrintBuffer buf;
+  buf.device = jsiGetDeviceFromClass(parent);
+  buf.len = 0;
+  if (!DEVICE_IS_USART(buf.device)) return;
 
   if (isPrint) arg = jsvAsString(arg, false);
-  jsvIterateCallback(arg, _jswrap_serial_print_cb, (void*)&device);
+  jsvIterateCallback(arg, _jswrap_serial_print_cb, (void*)&buf);
   if (isPrint) jsvUnLock(arg);
   if (newLine) {
-    _jswrap_serial_print_cb((unsigned char)'\r', (void*)&device);
-    _jswrap_serial_print_cb((unsigned char)'\n', (void*)&device);
+    _jswrap_serial_print_cb((unsigned char)'\r', (void*)&buf);
+    _jswrap_serial_print_cb((unsigned char)'\n', (void*)&buf);
   }
+  _jswrap_serial_print_flush(&buf);
 }
 
 /*JSON{
@@ -15,6 +15,7 @@
 
 
 void jswrap_serial_setup(JsVar *parent, JsVar *baud, JsVar *options);
+bool jswrap_serial_pushFramedData(JsVar *parent, JsVar *options, JsVar *data);
 void jswrap_serial_print(JsVar *parent, JsVar *str);
 void jswrap_serial_println(JsVar *parent, JsVar *str);
 void jswrap_serial_write(JsVar *parent, JsVar *data);
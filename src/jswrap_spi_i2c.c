@@ -221,26 +221,35 @@ JsVar *jswrap_spi_send(
   // Handle the data being a string
   else if (jsvIsString(srcdata)) {
     dst = jsvNewFromEmptyString();
-    JsvStringIterator it;
-    jsvStringIteratorNew(&it, srcdata, 0);
-    int incount = 0, outcount = 0;
-    while (jsvStringIteratorHasChar(&it) && !jspIsInterrupted()) {
-      unsigned char in = (unsigned char)jsvStringIteratorGetChar(&it);
-      incount++;
-      int out = data.spiSend(in, &data.spiSendData);
-      if (out>=0) {
+    if (dst) {
+      JsvStringIterator it, dstit;
+      jsvStringIteratorNew(&it, srcdata, 0);
+      jsvStringIteratorNew(&dstit, dst, 0);
+      jsvStringIteratorGotoEnd(&dstit);
+      int incount = 0, outcount = 0;
+      char outbuf[32];
+      // send straight out of each block of the string, appending what comes back in chunks
+      while (jsvStringIteratorHasChar(&it) && !jspIsInterrupted()) {
+        size_t n, i, outn = 0;
+        const char *span = jsvStringIteratorGetSpan(&it, &n);
+        if (n > sizeof(outbuf)) n = sizeof(outbuf);
+        for (i=0;i<n;i++) {
+          int out = data.spiSend((unsigned char)span[i], &data.spiSendData);
+          if (out>=0) outbuf[outn++] = (char)out;
+        }
+        incount += (int)n;
+        outcount += (int)outn;
+        jsvStringIteratorAppendBuf(&dstit, outbuf, outn);
+        jsvStringIteratorSkip(&it, n);
+      }
+      jsvStringIteratorFree(&it);
+      // finally add the remaining bytes  (no send!)
+      while (outcount < incount && !jspIsInterrupted()) {
         outcount++;
-        char outc = (char)out;
-        jsvAppendStringBuf(dst, (char*)&outc, 1);
+        char out = (char)data.spiSend(-1, &data.spiSendData);
+        jsvStringIteratorAppend(&dstit, out);
       }
-      jsvStringIteratorNext(&it);
-    }
-    jsvStringIteratorFree(&it);
-    // finally add the remaining bytes  (no send!)
-    while (outcount < incount && !jspIsInterrupted()) {
-      outcount++;
-      unsigned char out = (unsigned char)data.spiSend(-1, &data.spiSendData);
-      jsvAppendStringBuf(dst, (char*)&out, 1);
+      jsvStringIteratorFree(&dstit);
     }
   }
   // Handle the data being an iterable.
@@ -14,7 +14,9 @@
  * ----------------------------------------------------------------------------
  */
 #include "jswrap_string.h"
+#include "jswrap_regexp.h"
 #include "jsvariterator.h"
+#include "jsparse.h"
 
 /*JSON{
   "type" : "class",
@@ -158,45 +160,16 @@ Return the last index of substring in this string, or -1 if not found
  */
 int jswrap_string_indexOf(JsVar *parent, JsVar *substring, JsVar *fromIndex, bool lastIndexOf) {
   if (!jsvIsString(parent)) return 0;
-  // slow, but simple!
   substring = jsvAsString(substring, false);
   if (!substring) return 0; // out of memory
-  int parentLength = (int)jsvGetStringLength(parent);
-  int subStringLength = (int)jsvGetStringLength(substring);
-  if (subStringLength > parentLength) {
-    jsvUnLock(substring);
-    return -1;
-  }
-  int lastPossibleSearch = parentLength - subStringLength;
-  int idx, dir, end;
-  if (!lastIndexOf) { // normal indexOf
-    dir = 1;
-    end = lastPossibleSearch+1;
-    idx = 0;
-    if (jsvIsNumeric(fromIndex)) {
-      idx = (int)jsvGetInteger(fromIndex);
-      if (idx<0) idx=0;
-      if (idx>end) idx=end;
-    }
-  } else {
-    dir = -1;
-    end = -1;
-    idx = lastPossibleSearch;
-    if (jsvIsNumeric(fromIndex)) {
-      idx = (int)jsvGetInteger(fromIndex);
-      if (idx<0) idx=0;
-      if (idx>lastPossibleSearch) idx=lastPossibleSearch;
-    }
-  }
-
-  for (;idx!=end;idx+=dir) {
-    if (jsvCompareString(parent, substring, (size_t)idx, 0, true)==0) {
-      jsvUnLock(substring);
-      return idx;
-    }
+  JsVarInt idx = lastIndexOf ? (JsVarInt)jsvGetStringLength(parent) : 0;
+  if (jsvIsNumeric(fromIndex)) {
+    idx = jsvGetInteger(fromIndex);
+    if (idx<0) idx=0;
   }
+  int result = jsvGetStringIndexOfString(parent, substring, (size_t)idx, lastIndexOf);
   jsvUnLock(substring);
-  return -1;
+  return result;
 }
 
 /*JSON{
@@ -205,31 +178,76 @@ int jswrap_string_indexOf(JsVar *parent, JsVar *substring, JsVar *fromIndex, boo
   "name" : "replace",
   "generate" : "jswrap_string_replace",
   "params" : [
-    ["subStr","JsVar","The string to search for"],
-    ["newSubStr","JsVar","The string to replace it with"]
+    ["subStr","JsVar","The string (or RegExp) to search for"],
+    ["newSubStr","JsVar","The string to replace it with, or a function that returns it"]
   ],
   "return" : ["JsVar","This string with `subStr` replaced"]
 }
-Search and replace ONE occurrance of `subStr` with `newSubStr` and return the result. This doesn't alter the original string. Regular expressions not supported.
+Search and replace ONE occurrance of `subStr` with `newSubStr` and return the result. This doesn't alter the original string.
+
+If `subStr` is a RegExp, every match is replaced when it has the `g` flag,
+and `newSubStr` can contain `$&` (the match), `$1`..`$99` (capture groups),
+`` $` `` and `$'` (the text before and after the match), and `$$`.
+
+If `newSubStr` is a function, it is called with the matched text (followed by
+any capture groups), the index of the match and the whole string, and its
+return value is used as the replacement.
  */
 JsVar *jswrap_string_replace(JsVar *parent, JsVar *subStr, JsVar *newSubStr) {
+#ifndef SAVE_ON_FLASH
+  if (jswrap_regexp_isRegExp(subStr))
+    return jswrap_regexp_replace(subStr, parent, newSubStr);
+#endif
   JsVar *str = jsvAsString(parent, false);
   subStr = jsvAsString(subStr, false);
-  newSubStr = jsvAsString(newSubStr, false);
-
   int idx = jswrap_string_indexOf(parent, subStr, 0, false);
   if (idx>=0) {
+    if (jsvIsFunction(newSubStr)) {
+      JsVar *args[3] = { jsvLockAgain(subStr), jsvNewFromInteger(idx), jsvLockAgain(str) };
+      newSubStr = jsvAsString(jspExecuteFunction(newSubStr, 0, 3, args), true);
+      jsvUnLockMany(3, args);
+    } else
+      newSubStr = jsvAsString(newSubStr, false);
     JsVar *newStr = jsvNewFromStringVar(str, 0, (size_t)idx);
     jsvAppendStringVar(newStr, newSubStr, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
     jsvAppendStringVar(newStr, str, (size_t)idx+jsvGetStringLength(subStr), JSVAPPENDSTRINGVAR_MAXLENGTH);
-    jsvUnLock(str);
+    jsvUnLock2(str, newSubStr);
     str = newStr;
   }
 
-  jsvUnLock2(subStr, newSubStr);
+  jsvUnLock(subStr);
   return str;
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "String",
+  "name" : "match",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_string_match",
+  "params" : [
+    ["regex","JsVar","A RegExp (or a String, which is turned into one)"]
+  ],
+  "return" : ["JsVar","An array of matches, or null"]
+}
+Match this string against a regular expression. Without the `g` flag this
+is the same as `regex.exec(str)`. With it, an array of every matched string
+is returned, or `null` if there were no matches.
+
+```
+"a1b22c333".match(/\d+/g) == ["1","22","333"]
+```
+ */
+JsVar *jswrap_string_match(JsVar *parent, JsVar *regex) {
+  if (jswrap_regexp_isRegExp(regex))
+    return jswrap_regexp_match(regex, parent);
+  regex = jswrap_regexp_constructor(regex, 0);
+  if (!regex) return 0;
+  JsVar *result = jswrap_regexp_match(regex, parent);
+  jsvUnLock(regex);
+  return result;
+}
+
 
 /*JSON{
   "type" : "method",
@@ -313,13 +331,20 @@ JsVar *jswrap_string_slice(JsVar *parent, JsVarInt pStart, JsVar *vEnd) {
   "name" : "split",
   "generate" : "jswrap_string_split",
   "params" : [
-    ["separator","JsVar","The start character index"]
+    ["separator","JsVar","The string (or RegExp) to split on"]
   ],
   "return" : ["JsVar","Part of this string from start for len characters"]
 }
 Return an array made by splitting this string up by the separator. eg. ```'1,2,3'.split(',')==[1,2,3]```
+
+The separator can also be a RegExp, eg. ```'1, 2,3'.split(/, ?/)```. Any
+capture groups in it are added to the array too.
  */
 JsVar *jswrap_string_split(JsVar *parent, JsVar *split) {
+#ifndef SAVE_ON_FLASH
+  if (jswrap_regexp_isRegExp(split))
+    return jswrap_regexp_split(split, parent);
+#endif
   JsVar *array = jsvNewEmptyArray();
   if (!array) return 0; // out of memory
 
@@ -332,22 +357,41 @@ JsVar *jswrap_string_split(JsVar *parent, JsVar *split) {
 
   int idx, last = 0;
   int splitlen = jsvIsUndefined(split) ? 0 : (int)jsvGetStringLength(split);
-  int l = (int)jsvGetStringLength(parent) + 1 - splitlen;
-
-  for (idx=0;idx<=l;idx++) {
-    if (splitlen==0 && idx==0) continue; // special case for where split string is ""
-    if (idx==l || splitlen==0 || jsvCompareString(parent, split, (size_t)idx, 0, true)==0) {
-      if (idx==l) {
-        idx=l+splitlen; // if the last element, do to the end of the string
-        if (splitlen==0) break;
-      }
+  int l = (int)jsvGetStringLength(parent);
 
-      JsVar *part = jsvNewFromStringVar(parent, (size_t)last, (size_t)(idx-last));
+  if (splitlen==0) { // special case for where split string is "" - one character per element
+    for (idx=0;idx<l;idx++) {
+      JsVar *part = jsvNewFromStringVar(parent, (size_t)idx, 1);
       if (!part) break; // out of memory
-      jsvArrayPush(array, part);
-      jsvUnLock(part);
-      last = idx+splitlen;
+      jsvArrayPushAndUnLock(array, part);
     }
+  } else {
+    // One pass: 'it' finds each separator and 'src' follows behind, copying out the parts
+    JsvStringIterator it, src;
+    jsvStringIteratorNew(&it, parent, 0);
+    jsvStringIteratorNew(&src, parent, 0);
+    while (true) {
+      idx = jsvStringIteratorFindString(&it, split);
+      if (idx<0) idx = l; // the last element goes to the end of the string
+      JsVar *part = jsvNewFromEmptyString();
+      if (!part) break; // out of memory
+      JsvStringIterator dst;
+      jsvStringIteratorNew(&dst, part, 0);
+      for (;last<idx;last++) {
+        jsvStringIteratorAppend(&dst, jsvStringIteratorGetChar(&src));
+        jsvStringIteratorNext(&src);
+      }
+      jsvStringIteratorFree(&dst);
+      jsvArrayPushAndUnLock(array, part);
+      if (idx==l) break;
+      // skip over the separator
+      for (;last<idx+splitlen;last++) {
+        jsvStringIteratorNext(&it);
+        jsvStringIteratorNext(&src);
+      }
+    }
+    jsvStringIteratorFree(&it);
+    jsvStringIteratorFree(&src);
   }
   jsvUnLock(split);
   return array;
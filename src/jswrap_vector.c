@@ -0,0 +1,428 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Element-wise maths on arrays and typed arrays (E.vecAdd, E.dot, etc)
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_vector.h"
+#include "jsvariterator.h"
+#include "jsparse.h"
+
+/* Every function here works on Arrays or typed arrays. When all the arrays
+ * involved are typed arrays of the same type whose data is stored in one
+ * block, a loop written for that element type runs directly on the data.
+ * Otherwise (or for Uint8ClampedArray) we fall back to iterators, which
+ * work for anything but are much slower. */
+
+/// If arr is a typed array of the given type stored in one block, return a pointer to its data and update *n with the minimum length
+static char *jswrap_vector_getData(JsVar *arr, JsVarDataArrayBufferViewType type, size_t *n) {
+  if (!jsvIsArrayBuffer(arr) || arr->varData.arraybuffer.type!=type ||
+      JSV_ARRAYBUFFER_IS_CLAMPED(type) || type==ARRAYBUFFERVIEW_ARRAYBUFFER)
+    return 0;
+  size_t len;
+  char *data = jsvGetDataPointer(arr, &len);
+  size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+  if (!data || ((size_t)data & ((size>4?4:size)-1))) return 0;
+  if (len < *n) *n = len;
+  return data;
+}
+
+/// Write a value using an iterator that was created on an Array or typed array
+static void jswrap_vector_setValue(JsvIterator *it, JsVarFloat v) {
+  if (it->type == JSVI_ARRAYBUFFER)
+    jsvArrayBufferIteratorSetFloatValue(&it->it.buf, v);
+  else
+    jsvUnLock(jsvIteratorSetValue(it, jsvNewFromFloat(v)));
+}
+
+typedef enum {
+  JSWVEC_ADD,
+  JSWVEC_SUB,
+  JSWVEC_MUL,
+  JSWVEC_SCALE_OFFSET,
+  JSWVEC_ABS,
+  JSWVEC_CLIP,
+} JswVectorOp;
+
+static JsVarFloat jswrap_vector_apply(JswVectorOp op, JsVarFloat x, JsVarFloat y, JsVarFloat p1, JsVarFloat p2) {
+  switch (op) {
+  case JSWVEC_ADD: return x + y;
+  case JSWVEC_SUB: return x - y;
+  case JSWVEC_MUL: return x * y;
+  case JSWVEC_SCALE_OFFSET: return x*p1 + p2;
+  case JSWVEC_ABS: return x<0 ? -x : x;
+  case JSWVEC_CLIP: return x<p1 ? p1 : (x>p2 ? p2 : x);
+  }
+  return 0;
+}
+
+/* One loop per operation. T is the element type, C the type that add/sub
+ * are done in, U the type for multiplies (unsigned for integers so overflow
+ * wraps), F the type used for scaling/clipping and I the type results in F
+ * are converted to before being truncated to T */
+#define JSWVEC_LOOP(T, C, EXPR) for (i=0;i<n;i++) { C x = (C)xa[i]; d[i] = (T)(EXPR); }
+#define JSWVEC_KERNEL(T, C, U, F, I) { \
+    T *d = (T*)pd; \
+    const T *xa = (const T*)pa, *xb = (const T*)pb; \
+    C s = (C)p1; \
+    F fs = (F)p1, fo = (F)p2; \
+    switch (op) { \
+    case JSWVEC_ADD: if (xb) JSWVEC_LOOP(T, C, x + (C)xb[i]) else JSWVEC_LOOP(T, C, x + s) break; \
+    case JSWVEC_SUB: if (xb) JSWVEC_LOOP(T, C, x - (C)xb[i]) else JSWVEC_LOOP(T, C, x - s) break; \
+    case JSWVEC_MUL: if (xb) JSWVEC_LOOP(T, C, (U)x * (U)xb[i]) else JSWVEC_LOOP(T, C, (U)x * (U)s) break; \
+    case JSWVEC_SCALE_OFFSET: JSWVEC_LOOP(T, C, (I)((F)x*fs + fo)) break; \
+    case JSWVEC_ABS: JSWVEC_LOOP(T, C, x<0 ? -x : x) break; \
+    case JSWVEC_CLIP: JSWVEC_LOOP(T, C, ((F)x<fs) ? (I)fs : (((F)x>fo) ? (I)fo : x)) break; \
+    } \
+  }
+
+/** dst[i] = op(a[i], b[i]). If b isn't iterable, p1 is used in its place. p1
+ * and p2 are also the parameters for SCALE_OFFSET and CLIP */
+static void jswrap_vector_op(JsVar *dst, JsVar *a, JsVar *b, JsVarFloat p1, JsVarFloat p2, JswVectorOp op) {
+  if (!(jsvIsArray(dst) || jsvIsArrayBuffer(dst)) || !jsvIsIterable(a) ||
+      !(jsvIsUndefined(b) || jsvIsIterable(b))) {
+    jsExceptionHere(JSET_ERROR, "Expecting an Array or typed array to write to, and iterables to read from, not %t, %t and %t", dst, a, b);
+    return;
+  }
+  bool bIsArray = jsvIsIterable(b);
+
+  if (jsvIsArrayBuffer(dst)) {
+    JsVarDataArrayBufferViewType type = dst->varData.arraybuffer.type;
+    size_t n = jsvGetArrayBufferLength(dst);
+    char *pd = jswrap_vector_getData(dst, type, &n);
+    char *pa = jswrap_vector_getData(a, type, &n);
+    char *pb = bIsArray ? jswrap_vector_getData(b, type, &n) : 0;
+    // Integer arrays do add/sub/mul with integers, so only use them for integer scalars
+    bool scalarOk = JSV_ARRAYBUFFER_IS_FLOAT(type) ||
+        ((op==JSWVEC_SCALE_OFFSET || op==JSWVEC_CLIP) ? (isfinite(p1) && isfinite(p2)) :
+         (bIsArray || (p1>=-2147483648.0 && p1<=2147483647.0 && p1==(JsVarFloat)(int32_t)p1)));
+    if (pd && pa && (pb || !bIsArray) && scalarOk) {
+      size_t i;
+      switch (type) {
+      case ARRAYBUFFERVIEW_UINT8: JSWVEC_KERNEL(uint8_t, int32_t, uint32_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_INT8: JSWVEC_KERNEL(int8_t, int32_t, uint32_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_UINT16: JSWVEC_KERNEL(uint16_t, int32_t, uint32_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_INT16: JSWVEC_KERNEL(int16_t, int32_t, uint32_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_UINT32: JSWVEC_KERNEL(uint32_t, int64_t, uint64_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_INT32: JSWVEC_KERNEL(int32_t, int64_t, uint64_t, double, int64_t) break;
+      case ARRAYBUFFERVIEW_FLOAT32: JSWVEC_KERNEL(float, float, float, double, double) break;
+      case ARRAYBUFFERVIEW_FLOAT64: JSWVEC_KERNEL(double, double, double, double, double) break;
+      default: assert(0);
+      }
+      return;
+    }
+  }
+
+  JsvIterator itd, ita, itb;
+  jsvIteratorNew(&itd, dst);
+  jsvIteratorNew(&ita, a);
+  if (bIsArray) jsvIteratorNew(&itb, b);
+  while (jsvIteratorHasElement(&itd) && jsvIteratorHasElement(&ita) &&
+         (!bIsArray || jsvIteratorHasElement(&itb))) {
+    JsVarFloat y = p1;
+    if (bIsArray) {
+      y = jsvIteratorGetFloatValue(&itb);
+      jsvIteratorNext(&itb);
+    }
+    JsVarFloat v = jswrap_vector_apply(op, jsvIteratorGetFloatValue(&ita), y, p1, p2);
+    jswrap_vector_setValue(&itd, v);
+    jsvIteratorNext(&ita);
+    jsvIteratorNext(&itd);
+  }
+  if (bIsArray) jsvIteratorFree(&itb);
+  jsvIteratorFree(&ita);
+  jsvIteratorFree(&itd);
+}
+
+/// For add/sub/mul, 'b' can be an array or a number
+static void jswrap_vector_op2(JsVar *dst, JsVar *a, JsVar *b, JswVectorOp op) {
+  if (jsvIsIterable(b) && !jsvIsString(b))
+    jswrap_vector_op(dst, a, b, 0, 0, op);
+  else
+    jswrap_vector_op(dst, a, 0, jsvGetFloat(b), 0, op);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecAdd",
+  "generate" : "jswrap_vector_add",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `a`)"],
+    ["a","JsVar","An Array or typed array"],
+    ["b","JsVar","An Array or typed array, or a number to add to every element"]
+  ]
+}
+Set `dst[i] = a[i] + b[i]`, for as many elements as are in the shortest array.
+
+This is fastest when all the arrays are typed arrays of the same type. Results
+that don't fit in an integer `dst` wrap around as they would if written from
+JavaScript (except that for 32 bit arrays they are calculated exactly, rather
+than via a floating point number).
+ */
+void jswrap_vector_add(JsVar *dst, JsVar *a, JsVar *b) {
+  jswrap_vector_op2(dst, a, b, JSWVEC_ADD);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecSub",
+  "generate" : "jswrap_vector_sub",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `a`)"],
+    ["a","JsVar","An Array or typed array"],
+    ["b","JsVar","An Array or typed array, or a number to subtract from every element"]
+  ]
+}
+Set `dst[i] = a[i] - b[i]`, for as many elements as are in the shortest array.
+ */
+void jswrap_vector_sub(JsVar *dst, JsVar *a, JsVar *b) {
+  jswrap_vector_op2(dst, a, b, JSWVEC_SUB);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecMul",
+  "generate" : "jswrap_vector_mul",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `a`)"],
+    ["a","JsVar","An Array or typed array"],
+    ["b","JsVar","An Array or typed array, or a number to multiply every element by"]
+  ]
+}
+Set `dst[i] = a[i] * b[i]`, for as many elements as are in the shortest array.
+
+To multiply an integer typed array by a fractional number, use
+`E.vecScaleOffset`.
+ */
+void jswrap_vector_mul(JsVar *dst, JsVar *a, JsVar *b) {
+  jswrap_vector_op2(dst, a, b, JSWVEC_MUL);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecScaleOffset",
+  "generate" : "jswrap_vector_scaleOffset",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `src`)"],
+    ["src","JsVar","An Array or typed array"],
+    ["scale","float","The amount to multiply each element by"],
+    ["offset","float","The amount to add after multiplying"]
+  ]
+}
+Set `dst[i] = src[i]*scale + offset`. This is done in floating point, so can
+be used to apply a gain to integer data.
+ */
+void jswrap_vector_scaleOffset(JsVar *dst, JsVar *src, JsVarFloat scale, JsVarFloat offset) {
+  jswrap_vector_op(dst, src, 0, scale, offset, JSWVEC_SCALE_OFFSET);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecAbs",
+  "generate" : "jswrap_vector_abs",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `src`)"],
+    ["src","JsVar","An Array or typed array"]
+  ]
+}
+Set `dst[i] = Math.abs(src[i])`
+ */
+void jswrap_vector_abs(JsVar *dst, JsVar *src) {
+  jswrap_vector_op(dst, src, 0, 0, 0, JSWVEC_ABS);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "vecClip",
+  "generate" : "jswrap_vector_clip",
+  "params" : [
+    ["dst","JsVar","An Array or typed array to write the result into (may be the same as `src`)"],
+    ["src","JsVar","An Array or typed array"],
+    ["min","float","The minimum value"],
+    ["max","float","The maximum value"]
+  ]
+}
+Set `dst[i] = E.clip(src[i], min, max)`
+ */
+void jswrap_vector_clip(JsVar *dst, JsVar *src, JsVarFloat min, JsVarFloat max) {
+  jswrap_vector_op(dst, src, 0, min, max, JSWVEC_CLIP);
+}
+
+#define JSWVEC_DOT(T, C) { \
+    const T *x = (const T*)pa, *y = (const T*)pb; \
+    C part = 0; \
+    for (i=0;i<n;i++) { \
+      part += (C)x[i] * (C)y[i]; \
+      if ((i&63)==63) { sum += (JsVarFloat)part; part = 0; } \
+    } \
+    sum += (JsVarFloat)part; \
+  }
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "dot",
+  "generate" : "jswrap_vector_dot",
+  "params" : [
+    ["a","JsVar","An Array or typed array"],
+    ["b","JsVar","An Array or typed array"]
+  ],
+  "return" : ["float","The sum of `a[i]*b[i]`"]
+}
+Return the dot product of two arrays, `a[0]*b[0] + a[1]*b[1] + ...`, for as
+many elements as are in the shortest array.
+ */
+JsVarFloat jswrap_vector_dot(JsVar *a, JsVar *b) {
+  if (!jsvIsIterable(a) || !jsvIsIterable(b)) {
+    jsExceptionHere(JSET_ERROR, "Expecting 2 iterables, not %t and %t", a, b);
+    return NAN;
+  }
+  JsVarFloat sum = 0;
+  if (jsvIsArrayBuffer(a)) {
+    JsVarDataArrayBufferViewType type = a->varData.arraybuffer.type;
+    size_t n = jsvGetArrayBufferLength(a);
+    char *pa = jswrap_vector_getData(a, type, &n);
+    char *pb = jswrap_vector_getData(b, type, &n);
+    if (pa && pb) {
+      size_t i;
+      // sum in blocks, so single precision/integer maths can be used without losing much
+      switch (type) {
+      case ARRAYBUFFERVIEW_UINT8: JSWVEC_DOT(uint8_t, int32_t) break;
+      case ARRAYBUFFERVIEW_INT8: JSWVEC_DOT(int8_t, int32_t) break;
+      case ARRAYBUFFERVIEW_UINT16: JSWVEC_DOT(uint16_t, int64_t) break;
+      case ARRAYBUFFERVIEW_INT16: JSWVEC_DOT(int16_t, int64_t) break;
+      case ARRAYBUFFERVIEW_UINT32: JSWVEC_DOT(uint32_t, double) break;
+      case ARRAYBUFFERVIEW_INT32: JSWVEC_DOT(int32_t, double) break;
+      case ARRAYBUFFERVIEW_FLOAT32: JSWVEC_DOT(float, double) break;
+      case ARRAYBUFFERVIEW_FLOAT64: JSWVEC_DOT(double, double) break;
+      default: assert(0);
+      }
+      return sum;
+    }
+  }
+
+  JsvIterator ita, itb;
+  jsvIteratorNew(&ita, a);
+  jsvIteratorNew(&itb, b);
+  while (jsvIteratorHasElement(&ita) && jsvIteratorHasElement(&itb)) {
+    sum += jsvIteratorGetFloatValue(&ita) * jsvIteratorGetFloatValue(&itb);
+    jsvIteratorNext(&ita);
+    jsvIteratorNext(&itb);
+  }
+  jsvIteratorFree(&itb);
+  jsvIteratorFree(&ita);
+  return sum;
+}
+
+#define JSWVEC_MINMAX(T) { \
+    const T *x = (const T*)pa; \
+    T mn = x[0], mx = x[0]; \
+    for (i=1;i<n;i++) { \
+      T v = x[i]; \
+      if (v<mn) { mn = v; minIdx = i; } \
+      if (v>mx) { mx = v; maxIdx = i; } \
+    } \
+    min = (JsVarFloat)mn; \
+    max = (JsVarFloat)mx; \
+  }
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "minMax",
+  "generate" : "jswrap_vector_minMax",
+  "params" : [
+    ["arr","JsVar","An Array or typed array"]
+  ],
+  "return" : ["JsVar","An object containing `min`, `max`, `minIndex` and `maxIndex`, or undefined if the array was empty"]
+}
+Find the minimum and maximum values in an array, and where they are.
+
+```
+E.minMax([3,1,4,1,5]) == {min:1, max:5, minIndex:1, maxIndex:4}
+```
+
+If a value occurs more than once, the index of the first one is returned.
+`NaN` values are ignored, unless the first value is `NaN`.
+ */
+JsVar *jswrap_vector_minMax(JsVar *arr) {
+  if (!jsvIsIterable(arr)) {
+    jsExceptionHere(JSET_ERROR, "Expecting an iterable, not %t", arr);
+    return 0;
+  }
+  JsVarFloat min = 0, max = 0;
+  size_t minIdx = 0, maxIdx = 0;
+  bool found = false;
+  if (jsvIsArrayBuffer(arr)) {
+    JsVarDataArrayBufferViewType type = arr->varData.arraybuffer.type;
+    size_t n = jsvGetArrayBufferLength(arr);
+    char *pa = jswrap_vector_getData(arr, type, &n);
+    if (pa && n) {
+      size_t i;
+      switch (type) {
+      case ARRAYBUFFERVIEW_UINT8: JSWVEC_MINMAX(uint8_t) break;
+      case ARRAYBUFFERVIEW_INT8: JSWVEC_MINMAX(int8_t) break;
+      case ARRAYBUFFERVIEW_UINT16: JSWVEC_MINMAX(uint16_t) break;
+      case ARRAYBUFFERVIEW_INT16: JSWVEC_MINMAX(int16_t) break;
+      case ARRAYBUFFERVIEW_UINT32: JSWVEC_MINMAX(uint32_t) break;
+      case ARRAYBUFFERVIEW_INT32: JSWVEC_MINMAX(int32_t) break;
+      case ARRAYBUFFERVIEW_FLOAT32: JSWVEC_MINMAX(float) break;
+      case ARRAYBUFFERVIEW_FLOAT64: JSWVEC_MINMAX(double) break;
+      default: assert(0);
+      }
+      found = true;
+    } else if (pa) {
+      return 0; // empty
+    }
+  }
+
+  if (!found) {
+    JsvIterator it;
+    jsvIteratorNew(&it, arr);
+    size_t i = 0;
+    while (jsvIteratorHasElement(&it)) {
+      JsVarFloat v = jsvIteratorGetFloatValue(&it);
+      if (!found) {
+        min = max = v;
+        found = true;
+      }
+      if (v<min) { min = v; minIdx = i; }
+      if (v>max) { max = v; maxIdx = i; }
+      i++;
+      jsvIteratorNext(&it);
+    }
+    jsvIteratorFree(&it);
+    if (!found) return 0;
+  }
+
+  JsVar *result = jsvNewObject();
+  if (!result) return 0;
+  jsvObjectSetChildAndUnLock(result, "min", jsvNewFromFloat(min));
+  jsvObjectSetChildAndUnLock(result, "max", jsvNewFromFloat(max));
+  jsvObjectSetChildAndUnLock(result, "minIndex", jsvNewFromInteger((JsVarInt)minIdx));
+  jsvObjectSetChildAndUnLock(result, "maxIndex", jsvNewFromInteger((JsVarInt)maxIdx));
+  return result;
+}
@@ -0,0 +1,23 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Element-wise maths on arrays and typed arrays (E.vecAdd, E.dot, etc)
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+void jswrap_vector_add(JsVar *dst, JsVar *a, JsVar *b);
+void jswrap_vector_sub(JsVar *dst, JsVar *a, JsVar *b);
+void jswrap_vector_mul(JsVar *dst, JsVar *a, JsVar *b);
+void jswrap_vector_scaleOffset(JsVar *dst, JsVar *src, JsVarFloat scale, JsVarFloat offset);
+void jswrap_vector_abs(JsVar *dst, JsVar *src);
+void jswrap_vector_clip(JsVar *dst, JsVar *src, JsVarFloat min, JsVarFloat max);
+JsVarFloat jswrap_vector_dot(JsVar *a, JsVar *b);
+JsVar *jswrap_vector_minMax(JsVar *arr);
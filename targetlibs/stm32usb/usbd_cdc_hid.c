@@ -642,10 +642,15 @@ static uint8_t  USBD_CDC_HID_SOF (struct _USBD_HandleTypeDef *pdev) {
   if (!handle->cdcState & CDC_WRITE_TX_WAIT) {
     // try and fill the buffer
     unsigned int len = 0;
-    int c;
+    unsigned int chunk;
+    unsigned char *data;
     while (len<CDC_DATA_FS_IN_PACKET_SIZE-1 && // TODO: send max packet size -1 to ensure data is pushed through
-           ((c = jshGetCharToTransmit(EV_USBSERIAL)) >= 0) ) { // get byte to transmit
-      handle->cdcTX[len++] = (uint8_t)c;
+           ((chunk = jshGetTransmitChunk(EV_USBSERIAL, &data)) > 0) ) { // get block of bytes to transmit
+      if (chunk > CDC_DATA_FS_IN_PACKET_SIZE-1-len)
+        chunk = CDC_DATA_FS_IN_PACKET_SIZE-1-len;
+      memcpy(&handle->cdcTX[len], data, chunk);
+      jshTransmitChunkDone(EV_USBSERIAL, chunk);
+      len += chunk;
     }
 
     // send data if we have any...
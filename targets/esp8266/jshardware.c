@@ -747,14 +747,14 @@ void jshUSARTKick(
 ) {
   // transmit anything that is sitting in the uart output buffers
   if (device == EV_SERIAL1 || device == EV_SERIAL2) {
-    // Get the next character to transmit.  We will have reached the end when
-    // the value of the character to transmit is -1.
-    int c = jshGetCharToTransmit(device);
+    // Send each block of data waiting to be transmitted, until there is none left
     uint8_t uart = device == EV_SERIAL1 ? 0 : 1;
-
-    while (c >= 0) {
-      uart_tx_one_char(uart, c);
-      c = jshGetCharToTransmit(device);
+    unsigned char *data;
+    unsigned int i, len;
+    while ((len = jshGetTransmitChunk(device, &data)) > 0) {
+      for (i=0;i<len;i++)
+        uart_tx_one_char(uart, data[i]);
+      jshTransmitChunkDone(device, len);
     }
   }
 }
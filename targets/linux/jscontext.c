@@ -0,0 +1,359 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Isolated interpreter contexts for Linux
+ * ----------------------------------------------------------------------------
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "jscontext.h"
+#include "jsvar.h"
+#include "jsparse.h"
+#include "jsinteractive.h"
+#include "jshardware.h"
+#include "jswrap_json.h"
+
+typedef struct JsContextJob {
+  struct JsContextJob *next;
+  char *code;
+  char *result;     ///< If nonzero, the JSON of the result is written here
+  size_t resultLen;
+  bool isSync;      ///< Somebody is waiting for this in jscEvaluate - they own the memory
+  bool done;
+} JsContextJob;
+
+typedef struct JsContextMessage {
+  struct JsContextMessage *next;
+  char *data;
+} JsContextMessage;
+
+typedef struct {
+  JsContextMessage *first, *last;
+} JsContextMessageQueue;
+
+struct JsContext {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;        ///< Broadcast whenever anything below changes
+  JsContextJob *firstJob, *lastJob;
+  JsContextMessageQueue inbox;  ///< Messages posted to the context
+  JsContextMessageQueue outbox; ///< Messages the context has posted back to whoever created it
+  JsContext *parent;          ///< The context that created this one (0 for the main thread)
+  bool isIdle;                ///< Nothing queued, no timers and nothing happened last time around the loop
+  atomic_bool shouldInterrupt; ///< Set by jscInterrupt from any thread, polled by the context's own interpreter
+  bool shouldStop;
+  bool hasStopped;
+  bool hasChildMessages;      ///< A context we created has posted a message since we last went around the loop
+  unsigned int unfreed;       ///< JsVars still allocated after the interpreter was killed
+};
+
+/// The context that this thread is running (0 for the main thread)
+static JS_CONTEXT_LOCAL JsContext *currentContext = 0;
+
+bool jscIsSecondaryContext() {
+  return currentContext != 0;
+}
+
+/// Add a message to a queue - call with the mutex locked
+static void jscMessagePush(JsContextMessageQueue *queue, JsContextMessage *msg) {
+  if (queue->last) queue->last->next = msg;
+  else queue->first = msg;
+  queue->last = msg;
+}
+
+/// Remove the first message from a queue and return its data (which must be freed) - call with the mutex locked
+static char *jscMessagePop(JsContextMessageQueue *queue) {
+  JsContextMessage *msg = queue->first;
+  if (!msg) return 0;
+  queue->first = msg->next;
+  if (!queue->first) queue->last = 0;
+  char *data = msg->data;
+  free(msg);
+  return data;
+}
+
+static void jscMessageClear(JsContextMessageQueue *queue) {
+  char *data;
+  while ((data = jscMessagePop(queue)))
+    free(data);
+}
+
+static JsContextMessage *jscMessageNew(const char *data) {
+  JsContextMessage *msg = (JsContextMessage*)malloc(sizeof(JsContextMessage));
+  if (!msg) return 0;
+  msg->next = 0;
+  msg->data = strdup(data);
+  if (!msg->data) {
+    free(msg);
+    return 0;
+  }
+  return msg;
+}
+
+static void jscRunJob(JsContextJob *job) {
+  JsVar *v = jspEvaluate(job->code, false);
+  jsiExecuteMicrotasks();
+  if (job->result && job->resultLen) {
+    JsVar *json = jswrap_json_stringify(v);
+    if (json) jsvGetString(json, job->result, job->resultLen);
+    else strncpy(job->result, "undefined", job->resultLen);
+    job->result[job->resultLen-1] = 0;
+    jsvUnLock(json);
+  }
+  jsvUnLock(v);
+}
+
+static void jscFinishJob(JsContext *ctx, JsContextJob *job) {
+  if (job->isSync) {
+    job->done = true;
+    pthread_cond_broadcast(&ctx->cond);
+  } else {
+    free(job->code);
+    free(job);
+  }
+}
+
+static void *jscThread(void *arg) {
+  JsContext *ctx = (JsContext*)arg;
+  currentContext = ctx;
+  jsvInit();
+  jsiInit(false /* do not autoload */);
+  jscCheckInterrupt(); // we may have been interrupted before we started
+
+  while (true) {
+    pthread_mutex_lock(&ctx->mutex);
+    bool shouldStop = ctx->shouldStop;
+    JsContextJob *job = shouldStop ? 0 : ctx->firstJob;
+    if (job) {
+      ctx->firstJob = job->next;
+      if (!ctx->firstJob) ctx->lastJob = 0;
+    }
+    ctx->hasChildMessages = false; // jsiLoop will collect them
+    pthread_mutex_unlock(&ctx->mutex);
+    if (shouldStop) break;
+
+    if (job) {
+      jscRunJob(job);
+      pthread_mutex_lock(&ctx->mutex);
+      jscFinishJob(ctx, job);
+      pthread_mutex_unlock(&ctx->mutex);
+    }
+    // handle timers, events and report any errors
+    bool isBusy = jsiLoop();
+    if (!job && !isBusy && !jsiHasTimers()) {
+      pthread_mutex_lock(&ctx->mutex);
+      if (!ctx->firstJob && !ctx->inbox.first && !ctx->hasChildMessages && !ctx->shouldStop) {
+        ctx->isIdle = true;
+        pthread_cond_broadcast(&ctx->cond);
+        while (!ctx->firstJob && !ctx->inbox.first && !ctx->hasChildMessages && !ctx->shouldStop)
+          pthread_cond_wait(&ctx->cond, &ctx->mutex);
+      }
+      pthread_mutex_unlock(&ctx->mutex);
+    }
+  }
+
+  jsiKill();
+  jsvGarbageCollect();
+  unsigned int unfreed = jsvGetMemoryUsage();
+  jsvKill();
+
+  pthread_mutex_lock(&ctx->mutex);
+  // anything left in the queue is never going to run
+  while (ctx->firstJob) {
+    JsContextJob *job = ctx->firstJob;
+    ctx->firstJob = job->next;
+    jscFinishJob(ctx, job);
+  }
+  ctx->lastJob = 0;
+  jscMessageClear(&ctx->inbox);
+  ctx->unfreed = unfreed;
+  ctx->isIdle = true;
+  ctx->hasStopped = true;
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&ctx->mutex);
+  return 0;
+}
+
+JsContext *jscCreate() {
+  JsContext *ctx = (JsContext*)malloc(sizeof(JsContext));
+  if (!ctx) return 0;
+  memset(ctx, 0, sizeof(JsContext));
+  ctx->parent = currentContext;
+  pthread_mutex_init(&ctx->mutex, NULL);
+  pthread_cond_init(&ctx->cond, NULL);
+  if (pthread_create(&ctx->thread, NULL, jscThread, ctx)) {
+    pthread_cond_destroy(&ctx->cond);
+    pthread_mutex_destroy(&ctx->mutex);
+    free(ctx);
+    return 0;
+  }
+  return ctx;
+}
+
+unsigned int jscDestroy(JsContext *ctx) {
+  pthread_mutex_lock(&ctx->mutex);
+  ctx->shouldStop = true;
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&ctx->mutex);
+  pthread_join(ctx->thread, NULL);
+
+  unsigned int unfreed = ctx->unfreed;
+  jscMessageClear(&ctx->outbox);
+  pthread_cond_destroy(&ctx->cond);
+  pthread_mutex_destroy(&ctx->mutex);
+  free(ctx);
+  return unfreed;
+}
+
+/// Add a job to the context's queue - call with the mutex locked
+static bool jscQueueJob(JsContext *ctx, JsContextJob *job) {
+  if (ctx->shouldStop || ctx->hasStopped) return false;
+  if (ctx->lastJob) ctx->lastJob->next = job;
+  else ctx->firstJob = job;
+  ctx->lastJob = job;
+  ctx->isIdle = false;
+  pthread_cond_broadcast(&ctx->cond);
+  return true;
+}
+
+bool jscExecute(JsContext *ctx, const char *code) {
+  JsContextJob *job = (JsContextJob*)malloc(sizeof(JsContextJob));
+  if (!job) return false;
+  memset(job, 0, sizeof(JsContextJob));
+  job->code = strdup(code);
+  if (!job->code) {
+    free(job);
+    return false;
+  }
+  pthread_mutex_lock(&ctx->mutex);
+  bool ok = jscQueueJob(ctx, job);
+  pthread_mutex_unlock(&ctx->mutex);
+  if (!ok) {
+    free(job->code);
+    free(job);
+  }
+  return ok;
+}
+
+bool jscEvaluate(JsContext *ctx, const char *code, char *resultJSON, size_t resultLen) {
+  assert(ctx != currentContext); // we'd wait for ourselves forever
+  JsContextJob job;
+  memset(&job, 0, sizeof(JsContextJob));
+  job.code = (char*)code;
+  job.result = resultJSON;
+  job.resultLen = resultLen;
+  job.isSync = true;
+  if (resultJSON && resultLen) resultJSON[0] = 0;
+
+  pthread_mutex_lock(&ctx->mutex);
+  bool ok = jscQueueJob(ctx, &job);
+  if (ok) {
+    while (!job.done)
+      pthread_cond_wait(&ctx->cond, &ctx->mutex);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+  return ok;
+}
+
+void jscWaitForIdle(JsContext *ctx) {
+  pthread_mutex_lock(&ctx->mutex);
+  while (!ctx->isIdle)
+    pthread_cond_wait(&ctx->cond, &ctx->mutex);
+  pthread_mutex_unlock(&ctx->mutex);
+}
+
+bool jscPostMessage(JsContext *ctx, const char *data) {
+  JsContextMessage *msg = jscMessageNew(data);
+  if (!msg) return false;
+  pthread_mutex_lock(&ctx->mutex);
+  bool ok = !ctx->shouldStop && !ctx->hasStopped;
+  if (ok) {
+    jscMessagePush(&ctx->inbox, msg);
+    ctx->isIdle = false;
+    pthread_cond_broadcast(&ctx->cond);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+  if (!ok) {
+    free(msg->data);
+    free(msg);
+  }
+  return ok;
+}
+
+char *jscGetMessageFromContext(JsContext *ctx) {
+  pthread_mutex_lock(&ctx->mutex);
+  char *data = jscMessagePop(&ctx->outbox);
+  pthread_mutex_unlock(&ctx->mutex);
+  return data;
+}
+
+char *jscGetMessage() {
+  JsContext *ctx = currentContext;
+  if (!ctx) return 0;
+  pthread_mutex_lock(&ctx->mutex);
+  char *data = jscMessagePop(&ctx->inbox);
+  pthread_mutex_unlock(&ctx->mutex);
+  return data;
+}
+
+bool jscPostMessageToParent(const char *data) {
+  JsContext *ctx = currentContext;
+  if (!ctx) return false;
+  JsContextMessage *msg = jscMessageNew(data);
+  if (!msg) return false;
+  pthread_mutex_lock(&ctx->mutex);
+  jscMessagePush(&ctx->outbox, msg);
+  pthread_mutex_unlock(&ctx->mutex);
+  // Our parent may be asleep - wake it up to collect the message
+  JsContext *parent = ctx->parent;
+  if (parent) {
+    pthread_mutex_lock(&parent->mutex);
+    parent->hasChildMessages = true;
+    parent->isIdle = false;
+    pthread_cond_broadcast(&parent->cond);
+    pthread_mutex_unlock(&parent->mutex);
+  } else
+    jshWakeMainThread();
+  return true;
+}
+
+void jscInterrupt(JsContext *ctx) {
+  // execInfo belongs to the context's thread, so just raise a flag for it to pick up
+  atomic_store(&ctx->shouldInterrupt, true);
+}
+
+void jscCheckInterrupt() {
+  JsContext *ctx = currentContext;
+  if (ctx && atomic_load_explicit(&ctx->shouldInterrupt, memory_order_relaxed) &&
+      atomic_exchange(&ctx->shouldInterrupt, false))
+    jspSetInterrupted(true);
+}
+
+void jscSleep(JsSysTime timeUntilWake) {
+  JsContext *ctx = currentContext;
+  if (!ctx || timeUntilWake==JSSYSTIME_MAX) return; // no timers - jscThread waits for more code instead
+  JsVarFloat ms = jshGetMillisecondsFromTime(timeUntilWake);
+  if (ms < 1) return;
+  if (ms > 60000) ms = 60000; // avoid overflow - we're woken early if code is queued anyway
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  long long nsec = ts.tv_nsec + (long long)(ms*1000000);
+  ts.tv_sec += (time_t)(nsec / 1000000000);
+  ts.tv_nsec = (long)(nsec % 1000000000);
+
+  pthread_mutex_lock(&ctx->mutex);
+  if (!ctx->firstJob && !ctx->inbox.first && !ctx->hasChildMessages && !ctx->shouldStop)
+    pthread_cond_timedwait(&ctx->cond, &ctx->mutex, &ts);
+  pthread_mutex_unlock(&ctx->mutex);
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Isolated interpreter contexts for Linux. Each context runs on its own
+ * thread with its own JsVar heap, root scope, event queue and timers
+ * (everything marked JS_CONTEXT_LOCAL). Hardware (IO events, pin watches,
+ * the console) stays with the main thread's interpreter.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef JSCONTEXT_H_
+#define JSCONTEXT_H_
+
+#include "jsutils.h"
+
+typedef struct JsContext JsContext;
+
+/// Start a new interpreter on its own thread (call after jshInit). Returns 0 on failure
+JsContext *jscCreate();
+/** Stop the context once it has finished what it's executing (call
+ * jscInterrupt first if that may never happen), wait for its thread to exit
+ * and free it. Returns how many JsVars were still allocated after the
+ * interpreter was killed - this should be 0! */
+unsigned int jscDestroy(JsContext *ctx);
+/// Queue code to be executed in the context and return immediately
+bool jscExecute(JsContext *ctx, const char *code);
+/** Execute code in the context and wait for it to complete. If resultJSON is
+ * nonzero, the result is written into it as JSON (truncated to resultLen) */
+bool jscEvaluate(JsContext *ctx, const char *code, char *resultJSON, size_t resultLen);
+/// Wait until the context has no queued code, timers or events left
+void jscWaitForIdle(JsContext *ctx);
+/// Interrupt whatever the context is currently executing (like Ctrl-C). Safe to call from any thread
+void jscInterrupt(JsContext *ctx);
+/** Called by the interpreter (on its own thread) while executing - if
+ * jscInterrupt has been called for the current context, set EXEC_INTERRUPTED */
+void jscCheckInterrupt();
+
+/// Post a message (a copy of 'data') to the context. It's collected inside the context with jscGetMessage
+bool jscPostMessage(JsContext *ctx, const char *data);
+/// Get the next message the context has posted with jscPostMessageToParent, or 0. The result must be freed
+char *jscGetMessageFromContext(JsContext *ctx);
+/// In a secondary context, get the next message posted to it with jscPostMessage, or 0. The result must be freed
+char *jscGetMessage();
+/// In a secondary context, post a message (a copy of 'data') back to whoever created it
+bool jscPostMessageToParent(const char *data);
+
+/// Is the calling thread running a context created with jscCreate?
+bool jscIsSecondaryContext();
+/// Used by jsiIdle in a secondary context: sleep until a timer is due or more code is queued
+void jscSleep(JsSysTime timeUntilWake);
+/// Make the main thread's jshSleep return right away (in jshardware.c). Safe to call from any thread
+void jshWakeMainThread();
+
+#endif /* JSCONTEXT_H_ */
@@ -47,15 +47,53 @@
 // ----------------------------------------------------------------------------
 int ioDevices[EV_DEVICE_MAX+1]; // list of open IO devices (or 0)
 JshPinState gpioState[JSH_PIN_COUNT]; // will be set to UNDEFINED if it isn't exported
+IOEventFlags gpioEventFlags[JSH_PIN_COUNT];
+
+IOEventFlags pinToEVEXTI(Pin pin) {
+  return gpioEventFlags[pin];
+}
+
+#ifndef __MINGW32__
+/* Written to by the input and GPIO watch threads after they push IO events,
+ * so that jshSleep returns right away rather than at the end of its timeout */
+int mainWakePipe[2] = { -1, -1 };
+
+void jshWakeMainThread() {
+  char c = 0;
+  if (mainWakePipe[1]>=0)
+    NOT_USED(write(mainWakePipe[1], &c, 1));
+}
+#endif
 
 #ifdef SYSFS_GPIO_DIR
 
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+
+/// The sysfs GPIO directory. Set from ESPRUINO_SYSFS_GPIO_DIR if it exists (so a fake tree can be used for testing)
+const char *sysfsGpioDir = SYSFS_GPIO_DIR;
 
 bool gpioShouldWatch[JSH_PIN_COUNT]; // whether we should watch this pin for changes
 bool gpioLastState[JSH_PIN_COUNT]; // the last state of this pin
+int gpioWatchFd[JSH_PIN_COUNT]; // open 'value' file for each watched pin (or -1)
+int gpioWatchWakePipe[2]; // written to when gpioWatchFd changes, to wake gpioWatchThread
+pthread_mutex_t gpioWatchMutex = PTHREAD_MUTEX_INITIALIZER; // protects gpioWatchFd/gpioLastState
+pthread_t gpioWatchThread;
+volatile sig_atomic_t gpioWatchThreadRunning = false; // shared between the main and GPIO watch threads
+
+/* How long to wait in poll() before reading all watched pins anyway. sysfs
+ * only raises POLLPRI for pins whose 'edge' can be set, so this catches the
+ * rest (and lets a fake sysfs tree made of ordinary files work) */
+#define GPIO_WATCH_POLL_MS 100
 
+// Get the path of a file in sysfs for the given pin (or in the GPIO directory itself if pin<0)
+void sysfs_gpio_path(char *path, size_t len, int pin, const char *file) {
+  if (pin<0)
+    snprintf(path, len, "%s/%s", sysfsGpioDir, file);
+  else
+    snprintf(path, len, "%s/gpio%d/%s", sysfsGpioDir, pin, file);
+}
 
 // functions for accessing the sysfs GPIO
 void sysfs_write(const char *path, const char *data) {
@@ -80,7 +118,7 @@ void sysfs_read(const char *path, char *data, unsigned int len) {
   int amt = 0;
   int f = open(path, O_RDONLY);
   if (f>=0) {
-    amt = read(f, data, len-1);
+    amt = (int)read(f, data, len-1);
     close(f);
   } 
   if (amt<0) amt=0;
@@ -90,7 +128,104 @@ void sysfs_read(const char *path, char *data, unsigned int len) {
 JsVarInt sysfs_read_int(const char *path) {
   char buf[20];
   sysfs_read(path, buf, sizeof(buf));
-  return stringToIntWithRadix(buf, 10, 0);
+  return (JsVarInt)stringToIntWithRadix(buf, 10, 0);
+}
+
+/* Read the value of an already open 'value' file. sysfs needs us to seek
+ * back to the start and read again to clear an edge notification. */
+bool sysfs_read_value_fd(int f) {
+  char buf[8];
+  int amt = 0;
+  if (lseek(f, 0, SEEK_SET) == 0)
+    amt = (int)read(f, buf, sizeof(buf)-1);
+  if (amt<0) amt=0;
+  buf[amt]=0;
+  return stringToIntWithRadix(buf, 10, 0)!=0;
+}
+
+// Wake gpioWatchThread up so it notices changes to gpioWatchFd
+void gpioWatchKick() {
+  char c = 0;
+  if (gpioWatchThreadRunning)
+    write(gpioWatchWakePipe[1], &c, 1);
+}
+
+/* Waits for edges on all watched pins using poll(POLLPRI), and timestamps
+ * and queues them as soon as they happen - so edges shorter than the idle
+ * loop's period aren't lost. */
+void *jshGPIOWatchThread(void *arg) {
+  NOT_USED(arg);
+  struct pollfd fds[JSH_PIN_COUNT+1];
+  Pin fdPins[JSH_PIN_COUNT+1];
+  while (gpioWatchThreadRunning) {
+    Pin pin;
+    int n = 0;
+    fds[n].fd = gpioWatchWakePipe[0];
+    fds[n].events = POLLIN;
+    n++;
+    pthread_mutex_lock(&gpioWatchMutex);
+    for (pin=0;pin<JSH_PIN_COUNT;pin++)
+      if (gpioWatchFd[pin]>=0) {
+        fds[n].fd = gpioWatchFd[pin];
+        fds[n].events = POLLPRI | POLLERR;
+        fdPins[n] = pin;
+        n++;
+      }
+    pthread_mutex_unlock(&gpioWatchMutex);
+
+    int r = poll(fds, (nfds_t)n, (n>1) ? GPIO_WATCH_POLL_MS : -1);
+    // get the time as close to the edge as we can
+    JsSysTime time = jshGetSystemTime();
+    if (r<0) {
+      if (errno!=EINTR) usleep(1000);
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      char buf[16];
+      read(gpioWatchWakePipe[0], buf, sizeof(buf));
+    }
+
+    int i;
+    bool pushedEvent = false;
+    pthread_mutex_lock(&gpioWatchMutex);
+    for (i=1;i<n;i++) {
+      pin = fdPins[i];
+      if (gpioWatchFd[pin] != fds[i].fd) continue; // no longer watched
+      bool state = sysfs_read_value_fd(fds[i].fd);
+      if (state != gpioLastState[pin]) {
+        gpioLastState[pin] = state;
+        jshInterruptOff(); // the input thread could be pushing events too
+        jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), time);
+        jshInterruptOn();
+        pushedEvent = true;
+      }
+    }
+    pthread_mutex_unlock(&gpioWatchMutex);
+    if (pushedEvent) jshWakeMainThread();
+  }
+  return 0;
+}
+
+// Start or stop watching a pin for edges in gpioWatchThread
+void gpioWatchSet(Pin pin, bool shouldWatch) {
+  char path[256];
+  pthread_mutex_lock(&gpioWatchMutex);
+  if (gpioWatchFd[pin]>=0) {
+    close(gpioWatchFd[pin]);
+    gpioWatchFd[pin] = -1;
+  }
+  sysfs_gpio_path(path, sizeof(path), pin, "edge");
+  sysfs_write(path, shouldWatch ? "both" : "none");
+  if (shouldWatch) {
+    sysfs_gpio_path(path, sizeof(path), pin, "value");
+    gpioWatchFd[pin] = open(path, O_RDONLY | O_NONBLOCK);
+    if (gpioWatchFd[pin]>=0)
+      gpioLastState[pin] = sysfs_read_value_fd(gpioWatchFd[pin]);
+    else
+      gpioLastState[pin] = false;
+  }
+  pthread_mutex_unlock(&gpioWatchMutex);
+  gpioWatchKick();
 }
 #endif
 // ----------------------------------------------------------------------------
@@ -133,12 +268,6 @@ void (*irqEXTIs[16])(void) = {
 };
 #endif
 // ----------------------------------------------------------------------------
-IOEventFlags gpioEventFlags[JSH_PIN_COUNT];
-
-IOEventFlags pinToEVEXTI(Pin pin) {
-  return gpioEventFlags[pin];
-}
-
 IOEventFlags getNewEVEXTI() {
   int i;
   for (i=0;i<16;i++) {
@@ -221,8 +350,8 @@ int getch()
 {
     int r;
     unsigned char c;
-    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
-        return r;
+    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) <= 0) {
+        return -1; // error, or end of file (so stop reading)
     } else {
         return c;
     }
@@ -231,20 +360,26 @@ int getch()
 
 pthread_t inputThread;
 bool isInitialised;
+/* There are no interrupts here, but the input and GPIO watch threads both
+ * push IO events, so jshInterruptOff/On use a (recursive) mutex to keep them apart. */
+pthread_mutex_t interruptMutex;
+bool interruptMutexInitialised = false;
 
 void jshInputThread() {
   while (isInitialised) {
     bool shortSleep = false;
     /* Handle the delayed Ctrl-C -> interrupt behaviour (see description by EXEC_CTRL_C's definition)  */
-    if (execInfo.execute & EXEC_CTRL_C_WAIT)
-      execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C_WAIT) | EXEC_INTERRUPTED;
-    if (execInfo.execute & EXEC_CTRL_C)
-      execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C) | EXEC_CTRL_C_WAIT;
+    if (consoleExecInfo.execute & EXEC_CTRL_C_WAIT)
+      consoleExecInfo.execute = (consoleExecInfo.execute & ~EXEC_CTRL_C_WAIT) | EXEC_INTERRUPTED;
+    if (consoleExecInfo.execute & EXEC_CTRL_C)
+      consoleExecInfo.execute = (consoleExecInfo.execute & ~EXEC_CTRL_C) | EXEC_CTRL_C_WAIT;
+    bool pushedEvent = false;
     // Read from the console
     while (kbhit()) {
       int ch = getch();
       if (ch<0) break;
       jshPushIOCharEvent(EV_USBSERIAL, (char)ch);
+      pushedEvent = true;
     }
     // Read from any open devices - if we have space
     if (jshGetEventsUsed() < IOBUFFERMASK/2) {
@@ -258,36 +393,32 @@ void jshInputThread() {
             //int j; for (j=0;j<bytes;j++) printf("]] '%c'\r\n", buf[j]);
             jshPushIOCharEvents(i, buf, (unsigned int)bytes);
             shortSleep = true;
+            pushedEvent = true;
           }
         }
       }
     }
     // Write any data we have
-    IOEventFlags device = jshGetDeviceToTransmit();
-    while (device != EV_NONE) {
-      char ch = (char)jshGetCharToTransmit(device);
-      //printf("[[ '%c'\r\n", ch);
-      if (ioDevices[device]) {
-        write(ioDevices[device], &ch, 1);
-        shortSleep = true;
+    IOEventFlags device;
+    for (device=0;device<=EV_DEVICE_MAX;device++) {
+      unsigned char *data;
+      unsigned int len;
+      while ((len = jshGetTransmitChunk(device, &data)) > 0) {
+        if (ioDevices[device]) {
+          int written = (int)write(ioDevices[device], data, len);
+          if (written<=0) break; // device busy (O_NONBLOCK) - try again later
+          len = (unsigned int)written;
+          shortSleep = true;
+        }
+        jshTransmitChunkDone(device, len);
       }
-      device = jshGetDeviceToTransmit();
     }
 
-
-#ifdef SYSFS_GPIO_DIR
-    Pin pin;
-    for (pin=0;pin<JSH_PIN_COUNT;pin++)
-      if (gpioShouldWatch[pin]) {
-        shortSleep = true;
-        bool state = jshPinGetValue(pin);
-        if (state != gpioLastState[pin]) {
-          jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), jshGetSystemTime());
-          gpioLastState[pin] = state;
-        }
-      }
+#ifndef __MINGW32__
+    if (pushedEvent) jshWakeMainThread();
+#else
+    NOT_USED(pushedEvent);
 #endif
-
     usleep(shortSleep ? 1000 : 50000);
   }
 }
@@ -310,6 +441,15 @@ void jshInit() {
   for (i=0;i<=EV_DEVICE_MAX;i++)
     ioDevices[i] = 0;
 
+  if (!interruptMutexInitialised) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&interruptMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    interruptMutexInitialised = true;
+  }
+
   jshInitDevices();
 #ifndef __MINGW32__
   if (!terminal_set) {
@@ -331,8 +471,18 @@ void jshInit() {
     gpioEventFlags[i] = 0;
   }
 #ifdef SYSFS_GPIO_DIR
+  const char *gpioDir = getenv("ESPRUINO_SYSFS_GPIO_DIR");
+  if (gpioDir) sysfsGpioDir = gpioDir;
   for (i=0;i<JSH_PIN_COUNT;i++) {
     gpioShouldWatch[i] = false;    
+    gpioWatchFd[i] = -1;
+  }
+#endif
+
+#ifndef __MINGW32__
+  if (mainWakePipe[0]<0 && pipe(mainWakePipe)==0) {
+    fcntl(mainWakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(mainWakePipe[1], F_SETFL, O_NONBLOCK);
   }
 #endif
 
@@ -340,6 +490,16 @@ void jshInit() {
   int err = pthread_create(&inputThread, NULL, &jshInputThread, NULL);
   if (err != 0)
       printf("Unable to create input thread, %s", strerror(err));
+#ifdef SYSFS_GPIO_DIR
+  if (pipe(gpioWatchWakePipe) == 0) {
+    gpioWatchThreadRunning = true;
+    err = pthread_create(&gpioWatchThread, NULL, &jshGPIOWatchThread, NULL);
+    if (err != 0) {
+      gpioWatchThreadRunning = false;
+      printf("Unable to create GPIO watch thread, %s", strerror(err));
+    }
+  }
+#endif
 }
 
 void jshReset() {
@@ -358,11 +518,23 @@ void jshKill() {
     }
 
 #ifdef SYSFS_GPIO_DIR
-
+  if (gpioWatchThreadRunning) {
+    gpioWatchThreadRunning = false;
+    char c = 0;
+    write(gpioWatchWakePipe[1], &c, 1);
+    pthread_join(gpioWatchThread, NULL);
+    close(gpioWatchWakePipe[0]);
+    close(gpioWatchWakePipe[1]);
+  }
+  char path[256];
+  for (i=0;i<JSH_PIN_COUNT;i++)
+    if (gpioWatchFd[i]>=0)
+      gpioWatchSet((Pin)i, false);
   // unexport any GPIO that we exported
+  sysfs_gpio_path(path, sizeof(path), -1, "unexport");
   for (i=0;i<JSH_PIN_COUNT;i++)
     if (gpioState[i] != JSHPINSTATE_UNDEFINED)
-      sysfs_write_int(SYSFS_GPIO_DIR"/unexport", i);
+      sysfs_write_int(path, i);
 #endif
 }
 
@@ -413,9 +585,11 @@ void jshSetRegistrationCode(unsigned int code) {
 // ----------------------------------------------------------------------------
 
 void jshInterruptOff() {
+  pthread_mutex_lock(&interruptMutex);
 }
 
 void jshInterruptOn() {
+  pthread_mutex_unlock(&interruptMutex);
 }
 
 void jshDelayMicroseconds(int microsec) {
@@ -425,11 +599,12 @@ void jshDelayMicroseconds(int microsec) {
 void jshPinSetState(Pin pin, JshPinState state) {
 #ifdef SYSFS_GPIO_DIR
   if (gpioState[pin] != state) {
-    if (gpioState[pin] == JSHPINSTATE_UNDEFINED)
-      sysfs_write_int(SYSFS_GPIO_DIR"/export", pin);
-    char path[64] = SYSFS_GPIO_DIR"/gpio";
-    itostr(pin, &path[strlen(path)], 10);
-    strcat(&path[strlen(path)], "/direction");
+    char path[256];
+    if (gpioState[pin] == JSHPINSTATE_UNDEFINED) {
+      sysfs_gpio_path(path, sizeof(path), -1, "export");
+      sysfs_write_int(path, pin);
+    }
+    sysfs_gpio_path(path, sizeof(path), pin, "direction");
     sysfs_write(path, JSHPINSTATE_IS_OUTPUT(state)?"out":"in");
   }
 #endif
@@ -458,9 +633,8 @@ JshPinState jshPinGetState(Pin pin) {
 
 void jshPinSetValue(Pin pin, bool value) {
 #ifdef SYSFS_GPIO_DIR
-  char path[64] = SYSFS_GPIO_DIR"/gpio";
-  itostr(pin, &path[strlen(path)], 10);
-  strcat(&path[strlen(path)], "/value");
+  char path[256];
+  sysfs_gpio_path(path, sizeof(path), pin, "value");
   sysfs_write_int(path, value?1:0);
 #endif
 #ifdef USE_WIRINGPI
@@ -470,9 +644,8 @@ void jshPinSetValue(Pin pin, bool value) {
 
 bool jshPinGetValue(Pin pin) {
 #ifdef SYSFS_GPIO_DIR
-  char path[64] = SYSFS_GPIO_DIR"/gpio";
-  itostr(pin, &path[strlen(path)], 10);
-  strcat(&path[strlen(path)], "/value");
+  char path[256];
+  sysfs_gpio_path(path, sizeof(path), pin, "value");
   return sysfs_read_int(path);
 #elif defined(USE_WIRINGPI)
   return digitalRead(pin);
@@ -574,7 +747,7 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch) {
         jshPinSetState(pin, JSHPINSTATE_GPIO_IN);
 #ifdef SYSFS_GPIO_DIR
         gpioShouldWatch[pin] = true;
-        gpioLastState[pin] = jshPinGetValue(pin);
+        gpioWatchSet(pin, true);
 #endif
 #ifdef USE_WIRINGPI
         wiringPiISR(pin, INT_EDGE_BOTH, irqEXTIs[exti-EV_EXTI0]);
@@ -585,6 +758,8 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch) {
     if (!shouldWatch || !exti) {
       gpioEventFlags[pin] = 0;
 #ifdef SYSFS_GPIO_DIR
+      if (gpioShouldWatch[pin])
+        gpioWatchSet(pin, false);
       gpioShouldWatch[pin] = false;
 #endif
 #ifdef USE_WIRINGPI
@@ -755,21 +930,29 @@ void jshI2CRead(IOEventFlags device, unsigned char address, int nBytes, unsigned
 
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
-  bool hasWatches = false;
-#ifdef SYSFS_GPIO_DIR
-  Pin pin;
-  for (pin=0;pin<JSH_PIN_COUNT;pin++)
-    if (gpioShouldWatch[pin]) hasWatches = true;
-#endif
- 
   JsVarFloat usecfloat = jshGetMillisecondsFromTime(timeUntilWake)*1000;
   unsigned int usecs = (usecfloat < 0xFFFFFFFF) ? (unsigned int)usecfloat : 0xFFFFFFFF;
-  if (hasWatches && usecs>1000) 
-    usecs=1000; // don't sleep much if we have watches - we need to keep polling them
   if (usecs > 50000)
     usecs = 50000; // don't want to sleep too much (user input/HTTP/etc)
-  if (usecs >= 1000)  
-    usleep(usecs); 
+  if (usecs < 1000) return true;
+#ifndef __MINGW32__
+  if (mainWakePipe[0]>=0) {
+    /* Wait until the timeout, or until the input/GPIO watch threads tell us
+     * they've pushed an event (so setWatch callbacks run right away) */
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(mainWakePipe[0], &fds);
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = (suseconds_t)usecs;
+    if (select(mainWakePipe[0]+1, &fds, NULL, NULL, &tv) > 0) {
+      char buf[16];
+      while (read(mainWakePipe[0], buf, sizeof(buf)) > 0);
+    }
+    return true;
+  }
+#endif
+  usleep(usecs);
   return true;
 }
 
@@ -0,0 +1,502 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * This file is designed to be parsed during the build process
+ *
+ * Worker threads for Linux
+ * ----------------------------------------------------------------------------
+ */
+#include "jswrap_worker.h"
+#include "jscontext.h"
+#include "jsparse.h"
+#include "jsinteractive.h"
+#include "jswrap_json.h"
+#include "jswrap_date.h"
+#include "jswrap_arraybuffer.h"
+#include "jsvariterator.h"
+#include "jswrap_functions.h"
+
+#define JS_WORKERS_NAME JS_HIDDEN_CHAR_STR"Wrk" // the list of Workers we created
+#define JS_WORKER_CONTEXT_NAME JS_HIDDEN_CHAR_STR"ctx" // the JsContext in each Worker
+
+/*JSON{
+  "type" : "class",
+  "class" : "Worker"
+}
+A separate JavaScript interpreter running on its own thread, with its own
+memory. Use it to move long-running work (FFTs, big JSON documents, crypto)
+off the main event loop so IO keeps being handled.
+
+Values sent with `postMessage` are copied: objects, arrays, strings, numbers
+(including `NaN` and `Infinity`), `undefined`, Dates, ArrayBuffers and typed
+arrays survive, but functions are dropped and other objects arrive as plain
+Objects.
+
+```
+var w = new Worker(function() {
+  Worker.on('message', function(data) {
+    Worker.postMessage(E.sum(data));
+  });
+});
+w.on('message', function(sum) { console.log(sum); });
+w.postMessage(new Float32Array([1,2,3]));
+```
+
+**Note:** Workers have no access to hardware (pins, watches, Serial). Only available on Linux.
+*/
+/*JSON{
+  "type" : "event",
+  "class" : "Worker",
+  "name" : "message",
+  "params" : [
+    ["data","JsVar","The data that was sent with `postMessage`"]
+  ]
+}
+On a Worker object, emitted when the Worker calls `Worker.postMessage`. Inside
+the Worker, emitted on `Worker` itself when the parent calls `postMessage`.
+*/
+
+static JsVar* workersGetArray(bool create) {
+  return jsvObjectGetChild(execInfo.hiddenRoot, JS_WORKERS_NAME, create ? JSV_ARRAY : 0);
+}
+
+static JsContext *workerGetContext(JsVar *worker) {
+  JsContext *ctx = 0;
+  JsVar *ctxVar = jsvObjectGetChild(worker, JS_WORKER_CONTEXT_NAME, 0);
+  if (ctxVar) {
+    char buf[sizeof(JsContext*)+1/*trailing zero*/];
+    if (jsvGetString(ctxVar, buf, sizeof(buf)) == sizeof(JsContext*))
+      memcpy(&ctx, buf, sizeof(JsContext*));
+    jsvUnLock(ctxVar);
+  }
+  return ctx;
+}
+
+/// Copy a JS string into a malloc'd C string (which must be freed)
+static char *workerGetCString(JsVar *str) {
+  size_t len = jsvGetStringLength(str);
+  char *s = (char*)malloc(len+1);
+  if (s) jsvGetString(str, s, len+1);
+  return s;
+}
+
+/* Messages are JSON. Values JSON can't represent are written as objects with
+ * a WORKER_TAG key, and keys of normal objects that start with
+ * WORKER_TAG_CHAR get another one added, so they can't be mistaken for tags:
+ *
+ *   undefined          {"$t":"u"}
+ *   NaN/Infinity       {"$t":"n","v":"NaN"}
+ *   Date               {"$t":"d","v":milliseconds}
+ *   ArrayBuffer(View)  {"$t":"a","y":JsVarDataArrayBufferViewType,"v":"base64 of its bytes"}
+ *
+ * The receiver uses JSON.parse and then rebuilds these - messages are never
+ * evaluated. */
+#define WORKER_TAG_CHAR '$'
+#define WORKER_TAG "$t"
+
+/// The objects/arrays we're currently inside while encoding - used to spot circular references
+typedef struct WorkerEncodeParent {
+  JsVar *v;
+  struct WorkerEncodeParent *parent;
+} WorkerEncodeParent;
+
+static bool workerIsDate(JsVar *v) {
+  JsVar *dateClass = jsvObjectGetChild(execInfo.root, "Date", 0);
+  JsVar *dateProto = dateClass ? jsvSkipNameAndUnLock(jspGetNamedField(dateClass, JSPARSE_PROTOTYPE_VAR, false)) : 0;
+  JsVar *proto = jsvObjectGetChild(v, JSPARSE_INHERITS_VAR, 0);
+  bool isDate = dateProto && proto==dateProto;
+  jsvUnLock3(dateClass, dateProto, proto);
+  return isDate;
+}
+
+/// Append the encoded form of 'v' to 'str'. Functions are written as undefined
+static void workerEncode(JsVar *v, JsVar *str, WorkerEncodeParent *parent) {
+  WorkerEncodeParent p;
+  for (p.parent=parent;p.parent;p.parent=p.parent->parent) {
+    if (p.parent->v == v) {
+      if (!jspHasError())
+        jsExceptionHere(JSET_TYPEERROR, "Circular references can't be sent between Workers");
+      return;
+    }
+  }
+  p.v = v;
+  p.parent = parent;
+  if (jsvIsUndefined(v) || jsvIsFunction(v)) {
+    jsvAppendString(str, "{\""WORKER_TAG"\":\"u\"}");
+  } else if (jsvIsFloat(v) && !isfinite(jsvGetFloat(v))) {
+    JsVarFloat f = jsvGetFloat(v);
+    jsvAppendPrintf(str, "{\""WORKER_TAG"\":\"n\",\"v\":\"%s\"}", isnan(f) ? "NaN" : (f>0 ? "Infinity" : "-Infinity"));
+  } else if (jsvIsArrayBuffer(v)) {
+    // copy the bytes the view covers in one go, rather than a JsVar per element
+    JsVar *backing = jsvGetArrayBufferBackingString(v);
+    size_t byteLength = jsvGetArrayBufferLength(v) * JSV_ARRAYBUFFER_GET_SIZE(v->varData.arraybuffer.type);
+    JsVar *bytes = jsvNewFromStringVar(backing, v->varData.arraybuffer.byteOffset, byteLength);
+    JsVar *b64 = bytes ? jswrap_btoa(bytes) : 0;
+    jsvAppendPrintf(str, "{\""WORKER_TAG"\":\"a\",\"y\":%d,\"v\":\"%v\"}", (int)v->varData.arraybuffer.type, b64);
+    jsvUnLock3(backing, bytes, b64);
+  } else if (jsvIsArray(v)) {
+    // arrays can be sparse - fill in any gaps with undefined
+    JsVarInt length = jsvGetArrayLength(v);
+    JsVarInt index = 0;
+    jsvAppendCharacter(str, '[');
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, v);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVarInt itemIndex = jsvGetIntegerAndUnLock(jsvObjectIteratorGetKey(&it));
+      JsVar *item = jsvObjectIteratorGetValue(&it);
+      for (;index<itemIndex;index++)
+        jsvAppendString(str, index ? ",{\""WORKER_TAG"\":\"u\"}" : "{\""WORKER_TAG"\":\"u\"}");
+      if (index) jsvAppendCharacter(str, ',');
+      workerEncode(item, str, &p);
+      jsvUnLock(item);
+      index++;
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    for (;index<length;index++)
+      jsvAppendString(str, index ? ",{\""WORKER_TAG"\":\"u\"}" : "{\""WORKER_TAG"\":\"u\"}");
+    jsvAppendCharacter(str, ']');
+  } else if (jsvIsObject(v) && workerIsDate(v)) {
+    JsVar *ms = jsvNewFromFloat(jswrap_date_getTime(v));
+    jsvAppendString(str, "{\""WORKER_TAG"\":\"d\",\"v\":");
+    workerEncode(ms, str, &p);
+    jsvAppendCharacter(str, '}');
+    jsvUnLock(ms);
+  } else if (jsvIsObject(v)) {
+    bool first = true;
+    jsvAppendCharacter(str, '{');
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, v);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *key = jsvObjectIteratorGetKey(&it);
+      JsVar *item = jsvSkipName(key);
+      if (!jsvIsInternalObjectKey(key) && !jsvIsFunction(item)) {
+        if (!first) jsvAppendCharacter(str, ',');
+        first = false;
+        JsVar *keyStr = jsvAsString(key, false);
+        if (jsvGetCharInString(keyStr, 0)==WORKER_TAG_CHAR) {
+          JsVar *escaped = jsvNewFromEmptyString();
+          if (escaped) {
+            jsvAppendCharacter(escaped, WORKER_TAG_CHAR);
+            jsvAppendStringVarComplete(escaped, keyStr);
+          }
+          jsvUnLock(keyStr);
+          keyStr = escaped;
+        }
+        jsfGetJSON(keyStr, str, JSON_NONE);
+        jsvUnLock(keyStr);
+        jsvAppendCharacter(str, ':');
+        workerEncode(item, str, &p);
+      }
+      jsvUnLock2(key, item);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvAppendCharacter(str, '}');
+  } else {
+    // strings, finite numbers, booleans and null
+    jsfGetJSON(v, str, JSON_NONE);
+  }
+}
+
+/// Serialise a value (see workerEncode) into a malloc'd C string (which must be freed)
+static char *workerSerialise(JsVar *data) {
+  if (jsvIsFunction(data)) {
+    jsExceptionHere(JSET_TYPEERROR, "Functions can't be sent between Workers");
+    return 0;
+  }
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  workerEncode(data, str, 0);
+  char *s = jspHasError() ? 0 : workerGetCString(str);
+  jsvUnLock(str);
+  return s;
+}
+
+/// Rebuild the values JSON can't represent in something parsed from workerEncode's output
+static JsVar *workerDecode(JsVar *v) {
+  if (jsvIsArray(v)) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, v);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *item = jsvObjectIteratorGetValue(&it);
+      JsVar *decoded = workerDecode(item);
+      if (decoded != item) {
+        JsVar *key = jsvObjectIteratorGetKey(&it);
+        jsvSetValueOfName(key, decoded);
+        jsvUnLock(key);
+      }
+      jsvUnLock2(item, decoded);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    return jsvLockAgain(v);
+  }
+  if (!jsvIsObject(v)) return jsvLockAgainSafe(v);
+
+  JsVar *tag = jsvObjectGetChild(v, WORKER_TAG, 0);
+  if (tag) {
+    char t = jsvGetCharInString(tag, 0);
+    jsvUnLock(tag);
+    JsVar *value = jsvObjectGetChild(v, "v", 0);
+    JsVar *result = 0;
+    if (t=='n') {
+      if (jsvIsStringEqual(value, "NaN")) result = jsvNewFromFloat(NAN);
+      else if (jsvIsStringEqual(value, "Infinity")) result = jsvNewFromFloat(INFINITY);
+      else if (jsvIsStringEqual(value, "-Infinity")) result = jsvNewFromFloat(-INFINITY);
+    } else if (t=='d') {
+      result = jswrap_date_from_milliseconds(jsvGetFloat(value));
+    } else if (t=='a' && jsvIsString(value)) {
+      JsVarDataArrayBufferViewType type = (JsVarDataArrayBufferViewType)jsvGetIntegerAndUnLock(jsvObjectGetChild(v, "y", 0));
+      size_t size = JSV_ARRAYBUFFER_GET_SIZE(type);
+      bool isView = (size==1 || size==2 || size==4 || size==8) && type==(type&(ARRAYBUFFERVIEW_MASK_SIZE|ARRAYBUFFERVIEW_SIGNED|ARRAYBUFFERVIEW_FLOAT|ARRAYBUFFERVIEW_CLAMPED));
+      if (type==ARRAYBUFFERVIEW_ARRAYBUFFER || isView) {
+        // the decoded string becomes the new ArrayBuffer's data
+        JsVar *bytes = jswrap_atob(value);
+        size_t byteLength = jsvGetStringLength(bytes);
+        JsVar *buffer = (bytes && byteLength%size==0) ? jsvNewArrayBufferFromString(bytes, (unsigned int)byteLength) : 0;
+        if (buffer && isView)
+          result = jswrap_typedarray_constructor(type, buffer, 0, 0);
+        else
+          result = jsvLockAgainSafe(buffer);
+        jsvUnLock2(bytes, buffer);
+      }
+    } // else 'u' - undefined
+    jsvUnLock(value);
+    return result;
+  }
+
+  // A normal object - copy it, removing the escaping from keys
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, v);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *key = jsvAsString(jsvObjectIteratorGetKey(&it), true);
+    if (jsvGetCharInString(key, 0)==WORKER_TAG_CHAR) {
+      JsVar *unescaped = jsvNewFromStringVar(key, 1, JSVAPPENDSTRINGVAR_MAXLENGTH);
+      jsvUnLock(key);
+      key = unescaped;
+    }
+    JsVar *item = jsvObjectIteratorGetValue(&it);
+    JsVar *decoded = workerDecode(item);
+    JsVar *name = key ? jsvFindChildFromVar(obj, key, true) : 0;
+    if (name) jsvSetValueOfName(name, decoded);
+    jsvUnLock3(name, key, item);
+    jsvUnLock(decoded);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return obj;
+}
+
+/// Recreate a value sent with workerSerialise, and emit it as a 'message' event on obj
+static void workerEmitMessage(JsVar *obj, const char *msg) {
+  JsVar *json = jsvNewFromString(msg);
+  if (!json) return;
+  JsVar *parsed = jswrap_json_parse(json);
+  jsvUnLock(json);
+  JsVar *data = workerDecode(parsed);
+  jsvUnLock(parsed);
+  jsiQueueObjectCallbacks(obj, JS_EVENT_PREFIX"message", &data, 1);
+  jsvUnLock(data);
+}
+
+/*JSON{
+  "type" : "constructor",
+  "class" : "Worker",
+  "name" : "Worker",
+  "generate" : "jswrap_worker_constructor",
+  "params" : [
+    ["code","JsVar","The JavaScript code to run, as a String or a Function (which is run without its surrounding scope)"]
+  ],
+  "return" : ["JsVar","A Worker object"]
+}
+Start a new interpreter on its own thread and run `code` in it
+*/
+JsVar *jswrap_worker_constructor(JsVar *code) {
+  JsVar *codeStr = 0;
+  if (jsvIsFunction(code)) {
+    codeStr = jsvNewFromString("(");
+    if (codeStr) {
+      jsfGetJSON(code, codeStr, JSON_NONE);
+      jsvAppendString(codeStr, ")()");
+    }
+  } else if (jsvIsString(code)) {
+    codeStr = jsvLockAgain(code);
+  } else {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting a String or Function, got %t", code);
+    return 0;
+  }
+  if (!codeStr) return 0; // out of memory
+  char *codeCStr = workerGetCString(codeStr);
+  jsvUnLock(codeStr);
+  if (!codeCStr) return 0;
+
+  JsContext *ctx = jscCreate();
+  if (!ctx) {
+    free(codeCStr);
+    jsExceptionHere(JSET_ERROR, "Unable to start Worker thread");
+    return 0;
+  }
+  jscExecute(ctx, codeCStr);
+  free(codeCStr);
+
+  JsVar *worker = jspNewObject(0, "Worker");
+  JsVar *ctxVar = jsvNewStringOfLength(sizeof(JsContext*));
+  JsVar *arr = workersGetArray(true);
+  if (!worker || !ctxVar || !arr) {
+    jsvUnLock3(worker, ctxVar, arr);
+    jscInterrupt(ctx);
+    jscDestroy(ctx);
+    return 0;
+  }
+  jsvSetString(ctxVar, (char*)&ctx, sizeof(JsContext*));
+  jsvObjectSetChildAndUnLock(worker, JS_WORKER_CONTEXT_NAME, ctxVar);
+  jsvArrayPush(arr, worker);
+  jsvUnLock(arr);
+  return worker;
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Worker",
+  "name" : "postMessage",
+  "generate" : "jswrap_worker_postMessage",
+  "params" : [
+    ["data","JsVar","The data to send"]
+  ]
+}
+Send a copy of `data` to the Worker, where it is emitted as a `message` event on `Worker`
+*/
+void jswrap_worker_postMessage(JsVar *parent, JsVar *data) {
+  JsContext *ctx = workerGetContext(parent);
+  if (!ctx) {
+    jsExceptionHere(JSET_ERROR, "Worker has been terminated");
+    return;
+  }
+  char *msg = workerSerialise(data);
+  if (!msg) return;
+  jscPostMessage(ctx, msg);
+  free(msg);
+}
+
+/*JSON{
+  "type" : "method",
+  "class" : "Worker",
+  "name" : "terminate",
+  "generate" : "jswrap_worker_terminate"
+}
+Stop the Worker (interrupting anything it is executing) and free its memory
+*/
+void jswrap_worker_terminate(JsVar *parent) {
+  JsContext *ctx = workerGetContext(parent);
+  if (!ctx) return;
+  jsvRemoveNamedChild(parent, JS_WORKER_CONTEXT_NAME);
+  JsVar *arr = workersGetArray(false);
+  if (arr) {
+    JsVar *idx = jsvGetArrayIndexOf(arr, parent, true);
+    if (idx) {
+      jsvRemoveChild(arr, idx);
+      jsvUnLock(idx);
+    }
+    jsvUnLock(arr);
+  }
+  jscInterrupt(ctx);
+  jscDestroy(ctx);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "class" : "Worker",
+  "name" : "postMessage",
+  "generate" : "jswrap_worker_postMessageToParent",
+  "params" : [
+    ["data","JsVar","The data to send"]
+  ]
+}
+Inside a Worker, send a copy of `data` back to the Worker object in the parent,
+where it is emitted as a `message` event
+*/
+void jswrap_worker_postMessageToParent(JsVar *data) {
+  if (!jscIsSecondaryContext()) {
+    jsExceptionHere(JSET_ERROR, "Worker.postMessage can only be used inside a Worker");
+    return;
+  }
+  char *msg = workerSerialise(data);
+  if (!msg) return;
+  jscPostMessageToParent(msg);
+  free(msg);
+}
+
+/*JSON{
+  "type" : "idle",
+  "generate" : "jswrap_worker_idle"
+}*/
+bool jswrap_worker_idle() {
+  bool wasBusy = false;
+  char *msg;
+  // Messages from our parent, if we're a Worker
+  if (jscIsSecondaryContext()) {
+    JsVar *workerClass = jsvObjectGetChild(execInfo.root, "Worker", 0);
+    while ((msg = jscGetMessage())) {
+      if (workerClass) workerEmitMessage(workerClass, msg);
+      free(msg);
+      wasBusy = true;
+    }
+    jsvUnLock(workerClass);
+  }
+  // Messages from Workers we created
+  JsVar *arr = workersGetArray(false);
+  if (arr) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, arr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *worker = jsvObjectIteratorGetValue(&it);
+      JsContext *ctx = workerGetContext(worker);
+      while (ctx && (msg = jscGetMessageFromContext(ctx))) {
+        workerEmitMessage(worker, msg);
+        free(msg);
+        wasBusy = true;
+      }
+      jsvUnLock(worker);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(arr);
+  }
+  return wasBusy;
+}
+
+/*JSON{
+  "type" : "kill",
+  "generate" : "jswrap_worker_kill"
+}*/
+void jswrap_worker_kill() {
+  JsVar *arr = workersGetArray(false);
+  if (arr) {
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, arr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *worker = jsvObjectIteratorGetValue(&it);
+      JsContext *ctx = workerGetContext(worker);
+      if (ctx) {
+        jscInterrupt(ctx);
+        jscDestroy(ctx);
+      }
+      jsvRemoveNamedChild(worker, JS_WORKER_CONTEXT_NAME);
+      jsvUnLock(worker);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(arr);
+    jsvRemoveNamedChild(execInfo.hiddenRoot, JS_WORKERS_NAME);
+  }
+}
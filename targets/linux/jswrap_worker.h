@@ -0,0 +1,21 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Worker threads for Linux
+ * ----------------------------------------------------------------------------
+ */
+#include "jsvar.h"
+
+JsVar *jswrap_worker_constructor(JsVar *code);
+void jswrap_worker_postMessage(JsVar *parent, JsVar *data);
+void jswrap_worker_terminate(JsVar *parent);
+void jswrap_worker_postMessageToParent(JsVar *data);
+bool jswrap_worker_idle();
+void jswrap_worker_kill();
@@ -13,6 +13,7 @@
 #include "jsinteractive.h"
 #include "jshardware.h"
 #include "jswrapper.h"
+#include "jscontext.h"
 
 
 #define TEST_DIR "tests/"
@@ -67,6 +68,7 @@ bool run_test(const char *filename) {
   addNativeFunction("interrupt", nativeInterrupt);
 
   jsvUnLock(jspEvaluate(buffer, false));
+  jsiExecuteMicrotasks();
 
   isRunning = true;
   bool isBusy = true;
@@ -156,6 +158,45 @@ bool run_all_tests() {
   return passed == count;
 }
 
+/// Run the same test in 'count' isolated contexts at once, each on its own thread
+bool run_test_in_contexts(const char *filename, int count) {
+  printf("----------------------------------\r\n");
+  printf("----------------------------- TEST %s IN %d CONTEXTS\r\n", filename, count);
+  char *buffer = read_file(filename);
+  if (!buffer) exit(1);
+  if (count<1) count = 1;
+
+  jshInit();
+  JsContext **contexts = (JsContext**)malloc(sizeof(JsContext*)*(size_t)count);
+  int i, passed = 0;
+  for (i=0;i<count;i++) {
+    contexts[i] = jscCreate();
+    if (!contexts[i]) {
+      printf("Unable to create context\r\n");
+      exit(1);
+    }
+    jscExecute(contexts[i], buffer);
+  }
+  for (i=0;i<count;i++) {
+    char result[16];
+    jscWaitForIdle(contexts[i]);
+    jscEvaluate(contexts[i], "!!result", result, sizeof(result));
+    unsigned int unfreed = jscDestroy(contexts[i]);
+    bool pass = !strcmp(result, "true") && !unfreed;
+    printf("Context %d: %s (%d Memory Records unfreed)\r\n", i, pass?"PASS":"FAIL", unfreed);
+    if (pass) passed++;
+  }
+  free(contexts);
+  jshKill();
+  free(buffer);
+
+  if (passed==count)
+    printf("----------------------------- PASS %s\r\n", filename);
+  else
+    printf("----------------------------- FAIL %s (%d of %d contexts passed) <-------\r\n", filename, passed, count);
+  return passed==count;
+}
+
 bool run_memory_test(const char *fn, int vars) {
   unsigned int i;
   unsigned int min = 20;
@@ -218,6 +259,7 @@ void show_help() {
 #endif
     printf("   --test-all              Run all tests (in 'tests' directory)\n");
     printf("   --test test.js          Run the supplied test\n");
+    printf("   --test-contexts # test.js  Run the supplied test in # isolated contexts at once\n");
     printf("   --test-mem-all          Run all Exhaustive Memory crash tests\n");
     printf("   --test-mem test.js      Run the supplied Exhaustive Memory crash test\n");
     printf("   --test-mem-n test.js #  Run the supplied Exhaustive Memory crash test with # vars\n");
@@ -263,6 +305,7 @@ int main(int argc, char **argv) {
         jsiInit(true);
         addNativeFunction("quit", nativeQuit);
         jsvUnLock(jspEvaluate(argv[i+1], false));
+        jsiExecuteMicrotasks();
         int errCode = handleErrors();
         isRunning = !errCode;
         bool isBusy = true;
@@ -274,13 +317,17 @@ int main(int argc, char **argv) {
         exit(errCode);
 #ifdef USE_TELNET
       } else if (!strcmp(a,"--telnet")) {
-        extern bool telnetEnabled;
+        extern JS_CONTEXT_LOCAL bool telnetEnabled;
         telnetEnabled = true;
 #endif
       } else if (!strcmp(a,"--test")) {
         if (i+1>=argc) die("Expecting an extra argument\n");
         bool ok = run_test(argv[i+1]);
         exit(ok ? 0 : 1);
+      } else if (!strcmp(a,"--test-contexts")) {
+        if (i+2>=argc) die("Expecting an extra 2 arguments\n");
+        bool ok = run_test_in_contexts(argv[i+2], atoi(argv[i+1]));
+        exit(ok ? 0 : 1);
       } else if (!strcmp(a,"--test-all")) {
         bool ok = run_all_tests();
         exit(ok ? 0 : 1);
@@ -323,6 +370,7 @@ int main(int argc, char **argv) {
     jsiInit(false /* do not autoload!!! */);
     addNativeFunction("quit", nativeQuit);
     jsvUnLock(jspEvaluate(cmd, false));
+    jsiExecuteMicrotasks();
     int errCode = handleErrors();
     free(buffer);
     isRunning = !errCode;
@@ -0,0 +1,34 @@
+// Array iterators only create the callback arguments that get used
+var a = [5,6,7];
+a.foo = "bar";
+
+var r1 = a.map(function(v) { return v*2; });
+var r2 = a.map(function(v,i) { return i; });
+var r3 = a.map(function(v,i,arr) { return arr===a; });
+var r4 = a.map(function() { return arguments.length; });
+var r5 = a.map(function() { return 1; });
+// index variables that are kept hold of must not change
+var idx = [];
+a.forEach(function(v,i) { idx.push(i); });
+var r6 = a.filter(function(v,i) { return i!=1; });
+var r7 = a.reduce(function(p,v,i) { return p+v*i; }, 0);
+var r8 = a.reduce(function(p) { return p+1; });
+var r9 = a.reduce(function() { return arguments.length; }, 0);
+var bound = function(x,v,i) { return x+v+i; }.bind(null, 100);
+var r10 = a.map(bound);
+var r11 = new Uint8Array([1,2,3]).map(function(v,i) { return v+i; });
+var r12 = [1,,3].map(function(v,i) { return i; });
+
+result = r1.join()=="10,12,14" &&
+         r2.join()=="0,1,2" &&
+         r3.join()=="true,true,true" &&
+         r4.join()=="3,3,3" &&
+         r5.join()=="1,1,1" &&
+         idx.join()=="0,1,2" &&
+         r6.join()=="5,7" &&
+         r7==6+14 &&
+         r8==7 &&
+         r9==4 &&
+         r10.join()=="105,107,109" &&
+         r11.join()=="1,3,5" &&
+         r12.length==3 && r12[0]==0 && r12[2]==2;
@@ -0,0 +1,66 @@
+// Using an array as a queue with push/shift/unshift shouldn't affect indices
+
+var q = [];
+for (var i=0;i<10;i++) q.push(i);
+q.shift(); q.shift(); q.shift();
+q.push(10);
+
+var r = [
+  q.length==8,
+  q[0]==3,
+  q[7]==10,
+  q[8]===undefined,
+  JSON.stringify(q)=="[3,4,5,6,7,8,9,10]",
+  q.indexOf(5)==2,
+  q.join(",")=="3,4,5,6,7,8,9,10",
+  Object.keys(q).join(",")=="0,1,2,3,4,5,6,7",
+];
+
+// assigning via index
+q[0] = "a";
+q[q.length] = 11;
+r.push(JSON.stringify(q)=='["a",4,5,6,7,8,9,10,11]');
+q.shift();
+r.push(q.pop()==11);
+r.push(JSON.stringify(q)=="[4,5,6,7,8,9,10]");
+
+// unshift after shift, and repeated unshift
+q.unshift(1,2,3);
+r.push(JSON.stringify(q)=="[1,2,3,4,5,6,7,8,9,10]");
+var u = [];
+for (i=0;i<50;i++) u.unshift(i);
+r.push(u.length==50 && u[0]==49 && u[49]==0);
+var keys = 0;
+for (i in u) if (i==keys) keys++;
+r.push(keys==50);
+var m = u.map(function(v,i) { return v+i; });
+r.push(m.every(function(v) { return v==49; }));
+
+// a long running queue, which wraps the stored offset several times
+var t = [], sum = 0, expected = 0;
+for (i=0;i<2000;i++) {
+  t.push(i);
+  expected += i;
+  if (t.length > 5) sum += t.shift();
+}
+while (t.length) sum += t.shift();
+r.push(sum==expected && t.length==0);
+t.push("x");
+r.push(t[0]=="x" && JSON.stringify(t)=='["x"]');
+
+// sparse arrays and copies
+var s = [1,,3,4];
+r.push(s.shift()==1 && s.shift()===undefined && s.length==2 && s[0]==3);
+var c = s.slice();
+r.push(JSON.stringify(c)=="[3,4]" && c.concat([5])[2]==5);
+
+// code that walks the array's children itself (not through an iterator)
+var a = [1,2,3,4];
+a.shift(); a.unshift(9); a.shift(); a.shift();
+var st = JSON.createStringifier(a), out = "", chunk;
+while ((chunk = st.read(2)) !== undefined) out += chunk;
+r.push(out=="[3,4]" && JSON.stringify(a)=="[3,4]");
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
@@ -0,0 +1,58 @@
+// Sorting without a compare function - typed arrays are numeric, arrays compare as strings
+
+function sorted(a) {
+  for (var i=1;i<a.length;i++) if (a[i-1]>a[i]) return false;
+  return true;
+}
+
+var r = [];
+[Int8Array, Uint8Array, Uint8ClampedArray, Int16Array, Uint16Array, Int32Array, Uint32Array, Float32Array, Float64Array].forEach(function(T) {
+  var a = new T(200);
+  for (var i=0;i<a.length;i++) a[i] = ((i*7919)%251) - 100;
+  a.sort();
+  r.push(sorted(a));
+  // small arrays, which may not be stored contiguously
+  var s = new T([3,1,2]).sort();
+  r.push(s[0]==1 && s[1]==2 && s[2]==3);
+});
+var f = new Float64Array([3, NaN, 0, -1/Infinity, -Infinity, 1.5, NaN, -2]).sort();
+r.push(f[0]==-Infinity && f[1]==-2 && 1/f[2]<0 && 1/f[3]>0 && f[4]==1.5 && f[5]==3 && isNaN(f[6]) && isNaN(f[7]));
+// only sort the part of the buffer the view covers
+var buf = new Uint16Array([9,8,7,6,5,4]);
+new Uint16Array(buf.buffer, 2, 4).sort();
+r.push(buf.join(",")=="9,5,6,7,8,4");
+// views with an offset and no length stop at the end of the buffer
+var ab = new ArrayBuffer(200), o = new Uint8Array(ab, 100);
+for (i=0;i<o.length;i++) o[i] = (i*37)&255;
+o.sort();
+r.push(o.length==100 && sorted(o) && new Uint8Array(ab,0,100).join("")==new Uint8Array(100).join(""));
+var bad = 0;
+[[150,100],[300],[2,100]].forEach(function(args) {
+  try { new Uint16Array(ab, args[0], args[1]); } catch (e) { bad++; }
+});
+r.push(bad==3);
+// sorted already, reversed and all equal shouldn't be a problem
+var big = new Int16Array(1000);
+for (i=0;i<big.length;i++) big[i] = 1000-i;
+r.push(sorted(big.sort()) && sorted(big.sort()));
+big.fill(5);
+r.push(sorted(big.sort()));
+
+// Arrays
+r.push([10,9,1,100].sort().join(",")=="1,10,100,9");
+r.push(["b","c","a"].sort().join(",")=="a,b,c");
+var u = [3,undefined,1,,2].sort();
+r.push(u.length==5 && u[0]==1 && u[1]==2 && u[2]==3 && u[3]===undefined && !(4 in u));
+var o1 = {n:1}, o2 = {n:2}, o3 = {n:3};
+var objs = [o1,o2,"[object Object]",o3].sort(); // all the same string - should be stable
+r.push(objs[0]===o1 && objs[1]===o2 && objs[3]===o3);
+var m = [3,2,1]; m.foo = "bar";
+m.sort();
+r.push(m.join(",")=="1,2,3" && m.foo=="bar");
+var q = [5,4,3,2,1]; q.shift();
+r.push(q.sort().join(",")=="1,2,3,4" && q.length==4);
+r.push([5,3,4].sort(function(a,b) { return b-a; }).join(",")=="5,4,3");
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
@@ -0,0 +1,35 @@
+// ArrayBuffers and typed arrays bigger than 64kB (LARGE_ARRAYBUFFERS on Linux)
+
+var r = [];
+var a = new Float32Array(300000);
+r.push(a.length==300000 && a.byteLength==1200000);
+for (var i=0;i<a.length;i+=1000) a[i] = i;
+a[299999] = 7;
+r.push(a[299000]==299000 && a[299999]==7 && E.sum(a)==44850007);
+
+// views a long way into the buffer
+var v = new Float32Array(a.buffer, 800000, 1000);
+r.push(v.length==1000 && v.byteOffset==800000 && v[0]==200000);
+v[1] = 42;
+r.push(a[200001]==42);
+
+// copying, slicing and other element types
+var u = new Uint8Array(100000);
+u.fill(3);
+r.push(E.sum(u)==300000 && u.slice(99990).length==10);
+var c = new Uint8Array(u);
+r.push(c.length==100000 && c[99999]==3);
+var w = new Int16Array(200000);
+w[199999] = -5;
+r.push(w[199999]==-5 && new DataView(w.buffer).getInt16(399998, true)==-5);
+var o = { arr : w };
+r.push(JSON.stringify(Object.keys(o))=='["arr"]' && o.arr.length==200000);
+
+// too big
+var err = false;
+try { new Float64Array(0x20000000); } catch (e) { err = true; }
+r.push(err);
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
@@ -0,0 +1,40 @@
+// btoa/atob, E.toBase64/fromBase64 and E.toHex/fromHex
+var errors = [];
+function test(a,b) { if (a!==b) errors.push(JSON.stringify(a)+" should be "+JSON.stringify(b)); }
+
+test(btoa("Hello"),"SGVsbG8=");
+test(btoa("Hell"),"SGVsbA==");
+test(btoa("Hel"),"SGVs");
+test(btoa(""),"");
+test(btoa([1,2,3,4]),"AQIDBA==");
+test(atob("SGVsbG8="),"Hello");
+test(atob("SGVs bA"),"Hell"); // whitespace ignored, no padding
+test(E.fromBase64("-_8"),"\xfb\xff"); // URL-safe
+
+// big enough to use flat strings/ArrayBuffers
+var s = "";
+for (var i=0;i<1000;i++) s+=String.fromCharCode((i*7)&255);
+var u = new Uint8Array(1000);
+for (var i=0;i<1000;i++) u[i] = (i*7)&255;
+test(atob(btoa(s)),s);
+test(btoa(u),btoa(s));
+test(E.toHex(u),E.toHex(s));
+test(E.fromHex(E.toHex(s)),s);
+
+test(E.toHex([1,2,255]),"0102ff");
+test(E.fromHex("01 02 FF"),"\x01\x02\xff");
+
+// decoding/encoding into existing buffers
+var tgt = new Uint8Array(10);
+test(E.fromHex("0102030405",tgt,2),5);
+test(tgt.join(","),"0,0,1,2,3,4,5,0,0,0");
+test(E.toBase64("Hello",tgt),8);
+test(E.toString(tgt),"SGVsbG8=\x00\x00");
+test(E.fromBase64("SGVsbG8=",tgt,8),2); // truncated - no space
+test(tgt[8]+","+tgt[9],"72,101");
+var w = new Uint16Array(4);
+test(E.fromHex("0102ff",w,1),3);
+test(w.join(","),"0,1,2,255");
+
+if (errors.length) console.log(errors);
+result = errors.length==0;
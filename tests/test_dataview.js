@@ -0,0 +1,24 @@
+// DataView - mixed types and byte orders on one ArrayBuffer
+var b = new ArrayBuffer(16);
+var d = new DataView(b);
+d.setInt16(0, -2, true);
+d.setUint16(2, 0x1234);
+d.setFloat32(4, 1.5, true);
+d.setFloat64(8, -3.25);
+var bytes = [].slice.call(new Uint8Array(b));
+
+var ok = JSON.stringify(bytes)=="[254,255,18,52,0,0,192,63,192,10,0,0,0,0,0,0]";
+ok = ok && d.getInt16(0,true)==-2 && d.getUint16(0,true)==65534;
+ok = ok && d.getUint16(2)==0x1234 && d.getUint16(2,true)==0x3412;
+ok = ok && d.getFloat32(4,true)==1.5 && d.getFloat64(8)==-3.25;
+ok = ok && d.getInt8(0)==-2 && d.getUint8(0)==254;
+d.setUint32(0, 0xDEADBEEF);
+ok = ok && d.getUint32(0)==0xDEADBEEF && d.getInt32(0)==(0xDEADBEEF|0);
+
+// views with an offset
+var d2 = new DataView(b, 2, 4);
+ok = ok && d2.byteOffset==2 && d2.byteLength==4 && d2.getUint16(0)==0xBEEF;
+try { d2.getUint32(2); ok = false; } catch (e) { }
+try { new DataView([1,2]); ok = false; } catch (e) { }
+
+result = ok;
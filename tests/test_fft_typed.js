@@ -0,0 +1,61 @@
+// In-place FFTs on typed arrays should match the double precision version
+
+function close(a,b,eps) {
+  for (var i=0;i<a.length;i++) if (!(Math.abs(a[i]-b[i])<=eps)) return false;
+  return true;
+}
+
+var r = [];
+[4,64,256].forEach(function(N) {
+  var x = [], xi = [];
+  for (var i=0;i<N;i++) {
+    x.push(Math.sin(i*0.7) + 0.3*Math.cos(i*2.1) + (i%5)*0.1);
+    xi.push(Math.cos(i*0.3));
+  }
+  // real input only - result is the magnitude
+  var ref = x.slice(); E.FFT(ref);
+  var f = new Float32Array(x); E.FFT(f);
+  r.push(close(ref,f,1e-5));
+  ref = x.slice(); E.FFT(ref, undefined, true);
+  f = new Float32Array(x); E.FFT(f, undefined, true);
+  r.push(close(ref,f,1e-3));
+  // complex
+  var rr = x.slice(), ri = xi.slice(); E.FFT(rr, ri);
+  var fr = new Float32Array(x), fi = new Float32Array(xi); E.FFT(fr, fi);
+  r.push(close(rr,fr,1e-5) && close(ri,fi,1e-5));
+  // and back again
+  E.FFT(fr, fi, true);
+  r.push(close(fr,x,1e-4) && close(fi,xi,1e-4));
+  // fixed point
+  var qr = new Int16Array(N), qi = new Int16Array(N);
+  for (i=0;i<N;i++) { qr[i] = x[i]*10000; qi[i] = xi[i]*10000; }
+  E.FFT(qr, qi);
+  var er = [], ei = [];
+  for (i=0;i<N;i++) { er.push(qr[i]/10000); ei.push(qi[i]/10000); }
+  r.push(close(er,rr,2e-3) && close(ei,ri,2e-3));
+  // magnitude/power outputs
+  var mag = new Float32Array(N), pow = new Array(N).fill(0);
+  E.FFT(new Float32Array(x), new Float32Array(xi), false, {magnitude:mag, power:pow});
+  var ok = true;
+  for (i=0;i<N;i++) {
+    var p = rr[i]*rr[i] + ri[i]*ri[i];
+    if (Math.abs(mag[i]-Math.sqrt(p))>1e-5 || Math.abs(pow[i]-p)>1e-5) ok = false;
+  }
+  r.push(ok);
+});
+
+// plain arrays with an imaginary part get the real part back, not the magnitude
+var a = [1,0,0,0], b = [0,0,0,0];
+E.FFT(a, b);
+r.push(a.join(",")=="0.25,0.25,0.25,0.25" && b.join(",")=="0,0,0,0");
+
+// a view with an offset and no length only covers the end of its buffer
+var ab = new ArrayBuffer(256), ov = new Float32Array(ab, 128);
+for (var i=0;i<ov.length;i++) ov[i] = Math.sin(i);
+var ref = [].slice.call(ov);
+E.FFT(ov); E.FFT(ref);
+r.push(ov.length==32 && close(ov,ref,1e-5) && new Float32Array(ab,0,32).join(",")==new Float32Array(32).join(","));
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
@@ -0,0 +1,97 @@
+// Stateful FIR and biquad filters, compared against the same filters in JS
+
+function close(a, b) {
+  if (a.length != b.length) return false;
+  for (var i=0;i<a.length;i++)
+    if (Math.abs(a[i]-b[i]) > 0.0001*(1+Math.abs(b[i]))) return false;
+  return true;
+}
+function jsFIR(c, x) {
+  var y = [];
+  for (var n=0;n<x.length;n++) {
+    var s = 0;
+    for (var k=0;k<c.length;k++) if (n-k>=0) s += c[k]*x[n-k];
+    y.push(s);
+  }
+  return y;
+}
+function jsBiquad(c, x) {
+  for (var sec=0;sec<c.length;sec+=5) {
+    var y = [], x1=0, x2=0, y1=0, y2=0;
+    for (var n=0;n<x.length;n++) {
+      var v = c[sec]*x[n] + c[sec+1]*x1 + c[sec+2]*x2 - c[sec+3]*y1 - c[sec+4]*y2;
+      x2 = x1; x1 = x[n]; y2 = y1; y1 = v;
+      y.push(v);
+    }
+    x = y;
+  }
+  return x;
+}
+
+var r = [];
+var input = [];
+for (var i=0;i<100;i++) input.push(Math.sin(i*0.3)*10 + ((i*7)%5));
+
+// FIR, run in two halves to check the state carries over
+var fc = [0.1, 0.2, 0.4, 0.2, 0.1, -0.05, 0.03];
+var fir = new Filter({fir:fc});
+var a = new Float32Array(input.slice(0,50)), b = new Float32Array(input.slice(50));
+var out = new Float32Array(100);
+fir.process(a, new Float32Array(out.buffer, 0, 50));
+fir.process(b, new Float32Array(out.buffer, 200, 50));
+r.push(close(out, jsFIR(fc, input)));
+
+// biquad cascade, processed in place, and then one sample at a time
+var bc = [0.2, 0.4, 0.2, -0.5, 0.3,   1, -1.8, 1, -1.6, 0.8];
+var iir = new Filter({biquad:bc});
+var io = new Float32Array(input);
+iir.process(io);
+r.push(close(io, jsBiquad(bc, input)));
+iir.reset();
+var s = input.map(function(v) { return iir.sample(v); });
+r.push(close(s, jsBiquad(bc, input)));
+
+// integer arrays and plain arrays
+var i16 = new Int16Array(input);
+var o16 = new Int16Array(100);
+fir.reset();
+fir.process(i16, o16);
+var expected = jsFIR(fc, [].slice.call(i16)).map(function(v) { return v|0; });
+var ok = true;
+for (i=0;i<100;i++) if (Math.abs(o16[i]-expected[i])>1) ok = false;
+r.push(ok);
+var plain = [1,2,3];
+new Filter({fir:[1,1]}).process(plain);
+r.push(plain.join(",")=="1,3,5");
+
+// a Waveform's buffer can be used directly
+var w = new Waveform(8, {bits:16});
+for (i=0;i<8;i++) w.buffer[i] = i*100;
+var wo = new Float32Array(8);
+new Filter({fir:[1,-1]}).process(w, wo);
+r.push(wo.join(",")=="0,100,100,100,100,100,100,100");
+
+// a view with an offset and no length only covers the end of its buffer
+var ab = new ArrayBuffer(400), ov = new Float32Array(ab, 200);
+ov.fill(1);
+new Filter({fir:[2]}).process(ov);
+r.push(ov.length==50 && ov.join(",")==new Float32Array(50).fill(2).join(",") && new Float32Array(ab, 0, 50).join(",")==new Float32Array(50).join(","));
+
+// values too big for an integer wrap just like they do from JS
+var huge = new Int32Array(3);
+new Filter({fir:[1e30]}).process(new Float32Array([1, -1, 0]), huge);
+var wrap = new Uint8Array(1);
+new Filter({fir:[300]}).process([1], wrap);
+r.push(huge.join(",")=="0,0,0" && wrap[0]==44);
+
+// errors
+var err = 0;
+try { new Filter({fir:[]}); } catch (e) { err++; }
+try { new Filter({biquad:[1,2,3]}); } catch (e) { err++; }
+try { new Filter(); } catch (e) { err++; }
+try { fir.process("x", 5); } catch (e) { err++; }
+r.push(err==4);
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
@@ -0,0 +1,48 @@
+// Correctly rounded string to number conversion, and numbers surviving a round trip through a string
+var errors = [];
+function test(str, expected) {
+  [parseFloat(str), Number(str), JSON.parse(str), eval(str)].forEach(function(v) {
+    if (v!==expected) errors.push(str+" gave "+v+", expected "+expected);
+  });
+}
+
+test("0.1", 1/10);
+test("3.14159", 314159/100000);
+test("123.456", 123456/1000);
+test("9007199254740993", 9007199254740992); // halfway - round to even
+test("9007199254740995", 9007199254740996);
+test("0.30000000000000004", 0.1+0.2);
+test("1e23", 1e22*10);
+test("1e-7", 1/1e7);
+test("1.7976931348623157e308", Number.MAX_VALUE);
+test("1.7976931348623159e308", Infinity);
+test("5e-324", Math.pow(2,-1074)); // smallest subnormal
+test("2.4703282292062327e-324", 0); // just under halfway to the smallest subnormal
+test("2.4703282292062328e-324", Math.pow(2,-1074));
+test("1e-400", 0);
+// leading zeros
+test("0", 0);
+test("-0", -0);
+test("0.5", 1/2);
+test("0e5", 0);
+[parseFloat("00"), Number("00"), parseFloat(" 0"), parseFloat("0abc"), "0"*1].forEach(function(v, i) {
+  if (v!==0) errors.push("leading zero "+i+" gave "+v);
+});
+if (1/parseFloat("-0")!==-Infinity) errors.push("parseFloat('-0') isn't -0");
+// more digits than fit in 64 bits
+test("1.00000000000000011102230246251565404236316680908203125", 1); // exactly halfway - round to even
+test("1.00000000000000011102230246251565404236316680908203126", 1+Math.pow(2,-52));
+
+// anything should be read back exactly from its string form
+var dv = new DataView(new ArrayBuffer(8));
+var seed = 1;
+for (var i=0;i<200;i++) {
+  seed = (seed*1103515245 + 12345) & 0x7FFFFFFF;
+  dv.setUint32(0, (seed*7) & 0x7FEFFFFF);
+  dv.setUint32(4, seed ^ 0x55AA55AA);
+  var v = dv.getFloat64(0);
+  if (parseFloat(""+v)!==v) errors.push("Round trip of "+v+" failed");
+}
+
+if (errors.length) console.log(errors);
+result = errors.length==0 && (0.1+0.2)+""=="0.30000000000000004" && 1e21+""=="1e+21";
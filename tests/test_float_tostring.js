@@ -0,0 +1,58 @@
+// Numbers are converted to the shortest string that reads back as the same number
+var ok = true;
+function check(a, b) {
+  if (String(a)!==b || JSON.stringify(a)!==b) {
+    ok = false;
+    console.log(JSON.stringify(b), "got", String(a), JSON.stringify(a));
+  }
+}
+
+check(0.1+0.2, "0.30000000000000004");
+check(1/3, "0.3333333333333333");
+check(2/3, "0.6666666666666666");
+check(1/7, "0.14285714285714285");
+check(Math.PI, "3.141592653589793");
+check(0.1, "0.1");
+check(4.35, "4.35");
+check(123.456, "123.456");
+check(100, "100");
+check(-0.00001234, "-0.00001234");
+
+// extremes
+check(5e-324, "5e-324");
+check(1.2e-322, "1.2e-322");
+check(2.2250738585072014e-308, "2.2250738585072014e-308");
+check(1.7976931348623157e+308, "1.7976931348623157e+308");
+check(1e100, "1e+100");
+
+// fixed notation up to (but not including) 1e21
+check(1e20, "100000000000000000000");
+check(123456789012345.67e6, "123456789012345670000");
+check(9.999999999999999e20, "999999999999999900000");
+check(1e21, "1e+21");
+check(1.5e21, "1.5e+21");
+check(-1e21, "-1e+21");
+
+// and down to 1e-6
+check(1e-6, "0.000001");
+check(0.0000015, "0.0000015");
+check(0.000123, "0.000123");
+check(9.99e-7, "9.99e-7");
+check(5e-7, "5e-7");
+check(1e-7, "1e-7");
+check(1.5e-7, "1.5e-7");
+check(-1.5e-7, "-1.5e-7");
+check(1e-10, "1e-10");
+check(123e-20, "1.23e-18");
+
+// everything reads back as the same number
+var x = 1;
+for (var i=0;i<200;i++) {
+  x = x*1.7 + 1/(i+3);
+  if (parseFloat(String(x))!==x || parseFloat(String(1/x))!==1/x) {
+    ok = false;
+    console.log("round trip", x);
+  }
+}
+
+result = ok;
@@ -0,0 +1,50 @@
+// JSON.createParser - parse JSON that arrives in chunks
+
+var doc = '{"a":[1,-2.5,3e2,true,false,null],"b":"x\\"y\\u0041\\n","c":{},"d":[],"e":{"f":[{"g":1}]}}';
+var values = [];
+var p = JSON.createParser();
+p.on('value', function(v, path) { values.push(v); });
+// split at every possible place
+for (var i=0;i<doc.length;i++) {
+  p.write(doc.substr(0,i));
+  p.write(doc.substr(i));
+}
+p.write(' 42 '); // several documents one after the other
+p.write('[1,2');
+p.write('3]');
+
+var items = [];
+var q = JSON.createParser({depth:1});
+q.on('value', function(v, path) { items.push(JSON.stringify(path)+"="+JSON.stringify(v)); });
+q.write('[{"a":1},');
+q.write('{"a":2},"hello"]');
+q.write('{"x":1,"y":[2]}');
+
+var errors = 0;
+var r = JSON.createParser();
+r.on('value', function(v) { values.push(v); });
+try { r.write('[1,,2]'); } catch (e) { errors++; }
+r.write('7'); // parser was reset after the error
+r.end(); // a number is only known to be complete at the end
+r.write('[1');
+try { r.end(); } catch (e) { errors++; }
+try { r.write('nul'); r.end(); } catch (e) { errors++; }
+try { r.write('1.2.3 '); } catch (e) { errors++; }
+try { r.write('[01]'); } catch (e) { errors++; }
+try { r.write('-'); r.end(); } catch (e) { errors++; }
+r.write('-0.5e+1 '); // but valid numbers are fine
+
+// values are emitted from inside write, so the listener can't write to the same parser
+var reentrant = JSON.createParser();
+reentrant.on('value', function(v) { reentrant.write('1'); });
+try { reentrant.write('[1]'); } catch (e) { errors++; }
+
+var expected = JSON.stringify(JSON.parse(doc));
+var ok = values.length == doc.length+4;
+for (var i=0;i<doc.length;i++)
+  if (JSON.stringify(values[i])!=expected) ok = false;
+ok = ok && values[doc.length]===42 && values[doc.length+1].length==2 && values[doc.length+1][1]==23;
+ok = ok && values[doc.length+2]===7 && values[doc.length+3]===-5;
+result = ok && errors==7 &&
+  items.join(",")=='[0]={"a":1},[1]={"a":2},[2]="hello",["x"]=1,["y"]=[2]';
+if (!result) console.log(values.slice(doc.length), items, errors);
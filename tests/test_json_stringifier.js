@@ -0,0 +1,85 @@
+// JSON.createStringifier - produce JSON a piece at a time
+
+var long = "";
+for (var i=0;i<100;i++) long += "ab\"c\n";
+var data = {
+  a : [1,2.5,"x",undefined,null,true,[],{},[[3]]],
+  b : "short",
+  "c d" : long,
+  e : { f : function() {}, g : undefined, h : new Uint8Array([1,2,3,4,5,6,7,8,9,10]), i : new Uint8Array(4) },
+  5 : [long,long],
+  j : new Float32Array(40)
+};
+data.j[39] = 1.5;
+var expected = JSON.stringify(data);
+
+function readAll(d, chars) {
+  var s = JSON.createStringifier(d), r, all = "", n = 0;
+  while ((r = s.read(chars)) !== undefined) {
+    all += r;
+    if (r.length > chars+20) return "TOO LONG "+r.length;
+    if (n++ > 100000) return "NEVER ENDS";
+  }
+  return all;
+}
+
+var ok = true;
+[1,2,3,7,16,64,1000].forEach(function(chars) {
+  var s = readAll(data, chars);
+  if (s != expected) {
+    ok = false;
+    console.log("Chunk size "+chars+" gave\n"+s+"\nexpected\n"+expected);
+  }
+});
+[1,"hello",undefined,null,[],{},[1,[2,[3]]],new Uint8Array(3)].forEach(function(d) {
+  if (readAll(d, 2) != JSON.stringify(d)) {
+    ok = false;
+    console.log("Got "+readAll(d, 2)+" for "+JSON.stringify(d));
+  }
+});
+// sparse arrays, and arrays big enough that searching for each element would be slow
+var sparse = [1,,3];
+sparse[9] = 10;
+var big = [];
+for (var i=0;i<2000;i++) big.push(i);
+if (readAll(sparse, 3) != JSON.stringify(sparse) ||
+    readAll(big, 5) != JSON.stringify(big)) ok = false;
+// recursion doesn't go on forever
+var rec = {a:1};
+rec.b = rec;
+if (readAll(rec, 4) != JSON.stringify(rec)) ok = false;
+// the value shouldn't be changed while it's written, but if it is we mustn't crash
+var changing = {a:long, b:1, c:2, d:[long, 1, 2]};
+var cs = JSON.createStringifier(changing);
+cs.read(10); // part way through 'a', so the next child is 'b'
+delete changing.b;
+delete changing.c;
+changing.e = 3;
+process.memory(); // garbage collect
+var rest = cs.read(2000), more;
+while ((more = cs.read(100)) !== undefined) rest += more;
+if (rest.indexOf('"b"')>=0 || rest.indexOf('"c"')>=0) ok = false;
+var ca = [long, 1, 2, 3];
+cs = JSON.createStringifier(ca);
+cs.read(10);
+ca.length = 1;
+process.memory();
+while (cs.read(100) !== undefined);
+
+// pipe to something with backpressure
+var piped = "", writes = 0;
+var dest = {
+  write : function(d) {
+    piped += d;
+    writes++;
+    var self = this;
+    setTimeout(function() { self.emit('drain', self); }, 1); // like Socket, pass the destination
+    return false;
+  },
+  end : function() {
+    clearInterval(keepAlive);
+    result = ok && piped==expected && writes > 10;
+  }
+};
+var keepAlive = setInterval(function(){}, 10); // so the test doesn't stop while we wait for 'drain'
+JSON.createStringifier(data).pipe(dest, {chunkSize:64});
@@ -0,0 +1,39 @@
+#!/bin/bash
+# Runs tests in several isolated interpreter contexts at once (one thread each).
+# Every context has its own heap and globals, so they shouldn't see each other.
+#
+# Run from the Espruino root directory after building: tests/test_linux_contexts.sh
+
+ESPRUINO=${ESPRUINO:-./espruino}
+CONTEXTS=${CONTEXTS:-8}
+TESTDIR=`mktemp -d`
+trap "rm -rf $TESTDIR" EXIT
+
+cat > $TESTDIR/test_isolated.js <<JS
+var id = Math.random();
+var count = 0;
+var interval = setInterval(function() {
+  if (id === global.id) count++;
+  else count = -1000; // another context has overwritten our global
+  if (count>=20) {
+    clearInterval(interval);
+    result = count==20;
+  }
+}, 1);
+JS
+
+FAIL=0
+for TEST in $TESTDIR/test_isolated.js tests/test_promise_microtask.js tests/test_json_object.js tests/test_settimeout_cleartimeout.js tests/test_garbage_collection.js; do
+  $ESPRUINO --test-contexts $CONTEXTS $TEST </dev/null | grep -q "PASS $TEST"
+  if [ $? -ne 0 ]; then
+    echo "FAIL $TEST"
+    FAIL=1
+  fi
+done
+
+if [ $FAIL -eq 0 ]; then
+  echo "PASS test_linux_contexts"
+else
+  echo "FAIL test_linux_contexts"
+  exit 1
+fi
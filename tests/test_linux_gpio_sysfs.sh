@@ -0,0 +1,46 @@
+#!/bin/bash
+# Tests setWatch on Linux using a fake sysfs GPIO tree in a temp directory.
+# The GPIO watch thread should see the edges we make by writing to 'value'.
+#
+# Ordinary files never raise POLLPRI, so this only exercises the watch thread's
+# GPIO_WATCH_POLL_MS timeout path (not the kernel's edge notification). It does
+# check that once an edge is queued the main thread is woken to handle it
+# straight away, rather than whenever jshSleep next times out.
+#
+# Run from the Espruino root directory after building (with SYSFS_GPIO=1 if this
+# machine has no /sys/class/gpio): tests/test_linux_gpio_sysfs.sh
+
+ESPRUINO=${ESPRUINO:-./espruino}
+GPIODIR=`mktemp -d`
+trap "rm -rf $GPIODIR" EXIT
+
+touch $GPIODIR/export $GPIODIR/unexport
+mkdir $GPIODIR/gpio5
+echo "in" > $GPIODIR/gpio5/direction
+echo "none" > $GPIODIR/gpio5/edge
+echo "0" > $GPIODIR/gpio5/value
+
+cat > $GPIODIR/test.js <<JS
+var fs = require("fs");
+var edges = [];
+var maxDelay = 0;
+setWatch(function(e) {
+  edges.push(e.state);
+  maxDelay = Math.max(maxDelay, getTime()-e.time);
+}, D5, { repeat:true, edge:"both" });
+var edgeFile = fs.readFileSync("$GPIODIR/gpio5/edge").trim();
+setTimeout(function() { fs.writeFileSync("$GPIODIR/gpio5/value", "1"); }, 300);
+setTimeout(function() { fs.writeFileSync("$GPIODIR/gpio5/value", "0"); }, 600);
+setTimeout(function() {
+  clearWatch();
+  result = edgeFile=="both" && edges.length==2 && edges[0]==true && edges[1]==false && maxDelay<0.02;
+}, 900);
+JS
+
+ESPRUINO_SYSFS_GPIO_DIR=$GPIODIR $ESPRUINO --test $GPIODIR/test.js | grep -q "PASS $GPIODIR/test.js"
+if [ $? -eq 0 ]; then
+  echo "PASS test_linux_gpio_sysfs"
+else
+  echo "FAIL test_linux_gpio_sysfs"
+  exit 1
+fi
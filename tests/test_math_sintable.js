@@ -0,0 +1,30 @@
+// E.sinTable fills one period of a sine wave, and Math.exp/log still work
+var f = E.sinTable(new Float32Array(64));
+var maxErr = 0;
+for (var i=0;i<f.length;i++)
+  maxErr = Math.max(maxErr, Math.abs(f[i] - Math.sin(2*Math.PI*i/f.length)));
+
+var u = E.sinTable(new Uint8Array(4), 127, 128);
+var c = E.sinTable(new Float64Array(8), 2, 1, Math.PI/2); // cosine
+var cErr = 0;
+for (i=0;i<c.length;i++)
+  cErr = Math.max(cErr, Math.abs(c[i] - (1+2*Math.cos(2*Math.PI*i/c.length))));
+var big = E.sinTable(new Float64Array(10000));
+
+// large angles (FAST_MATH falls back to libm past 1e5, where its range reduction stops being accurate)
+var large = [[99999.5, 0.5104916150747798, -0.8598827309222711],
+             [100001.5, -0.9943286252966722, -0.1063512337287629],
+             [-3e6, 0.8784900581447479, 0.4777606280773224]];
+var largeOk = large.every(function(l) {
+  return Math.abs(Math.sin(l[0])-l[1]) < 1e-6 && Math.abs(Math.cos(l[0])-l[2]) < 1e-6;
+}) && Math.abs(Math.sin(1e20)+0.6452512852657808) < 1e-6 && Math.abs(Math.cos(1e20)) <= 1 &&
+     Math.abs(Math.tan(1e20)) < 1e6;
+
+var err = false;
+try { E.sinTable([1,2,3]); } catch (e) { err = true; }
+
+result = maxErr < 0.000001 && u.join()=="128,255,128,1" && cErr < 1e-7 &&
+         Math.abs(big[2500]-1) < 1e-7 && Math.abs(big[9999]-Math.sin(2*Math.PI*9999/10000)) < 1e-7 &&
+         largeOk && err &&
+         Math.abs(Math.exp(1)-Math.E) < 1e-8 && Math.abs(Math.log(Math.E)-1) < 1e-8 &&
+         Math.exp(-1000)==0 && Math.log(0)==-Infinity && isNaN(Math.log(-1));
@@ -0,0 +1,53 @@
+// E.matMul/matTranspose/matInverse and quaternion functions
+function near(a,b) {
+  if (a.length!=b.length) return false;
+  for (var i=0;i<a.length;i++) if (Math.abs(a[i]-b[i])>0.0001) return false;
+  return true;
+}
+
+var rot = new Float32Array([0,-1,0, 1,0,0, 0,0,1]);
+var v = new Float32Array([1,0,0]);
+var rv = E.matMul(rot, v, v);
+
+var a = new Float64Array([1,2,3,4]);
+var b = new Float64Array([5,6,7,8]);
+var ab = E.matMul(a, b, new Float64Array(4));
+E.matMul(a, b, a); // output aliases input
+
+var t = new Float32Array([1,2,3, 4,5,6, 7,8,9]);
+E.matTranspose(t);
+var t2 = E.matTranspose(new Float64Array([1,2,3,4]), new Float32Array(4));
+
+var m = new Float64Array([4,7,2, 3,6,1, 2,5,3]);
+var mi = E.matInverse(m, new Float64Array(9));
+var id = E.matMul(m, mi, new Float64Array(9));
+var m4 = new Float32Array([0,1,0,0, 1,0,0,0, 0,0,2,0, 0,0,0,4]); // needs pivoting
+E.matInverse(m4);
+var sing = E.matInverse(new Float32Array([1,2,2,4]));
+
+var s = Math.SQRT1_2;
+var qz = new Float64Array([s,0,0,s]); // 90 degrees about z
+var p = E.quatRotate(qz, new Float32Array([1,0,0]), new Float32Array(3));
+var q2 = E.quatMul(qz, qz, new Float64Array(4)); // 180 degrees about z
+var p2 = E.quatRotate(q2, new Float64Array([1,2,3]));
+var qn = E.quatNormalize(new Float32Array([2,0,0,0]));
+
+var err = 0;
+try { E.matMul([1,2,3,4], a, a); } catch (e) { err++; }
+try { E.matMul(new Float32Array(5), a, a); } catch (e) { err++; }
+try { E.matMul(a, b, new Int8Array(4)); } catch (e) { err++; }
+// arrays with more than 16 elements aren't truncated to a 4x4 matrix
+var bigErr = "";
+try { E.matTranspose(new Float32Array(25)); } catch (e) { bigErr = e.msg; }
+try { E.matMul(new Float64Array(16), new Float64Array(20), new Float64Array(20)); } catch (e) { err++; }
+try { E.quatNormalize(new Float32Array(20)); } catch (e) { err++; }
+
+result = rv===v && near(v,[0,1,0]) &&
+         near(ab,[19,22,43,50]) && near(a,[19,22,43,50]) &&
+         near(t,[1,4,7, 2,5,8, 3,6,9]) && near(t2,[1,3,2,4]) &&
+         near(id,[1,0,0, 0,1,0, 0,0,1]) &&
+         near(m4,[0,1,0,0, 1,0,0,0, 0,0,0.5,0, 0,0,0,0.25]) &&
+         sing===undefined &&
+         near(p,[0,1,0]) && near(q2,[0,0,0,1]) && near(p2,[-1,-2,3]) &&
+         near(qn,[1,0,0,0]) &&
+         err==5 && bigErr.indexOf("4x4 matrix")>=0 && bigErr.indexOf("25")>=0;
@@ -0,0 +1,28 @@
+// E.pack / E.unpack with Python struct-style format strings
+function arr(a) { return [].slice.call(a); }
+
+var little = E.unpack("<hHB", new Uint8Array([254,255,0x34,0x12,7]));
+var big = E.unpack(">hH", "\xff\xfe\x12\x34");
+var misc = E.unpack("<2B x ? c 3s", new Uint8Array([1,2,99,1,65,97,98,99]));
+var named = E.unpack("<id:H temp:h 3B acc:3b", new Uint8Array([1,0,0xff,0xff,9,9,9,1,2,0xff]));
+var offset = E.unpack("<B", new Uint8Array([1,2,3]), 2);
+var view = E.unpack(">HH", new Uint16Array([0x0102,0x0304]));
+
+var p1 = arr(E.pack("<HhB", [1,-2,3]));
+var p2 = arr(E.pack(">id:H temp:h", {id:1, temp:-2}));
+var p3 = arr(E.pack("<4s c ? x", ["ab","A",true]));
+var p4 = arr(E.pack("<v:2h", {v:[1,-1]}));
+var trip = E.unpack("<fdI", E.pack("<fdI",[1.5,Math.PI,4000000000]));
+
+var errors = 0;
+try { E.unpack("<I", "ab"); } catch (e) { errors++; }
+try { E.unpack("<q", "abcdefgh"); } catch (e) { errors++; }
+
+result = JSON.stringify(little)=="[-2,4660,7]" && JSON.stringify(big)=="[-2,4660]" &&
+         JSON.stringify(misc)=='[1,2,true,"A","abc"]' &&
+         JSON.stringify(named)=='{"id":1,"temp":-1,"acc":[1,2,-1]}' &&
+         JSON.stringify(offset)=="[3]" && JSON.stringify(view)=="[513,1027]" &&
+         p1.join()=="1,0,254,255,3" && p2.join()=="0,1,255,254" &&
+         p3.join()=="97,98,0,0,65,1,0" && p4.join()=="1,0,255,255" &&
+         trip[0]==1.5 && trip[1]==Math.PI && trip[2]==4000000000 &&
+         errors==2;
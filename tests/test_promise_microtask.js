@@ -0,0 +1,28 @@
+// Promise callbacks run as microtasks - straight after the current callback, before other timers/events
+var order = [];
+
+setTimeout(function() {
+  order.push("timeout1");
+  Promise.resolve("A").then(function(v) {
+    order.push("then"+v);
+    // microtasks queued from a microtask still run before the next timer
+    Promise.reject("B").catch(function(v) { order.push("catch"+v); });
+  });
+}, 1);
+setTimeout(function() {
+  order.push("timeout2");
+}, 1);
+
+Promise.resolve("C").then(function(v) { order.push("then"+v); });
+order.push("sync");
+
+// lots of queued microtasks, with a garbage collection while they're waiting
+var count = 0;
+for (var i=0;i<20;i++)
+  Promise.resolve({n:i}).then(function(v) { count += v.n; });
+process.memory();
+
+setTimeout(function() {
+  result = order == "sync,thenC,timeout1,thenA,catchB,timeout2" && count==190;
+  if (!result) console.log(""+order);
+}, 20);
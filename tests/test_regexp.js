@@ -0,0 +1,86 @@
+// RegExp literals, and String.match/replace/split with RegExps
+var mg = "a1b22c333".match(/\d+/g);
+var mnone = "abc".match(/x/g);
+var mstr = "abc".match("b.")[0];
+var m = /(\d+),(\d+)/.exec("pos 12,34");
+var unmatched = /(a)|(b)/.exec("b");
+
+var r1 = "Hello World".replace(/o/,"0");
+var r2 = "Hello World".replace(/o/g,"0");
+var r3 = "John Smith".replace(/(\w+)\s(\w+)/, "$2, $1");
+var r4 = "abc".replace(/b/, "[$`|$&|$'|$$]");
+var r5 = "a-b-c".replace(/-/g, function(m,i){ return "("+i+")"; });
+var r6 = "xyz".replace("y", function(m){ return m+m; });
+var r7 = "xAy".replace(/a/i, "b");
+
+var s1 = "1, 2,3".split(/, ?/);
+var s2 = "a1b2c".split(/(\d)/);
+var s3 = "abc".split(/(?:)/);
+var s4 = ["".split(/x/), "".split(/(?:)/)];
+
+var anchors = [/^abc$/i.test("ABC"), /^b/.test("a\nb"), /^b/m.test("a\nb"), /^$/.test("")];
+var dot = [/^a.c$/.test("abc"), /^a.c$/.test("a\nc")];
+var alt = /cat|dog|bird/.exec("hotdog")[0];
+var counted = [/x{2}/.exec("xxxx")[0], /x{2,3}/.exec("xxxx")[0], /x{2,}/.exec("xxxx")[0], /x{0,2}y/.exec("xxxy")[0]];
+var lazy = [/a.*?b/.exec("aXbYb")[0], /a.*b/.exec("aXbYb")[0], /a+?/.exec("aaa")[0]];
+var classes = [/[a-c]+/.exec("xxabcabd")[0], /[^a-c]+/.exec("abxyz")[0], /[\d.]+/.exec("v1.25x")[0]];
+var boundary = [/\bfoo\b/.test("a foo b"), /\bfoo\b/.test("afoob")];
+var escapes = [/a\/b/.test("a/b"), /[/]/.test("/"), /\x41B/.test("AB"), /\t/.test("\t")];
+var email = /(\w+)@(\w+)\.com/.exec("mail bob@example.com now");
+
+// lastIndex with the g flag
+var r = /o/g;
+var lastIndex = [r.exec("foo").index, r.lastIndex, r.exec("foo").index, r.exec("foo"), r.lastIndex];
+var str1 = [""+/ab+c/gi, new RegExp("a+","g").toString(), /a/.source, /a/mg.flags];
+var str2 = [new RegExp("a/b").toString(), new RegExp("a\\/b[/]").source, /a\/b/.source, ""+new RegExp(new RegExp("/")), new RegExp("\n").source];
+var str3 = new RegExp("a/b").exec("xa/b")[0];
+
+// '/' is still division after values
+var a = 4, g = 2;
+var division = [a/g/1, (a)/2, [4][0]/2, 10/2/5];
+
+// no catastrophic backtracking
+var s = "";
+for (var i=0;i<200;i++) s += "a";
+var linear = /(a+)+b/.test(s);
+
+// like JS, a repeat that matches nothing doesn't count (and groups are reset on each repeat)
+var empty1 = [/(a*)+b/.exec("b"), /(a*)*b/.exec("b"), /(?:(a)|b)+/.exec("ab"), /([^a]?)?$/.exec("a")];
+var empty2 = [/(?:(?:[^a]{0,}|(a)+)+|b)c/.exec("aabc"), /(?:(?:[^a]*|(a)+)+)*/.exec("aab")];
+var empty3 = [/(a*?)+?b/.exec("aab"), /(?:a?){2,}b/.exec("ab")[0]];
+var long = (s+"b"+s).replace(/a+/g, "x");
+
+// long chains of instructions that don't consume characters
+var chain = "";
+for (i=0;i<90;i++) chain += "a?";
+var chainMatch = new RegExp(chain+"b").exec("xaaab");
+chain = "";
+for (i=0;i<15;i++) chain = "("+chain+"a*)*";
+var nested = new RegExp(chain+"b").exec("aab");
+
+// Errors
+var errors = 0;
+["(a", "a)", "a**", "(a)\\1", "(?=a)", "[b-a]"].forEach(function(p) {
+  try { new RegExp(p); } catch (e) { errors++; }
+});
+
+result = JSON.stringify(mg)=='["1","22","333"]' && mnone===null && mstr=="bc" &&
+         JSON.stringify(m)=='["12,34","12","34"]' && m.index==4 && m.input=="pos 12,34" && m.length==3 &&
+         JSON.stringify(unmatched)=='["b",null,"b"]' && unmatched[1]===undefined &&
+         r1=="Hell0 World" && r2=="Hell0 W0rld" && r3=="Smith, John" && r4=="a[a|b|c|$]c" &&
+         r5=="a(1)b(3)c" && r6=="xyyz" && r7=="xby" &&
+         JSON.stringify(s1)=='["1","2","3"]' && JSON.stringify(s2)=='["a","1","b","2","c"]' &&
+         JSON.stringify(s3)=='["a","b","c"]' && JSON.stringify(s4)=='[[""],[]]' &&
+         anchors.join()=="true,false,true,true" && dot.join()=="true,false" && alt=="dog" &&
+         counted.join()=="xx,xxx,xxxx,xxy" && lazy.join()=="aXb,aXbYb,a" && classes.join()=="abcab,xyz,1.25" &&
+         boundary.join()=="true,false" && escapes.join()=="true,true,true,true" &&
+         JSON.stringify(email)=='["bob@example.com","bob","example"]' &&
+         JSON.stringify(lastIndex)=="[1,2,2,null,0]" &&
+         JSON.stringify(str1)=='["/ab+c/gi","/a+/g","a","mg"]' &&
+         JSON.stringify(str2)=='["/a\\\\/b/","a\\\\/b[/]","a\\\\/b","/\\\\//","\\\\n"]' && str3=="a/b" &&
+         division.join()=="2,2,2,1" && linear===false &&
+         JSON.stringify(empty1)=='[["b",""],["b",null],["ab",null],["",null]]' && empty1[1][1]===undefined &&
+         JSON.stringify(empty2)=='[["aabc",null],["aab",null]]' &&
+         JSON.stringify(empty3)=='[["aab","a"],"ab"]' && long=="xbx" &&
+         chainMatch[0]=="aaab" && nested[0]=="aab" && nested[15]=="aa" &&
+         errors==6;
@@ -0,0 +1,53 @@
+// Serial.setup's line/frameLength/framePrefix options, using the loopback devices
+
+// LoopbackB only buffers a few hundred characters, so send long lines 100 at a time
+var chunk = "", long = [];
+for (var i=0;i<100;i++) chunk += "x";
+for (i=0;i<11;i++) long.push(chunk);
+
+// each write is done separately, so lines/frames get split across them
+var tests = [
+  { name : "line", options : { line : "\n" },
+    writes : ["a\nb", "c\n\nd\n"], expected : ["a","bc","","d"] },
+  { name : "line \\r\\n", options : { line : "\r\n" },
+    writes : ["x\r", "\ny\r\r\n", "z\rq\r\n"], expected : ["x","y\r","z\rq"] },
+  { name : "frameLength", options : { frameLength : 4 },
+    writes : ["abcdef", "gh", "ijkl"], expected : ["abcd","efgh","ijkl"] },
+  { name : "framePrefix 1", options : { framePrefix : 1 },
+    writes : ["\x03ab", "c\x00\x02x", "y"], expected : ["abc","","xy"] },
+  { name : "framePrefix 2", options : { framePrefix : 2 },
+    writes : ["\x02", "\x00h", "i"], expected : ["hi"] },
+  { name : "overlong line", options : { line : "\n" },
+    writes : long.concat(["TAIL\nok\n"]), expected : ["ok"] },
+  { name : "overlong line \\r\\n", options : { line : "\r\n" },
+    writes : long.concat(["TAIL\r", "\nok\r\n"]), expected : ["ok"] },
+];
+
+var ok = true;
+var got;
+LoopbackB.on("line", function(l) { got.push(l); });
+LoopbackB.on("frame", function(f) { got.push(f); });
+
+function runTest(n) {
+  if (n >= tests.length) {
+    result = ok;
+    return;
+  }
+  var t = tests[n];
+  got = [];
+  LoopbackB.setup(9600, t.options);
+  var w = 0;
+  var interval = setInterval(function() {
+    if (w < t.writes.length) {
+      LoopbackA.write(t.writes[w++]);
+      return;
+    }
+    clearInterval(interval);
+    if (JSON.stringify(got) != JSON.stringify(t.expected)) {
+      ok = false;
+      console.log(t.name, "got", JSON.stringify(got), "expected", JSON.stringify(t.expected));
+    }
+    runTest(n+1);
+  }, 10);
+}
+runTest(0);
@@ -0,0 +1,16 @@
+// Check that lots of data written to a Serial port gets through the transmit buffer intact
+var fn = 'tests/test_serial_transmit.tmp';
+var fs = require('fs');
+fs.writeFileSync(fn, "");
+Serial1.setup(9600, { path : fn });
+
+var s = "";
+for (var i=0;i<100;i++) s += "Hello "+i+"\n";
+Serial1.write(s);
+Serial1.print("Done");
+Serial1.write([1,2,3]);
+
+setTimeout(function() {
+  result = fs.readFileSync(fn) == s+"Done\x01\x02\x03";
+  fs.unlink(fn);
+}, 500);
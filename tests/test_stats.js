@@ -0,0 +1,31 @@
+// E.stats, E.histogram and E.percentile
+function near(a,b) { return Math.abs(a-b) < 0.00001; }
+
+var s = E.stats([1,2,3,4]);
+var s2 = E.stats(new Int16Array([-5,10,0]));
+var se = E.stats([]);
+var sl = E.stats(new Float64Array([1e9+1,1e9+2,1e9+3]));
+
+var h1 = E.histogram([1,2,2,3,9], [0,2,4,6]);
+var h2 = E.histogram(new Uint8Array([0,1,2,3,4,5,6]), [0,1,3,6]); // uneven
+var out = [9,9,9,9];
+var h3 = E.histogram([0.1,0.2,0.3,0.7,1], [0,0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,1], new Uint8Array(10));
+var h4 = E.histogram([1,NaN,5], [0,2,4], out);
+
+var p = [5,1,4,2,3];
+var pc = [E.percentile(p,0), E.percentile(p,50), E.percentile(p,100), E.percentile(p,25), E.percentile([1,2,3,4],50), E.percentile(new Uint16Array([7]),90)];
+
+var big = new Float32Array(1001);
+for (var i=0;i<big.length;i++) big[i] = (i*7919)%1001;
+var pb = E.percentile(big,90);
+
+result = s.count==4 && s.mean==2.5 && s.variance==1.25 && s.min==1 && s.max==4 &&
+         s2.count==3 && near(s2.mean,5/3) && s2.min==-5 && s2.max==10 &&
+         se.count==0 && isNaN(se.mean) && isNaN(se.min) &&
+         near(sl.variance,2/3) &&
+         h1 instanceof Uint32Array && h1.join()=="1,3,0" &&
+         h2.join()=="1,2,4" &&
+         h3.join()=="0,1,1,1,0,0,0,1,0,1" &&
+         h4===out && out.join()=="1,0,9,9" &&
+         pc.join()=="1,3,5,2,2.5,7" &&
+         pb==900 && big[0]==0;
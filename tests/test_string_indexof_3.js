@@ -0,0 +1,33 @@
+// indexOf/lastIndexOf/split on long strings, both normal and flat (which are searched differently)
+var ok = true;
+function check(a,b,msg) { if (a!==b) { ok=false; console.log("FAIL",msg,a,b); } }
+var s = "";
+for (var i=0;i<300;i++) s += "line "+i+"\r\n";
+var flat = E.toString(s);
+[s, flat].forEach(function(str,n) {
+  check(str.indexOf("line 150\r\n"), s.indexOf("line 150\r\n"), "x");
+  var naive = function(a,b,from) { for (var i=from||0;i<=a.length-b.length;i++) if (a.substr(i,b.length)==b) return i; return -1; };
+  var naiveLast = function(a,b,from) { if (from===undefined) from=a.length; for (var i=Math.min(from,a.length-b.length);i>=0;i--) if (a.substr(i,b.length)==b) return i; return -1; };
+  ["line 299","\r\n","ine 1","line 300","e"," 7\r","line 12\r\nline 13\r\nline 14\r\nline 15\r\nline 16\r\nline 17\r\nline 18\r\nline 19","x"].forEach(function(q) {
+    [undefined,0,5,100,1000,3000,-5].forEach(function(f) {
+      check(str.indexOf(q,f), naive(s,q,f<0?0:f), n+" indexOf "+q+" "+f);
+      check(str.lastIndexOf(q,f), naiveLast(s,q,f<0?0:f), n+" lastIndexOf "+q+" "+f);
+    });
+  });
+  check(str.split("\r\n").length, 301, "split");
+  check(str.split("\r\n")[299], "line 299", "split2");
+  check(str.split("\r\n")[300], "", "split3");
+});
+check("a,b,,c".split(",").join("|"),"a|b||c","s4");
+check("abc".split("").join("|"),"a|b|c","s5");
+check("".split(",").length,1,"s6");
+check("abc".split("abc").join("|"),"|","s7");
+check("abc".indexOf(""),0,"e1");
+check("abc".lastIndexOf(""),3,"e2");
+check("abc".indexOf("c",3),-1,"e3");
+check("".indexOf("",5),0,"e4"); // fromIndex is clamped to the length
+check("ab".indexOf("",9),2,"e5");
+check("ab".lastIndexOf("",9),2,"e6");
+check("abc".indexOf("",1),1,"e7");
+check("hello world".replace("o","0"),"hell0 world","r1");
+result = ok;
@@ -0,0 +1,30 @@
+// Check the block-at-a-time string copying/appending used by native code
+var s = "";
+for (var i=0;i<1000;i++) s += String.fromCharCode(32+(i*7)%95);
+
+// substring copies (jsvAppendStringVar), checked against charAt
+var ok = true;
+[[0,1000],[1,999],[13,500],[300,17],[999,1],[1000,5]].forEach(function(p) {
+  var sub = s.substr(p[0],p[1]);
+  var exp = "";
+  for (var i=p[0];i<p[0]+p[1] && i<s.length;i++) exp += s.charAt(i);
+  if (sub!==exp) { ok = false; console.log("substr",p,"failed"); }
+});
+
+// E.toString / String concat of a long string
+var joined = [s,s].join("");
+ok = ok && joined.length==2000 && joined.substr(1000)==s;
+
+// btoa round trip, and for an array (non-string path)
+var b = btoa(s);
+ok = ok && b.length==Math.ceil(s.length/3)*4 && atob(b)==s;
+ok = ok && btoa("a")=="YQ==" && btoa("ab")=="YWI=" && btoa("abc")=="YWJj" && btoa("")=="";
+ok = ok && btoa([104,105,33])=="aGkh";
+
+// JSON escaping in batches
+var e = "Hello \"world\"\n\\"+s+"\x01\xFF";
+ok = ok && JSON.parse(JSON.stringify(e))==e;
+ok = ok && JSON.stringify("a\"b")=='"a\\"b"';
+ok = ok && JSON.stringify("a\0b")=='"a\\x00b"';
+
+result = ok;
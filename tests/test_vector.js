@@ -0,0 +1,110 @@
+// Element-wise maths on typed arrays, compared against plain JS loops
+
+function same(a, b) {
+  if (a.length != b.length) return false;
+  for (var i=0;i<a.length;i++)
+    if (a[i]!=b[i] && !(isNaN(a[i]) && isNaN(b[i]))) return false;
+  return true;
+}
+function jsOp(T, a, b, fn) {
+  var d = new T(Math.min(a.length, b.length));
+  for (var i=0;i<d.length;i++) d[i] = fn(a[i], b[i]);
+  return d;
+}
+
+var r = [];
+var types = [Int8Array, Uint8Array, Int16Array, Uint16Array, Int32Array, Uint32Array, Float32Array, Float64Array, Uint8ClampedArray];
+types.forEach(function(T) {
+  var a = new T([1, 100, -5, 127, 3.5, 0, 200, -128]);
+  var b = new T([2, 100, 7, 2, -1.5, 0, 100]);
+  var d = new T(a.length);
+  E.vecAdd(d, a, b);
+  r.push(same(d.slice(0,7), jsOp(T, a, b, function(x,y) { return x+y; })) && d[7]==0);
+  E.vecSub(d, a, b);
+  r.push(same(d.slice(0,7), jsOp(T, a, b, function(x,y) { return x-y; })));
+  E.vecMul(d, a, b);
+  r.push(same(d.slice(0,7), jsOp(T, a, b, function(x,y) { return x*y; })));
+  E.vecMul(d, a, 3);
+  r.push(same(d, jsOp(T, a, a, function(x) { return x*3; })));
+  E.vecScaleOffset(d, a, 0.5, 1);
+  r.push(same(d, jsOp(T, a, a, function(x) { return x*0.5+1; })));
+  E.vecClip(d, a, 0, 50);
+  r.push(same(d, jsOp(T, a, a, function(x) { return E.clip(x,0,50); })));
+  E.vecAbs(d, a);
+  r.push(same(d, jsOp(T, a, a, function(x) { return Math.abs(x); })));
+  var dot = 0;
+  for (var i=0;i<b.length;i++) dot += a[i]*b[i];
+  r.push(E.dot(a, b)==dot);
+  // in place
+  var c = new T(a);
+  E.vecAdd(c, c, 1);
+  r.push(same(c, jsOp(T, a, a, function(x) { return x+1; })));
+});
+
+// fractional scalar on an integer array goes the slow way
+var i16 = new Int16Array([10, 20, 30]);
+E.vecAdd(i16, i16, 0.5);
+r.push(same(i16, [10, 20, 30]));
+E.vecMul(i16, i16, 2.5);
+r.push(same(i16, [25, 50, 75]));
+
+// mixed types and plain arrays
+var f = new Float32Array(4);
+E.vecAdd(f, [1,2,3,4], new Int8Array([10,20,30,40]));
+r.push(same(f, [11,22,33,44]));
+var p = [0,0,0];
+E.vecMul(p, [1,2,3], [4,5,6]);
+r.push(same(p, [4,10,18]));
+r.push(E.dot([1,2,3], new Float64Array([4,5,6]))==32);
+
+// views onto part of a buffer
+var buf = new ArrayBuffer(16);
+var v = new Int16Array(buf, 2, 4);
+v.set([1,2,3,4]);
+E.vecScaleOffset(v, v, 2, 0);
+r.push(same(new Int16Array(buf), [0,2,4,6,8,0,0,0]));
+// ...and a view with an offset but no length, big enough to be stored in one block
+var big = new ArrayBuffer(200), o = new Uint8Array(big, 100);
+o.fill(1);
+E.vecAdd(o, o, 7);
+r.push(o.length==100 && same(o, jsOp(Uint8Array, o, o, function() { return 8; })) && E.minMax(new Uint8Array(big, 0, 100)).max==0);
+var of = new Float32Array(new ArrayBuffer(400), 200);
+of.fill(2);
+r.push(of.length==50 && E.dot(of, of)==200);
+
+// a long float dot product (summed in blocks)
+var l = new Float32Array(1000);
+l.fill(0.1);
+r.push(Math.abs(E.dot(l, l) - 10) < 0.001);
+
+// bigger arrays, which are stored in one block so use the fast path
+types.slice(0,8).forEach(function(T) {
+  var a = new T(300), b = new T(300), d = new T(300);
+  for (var i=0;i<300;i++) { a[i] = i*37-5000+i*i*13; b[i] = (i*91)%300-150; }
+  E.vecAdd(d, a, b);
+  r.push(same(d, jsOp(T, a, b, function(x,y) { return x+y; })));
+  E.vecScaleOffset(d, a, 0.37, -3);
+  r.push(same(d, jsOp(T, a, a, function(x) { return x*0.37-3; })));
+  E.vecClip(d, a, -100, 1000);
+  r.push(same(d, jsOp(T, a, a, function(x) { return E.clip(x,-100,1000); })));
+  r.push(E.minMax(a).min == E.minMax([].slice.call(a)).min);
+});
+
+// minMax
+var mm = E.minMax(new Int16Array([3, -1, 4, -1, 5, 9, 2, 9]));
+r.push(mm.min==-1 && mm.max==9 && mm.minIndex==1 && mm.maxIndex==5);
+mm = E.minMax([3, NaN, 0.5, 7]);
+r.push(mm.min==0.5 && mm.max==7 && mm.minIndex==2 && mm.maxIndex==3);
+mm = E.minMax(new Float32Array([2, -3.5]));
+r.push(mm.min==-3.5 && mm.max==2);
+r.push(E.minMax(new Uint8Array(0))===undefined && E.minMax([])===undefined);
+
+// errors
+var err = 0;
+try { E.vecAdd("hello", [1], [2]); } catch (e) { err++; }
+try { E.dot(1, [2]); } catch (e) { err++; }
+r.push(err==2);
+
+var pass = 0;
+r.forEach(function(n) { if (n) pass++; });
+result = pass==r.length;
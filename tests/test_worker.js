@@ -0,0 +1,55 @@
+// Worker threads with message passing (Linux only)
+var secret = 42;
+var w = new Worker(function() {
+  Worker.on('message', function(d) {
+    if (d.echo) return Worker.postMessage(d.echo);
+    var sum = 0;
+    for (var i=0;i<d.data.length;i++) sum += d.data[i];
+    Worker.postMessage({ id : d.id, sum : sum, data : d.data, secret : typeof secret });
+  });
+});
+var stuck = new Worker("while (true);");
+// the main thread is woken as soon as a message arrives, not when it next has a timer due
+var late = new Worker("setTimeout(function() { Worker.postMessage(getTime()); }, 100);");
+var lateDelay;
+late.on('message', function(t) { lateDelay = getTime()-t; });
+
+var reply, echo, echoBig;
+w.on('message', function(r) {
+  if (r.id) reply = r;
+  else if ("big" in r) echoBig = r;
+  else echo = r;
+});
+w.postMessage({ id : 1, data : new Float32Array([1, 2, 3.5]), fn : function() {} });
+// types JSON can't represent survive, and data is never evaluated
+var ov = new Uint16Array(new ArrayBuffer(10), 2, 3);
+ov.set([1, 65535, 3]);
+var big = new Float64Array(2000);
+for (var i=0;i<big.length;i++) big[i] = i/3;
+w.postMessage({ echo : { ov : ov, big : big } });
+w.postMessage({ echo : { date : new Date(1234567), u : undefined, nan : NaN, inf : -Infinity,
+                         arr : [1,,3], i16 : new Int16Array([-1,2]), ab : new Uint8Array([7,8]).buffer,
+                         $t : "u", $$x : 1, code : "secret=0" } });
+
+var threw = false;
+try { Worker.postMessage(1); } catch (e) { threw = true; }
+
+setTimeout(function() {
+  w.terminate();
+  stuck.terminate();
+  late.terminate();
+  var b = echoBig;
+  var bigOk = b && b.big instanceof Float64Array && b.big.length==2000 && b.big[1999]==1999/3 &&
+              b.ov instanceof Uint16Array && b.ov.length==3 && b.ov.buffer.length==6 && b.ov.join(",")=="1,65535,3";
+  var e = echo && echo.echo===undefined && echo;
+  result = reply && reply.id==1 && reply.sum==6.5 &&
+           reply.data instanceof Float32Array && reply.data.length==3 &&
+           reply.secret=="undefined" && threw &&
+           e && e.date instanceof Date && e.date.getTime()==1234567 &&
+           ("u" in e) && e.u===undefined && isNaN(e.nan) && e.inf==-Infinity &&
+           e.arr.length==3 && e.arr[1]===undefined && e.arr[2]==3 &&
+           e.i16 instanceof Int16Array && e.i16[0]==-1 && e.i16[1]==2 &&
+           e.ab instanceof ArrayBuffer && e.ab.length==2 && e.ab[1]==8 &&
+           e.$t=="u" && e.$$x==1 && e.code=="secret=0" && secret==42 &&
+           bigOk && lateDelay < 0.05;
+}, 500);